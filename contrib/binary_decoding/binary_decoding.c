@@ -0,0 +1,607 @@
+/*-------------------------------------------------------------------------
+ *
+ * binary_decoding.c
+ *		  logical decoding output plugin emitting changes in binary format
+ *
+ * Unlike test_decoding, which formats every column of every row as text,
+ * this plugin sends column values using the types' binary send functions,
+ * and describes each relation only once per decoding session, so it can be
+ * used to measure the throughput of logical decoding itself, and as a
+ * starting point for consumers that need efficient output.
+ *
+ * The output of a transaction is a sequence of messages, each starting with
+ * a one-byte message type. All integers are in network byte order, strings
+ * are null-terminated and in the database encoding.
+ *
+ *	'B' begin:		int64 final_lsn, int64 commit_time, int32 xid
+ *	'C' commit:		int64 commit_lsn, int64 end_lsn, int64 commit_time
+ *	'R' relation:	int32 relid, string nspname, string relname,
+ *					int16 natts, natts * (int8 flags, string attname,
+ *					int32 atttypid, int32 atttypmod)
+ *	'I' insert:		int32 relid, 'N' tuple
+ *	'U' update:		int32 relid, ['K' tuple], 'N' tuple
+ *	'D' delete:		int32 relid, ['K' tuple]
+ *	'M' message:	int8 transactional, int64 lsn, int32 size, size bytes
+ *
+ * A tuple is an int16 column count followed by one entry per column, which
+ * starts with 'n' for a NULL value, 'u' for an unchanged TOASTed value that
+ * is not part of the WAL record, 'b' for a value in binary format or 't' for
+ * one in text format (for types without a send function), the latter two
+ * followed by int32 length and the data. Dropped columns are not sent. Bit
+ * 1 of a relation column's flags is set if the column is part of the
+ * replica identity.
+ *
+ * A relation message is sent before the first change of each relation in a
+ * session, and again when the relation has been invalidated since. The
+ * messages of a transaction are batched into writes of up to "batch-size"
+ * bytes.
+ *
+ * Copyright (c) 2012-2014, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		  contrib/binary_decoding/binary_decoding.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/sysattr.h"
+
+#include "catalog/pg_type.h"
+
+#include "libpq/pqformat.h"
+
+#include "nodes/bitmapset.h"
+#include "nodes/parsenodes.h"
+
+#include "replication/logical.h"
+#include "replication/output_plugin.h"
+
+#include "utils/builtins.h"
+#include "utils/inval.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/relcache.h"
+#include "utils/syscache.h"
+
+
+PG_MODULE_MAGIC;
+
+/* These must be available to pg_dlsym() */
+extern void _PG_init(void);
+extern void _PG_output_plugin_init(OutputPluginCallbacks *cb);
+
+#define BINARY_DECODING_ATT_IDENTITY	0x01
+
+/* per-column output information, kept for each relation */
+typedef struct BinaryColumnInfo
+{
+	bool		dropped;
+	bool		binary;			/* use the send, not the output function */
+	FmgrInfo	func;
+} BinaryColumnInfo;
+
+/*
+ * Entry of the backend-wide relation cache, keyed by relation oid. The cache
+ * lives in CacheMemoryContext, so the relcache callback, which can't be
+ * unregistered, can safely access it even if a decoding session errored out
+ * without its shutdown callback being called.
+ */
+typedef struct BinaryRelationEntry
+{
+	Oid			relid;
+	bool		valid;			/* column info is up to date */
+	uint32		version;		/* incremented whenever column info is rebuilt */
+	int			natts;
+	int			nlive;			/* number of non-dropped columns */
+	MemoryContext context;		/* holds columns, reset on every rebuild */
+	BinaryColumnInfo *columns;
+} BinaryRelationEntry;
+
+/* per-session record of the relations described to the client */
+typedef struct BinarySentEntry
+{
+	Oid			relid;
+	uint32		version;		/* version of BinaryRelationEntry sent */
+} BinarySentEntry;
+
+typedef struct
+{
+	MemoryContext context;		/* reset after every change */
+	HTAB	   *sent;			/* BinarySentEntry by relation oid */
+	int			batch_size;
+} BinaryDecodingData;
+
+static HTAB *RelationCache = NULL;
+
+static void bd_startup(LogicalDecodingContext *ctx, OutputPluginOptions *opt,
+		   bool is_init);
+static void bd_shutdown(LogicalDecodingContext *ctx);
+static void bd_begin_txn(LogicalDecodingContext *ctx,
+			 ReorderBufferTXN *txn);
+static void bd_commit_txn(LogicalDecodingContext *ctx,
+			  ReorderBufferTXN *txn, XLogRecPtr commit_lsn);
+static void bd_change(LogicalDecodingContext *ctx,
+		  ReorderBufferTXN *txn, Relation rel,
+		  ReorderBufferChange *change);
+static void bd_message(LogicalDecodingContext *ctx,
+		   ReorderBufferTXN *txn, XLogRecPtr message_lsn,
+		   bool transactional, Size sz,
+		   const char *message);
+
+static void bd_invalidate_relation(Datum arg, Oid relid);
+static void bd_build_columns(BinaryRelationEntry *entry, TupleDesc desc);
+static BinaryRelationEntry *bd_get_relation(LogicalDecodingContext *ctx,
+				Relation relation);
+static void bd_maybe_flush(LogicalDecodingContext *ctx);
+static void bd_write_tuple(StringInfo out, BinaryRelationEntry *entry,
+			   TupleDesc desc, HeapTuple tuple);
+
+void
+_PG_init(void)
+{
+	/* other plugins can perform things here */
+}
+
+/* specify output plugin callbacks */
+void
+_PG_output_plugin_init(OutputPluginCallbacks *cb)
+{
+	AssertVariableIsOfType(&_PG_output_plugin_init, LogicalOutputPluginInit);
+
+	cb->startup_cb = bd_startup;
+	cb->begin_cb = bd_begin_txn;
+	cb->change_cb = bd_change;
+	cb->commit_cb = bd_commit_txn;
+	cb->shutdown_cb = bd_shutdown;
+	cb->message_cb = bd_message;
+}
+
+/* initialize this plugin */
+static void
+bd_startup(LogicalDecodingContext *ctx, OutputPluginOptions *opt,
+		   bool is_init)
+{
+	ListCell   *option;
+	BinaryDecodingData *data;
+	HASHCTL		ctl;
+
+	data = palloc0(sizeof(BinaryDecodingData));
+	data->context = AllocSetContextCreate(ctx->context,
+										  "binary decoding change context",
+										  ALLOCSET_DEFAULT_MINSIZE,
+										  ALLOCSET_DEFAULT_INITSIZE,
+										  ALLOCSET_DEFAULT_MAXSIZE);
+	data->batch_size = 65536;
+
+	ctx->output_plugin_private = data;
+
+	opt->output_type = OUTPUT_PLUGIN_BINARY_OUTPUT;
+
+	foreach(option, ctx->output_plugin_options)
+	{
+		DefElem    *elem = lfirst(option);
+
+		Assert(elem->arg == NULL || IsA(elem->arg, String));
+
+		if (strcmp(elem->defname, "batch-size") == 0)
+		{
+			if (elem->arg == NULL)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("parameter \"%s\" requires a value",
+								elem->defname)));
+
+			data->batch_size = pg_atoi(strVal(elem->arg), sizeof(int32), 0);
+			if (data->batch_size < 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("value \"%s\" for parameter \"%s\" is out of range",
+								strVal(elem->arg), elem->defname)));
+		}
+		else
+		{
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("option \"%s\" = \"%s\" is unknown",
+							elem->defname,
+							elem->arg ? strVal(elem->arg) : "(null)")));
+		}
+	}
+
+	/* relations are described anew in every session */
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(BinarySentEntry);
+	ctl.hash = oid_hash;
+	ctl.hcxt = ctx->context;
+	data->sent = hash_create("binary decoding sent relations", 128, &ctl,
+							 HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+
+	if (RelationCache == NULL)
+	{
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(BinaryRelationEntry);
+		ctl.hash = oid_hash;
+		ctl.hcxt = CacheMemoryContext;
+		RelationCache = hash_create("binary decoding relation cache", 128,
+									&ctl,
+									HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+
+		CacheRegisterRelcacheCallback(bd_invalidate_relation, (Datum) 0);
+	}
+
+	/*
+	 * The cached column info may stem from a different point in the catalog's
+	 * history than the one this session starts decoding at.
+	 */
+	bd_invalidate_relation((Datum) 0, InvalidOid);
+}
+
+/* cleanup this plugin's resources */
+static void
+bd_shutdown(LogicalDecodingContext *ctx)
+{
+	BinaryDecodingData *data = ctx->output_plugin_private;
+
+	/* cleanup our own resources via memory context reset */
+	MemoryContextDelete(data->context);
+	hash_destroy(data->sent);
+}
+
+/*
+ * Relcache invalidation callback: rebuild the relation's column info, and
+ * describe it to the client again, before its next change. This is invoked
+ * whenever the reorder buffer executes a transaction's invalidations, so a
+ * relation changed by DDL is re-described with its new definition.
+ */
+static void
+bd_invalidate_relation(Datum arg, Oid relid)
+{
+	HASH_SEQ_STATUS status;
+	BinaryRelationEntry *entry;
+
+	if (OidIsValid(relid))
+	{
+		entry = hash_search(RelationCache, &relid, HASH_FIND, NULL);
+		if (entry != NULL)
+			entry->valid = false;
+		return;
+	}
+
+	hash_seq_init(&status, RelationCache);
+	while ((entry = hash_seq_search(&status)) != NULL)
+		entry->valid = false;
+}
+
+/*
+ * Write whatever has been batched so far, and start a new batch, if the
+ * batch exceeds the configured size.
+ */
+static void
+bd_maybe_flush(LogicalDecodingContext *ctx)
+{
+	BinaryDecodingData *data = ctx->output_plugin_private;
+
+	if (ctx->out->len < data->batch_size)
+		return;
+
+	OutputPluginWrite(ctx, false);
+	OutputPluginPrepareWrite(ctx, false);
+}
+
+/* BEGIN callback */
+static void
+bd_begin_txn(LogicalDecodingContext *ctx, ReorderBufferTXN *txn)
+{
+	/* the batch stays open until the commit callback */
+	OutputPluginPrepareWrite(ctx, false);
+
+	pq_sendbyte(ctx->out, 'B');
+	pq_sendint64(ctx->out, txn->final_lsn);
+	pq_sendint64(ctx->out, txn->commit_time);
+	pq_sendint(ctx->out, txn->xid, 4);
+
+	bd_maybe_flush(ctx);
+}
+
+/* COMMIT callback */
+static void
+bd_commit_txn(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+			  XLogRecPtr commit_lsn)
+{
+	pq_sendbyte(ctx->out, 'C');
+	pq_sendint64(ctx->out, commit_lsn);
+	pq_sendint64(ctx->out, txn->end_lsn);
+	pq_sendint64(ctx->out, txn->commit_time);
+
+	OutputPluginWrite(ctx, true);
+}
+
+/*
+ * (Re-)build the per-column output information of a relation cache entry.
+ */
+static void
+bd_build_columns(BinaryRelationEntry *entry, TupleDesc desc)
+{
+	int			i;
+
+	/* free the previous column info, including what the FmgrInfos point to */
+	if (entry->context == NULL)
+		entry->context = AllocSetContextCreate(CacheMemoryContext,
+											   "binary_decoding relation",
+											   ALLOCSET_SMALL_MINSIZE,
+											   ALLOCSET_SMALL_INITSIZE,
+											   ALLOCSET_SMALL_MAXSIZE);
+	else
+		MemoryContextReset(entry->context);
+	entry->columns = NULL;
+	entry->valid = false;
+
+	entry->natts = desc->natts;
+	entry->nlive = 0;
+	entry->columns = MemoryContextAllocZero(entry->context,
+										 sizeof(BinaryColumnInfo) * desc->natts);
+
+	for (i = 0; i < desc->natts; i++)
+	{
+		Form_pg_attribute att = desc->attrs[i];
+		BinaryColumnInfo *col = &entry->columns[i];
+		HeapTuple	typtup;
+		Form_pg_type typform;
+		Oid			funcid;
+
+		if (att->attisdropped)
+		{
+			col->dropped = true;
+			continue;
+		}
+
+		typtup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(att->atttypid));
+		if (!HeapTupleIsValid(typtup))
+			elog(ERROR, "cache lookup failed for type %u", att->atttypid);
+		typform = (Form_pg_type) GETSTRUCT(typtup);
+
+		col->binary = OidIsValid(typform->typsend);
+		funcid = col->binary ? typform->typsend : typform->typoutput;
+
+		ReleaseSysCache(typtup);
+
+		fmgr_info_cxt(funcid, &col->func, entry->context);
+		entry->nlive++;
+	}
+
+	entry->valid = true;
+	entry->version++;
+}
+
+/*
+ * Look up the entry for relation, describing the relation to the client
+ * first if it hasn't been yet, or has changed since.
+ */
+static BinaryRelationEntry *
+bd_get_relation(LogicalDecodingContext *ctx, Relation relation)
+{
+	BinaryDecodingData *data = ctx->output_plugin_private;
+	Oid			relid = RelationGetRelid(relation);
+	TupleDesc	desc = RelationGetDescr(relation);
+	BinaryRelationEntry *entry;
+	BinarySentEntry *sent;
+	Bitmapset  *idattrs;
+	bool		found;
+	char	   *nspname;
+	char	   *relname;
+	int			i;
+
+	entry = hash_search(RelationCache, &relid, HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->valid = false;
+		entry->version = 0;
+		entry->context = NULL;
+		entry->columns = NULL;
+	}
+
+	if (!entry->valid || entry->natts != desc->natts)
+		bd_build_columns(entry, desc);
+
+	sent = hash_search(data->sent, &relid, HASH_ENTER, &found);
+	if (found && sent->version == entry->version)
+		return entry;
+
+	/* describe the relation to the client */
+	idattrs = RelationGetIndexAttrBitmap(relation,
+										 INDEX_ATTR_BITMAP_IDENTITY_KEY);
+	nspname = get_namespace_name(RelationGetNamespace(relation));
+	relname = RelationGetRelationName(relation);
+
+	pq_sendbyte(ctx->out, 'R');
+	pq_sendint(ctx->out, relid, 4);
+	pq_sendbytes(ctx->out, nspname, strlen(nspname) + 1);
+	pq_sendbytes(ctx->out, relname, strlen(relname) + 1);
+
+	pq_sendint(ctx->out, entry->nlive, 2);
+	for (i = 0; i < desc->natts; i++)
+	{
+		Form_pg_attribute att = desc->attrs[i];
+		uint8		flags = 0;
+
+		if (entry->columns[i].dropped)
+			continue;
+
+		if (bms_is_member(att->attnum - FirstLowInvalidHeapAttributeNumber,
+						  idattrs))
+			flags |= BINARY_DECODING_ATT_IDENTITY;
+
+		pq_sendbyte(ctx->out, flags);
+		pq_sendbytes(ctx->out, NameStr(att->attname),
+					 strlen(NameStr(att->attname)) + 1);
+		pq_sendint(ctx->out, att->atttypid, 4);
+		pq_sendint(ctx->out, att->atttypmod, 4);
+	}
+
+	bms_free(idattrs);
+
+	sent->version = entry->version;
+
+	bd_maybe_flush(ctx);
+
+	return entry;
+}
+
+/*
+ * Write a tuple of a relation described by entry.
+ */
+static void
+bd_write_tuple(StringInfo out, BinaryRelationEntry *entry, TupleDesc desc,
+			   HeapTuple tuple)
+{
+	Datum	   *values;
+	bool	   *isnull;
+	int			i;
+
+	values = palloc(sizeof(Datum) * desc->natts);
+	isnull = palloc(sizeof(bool) * desc->natts);
+
+	heap_deform_tuple(tuple, desc, values, isnull);
+
+	pq_sendint(out, entry->nlive, 2);
+
+	for (i = 0; i < desc->natts; i++)
+	{
+		BinaryColumnInfo *col = &entry->columns[i];
+
+		if (col->dropped)
+			continue;
+
+		if (isnull[i])
+		{
+			pq_sendbyte(out, 'n');
+			continue;
+		}
+
+		/* the value of an unchanged TOASTed column isn't in the WAL */
+		if (desc->attrs[i]->attlen == -1 &&
+			VARATT_IS_EXTERNAL_ONDISK(DatumGetPointer(values[i])))
+		{
+			pq_sendbyte(out, 'u');
+			continue;
+		}
+
+		if (col->binary)
+		{
+			bytea	   *outputbytes;
+
+			outputbytes = SendFunctionCall(&col->func, values[i]);
+			pq_sendbyte(out, 'b');
+			pq_sendint(out, VARSIZE(outputbytes) - VARHDRSZ, 4);
+			pq_sendbytes(out, VARDATA(outputbytes),
+						 VARSIZE(outputbytes) - VARHDRSZ);
+		}
+		else
+		{
+			char	   *outputstr;
+			int			len;
+
+			outputstr = OutputFunctionCall(&col->func, values[i]);
+			len = strlen(outputstr);
+			pq_sendbyte(out, 't');
+			pq_sendint(out, len, 4);
+			pq_sendbytes(out, outputstr, len);
+		}
+	}
+}
+
+/*
+ * callback for individual changed tuples
+ */
+static void
+bd_change(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+		  Relation relation, ReorderBufferChange *change)
+{
+	BinaryDecodingData *data = ctx->output_plugin_private;
+	BinaryRelationEntry *entry;
+	TupleDesc	desc = RelationGetDescr(relation);
+	MemoryContext old;
+
+	/* Avoid leaking memory by using and resetting our own context */
+	old = MemoryContextSwitchTo(data->context);
+
+	entry = bd_get_relation(ctx, relation);
+
+	switch (change->action)
+	{
+		case REORDER_BUFFER_CHANGE_INSERT:
+			pq_sendbyte(ctx->out, 'I');
+			pq_sendint(ctx->out, entry->relid, 4);
+			if (change->data.tp.newtuple != NULL)
+			{
+				pq_sendbyte(ctx->out, 'N');
+				bd_write_tuple(ctx->out, entry, desc,
+							   &change->data.tp.newtuple->tuple);
+			}
+			break;
+		case REORDER_BUFFER_CHANGE_UPDATE:
+			pq_sendbyte(ctx->out, 'U');
+			pq_sendint(ctx->out, entry->relid, 4);
+			if (change->data.tp.oldtuple != NULL)
+			{
+				pq_sendbyte(ctx->out, 'K');
+				bd_write_tuple(ctx->out, entry, desc,
+							   &change->data.tp.oldtuple->tuple);
+			}
+			if (change->data.tp.newtuple != NULL)
+			{
+				pq_sendbyte(ctx->out, 'N');
+				bd_write_tuple(ctx->out, entry, desc,
+							   &change->data.tp.newtuple->tuple);
+			}
+			break;
+		case REORDER_BUFFER_CHANGE_DELETE:
+			pq_sendbyte(ctx->out, 'D');
+			pq_sendint(ctx->out, entry->relid, 4);
+			/* if there was no replica identity, that's all we know */
+			if (change->data.tp.oldtuple != NULL)
+			{
+				pq_sendbyte(ctx->out, 'K');
+				bd_write_tuple(ctx->out, entry, desc,
+							   &change->data.tp.oldtuple->tuple);
+			}
+			break;
+		default:
+			Assert(false);
+	}
+
+	MemoryContextSwitchTo(old);
+	MemoryContextReset(data->context);
+
+	bd_maybe_flush(ctx);
+}
+
+static void
+bd_message(LogicalDecodingContext *ctx,
+		   ReorderBufferTXN *txn, XLogRecPtr lsn,
+		   bool transactional, Size sz,
+		   const char *message)
+{
+	/* non-transactional messages are sent outside of any batch */
+	bool		batched = ctx->prepared_write;
+
+	if (!batched)
+		OutputPluginPrepareWrite(ctx, true);
+
+	pq_sendbyte(ctx->out, 'M');
+	pq_sendbyte(ctx->out, transactional);
+	pq_sendint64(ctx->out, lsn);
+	pq_sendint(ctx->out, sz, 4);
+	pq_sendbytes(ctx->out, message, sz);
+
+	if (!batched)
+		OutputPluginWrite(ctx, true);
+	else
+		bd_maybe_flush(ctx);
+}
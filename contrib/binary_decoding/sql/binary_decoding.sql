@@ -0,0 +1,30 @@
+-- predictability
+SET synchronous_commit = on;
+
+CREATE TABLE bd_test(id int primary key, data text);
+
+SELECT 'init' FROM pg_create_logical_replication_slot('regression_slot', 'binary_decoding');
+
+BEGIN;
+INSERT INTO bd_test VALUES (1, 'one');
+INSERT INTO bd_test VALUES (2, 'two');
+COMMIT;
+UPDATE bd_test SET data = 'three' WHERE id = 1;
+ALTER TABLE bd_test ADD COLUMN extra int;
+INSERT INTO bd_test VALUES (3, 'four', 3);
+DELETE FROM bd_test WHERE id = 2;
+
+-- fails, unknown option
+SELECT data FROM pg_logical_slot_peek_binary_changes('regression_slot', NULL, NULL, 'nonexistent', '1');
+
+-- one message per write; the relation is described again after the ALTER
+SELECT chr(get_byte(data, 0)) AS type, length(data)
+FROM pg_logical_slot_peek_binary_changes('regression_slot', NULL, NULL, 'batch-size', '0');
+
+-- one write per transaction; every session describes relations anew
+SELECT chr(get_byte(data, 0)) AS type, length(data)
+FROM pg_logical_slot_get_binary_changes('regression_slot', NULL, NULL);
+
+SELECT 'stop' FROM pg_drop_replication_slot('regression_slot');
+
+DROP TABLE bd_test;
@@ -0,0 +1,7 @@
+-- contrib/pgbench/deparse_schema.sql
+--
+-- Create a partition set of "tables" tables, each with a CHECK constraint
+-- and an index, and roll it back; see deparse_setup.sql.
+BEGIN;
+DO $$BEGIN FOR i IN 1..:tables LOOP EXECUTE format('CREATE TABLE deparse_bench.part_%s (CHECK (id >= %s AND id < %s)) INHERITS (deparse_bench.parent)', i, i * 1000, (i + 1) * 1000); EXECUTE format('CREATE INDEX ON deparse_bench.part_%s (created)', i); END LOOP; END$$;
+ROLLBACK;
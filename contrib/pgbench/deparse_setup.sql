@@ -0,0 +1,35 @@
+-- contrib/pgbench/deparse_setup.sql
+--
+-- Setup for timing the deparsing of DDL commands with deparse_schema.sql.
+-- Run it once with psql, then create and roll back a partition set of
+-- the given number of tables, e.g.
+--
+--   pgbench -n -c 1 -t 10 -D tables=10000 -f deparse_schema.sql
+--
+-- The event trigger deparses every DDL command run in the database and
+-- expands it back into SQL, as a DDL replication consumer would. Compare
+-- with the time taken after DROP EVENT TRIGGER deparse_bench.
+
+DROP EVENT TRIGGER IF EXISTS deparse_bench;
+DROP SCHEMA IF EXISTS deparse_bench CASCADE;
+
+CREATE SCHEMA deparse_bench;
+
+CREATE TABLE deparse_bench.parent (
+	id bigint NOT NULL,
+	created timestamp(3) with time zone NOT NULL DEFAULT now(),
+	amount numeric(12,2),
+	tags text[],
+	payload jsonb
+);
+
+CREATE FUNCTION deparse_bench.deparse_commands() RETURNS event_trigger
+LANGUAGE plpgsql AS $$
+BEGIN
+	PERFORM pg_event_trigger_expand_command(command)
+	   FROM pg_event_trigger_get_creation_commands();
+END;
+$$;
+
+CREATE EVENT TRIGGER deparse_bench ON ddl_command_end
+	EXECUTE PROCEDURE deparse_bench.deparse_commands();
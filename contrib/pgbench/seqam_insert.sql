@@ -0,0 +1,5 @@
+-- contrib/pgbench/seqam_insert.sql
+--
+-- Insert rows keyed by a sequence using the access method given by the
+-- "am" variable, local or shared; see seqam_setup.sql.
+INSERT INTO seqam_bench_:am DEFAULT VALUES;
@@ -0,0 +1,24 @@
+-- contrib/pgbench/seqam_setup.sql
+--
+-- Setup for comparing the local and shared sequence access methods with
+-- seqam_insert.sql. Run it once with psql, then benchmark each access
+-- method with the same number of clients, e.g.
+--
+--   pgbench -n -c 32 -j 32 -T 60 -D am=local -f seqam_insert.sql
+--   pgbench -n -c 32 -j 32 -T 60 -D am=shared -f seqam_insert.sql
+--
+-- Both tables draw their keys from a sequence with the default CACHE of 1,
+-- so with the local access method every insert locks the sequence page.
+
+DROP TABLE IF EXISTS seqam_bench_local, seqam_bench_shared;
+DROP SEQUENCE IF EXISTS seqam_bench_local_seq, seqam_bench_shared_seq;
+
+CREATE SEQUENCE seqam_bench_local_seq USING local;
+CREATE SEQUENCE seqam_bench_shared_seq USING shared;
+
+CREATE UNLOGGED TABLE seqam_bench_local (
+	id bigint NOT NULL DEFAULT nextval('seqam_bench_local_seq')
+);
+CREATE UNLOGGED TABLE seqam_bench_shared (
+	id bigint NOT NULL DEFAULT nextval('seqam_bench_shared_seq')
+);
@@ -0,0 +1,36 @@
+--
+-- Commit timestamps
+--
+CREATE TABLE committs_test (id int);
+INSERT INTO committs_test VALUES (1);
+INSERT INTO committs_test VALUES (2);
+INSERT INTO committs_test VALUES (3);
+
+-- every transaction committed in a time span lies within the returned range
+SELECT count(*) AS committed,
+       bool_and(t.xmin::text::bigint
+                BETWEEN r.first_xid::text::bigint AND r.last_xid::text::bigint)
+         AS in_range
+FROM committs_test t,
+     pg_xid_range_for_committime(
+       (SELECT min(pg_get_transaction_committime(xmin)) FROM committs_test),
+       (SELECT max(pg_get_transaction_committime(xmin)) FROM committs_test)) r;
+
+-- a single transaction's commit time
+SELECT t.xmin::text::bigint
+         BETWEEN r.first_xid::text::bigint AND r.last_xid::text::bigint
+         AS in_range
+FROM committs_test t,
+     pg_xid_range_for_committime(pg_get_transaction_committime(t.xmin),
+                                 pg_get_transaction_committime(t.xmin)) r
+WHERE t.id = 2;
+
+-- empty time span
+SELECT * FROM pg_xid_range_for_committime(now(), now() - interval '1 day');
+
+-- nothing committed before the server started, nor in the future
+SELECT * FROM pg_xid_range_for_committime('2000-01-01', '2000-01-02');
+SELECT * FROM pg_xid_range_for_committime(now() + interval '1 day',
+                                          now() + interval '2 days');
+
+DROP TABLE committs_test;
@@ -0,0 +1,46 @@
+-- predictability
+SET synchronous_commit = on;
+
+SELECT 'init' FROM pg_create_logical_replication_slot('regression_slot', 'test_decoding');
+
+CREATE TABLE churn_test(id int);
+
+-- lots of catalog modifying subtransactions, interleaved with data changes
+DO $$
+BEGIN
+    FOR i IN 1..1000 LOOP
+        BEGIN
+            CREATE TEMP TABLE churn_tmp(id int) ON COMMIT DROP;
+            INSERT INTO churn_tmp VALUES (i);
+            INSERT INTO churn_test VALUES (i);
+            DROP TABLE churn_tmp;
+        EXCEPTION WHEN division_by_zero THEN
+            RAISE;
+        END;
+    END LOOP;
+END $$;
+
+-- catalog modifying toplevel transactions
+BEGIN;
+CREATE TEMP TABLE churn_tmp(id int) ON COMMIT DROP;
+INSERT INTO churn_test VALUES (1001);
+COMMIT;
+BEGIN;
+CREATE TEMP TABLE churn_tmp(id int) ON COMMIT DROP;
+INSERT INTO churn_test VALUES (1002);
+COMMIT;
+BEGIN;
+CREATE TEMP TABLE churn_tmp(id int) ON COMMIT DROP;
+INSERT INTO churn_test VALUES (1003);
+COMMIT;
+
+-- changes to the decoded table have to be seen after all that churn
+ALTER TABLE churn_test ADD COLUMN data text;
+INSERT INTO churn_test VALUES (1004, 'after churn');
+
+SELECT count(*) FROM pg_logical_slot_peek_changes('regression_slot', NULL, NULL) WHERE data ~ 'INSERT';
+SELECT data FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL) WHERE data ~ 'after churn';
+
+DROP TABLE churn_test;
+
+SELECT pg_drop_replication_slot('regression_slot');
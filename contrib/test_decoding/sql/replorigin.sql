@@ -0,0 +1,25 @@
+-- predictability
+SET synchronous_commit = on;
+
+CREATE TABLE origin_tbl(id serial primary key, data text);
+
+SELECT 'init' FROM pg_create_logical_replication_slot('regression_slot', 'test_decoding');
+SELECT 'init' FROM pg_replication_identifier_create('test_decoding: regression');
+
+-- a change made locally
+INSERT INTO origin_tbl(data) VALUES ('will be replicated');
+
+-- a change replayed from another node
+SELECT 'setup' FROM pg_replication_identifier_setup_replaying_from('test_decoding: regression');
+INSERT INTO origin_tbl(data) VALUES ('will not be replicated');
+SELECT 'reset' FROM pg_replication_identifier_reset_replaying_from();
+
+-- both changes are decoded by default
+SELECT data FROM pg_logical_slot_peek_changes('regression_slot', NULL, NULL, 'include-xids', '0', 'skip-empty-xacts', '1');
+
+-- only the local one is decoded when filtering by origin
+SELECT data FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL, 'include-xids', '0', 'skip-empty-xacts', '1', 'only-local', '1');
+
+SELECT pg_drop_replication_slot('regression_slot');
+SELECT pg_replication_identifier_drop('test_decoding: regression');
+DROP TABLE origin_tbl;
@@ -0,0 +1,56 @@
+-- predictability
+SET synchronous_commit = on;
+-- stream with a small memory budget
+SET logical_decoding_work_mem = '64kB';
+
+SELECT 'init' FROM pg_create_logical_replication_slot('regression_slot', 'test_decoding');
+
+CREATE TABLE stream_test(data text);
+
+-- consume DDL
+SELECT data FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL, 'include-xids', '0', 'skip-empty-xacts', '1');
+
+-- streaming a large transaction, remainder is sent at commit
+BEGIN;
+INSERT INTO stream_test SELECT 'stream-topbig:'||g.i FROM generate_series(1, 5000) g(i);
+COMMIT;
+SELECT count(*) FILTER (WHERE data ~ '^opening a streamed block') > 1 AS streamed,
+    count(*) FILTER (WHERE data ~ '^opening a streamed block') =
+    count(*) FILTER (WHERE data ~ '^closing a streamed block') AS balanced,
+    count(*) FILTER (WHERE data ~ 'INSERT') AS inserts,
+    string_agg(data, ', ') FILTER (WHERE data !~ 'streamed block|INSERT') AS other
+FROM pg_logical_slot_get_changes('regression_slot', NULL,NULL, 'include-xids', '0', 'skip-empty-xacts', '1', 'stream-changes', '1');
+
+-- streaming an aborted transaction
+BEGIN;
+INSERT INTO stream_test SELECT 'stream-topbig-abort:'||g.i FROM generate_series(1, 5000) g(i);
+ROLLBACK;
+SELECT count(*) FILTER (WHERE data ~ '^opening a streamed block') > 1 AS streamed,
+    count(*) FILTER (WHERE data ~ '^opening a streamed block') =
+    count(*) FILTER (WHERE data ~ '^closing a streamed block') AS balanced,
+    string_agg(data, ', ') FILTER (WHERE data !~ 'streamed block|INSERT') AS other
+FROM pg_logical_slot_get_changes('regression_slot', NULL,NULL, 'include-xids', '0', 'skip-empty-xacts', '1', 'stream-changes', '1');
+
+-- streaming a subtransaction that's rolled back, the main xact commits
+BEGIN;
+SAVEPOINT s;
+INSERT INTO stream_test SELECT 'stream-subbig-abort:'||g.i FROM generate_series(1, 5000) g(i);
+ROLLBACK TO SAVEPOINT s;
+INSERT INTO stream_test SELECT 'stream-subbig-abort-top:'||g.i FROM generate_series(1, 10) g(i);
+COMMIT;
+SELECT count(*) FILTER (WHERE data ~ '^opening a streamed block') > 1 AS streamed,
+    count(*) FILTER (WHERE data ~ '^opening a streamed block') =
+    count(*) FILTER (WHERE data ~ '^closing a streamed block') AS balanced,
+    count(*) FILTER (WHERE data ~ 'stream-subbig-abort-top') AS top_inserts,
+    string_agg(data, ', ') FILTER (WHERE data !~ 'streamed block|INSERT') AS other
+FROM pg_logical_slot_get_changes('regression_slot', NULL,NULL, 'include-xids', '0', 'skip-empty-xacts', '1', 'stream-changes', '1');
+
+-- without the option large transactions are decoded at commit
+BEGIN;
+INSERT INTO stream_test SELECT 'nostream-topbig:'||g.i FROM generate_series(1, 5000) g(i);
+COMMIT;
+SELECT data FROM pg_logical_slot_get_changes('regression_slot', NULL,NULL, 'include-xids', '0', 'skip-empty-xacts', '1') WHERE data !~ 'INSERT';
+
+DROP TABLE stream_test;
+
+SELECT pg_drop_replication_slot('regression_slot');
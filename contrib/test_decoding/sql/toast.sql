@@ -298,4 +298,14 @@ DROP TABLE toasted_several;
 
 SELECT regexp_replace(data, '^(.{100}).*(.{100})$', '\1..\2') FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL, 'include-xids', '0', 'skip-empty-xacts', '1')
 WHERE data NOT LIKE '%INSERT: %';
+
+-- TOASTed values aren't reassembled if the output plugin doesn't need them
+CREATE TABLE toasted_skip(id serial primary key, data text);
+ALTER TABLE toasted_skip ALTER COLUMN data SET STORAGE EXTERNAL;
+INSERT INTO toasted_skip(data) VALUES(repeat('1234567890', 300));
+UPDATE toasted_skip SET data = repeat('0987654321', 300);
+UPDATE toasted_skip SET id = 2;
+SELECT data FROM pg_logical_slot_get_changes('regression_slot', NULL, NULL, 'include-xids', '0', 'skip-empty-xacts', '1', 'skip-toast-reassembly', '1');
+DROP TABLE toasted_skip;
+
 SELECT pg_drop_replication_slot('regression_slot');
@@ -0,0 +1,47 @@
+# Test shared_logical_decoding through a walsender
+use strict;
+use warnings;
+use IPC::Run qw(run);
+use Time::HiRes qw(usleep);
+use TestLib;
+use Test::More tests => 2;
+
+my $tempdir = tempdir;
+start_test_server $tempdir;
+
+configure_hba_for_replication "$tempdir/pgdata";
+open CONF, ">>$tempdir/pgdata/postgresql.conf";
+print CONF "wal_level = logical\n";
+print CONF "max_wal_senders = 4\n";
+print CONF "max_replication_slots = 4\n";
+print CONF "shared_logical_decoding = on\n";
+close CONF;
+restart_test_server;
+
+psql 'postgres',
+  "SELECT pg_create_logical_replication_slot('shared_slot', 'test_decoding')";
+psql 'postgres', "CREATE TABLE shared_tbl(id int); INSERT INTO shared_tbl VALUES (1)";
+
+# An output plugin option without a value has to be passed on to the
+# decoding group. psql can't stream, so it disconnects once streaming
+# started, and the walsender exits.
+my ($stdout, $stderr);
+run [ 'psql', '-X', '-d', 'dbname=postgres replication=database', '-c',
+	'START_REPLICATION SLOT shared_slot LOGICAL 0/0 ("include-xids")' ],
+  '>', \$stdout, '2>', \$stderr;
+like($stderr, qr/unexpected PQresultStatus/,
+	'walsender starts streaming with an option without a value');
+
+# wait for the walsender to release the slot
+my $active = 't';
+for (my $i = 0; $i < 600 && $active ne 'f'; $i++)
+{
+	usleep(100_000);
+	$active = eval {
+		psql 'postgres',
+		  "SELECT active FROM pg_replication_slots WHERE slot_name = 'shared_slot'";
+	} || 't';
+}
+
+unlike(slurp_file("$log_path/postmaster.log"), qr/terminated by signal/,
+	'walsender exits without crashing');
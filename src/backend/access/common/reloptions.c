@@ -209,6 +209,14 @@ static relopt_int intRelOpts[] =
 			RELOPT_KIND_HEAP | RELOPT_KIND_TOAST
 		}, -1, 0, 2000000000
 	},
+	{
+		{
+			"block_size",
+			"Number of values the shared sequence access method reserves at once",
+			RELOPT_KIND_SHARED_SEQUENCE
+		},
+		-1, 1, INT_MAX
+	},
 
 	/* list terminator */
 	{{NULL}}
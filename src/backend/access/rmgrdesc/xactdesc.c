@@ -21,7 +21,7 @@
 
 
 static void
-xact_desc_commit(StringInfo buf, xl_xact_commit *xlrec)
+xact_desc_commit(StringInfo buf, xl_xact_commit *xlrec, RepNodeId origin_id)
 {
 	int			i;
 	TransactionId *subxacts;
@@ -82,13 +82,14 @@ xact_desc_commit(StringInfo buf, xl_xact_commit *xlrec)
 	}
 	if (xlrec->xinfo & XACT_CONTAINS_ORIGIN)
 	{
-		xl_xact_origin *origin = (xl_xact_origin *) &(msgs[xlrec->nmsgs]);
+		xl_xact_origin origin;
 
+		memcpy(&origin, &(msgs[xlrec->nmsgs]), sizeof(xl_xact_origin));
 		appendStringInfo(buf, " origin %u, lsn %X/%X, at %s",
-						 origin->origin_node_id,
-						 (uint32)(origin->origin_lsn >> 32),
-						 (uint32)origin->origin_lsn,
-						 timestamptz_to_str(origin->origin_timestamp));
+						 origin_id,
+						 (uint32)(origin.origin_lsn >> 32),
+						 (uint32)origin.origin_lsn,
+						 timestamptz_to_str(origin.origin_timestamp));
 	}
 
 }
@@ -151,6 +152,8 @@ void
 xact_desc(StringInfo buf, uint8 xl_info, char *rec)
 {
 	uint8		info = xl_info & ~XLR_INFO_MASK;
+	/* the origin is kept in the record's header, see RmgrData */
+	XLogRecord *record = (XLogRecord *) (rec - SizeOfXLogRecord);
 
 	if (info == XLOG_XACT_COMMIT_COMPACT)
 	{
@@ -164,7 +167,7 @@ xact_desc(StringInfo buf, uint8 xl_info, char *rec)
 		xl_xact_commit *xlrec = (xl_xact_commit *) rec;
 
 		appendStringInfoString(buf, "commit: ");
-		xact_desc_commit(buf, xlrec);
+		xact_desc_commit(buf, xlrec, record->xl_origin_id);
 	}
 	else if (info == XLOG_XACT_ABORT)
 	{
@@ -182,7 +185,7 @@ xact_desc(StringInfo buf, uint8 xl_info, char *rec)
 		xl_xact_commit_prepared *xlrec = (xl_xact_commit_prepared *) rec;
 
 		appendStringInfo(buf, "commit prepared %u: ", xlrec->xid);
-		xact_desc_commit(buf, &xlrec->crec);
+		xact_desc_commit(buf, &xlrec->crec, record->xl_origin_id);
 	}
 	else if (info == XLOG_XACT_ABORT_PREPARED)
 	{
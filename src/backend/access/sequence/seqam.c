@@ -56,7 +56,17 @@
  *
  * Note that the SeqAM API calls are synchronous. It is up to the SeqAM to
  * decide how that is handled, for example, whether there is a higher level
- * cache at instance level to amortise network traffic in cluster.
+ * cache at instance level to amortise network traffic in cluster. Such a
+ * cache can be served by the optional seqamnextval function, which is called
+ * before the sequence page is locked, unlike seqamalloc. The built-in
+ * "shared" SeqAm uses it to hand out values from a range kept in shared
+ * memory; see seqam_shared.c.
+ *
+ * An AM with such a cache can avoid ever stalling nextval() by calling
+ * sequence_low_watermark() when the cache runs low. A background worker
+ * then calls the AM's optional seqamrefill function, with the sequence page
+ * locked just like for seqamalloc, to refill the cache ahead of time; see
+ * seqam_refill.c.
  *
  * The SeqAM is identified by Oid of corresponding tuple in pg_seqam.  There is
  * no syscache for pg_seqam, though the SeqAm data is stored on the relcache
@@ -97,6 +107,8 @@ do { \
  *  INTERFACE ROUTINES
  *		sequence_alloc		- allocate a new range of values for the sequence
  *		sequence_setval		- coordinate the reset of a sequence to new value
+ *		sequence_nextval	- return values cached by the AM itself, if any
+ *		sequence_refill		- refill the AM's cache in the background
  *
  *		sequence_reloptions	- process options - located in reloptions.c
  *
@@ -153,6 +165,69 @@ sequence_setval(Relation seqRelation, SeqTable seq_elem, Buffer buf, HeapTuple t
 				  BoolGetDatum(iscalled));
 }
 
+/*
+ * sequence_nextval - return values from a cache kept by the sequence AM
+ *
+ * Unlike sequence_alloc, this is called without the sequence page locked.
+ * Returns true if the AM has stored the next values in seq_elem, and false
+ * if it has no such cache or the cache is empty, in which case
+ * sequence_alloc has to be called.
+ */
+bool
+sequence_nextval(Relation seqRelation, SeqTable seq_elem)
+{
+	FmgrInfo   *procedure;
+
+	Assert(RelationIsValid(seqRelation));
+	Assert(PointerIsValid(seqRelation->rd_seqam));
+	Assert(OidIsValid(seqRelation->rd_rel->relam));
+
+	/* the function is optional */
+	if (!RegProcedureIsValid(seqRelation->rd_seqam->seqamnextval))
+		return false;
+
+	GET_SEQAM_PROCEDURE(seqamnextval);
+
+	return DatumGetBool(FunctionCall2(procedure,
+									  PointerGetDatum(seqRelation),
+									  PointerGetDatum(seq_elem)));
+}
+
+/*
+ * sequence_refill - refill the cache kept by the sequence AM
+ *
+ * Called by the refill worker with the sequence page locked, after the AM
+ * has called sequence_low_watermark().
+ */
+void
+sequence_refill(Relation seqRelation, SeqTable seq_elem, Buffer buf, HeapTuple tup)
+{
+	FmgrInfo   *procedure;
+
+	Assert(RelationIsValid(seqRelation));
+	Assert(PointerIsValid(seqRelation->rd_seqam));
+	Assert(OidIsValid(seqRelation->rd_rel->relam));
+
+	GET_SEQAM_PROCEDURE(seqamrefill);
+
+	FunctionCall4(procedure,
+				  PointerGetDatum(seqRelation),
+				  PointerGetDatum(seq_elem),
+				  Int32GetDatum(buf),
+				  PointerGetDatum(tup));
+}
+
+/*
+ * sequence_has_refill - does the sequence's AM have a seqamrefill function?
+ */
+bool
+sequence_has_refill(Relation seqRelation)
+{
+	Assert(PointerIsValid(seqRelation->rd_seqam));
+
+	return RegProcedureIsValid(seqRelation->rd_seqam->seqamrefill);
+}
+
 /*------------------------------------------------------------
  *
  * Sequence Access Manager management functions
@@ -0,0 +1,641 @@
+/*-------------------------------------------------------------------------
+ *
+ * seqam_refill.c
+ *	  background refill of the caches of sequence access methods
+ *
+ * Portions Copyright (c) 1996-2014, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/sequence/seqam_refill.c
+ *
+ *
+ * A SeqAm that caches values outside of the sequence page, like the "shared"
+ * SeqAm, has to refill that cache by locking the page and reserving more
+ * values, and every nextval() arriving meanwhile waits for it. To take that
+ * off the nextval() path, the AM calls sequence_low_watermark() once its
+ * cache runs low. That records a refill request for the sequence and wakes
+ * up the refill worker of the sequence's database, starting one as a
+ * dynamic background worker if there is none. The worker locks the
+ * sequence page and calls the AM's seqamrefill function, which reserves the
+ * next values before the cache is used up.
+ *
+ * There is at most one refill worker per database. It exits once it has
+ * been idle for a second: a connected worker would make DROP DATABASE
+ * fail, which waits only a few seconds for other sessions to go away, and
+ * starting a worker is cheap compared to the rate at which refill requests
+ * arrive for a busy sequence.
+ *
+ * Whenever nextval() has to lock the sequence page of a sequence whose AM
+ * has a seqamrefill function anyway, it reports a stall, and the number and
+ * duration of stalls are shown per sequence in pg_stat_sequence_refill.
+ * Both the requests and the statistics are kept in a fixed-size table of
+ * max_shared_sequences entries; once that is full, the least recently used
+ * entry without a pending request is reused.
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <signal.h>
+
+#include "access/seqam.h"
+#include "access/xact.h"
+#include "catalog/pg_class.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "storage/bufmgr.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lmgr.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+/*
+ * Refill requests and statistics of a sequence.
+ */
+typedef struct SeqRefillEntry
+{
+	Oid			dbid;			/* database of the sequence, or InvalidOid */
+	Oid			relid;			/* pg_class OID of the sequence */
+	bool		pending;		/* is a refill requested? */
+	int64		requests;		/* number of refill requests */
+	int64		refills;		/* number of refills done by the worker */
+	int64		stalls;			/* number of nextval() calls that waited */
+	double		stall_time;		/* time spent in them, in milliseconds */
+	TimestampTz last_used;		/* last request or stall, for reuse */
+	TimestampTz last_refill;	/* last refill done by the worker */
+} SeqRefillEntry;
+
+/*
+ * The refill worker of a database. pid is zero while the worker is being
+ * started.
+ */
+typedef struct SeqRefillWorker
+{
+	Oid			dbid;			/* database served, or InvalidOid */
+	int			pid;			/* PID of the worker, or 0 */
+	Latch	   *latch;			/* latch of the worker, if it runs */
+	TimestampTz start_time;		/* when the worker was registered */
+} SeqRefillWorker;
+
+/* Both arrays are protected by SequenceRefillLock. */
+typedef struct SeqRefillCtlData
+{
+	SeqRefillWorker *workers;	/* max_worker_processes entries */
+	SeqRefillEntry *entries;	/* max_shared_sequences entries */
+} SeqRefillCtlData;
+
+static SeqRefillCtlData SeqRefillCtl;
+
+/* start another worker if the registered one hasn't come up by then */
+#define SEQ_REFILL_START_TIMEOUT	10000	/* ms */
+/* let the worker exit after being idle for that long */
+#define SEQ_REFILL_IDLE_TIMEOUT		1000	/* ms */
+
+/* flags set by signal handlers of the refill worker */
+static volatile sig_atomic_t got_sigterm = false;
+static volatile sig_atomic_t got_sighup = false;
+
+static SeqRefillEntry *SeqRefillLookup(Oid relid, bool create);
+static bool SeqRefillStartWorker(Oid dbid);
+static void SeqRefillWorkerMain(Datum main_arg);
+static void SeqRefillWorkerCleanup(int code, Datum arg);
+static bool SeqRefillOne(Oid relid);
+
+/*
+ * Report shared-memory space needed by SeqRefillShmemInit
+ */
+Size
+SeqRefillShmemSize(void)
+{
+	Size		size;
+
+	size = mul_size(max_worker_processes, sizeof(SeqRefillWorker));
+	size = add_size(size, mul_size(max_shared_sequences,
+								   sizeof(SeqRefillEntry)));
+
+	return size;
+}
+
+/*
+ * Allocate and initialize the refill request table
+ */
+void
+SeqRefillShmemInit(void)
+{
+	char	   *ptr;
+	bool		found;
+
+	ptr = ShmemInitStruct("Sequence Refill Requests", SeqRefillShmemSize(),
+						  &found);
+
+	if (!found)
+		MemSet(ptr, 0, SeqRefillShmemSize());
+
+	SeqRefillCtl.workers = (SeqRefillWorker *) ptr;
+	SeqRefillCtl.entries = (SeqRefillEntry *)
+		(ptr + mul_size(max_worker_processes, sizeof(SeqRefillWorker)));
+}
+
+/*
+ * Find the entry of a sequence of the current database. If there is none
+ * and create is true, assign one, preferring unused entries and otherwise
+ * reusing the least recently used one that has no pending request.
+ *
+ * The caller must hold SequenceRefillLock exclusively.
+ */
+static SeqRefillEntry *
+SeqRefillLookup(Oid relid, bool create)
+{
+	SeqRefillEntry *victim = NULL;
+	int			i;
+
+	for (i = 0; i < max_shared_sequences; i++)
+	{
+		SeqRefillEntry *entry = &SeqRefillCtl.entries[i];
+
+		if (entry->dbid == MyDatabaseId && entry->relid == relid)
+			return entry;
+
+		if (!create || entry->pending)
+			continue;
+
+		if (!OidIsValid(entry->dbid))
+		{
+			if (victim == NULL || OidIsValid(victim->dbid))
+				victim = entry;
+		}
+		else if (victim == NULL ||
+				 (OidIsValid(victim->dbid) &&
+				  entry->last_used < victim->last_used))
+			victim = entry;
+	}
+
+	if (victim != NULL)
+	{
+		MemSet(victim, 0, sizeof(SeqRefillEntry));
+		victim->dbid = MyDatabaseId;
+		victim->relid = relid;
+	}
+
+	return victim;
+}
+
+/*
+ * sequence_low_watermark - request a background refill of a sequence
+ *
+ * Called by a SeqAm with a seqamrefill function once its cache of values of
+ * the sequence runs low. The refill happens asynchronously, so the AM has
+ * to cope with its cache running empty before that; it should not call this
+ * again until the refill has happened.
+ */
+void
+sequence_low_watermark(Relation seqrel)
+{
+	SeqRefillWorker *worker = NULL;
+	SeqRefillEntry *entry;
+	Latch	   *latch = NULL;
+	bool		start = false;
+	TimestampTz now;
+	int			i;
+
+	/* the worker can't see the local buffers of temporary sequences */
+	if (seqrel->rd_rel->relpersistence == RELPERSISTENCE_TEMP)
+		return;
+
+	if (max_shared_sequences == 0 || max_worker_processes == 0)
+		return;
+
+	now = GetCurrentTimestamp();
+
+	LWLockAcquire(SequenceRefillLock, LW_EXCLUSIVE);
+
+	entry = SeqRefillLookup(RelationGetRelid(seqrel), true);
+	if (entry == NULL)
+	{
+		/* all entries have pending requests; the refill has to wait */
+		LWLockRelease(SequenceRefillLock);
+		return;
+	}
+
+	entry->requests++;
+	entry->pending = true;
+	entry->last_used = now;
+
+	for (i = 0; i < max_worker_processes; i++)
+	{
+		if (SeqRefillCtl.workers[i].dbid == MyDatabaseId)
+		{
+			worker = &SeqRefillCtl.workers[i];
+			break;
+		}
+	}
+
+	if (worker == NULL)
+	{
+		/* claim an entry for a new worker */
+		for (i = 0; i < max_worker_processes; i++)
+		{
+			if (!OidIsValid(SeqRefillCtl.workers[i].dbid))
+			{
+				worker = &SeqRefillCtl.workers[i];
+				worker->dbid = MyDatabaseId;
+				worker->pid = 0;
+				worker->latch = NULL;
+				worker->start_time = now;
+				start = true;
+				break;
+			}
+		}
+	}
+	else if (worker->pid != 0)
+		latch = worker->latch;
+	else if (TimestampDifferenceExceeds(worker->start_time, now,
+										SEQ_REFILL_START_TIMEOUT))
+	{
+		/* the worker we registered never came up, try again */
+		worker->start_time = now;
+		start = true;
+	}
+
+	LWLockRelease(SequenceRefillLock);
+
+	if (latch != NULL)
+		SetLatch(latch);
+
+	if (start && !SeqRefillStartWorker(MyDatabaseId))
+	{
+		/* no free background worker slot; give the entry back */
+		LWLockAcquire(SequenceRefillLock, LW_EXCLUSIVE);
+		if (worker->dbid == MyDatabaseId && worker->pid == 0)
+			worker->dbid = InvalidOid;
+		LWLockRelease(SequenceRefillLock);
+	}
+}
+
+/*
+ * sequence_report_stall - count a nextval() that had to wait for a refill
+ *
+ * start is the time nextval() started to wait.
+ */
+void
+sequence_report_stall(Relation seqrel, TimestampTz start)
+{
+	SeqRefillEntry *entry;
+	TimestampTz now;
+	long		secs;
+	int			usecs;
+
+	if (max_shared_sequences == 0)
+		return;
+
+	now = GetCurrentTimestamp();
+	TimestampDifference(start, now, &secs, &usecs);
+
+	LWLockAcquire(SequenceRefillLock, LW_EXCLUSIVE);
+
+	entry = SeqRefillLookup(RelationGetRelid(seqrel), true);
+	if (entry != NULL)
+	{
+		entry->stalls++;
+		entry->stall_time += (double) secs * 1000.0 + (double) usecs / 1000.0;
+		entry->last_used = now;
+	}
+
+	LWLockRelease(SequenceRefillLock);
+}
+
+/*
+ * Register the refill worker of a database.
+ */
+static bool
+SeqRefillStartWorker(Oid dbid)
+{
+	BackgroundWorker worker;
+	BackgroundWorkerHandle *handle;
+
+	MemSet(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS |
+		BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	/* the entry point is in core, so there is no library to load */
+	worker.bgw_main = SeqRefillWorkerMain;
+	worker.bgw_main_arg = ObjectIdGetDatum(dbid);
+	worker.bgw_notify_pid = 0;
+	snprintf(worker.bgw_name, BGW_MAXLEN, "sequence refill worker for database %u",
+			 dbid);
+
+	return RegisterDynamicBackgroundWorker(&worker, &handle);
+}
+
+/*
+ * Signal handler for SIGTERM
+ *		Set a flag to let the main loop to terminate, and set our latch to wake
+ *		it up.
+ */
+static void
+seqrefill_sigterm(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sigterm = true;
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * Signal handler for SIGHUP
+ *		Set a flag to tell the main loop to reread the config file, and set
+ *		our latch to wake it up.
+ */
+static void
+seqrefill_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sighup = true;
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * Give up our worker entry when exiting.
+ */
+static void
+SeqRefillWorkerCleanup(int code, Datum arg)
+{
+	int			i;
+
+	LWLockAcquire(SequenceRefillLock, LW_EXCLUSIVE);
+	for (i = 0; i < max_worker_processes; i++)
+	{
+		SeqRefillWorker *worker = &SeqRefillCtl.workers[i];
+
+		if (worker->pid == MyProcPid)
+		{
+			worker->dbid = InvalidOid;
+			worker->pid = 0;
+			worker->latch = NULL;
+		}
+	}
+	LWLockRelease(SequenceRefillLock);
+}
+
+/*
+ * Main entry point of the refill worker of a database.
+ */
+static void
+SeqRefillWorkerMain(Datum main_arg)
+{
+	Oid			dbid = DatumGetObjectId(main_arg);
+	SeqRefillWorker *worker = NULL;
+	Oid		   *relids;
+	TimestampTz last_work;
+	int			i;
+
+	pqsignal(SIGHUP, seqrefill_sighup);
+	pqsignal(SIGTERM, seqrefill_sigterm);
+
+	BackgroundWorkerUnblockSignals();
+
+	BackgroundWorkerInitializeConnectionByOid(dbid, NULL);
+
+	/* claim our entry, unless another worker for the database runs */
+	LWLockAcquire(SequenceRefillLock, LW_EXCLUSIVE);
+	for (i = 0; i < max_worker_processes; i++)
+	{
+		if (SeqRefillCtl.workers[i].dbid == dbid)
+		{
+			worker = &SeqRefillCtl.workers[i];
+			break;
+		}
+	}
+	if (worker == NULL || worker->pid != 0)
+	{
+		LWLockRelease(SequenceRefillLock);
+		proc_exit(0);
+	}
+	worker->pid = MyProcPid;
+	worker->latch = &MyProc->procLatch;
+	LWLockRelease(SequenceRefillLock);
+
+	on_shmem_exit(SeqRefillWorkerCleanup, (Datum) 0);
+
+	relids = (Oid *) MemoryContextAlloc(TopMemoryContext,
+										max_shared_sequences * sizeof(Oid));
+	last_work = GetCurrentTimestamp();
+
+	while (!got_sigterm)
+	{
+		int			nrelids = 0;
+		int			rc;
+
+		ResetLatch(&MyProc->procLatch);
+
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		/* take over the pending requests of our database */
+		LWLockAcquire(SequenceRefillLock, LW_EXCLUSIVE);
+		for (i = 0; i < max_shared_sequences; i++)
+		{
+			SeqRefillEntry *entry = &SeqRefillCtl.entries[i];
+
+			if (entry->dbid == MyDatabaseId && entry->pending)
+			{
+				entry->pending = false;
+				relids[nrelids++] = entry->relid;
+			}
+		}
+
+		if (nrelids == 0 &&
+			TimestampDifferenceExceeds(last_work, GetCurrentTimestamp(),
+									   SEQ_REFILL_IDLE_TIMEOUT))
+		{
+			/*
+			 * Give up our entry while still holding the lock, so that the
+			 * next request starts a new worker instead of waking us up.
+			 */
+			worker->dbid = InvalidOid;
+			worker->pid = 0;
+			worker->latch = NULL;
+			LWLockRelease(SequenceRefillLock);
+			break;
+		}
+		LWLockRelease(SequenceRefillLock);
+
+		for (i = 0; i < nrelids; i++)
+		{
+			TimestampTz now;
+			SeqRefillEntry *entry;
+
+			if (!SeqRefillOne(relids[i]))
+				continue;
+
+			now = GetCurrentTimestamp();
+
+			LWLockAcquire(SequenceRefillLock, LW_EXCLUSIVE);
+			entry = SeqRefillLookup(relids[i], false);
+			if (entry != NULL)
+			{
+				entry->refills++;
+				entry->last_refill = now;
+			}
+			LWLockRelease(SequenceRefillLock);
+		}
+
+		if (nrelids > 0)
+		{
+			last_work = GetCurrentTimestamp();
+			continue;
+		}
+
+		rc = WaitLatch(&MyProc->procLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   SEQ_REFILL_IDLE_TIMEOUT);
+
+		/* emergency bailout if postmaster has died */
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+	}
+
+	proc_exit(0);
+}
+
+/*
+ * Have the AM of a sequence refill its cache. Returns false if the sequence
+ * is gone or its AM doesn't do background refills (anymore).
+ */
+static bool
+SeqRefillOne(Oid relid)
+{
+	SeqTable	elm;
+	Relation	seqrel;
+	Buffer		buf;
+	HeapTupleData seqtuple;
+	bool		done = false;
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+
+	/* the sequence might have been dropped since the request */
+	LockRelationOid(relid, AccessShareLock);
+	if (SearchSysCacheExists1(RELOID, ObjectIdGetDatum(relid)) &&
+		get_rel_relkind(relid) == RELKIND_SEQUENCE)
+	{
+		init_sequence(relid, &elm, &seqrel);
+
+		if (sequence_has_refill(seqrel))
+		{
+			pgstat_report_activity(STATE_RUNNING, "refilling sequence");
+
+			read_seq_tuple(elm, seqrel, &buf, &seqtuple);
+			sequence_refill(seqrel, elm, buf, &seqtuple);
+			UnlockReleaseBuffer(buf);
+			done = true;
+		}
+
+		relation_close(seqrel, NoLock);
+	}
+
+	CommitTransactionCommand();
+	pgstat_report_activity(STATE_IDLE, NULL);
+
+	return done;
+}
+
+/*
+ * Returns the background refill statistics of the sequences of the current
+ * database.
+ */
+Datum
+pg_stat_get_sequence_refill(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_SEQUENCE_REFILL_COLS	6
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	LWLockAcquire(SequenceRefillLock, LW_SHARED);
+
+	for (i = 0; i < max_shared_sequences; i++)
+	{
+		SeqRefillEntry *entry = &SeqRefillCtl.entries[i];
+		Datum		values[PG_STAT_GET_SEQUENCE_REFILL_COLS];
+		bool		nulls[PG_STAT_GET_SEQUENCE_REFILL_COLS];
+
+		if (entry->dbid != MyDatabaseId)
+			continue;
+
+		MemSet(values, 0, sizeof(values));
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = ObjectIdGetDatum(entry->relid);
+		values[1] = Int64GetDatum(entry->requests);
+		values[2] = Int64GetDatum(entry->refills);
+		values[3] = Int64GetDatum(entry->stalls);
+		values[4] = Float8GetDatum(entry->stall_time);
+		if (entry->last_refill != 0)
+			values[5] = TimestampTzGetDatum(entry->last_refill);
+		else
+			nulls[5] = true;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	LWLockRelease(SequenceRefillLock);
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
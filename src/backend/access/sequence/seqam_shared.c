@@ -0,0 +1,731 @@
+/*-------------------------------------------------------------------------
+ *
+ * seqam_shared.c
+ *	  sequence access method that caches ranges of values in shared memory
+ *
+ * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/sequence/seqam_shared.c
+ *
+ *
+ * The "local" SeqAm reads and modifies the sequence tuple for every value it
+ * hands out (unless the sequence's CACHE is used, which keeps values in a
+ * single backend and loses them at disconnect). That requires an exclusive
+ * lock on the sequence's only page, so all backends calling nextval() on the
+ * same sequence serialize on that buffer lock.
+ *
+ * The "shared" SeqAm instead reserves a large block of values on disk at
+ * once, WAL-logging only the end of the block, and keeps the reserved range
+ * in shared memory. nextval() takes values from that range by advancing its
+ * start under a spinlock, before the sequence page is even looked at. Only
+ * once the range is used up does a backend lock the page, via the regular
+ * seqamalloc path, and reserve the next block; other backends waiting for
+ * the page lock meanwhile find the refilled range and take their values
+ * from it without touching the page.  The size of a block is the
+ * sequence's block_size option, or shared_sequence_block_size if unset.
+ *
+ * To avoid even that stall, the next block is reserved in the background:
+ * once only a quarter of the range is left, the SeqAm calls the
+ * sequence_low_watermark() hook, which has a refill worker call our
+ * seqamrefill function. That reserves the following block on disk and keeps
+ * it in the slot as the prefetched range, which nextval() continues with
+ * once the current range is used up.
+ *
+ * Values are still handed out in increasing (or decreasing) order across
+ * the instance, and CACHE still determines how many of them a backend takes
+ * at once. As with the WAL-logged cache of the local SeqAm, a crash or the
+ * eviction of a range from shared memory loses the unused remainder of a
+ * block, leaving a gap.
+ *
+ * Ranges are kept in a fixed number of slots, max_shared_sequences. A slot
+ * is identified by database, sequence and relfilenode, and invalidated when
+ * the sequence is reset by setval() or ALTER SEQUENCE. It is released when
+ * the sequence is dropped, as a new sequence may get the same OID and, with
+ * it, the same relfilenode. Backends remember
+ * the slot of each sequence in its SeqTable entry and re-check its identity
+ * under the slot's spinlock on each use, so that a slot can be reassigned to
+ * a different sequence at any time. Ranges are only ever installed while
+ * holding the lock on the sequence page, so reserving blocks on disk and
+ * installing them happen in the same order.
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/reloptions.h"
+#include "access/seqam.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "catalog/pg_seqam.h"
+#include "miscadmin.h"
+#include "storage/bufmgr.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/rel.h"
+#include "utils/timestamp.h"
+
+/*
+ * A range of values reserved on disk for a sequence.
+ *
+ * dbid, relid and filenode are only changed while holding both
+ * SharedSequenceLock exclusively and the mutex, so they can be read holding
+ * either of them.
+ */
+typedef struct SharedSeqSlot
+{
+	slock_t		mutex;
+
+	Oid			dbid;			/* database of the sequence, or InvalidOid */
+	Oid			relid;			/* pg_class OID of the sequence */
+	Oid			filenode;		/* relfilenode the range was reserved in */
+
+	bool		valid;			/* are there values left in the range? */
+	int64		next;			/* next value to hand out */
+	int64		last;			/* last value of the range */
+	int64		increment;		/* copy of the sequence's increment */
+	int64		cache;			/* copy of the sequence's cache */
+	uint64		low_watermark;	/* request a refill with this many left */
+	TimestampTz last_refill;	/* when the range was reserved, for eviction */
+
+	bool		refill_requested;	/* sequence_low_watermark() called? */
+	bool		prefetched;		/* is there a block to continue with? */
+	int64		pf_first;		/* first value of the prefetched block */
+	int64		pf_last;		/* last value of the prefetched block */
+} SharedSeqSlot;
+
+/* fraction of a block left when its successor is reserved in the background */
+#define SHARED_SEQ_LOW_WATERMARK_DIVISOR	4
+
+/* array of max_shared_sequences slots in shared memory */
+static SharedSeqSlot *SharedSeqSlots = NULL;
+
+/* GUC variables */
+int			max_shared_sequences = 64;
+int			shared_sequence_block_size = 1024;
+
+static SharedSeqSlot *SharedSeqLookup(Relation seqrel, bool create);
+static bool SharedSeqTake(SharedSeqSlot *slot, Relation seqrel, SeqTable elm,
+			  bool *refill);
+static bool SharedSeqTakeLocked(SharedSeqSlot *slot, SeqTable elm);
+static void SharedSeqInstallLocked(SharedSeqSlot *slot, Relation seqrel,
+					   Form_pg_sequence seq, int64 first, int64 last);
+static bool SharedSeqReserveBlock(Relation seqrel, Buffer buf,
+					  HeapTuple seqtuple, bool noerror,
+					  int64 *first, int64 *last);
+static uint64 SharedSeqRangeSize(int64 first, int64 last, int64 incby);
+
+/*
+ * Report shared-memory space needed by SharedSeqShmemInit.
+ */
+Size
+SharedSeqShmemSize(void)
+{
+	return mul_size(max_shared_sequences, sizeof(SharedSeqSlot));
+}
+
+/*
+ * Allocate and initialize the shared sequence ranges.
+ */
+void
+SharedSeqShmemInit(void)
+{
+	bool		found;
+
+	SharedSeqSlots = (SharedSeqSlot *)
+		ShmemInitStruct("Shared Sequence Ranges", SharedSeqShmemSize(),
+						&found);
+
+	if (!found)
+	{
+		int			i;
+
+		MemSet(SharedSeqSlots, 0, SharedSeqShmemSize());
+
+		for (i = 0; i < max_shared_sequences; i++)
+			SpinLockInit(&SharedSeqSlots[i].mutex);
+	}
+}
+
+/*
+ * Find the slot of a sequence. If there is none and create is true, assign
+ * one, preferring unused slots and otherwise evicting the range that was
+ * reserved least recently.
+ */
+static SharedSeqSlot *
+SharedSeqLookup(Relation seqrel, bool create)
+{
+	Oid			relid = RelationGetRelid(seqrel);
+	SharedSeqSlot *victim = NULL;
+	int			i;
+
+	if (max_shared_sequences == 0)
+		return NULL;
+
+	LWLockAcquire(SharedSequenceLock, create ? LW_EXCLUSIVE : LW_SHARED);
+
+	for (i = 0; i < max_shared_sequences; i++)
+	{
+		SharedSeqSlot *slot = &SharedSeqSlots[i];
+
+		if (slot->dbid == MyDatabaseId && slot->relid == relid)
+		{
+			LWLockRelease(SharedSequenceLock);
+			return slot;
+		}
+
+		if (!create)
+			continue;
+
+		if (!OidIsValid(slot->dbid))
+		{
+			if (victim == NULL || OidIsValid(victim->dbid))
+				victim = slot;
+		}
+		else if (victim == NULL ||
+				 (OidIsValid(victim->dbid) &&
+				  slot->last_refill < victim->last_refill))
+			victim = slot;
+	}
+
+	if (victim != NULL)
+	{
+		SpinLockAcquire(&victim->mutex);
+		victim->dbid = MyDatabaseId;
+		victim->relid = relid;
+		victim->filenode = InvalidOid;
+		victim->valid = false;
+		victim->refill_requested = false;
+		victim->prefetched = false;
+		SpinLockRelease(&victim->mutex);
+	}
+
+	LWLockRelease(SharedSequenceLock);
+
+	return victim;
+}
+
+/*
+ * Number of values from first to last, stepping by incby.
+ */
+static uint64
+SharedSeqRangeSize(int64 first, int64 last, int64 incby)
+{
+	/* compute in uint64, the range may be wider than INT64_MAX */
+	if (incby > 0)
+		return ((uint64) last - (uint64) first) / (uint64) incby + 1;
+	else
+		return ((uint64) first - (uint64) last) /
+			((uint64) 0 - (uint64) incby) + 1;
+}
+
+/*
+ * Take the next CACHE values of the sequence from its slot, and store them
+ * in elm like the seqamalloc function does. *refill is set if the caller
+ * has to call sequence_low_watermark().
+ *
+ * Returns false if the slot has been reassigned or invalidated, or its range
+ * is used up.
+ */
+static bool
+SharedSeqTake(SharedSeqSlot *slot, Relation seqrel, SeqTable elm,
+			  bool *refill)
+{
+	SpinLockAcquire(&slot->mutex);
+
+	if (!slot->valid ||
+		slot->dbid != MyDatabaseId ||
+		slot->relid != RelationGetRelid(seqrel) ||
+		slot->filenode != seqrel->rd_rel->relfilenode)
+	{
+		SpinLockRelease(&slot->mutex);
+		*refill = false;
+		return false;
+	}
+
+	*refill = SharedSeqTakeLocked(slot, elm);
+
+	SpinLockRelease(&slot->mutex);
+
+	return true;
+}
+
+/*
+ * Guts of SharedSeqTake(); the caller must hold the slot's mutex and have
+ * checked that the slot holds a valid range of the sequence. Returns true
+ * if the range has dropped to its low watermark and no refill has been
+ * requested yet.
+ */
+static bool
+SharedSeqTakeLocked(SharedSeqSlot *slot, SeqTable elm)
+{
+	int64		result = slot->next;
+	int64		incby = slot->increment;
+	uint64		remaining;
+	uint64		count;
+	uint64		left;
+
+	remaining = SharedSeqRangeSize(slot->next, slot->last, incby);
+	count = Min((uint64) slot->cache, remaining);
+
+	if (count < remaining)
+	{
+		slot->next += (int64) count * incby;
+		left = remaining - count;
+	}
+	else if (slot->prefetched)
+	{
+		/* continue with the block reserved in the background */
+		slot->next = slot->pf_first;
+		slot->last = slot->pf_last;
+		slot->prefetched = false;
+		slot->refill_requested = false;
+		left = SharedSeqRangeSize(slot->next, slot->last, incby);
+	}
+	else
+	{
+		slot->valid = false;
+		left = 0;
+	}
+
+	elm->last = result;
+	elm->cached = result + ((int64) count - 1) * incby;
+	elm->increment = incby;
+	elm->last_valid = true;
+
+	if (!slot->prefetched && !slot->refill_requested &&
+		left <= slot->low_watermark)
+	{
+		slot->refill_requested = true;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Make the block from first to last the current range of the slot; the
+ * caller must hold the slot's mutex.
+ */
+static void
+SharedSeqInstallLocked(SharedSeqSlot *slot, Relation seqrel,
+					   Form_pg_sequence seq, int64 first, int64 last)
+{
+	slot->filenode = seqrel->rd_rel->relfilenode;
+	slot->next = first;
+	slot->last = last;
+	slot->increment = seq->increment_by;
+	slot->cache = seq->cache_value;
+	slot->low_watermark = SharedSeqRangeSize(first, last, seq->increment_by) /
+		SHARED_SEQ_LOW_WATERMARK_DIVISOR;
+	slot->valid = true;
+	slot->refill_requested = false;
+	slot->prefetched = false;
+}
+
+/*
+ * Reserve the next block of values of the sequence on disk, and return its
+ * first and last value. The sequence page must be locked.
+ *
+ * If the sequence has reached its maximum (or minimum) value and doesn't
+ * cycle, raise an error, or return false if noerror is set.
+ */
+static bool
+SharedSeqReserveBlock(Relation seqrel, Buffer buf, HeapTuple seqtuple,
+					  bool noerror, int64 *first, int64 *last)
+{
+	Page		page = BufferGetPage(buf);
+	Form_pg_sequence seq = (Form_pg_sequence) GETSTRUCT(seqtuple);
+	int64		incby = seq->increment_by;
+	int64		maxv = seq->max_value;
+	int64		minv = seq->min_value;
+	int64		next;
+	uint64		avail;
+	uint64		block;
+
+	/* the first value of the new block, as the local SeqAm computes it */
+	next = seq->last_value;
+	if (seq->is_called)
+	{
+		if (incby > 0)
+		{
+			/* ascending sequence */
+			if ((maxv >= 0 && next > maxv - incby) ||
+				(maxv < 0 && next + incby > maxv))
+			{
+				if (!seq->is_cycled)
+				{
+					char		bufm[100];
+
+					if (noerror)
+						return false;
+
+					snprintf(bufm, sizeof(bufm), INT64_FORMAT, maxv);
+					ereport(ERROR,
+						  (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+						   errmsg("nextval: reached maximum value of sequence \"%s\" (%s)",
+								  RelationGetRelationName(seqrel), bufm)));
+				}
+				next = minv;
+			}
+			else
+				next += incby;
+		}
+		else
+		{
+			/* descending sequence */
+			if ((minv < 0 && next < minv - incby) ||
+				(minv >= 0 && next + incby < minv))
+			{
+				if (!seq->is_cycled)
+				{
+					char		bufm[100];
+
+					if (noerror)
+						return false;
+
+					snprintf(bufm, sizeof(bufm), INT64_FORMAT, minv);
+					ereport(ERROR,
+						  (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+						   errmsg("nextval: reached minimum value of sequence \"%s\" (%s)",
+								  RelationGetRelationName(seqrel), bufm)));
+				}
+				next = maxv;
+			}
+			else
+				next += incby;
+		}
+	}
+
+	/*
+	 * Reserve the sequence's block_size values, falling back to
+	 * shared_sequence_block_size, but at least CACHE of them, and never wrap
+	 * around within a block.
+	 */
+	if (incby > 0)
+		avail = SharedSeqRangeSize(next, maxv, incby);
+	else
+		avail = SharedSeqRangeSize(next, minv, incby);
+	if (seqrel->rd_options != NULL &&
+		((SharedSeqOptions *) seqrel->rd_options)->block_size > 0)
+		block = ((SharedSeqOptions *) seqrel->rd_options)->block_size;
+	else
+		block = shared_sequence_block_size;
+	block = Max(block, (uint64) seq->cache_value);
+	block = Min(block, avail);
+
+	*first = next;
+	*last = next + ((int64) block - 1) * incby;
+
+	/* check the comment above sequence_local_alloc()'s equivalent call. */
+	if (RelationNeedsWAL(seqrel))
+		GetTopTransactionId();
+
+	/* ready to change the on-disk (or really, in-buffer) tuple */
+	START_CRIT_SECTION();
+
+	MarkBufferDirty(buf);
+
+	/*
+	 * The whole block counts as used on disk, so there is nothing left for
+	 * log_cnt to cover.
+	 */
+	seq->last_value = *last;
+	seq->is_called = true;
+	seq->log_cnt = 0;
+
+	if (RelationNeedsWAL(seqrel))
+		log_sequence_tuple(seqrel, seqtuple, page);
+
+	END_CRIT_SECTION();
+
+	return true;
+}
+
+/*
+ * Invalidate the range of a sequence, if there is one.
+ */
+void
+sequence_shared_invalidate(Relation seqrel)
+{
+	SharedSeqSlot *slot = SharedSeqLookup(seqrel, false);
+
+	if (slot == NULL)
+		return;
+
+	SpinLockAcquire(&slot->mutex);
+	if (slot->dbid == MyDatabaseId &&
+		slot->relid == RelationGetRelid(seqrel))
+	{
+		slot->valid = false;
+		slot->refill_requested = false;
+		slot->prefetched = false;
+	}
+	SpinLockRelease(&slot->mutex);
+}
+
+/*
+ * Release the slot of a sequence that is being dropped, if it has one.
+ *
+ * Called with the sequence locked exclusively, so nobody can install a new
+ * range before the drop commits. If it aborts instead, the sequence just
+ * continues with a new block.
+ */
+void
+sequence_shared_forget(Oid relid)
+{
+	int			i;
+
+	if (max_shared_sequences == 0)
+		return;
+
+	LWLockAcquire(SharedSequenceLock, LW_EXCLUSIVE);
+
+	for (i = 0; i < max_shared_sequences; i++)
+	{
+		SharedSeqSlot *slot = &SharedSeqSlots[i];
+
+		if (slot->dbid != MyDatabaseId || slot->relid != relid)
+			continue;
+
+		SpinLockAcquire(&slot->mutex);
+		slot->dbid = InvalidOid;
+		slot->relid = InvalidOid;
+		slot->filenode = InvalidOid;
+		slot->valid = false;
+		slot->refill_requested = false;
+		slot->prefetched = false;
+		SpinLockRelease(&slot->mutex);
+	}
+
+	LWLockRelease(SharedSequenceLock);
+}
+
+/*------------------------------------------------------------
+ *
+ * Sequence Access Manager = SHARED functions
+ *
+ *------------------------------------------------------------
+ */
+
+/*
+ * sequence_shared_nextval()
+ *
+ * Hand out values from the range in shared memory, without locking the
+ * sequence page. Returns false if the range has to be refilled first.
+ */
+Datum
+sequence_shared_nextval(PG_FUNCTION_ARGS)
+{
+	Relation	seqrel = (Relation) PG_GETARG_POINTER(0);
+	SeqTable	elm = (SeqTable) PG_GETARG_POINTER(1);
+	SharedSeqSlot *slot = (SharedSeqSlot *) DatumGetPointer(elm->am_private);
+	bool		refill;
+
+	if (slot == NULL)
+	{
+		slot = SharedSeqLookup(seqrel, false);
+		if (slot == NULL)
+			PG_RETURN_BOOL(false);
+		elm->am_private = PointerGetDatum(slot);
+	}
+
+	if (!SharedSeqTake(slot, seqrel, elm, &refill))
+		PG_RETURN_BOOL(false);
+
+	if (refill)
+		sequence_low_watermark(seqrel);
+
+	PG_RETURN_BOOL(true);
+}
+
+/*
+ * sequence_shared_alloc()
+ *
+ * Reserve a new block of values on disk and install it as the shared range
+ * of the sequence. Called with the sequence page locked once
+ * sequence_shared_nextval() found the range used up.
+ */
+Datum
+sequence_shared_alloc(PG_FUNCTION_ARGS)
+{
+	Relation	seqrel = (Relation) PG_GETARG_POINTER(0);
+	SeqTable	elm = (SeqTable) PG_GETARG_POINTER(1);
+	Buffer		buf = (Buffer) PG_GETARG_INT32(2);
+	HeapTuple	seqtuple = (HeapTuple) PG_GETARG_POINTER(3);
+	Form_pg_sequence seq = (Form_pg_sequence) GETSTRUCT(seqtuple);
+	SharedSeqSlot *slot;
+	bool		refill = false;
+	int64		first;
+	int64		last;
+
+	/*
+	 * Another backend or the refill worker might have refilled the range
+	 * while we were waiting for the page lock.
+	 */
+	slot = SharedSeqLookup(seqrel, true);
+	if (slot != NULL)
+	{
+		elm->am_private = PointerGetDatum(slot);
+		if (SharedSeqTake(slot, seqrel, elm, &refill))
+		{
+			if (refill)
+				sequence_low_watermark(seqrel);
+			PG_RETURN_VOID();
+		}
+	}
+
+	(void) SharedSeqReserveBlock(seqrel, buf, seqtuple, false, &first, &last);
+
+	/*
+	 * Install the block as the shared range and take our values from it,
+	 * unless the slot has been evicted in the meantime.
+	 */
+	if (slot != NULL)
+	{
+		TimestampTz now = GetCurrentTimestamp();
+		bool		installed = false;
+
+		SpinLockAcquire(&slot->mutex);
+		if (slot->dbid == MyDatabaseId &&
+			slot->relid == RelationGetRelid(seqrel))
+		{
+			SharedSeqInstallLocked(slot, seqrel, seq, first, last);
+			slot->last_refill = now;
+			refill = SharedSeqTakeLocked(slot, elm);
+			installed = true;
+		}
+		SpinLockRelease(&slot->mutex);
+
+		if (installed)
+		{
+			if (refill)
+				sequence_low_watermark(seqrel);
+			PG_RETURN_VOID();
+		}
+	}
+
+	/* without a slot, the block serves just this backend */
+	elm->last = first;
+	elm->cached = last;
+	elm->increment = seq->increment_by;
+	elm->last_valid = true;
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * sequence_shared_refill()
+ *
+ * Reserve the block following the current range in the background, so that
+ * nextval() can continue with it without waiting for the sequence page.
+ * Called by the refill worker with the sequence page locked.
+ */
+Datum
+sequence_shared_refill(PG_FUNCTION_ARGS)
+{
+	Relation	seqrel = (Relation) PG_GETARG_POINTER(0);
+	Buffer		buf = (Buffer) PG_GETARG_INT32(2);
+	HeapTuple	seqtuple = (HeapTuple) PG_GETARG_POINTER(3);
+	Form_pg_sequence seq = (Form_pg_sequence) GETSTRUCT(seqtuple);
+	SharedSeqSlot *slot;
+	bool		needed;
+	int64		first;
+	int64		last;
+	TimestampTz now;
+
+	slot = SharedSeqLookup(seqrel, false);
+	if (slot == NULL)
+		PG_RETURN_VOID();
+
+	/* nothing to do if a nextval() stall has refilled the range meanwhile */
+	SpinLockAcquire(&slot->mutex);
+	needed = (slot->dbid == MyDatabaseId &&
+			  slot->relid == RelationGetRelid(seqrel) &&
+			  slot->refill_requested && !slot->prefetched);
+	SpinLockRelease(&slot->mutex);
+
+	if (!needed)
+		PG_RETURN_VOID();
+
+	/* once the sequence is exhausted, leave the error to nextval() */
+	if (!SharedSeqReserveBlock(seqrel, buf, seqtuple, true, &first, &last))
+		PG_RETURN_VOID();
+
+	now = GetCurrentTimestamp();
+
+	SpinLockAcquire(&slot->mutex);
+	if (slot->dbid == MyDatabaseId &&
+		slot->relid == RelationGetRelid(seqrel))
+	{
+		if (slot->valid && slot->filenode == seqrel->rd_rel->relfilenode)
+		{
+			slot->pf_first = first;
+			slot->pf_last = last;
+			slot->prefetched = true;
+			slot->refill_requested = false;
+		}
+		else
+			SharedSeqInstallLocked(slot, seqrel, seq, first, last);
+		slot->last_refill = now;
+	}
+	SpinLockRelease(&slot->mutex);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * sequence_shared_options()
+ *
+ * Parse and verify the options of a shared sequence.
+ */
+Datum
+sequence_shared_options(PG_FUNCTION_ARGS)
+{
+	Datum		reloptions = PG_GETARG_DATUM(0);
+	bool		validate = PG_GETARG_BOOL(1);
+	relopt_value *options;
+	SharedSeqOptions *rdopts;
+	int			numoptions;
+	static const relopt_parse_elt tab[] = {
+		{"block_size", RELOPT_TYPE_INT, offsetof(SharedSeqOptions, block_size)}
+	};
+
+	options = parseRelOptions(reloptions, validate,
+							  RELOPT_KIND_SHARED_SEQUENCE, &numoptions);
+
+	/* if none set, we're done */
+	if (numoptions == 0)
+		PG_RETURN_NULL();
+
+	rdopts = allocateReloptStruct(sizeof(SharedSeqOptions), options,
+								  numoptions);
+
+	fillRelOptions((void *) rdopts, sizeof(SharedSeqOptions), options,
+				   numoptions, validate, tab, lengthof(tab));
+
+	pfree(options);
+
+	PG_RETURN_BYTEA_P(rdopts);
+}
+
+/*
+ * sequence_shared_setval()
+ *
+ * Forget the shared range of the sequence, then set it like a local one.
+ */
+Datum
+sequence_shared_setval(PG_FUNCTION_ARGS)
+{
+	Relation	seqrel = (Relation) PG_GETARG_POINTER(0);
+
+	sequence_shared_invalidate(seqrel);
+
+	sequence_local_setval(fcinfo);
+
+	PG_RETURN_VOID();
+}
@@ -15,6 +15,12 @@
  * re-perform the status update on redo; so we need make no additional XLOG
  * entry here.
  *
+ * To find the transactions that committed in a given time range without
+ * scanning the whole SLRU, we keep a sparse index in shared memory storing
+ * the lowest and highest commit timestamp of each CommitTs segment.  It is
+ * saved to a file at checkpoints; as updating an index entry is idempotent,
+ * replaying the commits after the checkpoint brings it up to date again.
+ *
  * Portions Copyright (c) 1996-2013, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -24,6 +30,10 @@
  */
 #include "postgres.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "access/committs.h"
 #include "access/htup_details.h"
 #include "access/slru.h"
@@ -32,7 +42,9 @@
 #include "funcapi.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
+#include "storage/fd.h"
 #include "utils/builtins.h"
+#include "utils/pg_crc.h"
 #include "utils/snapmgr.h"
 #include "utils/timestamp.h"
 
@@ -66,6 +78,46 @@ typedef struct CommitTimestampEntry
 #define TransactionIdToCTsEntry(xid)	\
 	((xid) % (TransactionId) COMMITTS_XACTS_PER_PAGE)
 
+/*
+ * Defines for the commit timestamp index, which has one entry per CommitTs
+ * segment, covering the whole XID space.
+ */
+#define COMMITTS_XACTS_PER_SEGMENT \
+	((uint64) COMMITTS_XACTS_PER_PAGE * SLRU_PAGES_PER_SEGMENT)
+
+#define TransactionIdToCTsIndexEntry(xid) \
+	((int) ((xid) / COMMITTS_XACTS_PER_SEGMENT))
+
+#define COMMITTS_INDEX_ENTRIES \
+	(TransactionIdToCTsIndexEntry(MaxTransactionId) + 1)
+
+/* number of entries examined per acquisition of CommitTsLock */
+#define COMMITTS_INDEX_SCAN_BATCH	1024
+
+/* Lowest and highest commit timestamp of the transactions in a segment */
+typedef struct CommitTsIndexEntry
+{
+	TimestampTz min_time;
+	TimestampTz max_time;
+} CommitTsIndexEntry;
+
+/*
+ * On-disk format of the index, written by CheckPointCommitTs().  The entries
+ * of the segments from firstEntry on follow the header.
+ */
+typedef struct CommitTsIndexFileHeader
+{
+	uint32		magic;
+	pg_crc32	checksum;		/* covers the rest of the file */
+	TransactionId indexStartXid;
+	int			firstEntry;
+	int			nentries;
+} CommitTsIndexFileHeader;
+
+#define COMMITTS_INDEX_MAGIC	0x2C07D1E5
+#define COMMITTS_INDEX_FILE		"pg_committs/index"
+#define COMMITTS_INDEX_TMPFILE	"pg_committs/index.tmp"
+
 /*
  * Link to shared-memory data structures for CLOG control
  */
@@ -75,19 +127,32 @@ static SlruCtlData CommitTsCtlData;
 
 /*
  * We keep a cache of the last value set in shared memory.  This is protected
- * by CommitTsLock.
+ * by CommitTsLock, as is ShmemVariableCache->oldestCommitTs.
+ *
+ * The SLRU is banked, see SimpleLruInitBanked(), so lookups of different
+ * pages don't serialize on CommitTsControlLock.
+ *
+ * The index entries are protected by CommitTsLock as well, so maintaining
+ * them doesn't add a lock acquisition to every commit.  Transactions before
+ * indexStartXid, which committed while the index wasn't maintained, are not
+ * covered by the index.
  */
 typedef struct CommitTimestampShared
 {
 	TransactionId	xidLastCommit;
 	CommitTimestampEntry dataLastCommit;
+	TransactionId	indexStartXid;
 } CommitTimestampShared;
 
 CommitTimestampShared	*commitTsShared;
 
+/* array of COMMITTS_INDEX_ENTRIES entries, only allocated if enabled */
+static CommitTsIndexEntry *commitTsIndex;
+
 
 /* GUC variables */
 bool	commit_ts_enabled;
+int		commit_ts_buffers = 0;
 
 static void SetXidCommitTsInPage(TransactionId xid, int nsubxids,
 					 TransactionId *subxids, TimestampTz committs,
@@ -101,6 +166,9 @@ static void WriteTruncateXlogRec(int pageno);
 static void WriteSetTimestampXlogRec(TransactionId mainxid, int nsubxids,
 						 TransactionId *subxids, TimestampTz timestamp,
 						 CommitExtraData data);
+static void CommitTsIndexUpdate(TransactionId xid, TimestampTz timestamp);
+static void CommitTsIndexReset(int entryno);
+static void CheckPointCommitTsIndex(void);
 
 
 /*
@@ -175,15 +243,54 @@ TransactionTreeSetCommitTimestamp(TransactionId xid, int nsubxids,
 	}
 
 	/*
-	 * Update the cached value in shared memory
+	 * Update the cached value in shared memory, and the index entries of the
+	 * segments the transaction tree is on.
 	 */
 	LWLockAcquire(CommitTsLock, LW_EXCLUSIVE);
 	commitTsShared->xidLastCommit = xid;
 	commitTsShared->dataLastCommit.time = timestamp;
 	commitTsShared->dataLastCommit.extra = extra;
+
+	CommitTsIndexUpdate(xid, timestamp);
+	for (i = 0; i < nsubxids; i++)
+	{
+		if (TransactionIdToCTsIndexEntry(subxids[i]) !=
+			TransactionIdToCTsIndexEntry(i > 0 ? subxids[i - 1] : xid))
+			CommitTsIndexUpdate(subxids[i], timestamp);
+	}
 	LWLockRelease(CommitTsLock);
 }
 
+/*
+ * Account for a commit timestamp in the index entry of xid's segment.
+ *
+ * Must be called with CommitTsLock held exclusively.
+ */
+static void
+CommitTsIndexUpdate(TransactionId xid, TimestampTz timestamp)
+{
+	CommitTsIndexEntry *entry;
+
+	entry = &commitTsIndex[TransactionIdToCTsIndexEntry(xid)];
+
+	if (timestamp < entry->min_time)
+		entry->min_time = timestamp;
+	if (timestamp > entry->max_time)
+		entry->max_time = timestamp;
+}
+
+/*
+ * Empty an index entry, when its segment is (re-)initialized.
+ *
+ * Must be called with CommitTsLock held exclusively.
+ */
+static void
+CommitTsIndexReset(int entryno)
+{
+	commitTsIndex[entryno].min_time = DT_NOEND;
+	commitTsIndex[entryno].max_time = DT_NOBEGIN;
+}
+
 /*
  * Record the commit timestamp of transaction entries in the commit log for all
  * entries on a single page.  Atomic only on this page.
@@ -193,10 +300,11 @@ SetXidCommitTsInPage(TransactionId xid, int nsubxids,
 					 TransactionId *subxids, TimestampTz committs,
 					 CommitExtraData extra, int pageno)
 {
+	LWLock	   *lock = SimpleLruGetBankLock(CommitTsCtl, pageno);
 	int			slotno;
 	int			i;
 
-	LWLockAcquire(CommitTsControlLock, LW_EXCLUSIVE);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
 
 	slotno = SimpleLruReadPage(CommitTsCtl, pageno, true, xid);
 
@@ -206,13 +314,13 @@ SetXidCommitTsInPage(TransactionId xid, int nsubxids,
 
 	CommitTsCtl->shared->page_dirty[slotno] = true;
 
-	LWLockRelease(CommitTsControlLock);
+	LWLockRelease(lock);
 }
 
 /*
  * Sets the commit timestamp of a single transaction.
  *
- * Must be called with CommitTsControlLock held
+ * Must be called with the bank lock of the page held
  */
 static void
 TransactionIdSetCommitTs(TransactionId xid, TimestampTz committs,
@@ -252,10 +360,12 @@ TransactionIdGetCommitTsData(TransactionId xid, TimestampTz *ts,
 		return;
 	}
 
-	/* Also return empty if the requested value is older than what we have */
-	LWLockAcquire(CommitTsControlLock, LW_SHARED);
+	/*
+	 * Also return empty if the requested value is older than what we have.
+	 * Reading the value without CommitTsLock is fine, since it could change
+	 * right after releasing the lock just as well.
+	 */
 	oldestCommitTs = ShmemVariableCache->oldestCommitTs;
-	LWLockRelease(CommitTsControlLock);
 
 	if (!TransactionIdIsValid(oldestCommitTs) ||
 		TransactionIdPrecedes(xid, oldestCommitTs))
@@ -300,7 +410,7 @@ TransactionIdGetCommitTsData(TransactionId xid, TimestampTz *ts,
 	if (data)
 		*data = entry->extra;
 
-	LWLockRelease(CommitTsControlLock);
+	LWLockRelease(SimpleLruGetBankLock(CommitTsCtl, pageno));
 }
 
 /*
@@ -443,16 +553,191 @@ pg_get_latest_transaction_committime_data(PG_FUNCTION_ARGS)
 	PG_RETURN_DATUM(HeapTupleGetDatum(htup));
 }
 
+/*
+ * Determine the range of XIDs that may have committed between from and to,
+ * inclusive, using the index.
+ *
+ * Returns false if there can't be any such transaction.  Otherwise all
+ * transactions that committed in that time range are between *first_xid and
+ * *last_xid, but not every transaction in that XID range did.
+ */
+bool
+CommitTsGetXidRange(TimestampTz from, TimestampTz to,
+					TransactionId *first_xid, TransactionId *last_xid)
+{
+	TransactionId oldest;
+	TransactionId newest;
+	TransactionId indexStart;
+	TransactionId scanStart;
+	int			entryno;
+	int			lastentry;
+	bool		found = false;
+	bool		done = false;
+
+	if (!commit_ts_enabled || from > to)
+		return false;
+
+	LWLockAcquire(CommitTsLock, LW_SHARED);
+	oldest = ShmemVariableCache->oldestCommitTs;
+	indexStart = commitTsShared->indexStartXid;
+	LWLockRelease(CommitTsLock);
+
+	if (!TransactionIdIsValid(oldest))
+		return false;
+
+	newest = ReadNewTransactionId();
+	TransactionIdRetreat(newest);
+	if (TransactionIdPrecedes(newest, oldest))
+		return false;
+
+	/*
+	 * Transactions that aren't covered by the index might have committed at
+	 * any time.
+	 */
+	scanStart = oldest;
+	if (TransactionIdPrecedes(oldest, indexStart))
+	{
+		*first_xid = oldest;
+		*last_xid = indexStart;
+		TransactionIdRetreat(*last_xid);
+		found = true;
+
+		if (TransactionIdPrecedes(newest, indexStart))
+			return true;
+		scanStart = indexStart;
+	}
+
+	entryno = TransactionIdToCTsIndexEntry(scanStart);
+	lastentry = TransactionIdToCTsIndexEntry(newest);
+
+	/*
+	 * Scan the entries from the one of the oldest to the one of the newest
+	 * transaction, which may wrap around.  Release the lock every now and
+	 * then, so we don't block commits for long; an entry changing behind
+	 * our back can only affect transactions committing concurrently.
+	 */
+	while (!done)
+	{
+		int			i;
+
+		CHECK_FOR_INTERRUPTS();
+
+		LWLockAcquire(CommitTsLock, LW_SHARED);
+		for (i = 0; i < COMMITTS_INDEX_SCAN_BATCH && !done; i++)
+		{
+			CommitTsIndexEntry *entry = &commitTsIndex[entryno];
+
+			if (entry->min_time <= to && entry->max_time >= from)
+			{
+				TransactionId segstart;
+				TransactionId segend;
+
+				segstart = (TransactionId) (entryno * COMMITTS_XACTS_PER_SEGMENT);
+				segend = (TransactionId)
+					Min(segstart + COMMITTS_XACTS_PER_SEGMENT - 1,
+						(uint64) MaxTransactionId);
+
+				if (!found)
+				{
+					if (entryno == TransactionIdToCTsIndexEntry(scanStart))
+						segstart = scanStart;
+					else if (!TransactionIdIsNormal(segstart))
+						segstart = FirstNormalTransactionId;
+					*first_xid = segstart;
+					found = true;
+				}
+				*last_xid = entryno == lastentry ? newest : segend;
+			}
+
+			if (entryno == lastentry)
+				done = true;
+			else
+				entryno = (entryno + 1) % COMMITTS_INDEX_ENTRIES;
+		}
+		LWLockRelease(CommitTsLock);
+	}
+
+	return found;
+}
+
+/*
+ * SQL-callable function returning the range of XIDs that may have committed
+ * between two timestamps, or NULLs if no transaction did.
+ */
+PG_FUNCTION_INFO_V1(pg_xid_range_for_committime);
+Datum
+pg_xid_range_for_committime(PG_FUNCTION_ARGS)
+{
+	TimestampTz from = PG_GETARG_TIMESTAMPTZ(0);
+	TimestampTz to = PG_GETARG_TIMESTAMPTZ(1);
+	TransactionId first_xid;
+	TransactionId last_xid;
+	Datum       values[2];
+	bool        nulls[2];
+	TupleDesc   tupdesc;
+	HeapTuple	htup;
+
+	/*
+	 * Construct a tuple descriptor for the result row.  This must match this
+	 * function's pg_proc entry!
+	 */
+	tupdesc = CreateTemplateTupleDesc(2, false);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "first_xid",
+					   XIDOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "last_xid",
+					   XIDOID, -1, 0);
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	if (CommitTsGetXidRange(from, to, &first_xid, &last_xid))
+	{
+		values[0] = TransactionIdGetDatum(first_xid);
+		nulls[0] = false;
+		values[1] = TransactionIdGetDatum(last_xid);
+		nulls[1] = false;
+	}
+	else
+	{
+		values[0] = values[1] = (Datum) 0;
+		nulls[0] = nulls[1] = true;
+	}
+
+	htup = heap_form_tuple(tupdesc, values, nulls);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(htup));
+}
+
 /*
  * Number of shared CommitTS buffers.
  *
- * We use a very similar logic as for the number of CLOG buffers; see comments
- * in CLOGShmemBuffers.
+ * Unless configured with commit_ts_buffers, we use 1/512th of shared_buffers,
+ * but at least one and at most 64 banks.  Lookups of commit timestamps, e.g.
+ * for conflict resolution, can touch many more pages than CLOG lookups do,
+ * as the entries are much larger.
  */
 Size
 CommitTsShmemBuffers(void)
 {
-	return Min(16, Max(4, NBuffers / 1024));
+	int			nbuffers = commit_ts_buffers;
+
+	if (nbuffers == 0)
+		nbuffers = Min(64 * SLRU_BANK_SIZE,
+					   Max(SLRU_BANK_SIZE, NBuffers / 512));
+
+	/* round to whole banks */
+	return Max(SLRU_BANK_SIZE, nbuffers - nbuffers % SLRU_BANK_SIZE);
+}
+
+/*
+ * Number of LWLocks needed by the CommitTs SLRU, in addition to
+ * CommitTsControlLock.
+ */
+int
+CommitTsNumLWLocks(void)
+{
+	int			nbuffers = CommitTsShmemBuffers();
+
+	/* one per buffer, and one per bank but the first */
+	return nbuffers + SimpleLruNumBanks(nbuffers) - 1;
 }
 
 /*
@@ -461,8 +746,15 @@ CommitTsShmemBuffers(void)
 Size
 CommitTsShmemSize(void)
 {
-	return SimpleLruShmemSize(CommitTsShmemBuffers(), 0) +
-		sizeof(CommitTimestampShared);
+	Size		size;
+
+	size = SimpleLruShmemSize(CommitTsShmemBuffers(), 0);
+	size = add_size(size, sizeof(CommitTimestampShared));
+	if (commit_ts_enabled)
+		size = add_size(size, mul_size(COMMITTS_INDEX_ENTRIES,
+									   sizeof(CommitTsIndexEntry)));
+
+	return size;
 }
 
 void
@@ -471,8 +763,8 @@ CommitTsShmemInit(void)
 	bool	found;
 
 	CommitTsCtl->PagePrecedes = CommitTsPagePrecedes;
-	SimpleLruInit(CommitTsCtl, "CommitTs Ctl", CommitTsShmemBuffers(), 0,
-				  CommitTsControlLock, "pg_committs");
+	SimpleLruInitBanked(CommitTsCtl, "CommitTs Ctl", CommitTsShmemBuffers(), 0,
+						CommitTsControlLock, "pg_committs");
 
 	commitTsShared = ShmemInitStruct("CommitTs shared",
 									 sizeof(CommitTimestampShared),
@@ -485,9 +777,25 @@ CommitTsShmemInit(void)
 		commitTsShared->xidLastCommit = InvalidTransactionId;
 		commitTsShared->dataLastCommit.time = 0;
 		commitTsShared->dataLastCommit.extra = 0;
+		commitTsShared->indexStartXid = InvalidTransactionId;
 	}
 	else
 		Assert(found);
+
+	if (commit_ts_enabled)
+	{
+		commitTsIndex = ShmemInitStruct("CommitTs index",
+										COMMITTS_INDEX_ENTRIES *
+										sizeof(CommitTsIndexEntry),
+										&found);
+		if (!found)
+		{
+			int			i;
+
+			for (i = 0; i < COMMITTS_INDEX_ENTRIES; i++)
+				CommitTsIndexReset(i);
+		}
+	}
 }
 
 /*
@@ -513,7 +821,7 @@ BootStrapCommitTs(void)
  * The page is not actually written, just set up in shared memory.
  * The slot number of the new page is returned.
  *
- * Control lock must be held at entry, and will be held at exit.
+ * The bank lock of the page must be held at entry, and will be held at exit.
  */
 static int
 ZeroCommitTsPage(int pageno, bool writeXlog)
@@ -522,6 +830,14 @@ ZeroCommitTsPage(int pageno, bool writeXlog)
 
 	slotno = SimpleLruZeroPage(CommitTsCtl, pageno);
 
+	/* a new segment starts out without any commits */
+	if (commit_ts_enabled && pageno % SLRU_PAGES_PER_SEGMENT == 0)
+	{
+		LWLockAcquire(CommitTsLock, LW_EXCLUSIVE);
+		CommitTsIndexReset(pageno / SLRU_PAGES_PER_SEGMENT);
+		LWLockRelease(CommitTsLock);
+	}
+
 	if (writeXlog)
 		WriteZeroPageXlogRec(pageno);
 
@@ -543,8 +859,10 @@ StartupCommitTs(void)
 	TransactionId xid = ShmemVariableCache->nextXid;
 	int			pageno = TransactionIdToCTsPage(xid);
 	SlruCtl		ctl = CommitTsCtl;
+	LWLock	   *lock = SimpleLruGetBankLock(ctl, pageno);
 
-	LWLockAcquire(CommitTsControlLock, LW_EXCLUSIVE);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
+	LWLockAcquire(CommitTsLock, LW_EXCLUSIVE);
 
 	/*
 	 * Initialize our idea of the latest page number.
@@ -558,10 +876,18 @@ StartupCommitTs(void)
 	if (!commit_ts_enabled)
 	{
 		ShmemVariableCache->oldestCommitTs = InvalidTransactionId;
-		LWLockRelease(CommitTsControlLock);
+		LWLockRelease(CommitTsLock);
+		LWLockRelease(lock);
 
 		TruncateCommitTs(ReadNewTransactionId());
 
+		/* the index would be stale once we're enabled again */
+		if (unlink(COMMITTS_INDEX_FILE) < 0 && errno != ENOENT)
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not remove file \"%s\": %m",
+							COMMITTS_INDEX_FILE)));
+
 		return;
 	}
 
@@ -580,6 +906,7 @@ StartupCommitTs(void)
 	 */
 	if (ShmemVariableCache->oldestCommitTs == InvalidTransactionId)
 		ShmemVariableCache->oldestCommitTs = ReadNewTransactionId();
+	LWLockRelease(CommitTsLock);
 
 	/* Finally, create the current segment file, if necessary */
 	if (!SimpleLruDoesPhysicalPageExist(ctl, pageno))
@@ -591,7 +918,7 @@ StartupCommitTs(void)
 		Assert(!CommitTsCtl->shared->page_dirty[slotno]);
 	}
 
-	LWLockRelease(CommitTsControlLock);
+	LWLockRelease(lock);
 }
 
 /*
@@ -612,6 +939,195 @@ CheckPointCommitTs(void)
 {
 	/* Flush dirty CommitTs pages to disk */
 	SimpleLruFlush(CommitTsCtl, true);
+
+	if (commit_ts_enabled)
+		CheckPointCommitTsIndex();
+}
+
+/*
+ * Save the index entries of the segments that can be consulted.
+ *
+ * Commits are prevented from being split across the checkpoint's redo
+ * pointer by delayChkpt, so everything committed before it is in the file;
+ * the rest is added back when replaying the commit records.
+ */
+static void
+CheckPointCommitTsIndex(void)
+{
+	CommitTsIndexFileHeader hdr;
+	CommitTsIndexEntry *entries;
+	TransactionId oldest;
+	TransactionId newest;
+	int			lastentry;
+	int			nfirst;
+	int			fd;
+
+	newest = ReadNewTransactionId();
+
+	LWLockAcquire(CommitTsLock, LW_SHARED);
+	oldest = ShmemVariableCache->oldestCommitTs;
+	if (!TransactionIdIsValid(oldest))
+		oldest = newest;
+
+	/* transactions older than oldestCommitTs aren't of interest anymore */
+	hdr.indexStartXid = commitTsShared->indexStartXid;
+	if (!TransactionIdIsValid(hdr.indexStartXid) ||
+		TransactionIdPrecedes(hdr.indexStartXid, oldest))
+		hdr.indexStartXid = oldest;
+
+	hdr.firstEntry = TransactionIdToCTsIndexEntry(oldest);
+	lastentry = TransactionIdToCTsIndexEntry(newest);
+	hdr.nentries = (lastentry - hdr.firstEntry + COMMITTS_INDEX_ENTRIES) %
+		COMMITTS_INDEX_ENTRIES + 1;
+
+	entries = palloc(sizeof(CommitTsIndexEntry) * hdr.nentries);
+	nfirst = Min(hdr.nentries, COMMITTS_INDEX_ENTRIES - hdr.firstEntry);
+	memcpy(entries, &commitTsIndex[hdr.firstEntry],
+		   sizeof(CommitTsIndexEntry) * nfirst);
+	memcpy(entries + nfirst, commitTsIndex,
+		   sizeof(CommitTsIndexEntry) * (hdr.nentries - nfirst));
+	LWLockRelease(CommitTsLock);
+
+	hdr.magic = COMMITTS_INDEX_MAGIC;
+	INIT_CRC32(hdr.checksum);
+	COMP_CRC32(hdr.checksum,
+			   (char *) &hdr + offsetof(CommitTsIndexFileHeader, indexStartXid),
+			   sizeof(CommitTsIndexFileHeader) -
+			   offsetof(CommitTsIndexFileHeader, indexStartXid));
+	COMP_CRC32(hdr.checksum, entries,
+			   sizeof(CommitTsIndexEntry) * hdr.nentries);
+	FIN_CRC32(hdr.checksum);
+
+	/* write to a temporary file, and rename it into place atomically */
+	fd = OpenTransientFile(COMMITTS_INDEX_TMPFILE,
+						   O_CREAT | O_TRUNC | O_WRONLY | PG_BINARY,
+						   S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m",
+						COMMITTS_INDEX_TMPFILE)));
+
+	errno = 0;
+	if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+		write(fd, entries, sizeof(CommitTsIndexEntry) * hdr.nentries) !=
+		sizeof(CommitTsIndexEntry) * hdr.nentries)
+	{
+		int			save_errno = errno;
+
+		CloseTransientFile(fd);
+		/* if write didn't set errno, assume problem is no disk space */
+		errno = save_errno ? save_errno : ENOSPC;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s\": %m",
+						COMMITTS_INDEX_TMPFILE)));
+	}
+
+	if (pg_fsync(fd) != 0)
+	{
+		CloseTransientFile(fd);
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not fsync file \"%s\": %m",
+						COMMITTS_INDEX_TMPFILE)));
+	}
+
+	CloseTransientFile(fd);
+	pfree(entries);
+
+	if (rename(COMMITTS_INDEX_TMPFILE, COMMITTS_INDEX_FILE) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not rename file \"%s\" to \"%s\": %m",
+						COMMITTS_INDEX_TMPFILE, COMMITTS_INDEX_FILE)));
+
+	fsync_fname(COMMITTS_INDEX_FILE, false);
+	fsync_fname("pg_committs", true);
+}
+
+/*
+ * Load the index saved by the last checkpoint.
+ *
+ * This must be called ONCE during startup, before WAL replay, after
+ * ShmemVariableCache->nextXid has been set from the checkpoint.  If there is
+ * no usable index, only the transactions from then on are indexed.
+ */
+void
+StartupCommitTsIndex(void)
+{
+	CommitTsIndexFileHeader hdr;
+	CommitTsIndexEntry *entries;
+	pg_crc32	checksum;
+	int			fd;
+	int			nfirst;
+
+	if (!commit_ts_enabled)
+		return;
+
+	commitTsShared->indexStartXid = ShmemVariableCache->nextXid;
+
+	fd = OpenTransientFile(COMMITTS_INDEX_FILE, O_RDONLY | PG_BINARY, 0);
+	if (fd < 0)
+	{
+		if (errno != ENOENT)
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m",
+							COMMITTS_INDEX_FILE)));
+		return;
+	}
+
+	if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+		hdr.magic != COMMITTS_INDEX_MAGIC ||
+		hdr.firstEntry < 0 || hdr.firstEntry >= COMMITTS_INDEX_ENTRIES ||
+		hdr.nentries <= 0 || hdr.nentries > COMMITTS_INDEX_ENTRIES)
+	{
+		CloseTransientFile(fd);
+		ereport(LOG,
+				(errmsg("ignoring invalid commit timestamp index file \"%s\"",
+						COMMITTS_INDEX_FILE)));
+		return;
+	}
+
+	entries = palloc(sizeof(CommitTsIndexEntry) * hdr.nentries);
+	if (read(fd, entries, sizeof(CommitTsIndexEntry) * hdr.nentries) !=
+		sizeof(CommitTsIndexEntry) * hdr.nentries)
+	{
+		CloseTransientFile(fd);
+		pfree(entries);
+		ereport(LOG,
+				(errmsg("ignoring invalid commit timestamp index file \"%s\"",
+						COMMITTS_INDEX_FILE)));
+		return;
+	}
+	CloseTransientFile(fd);
+
+	INIT_CRC32(checksum);
+	COMP_CRC32(checksum,
+			   (char *) &hdr + offsetof(CommitTsIndexFileHeader, indexStartXid),
+			   sizeof(CommitTsIndexFileHeader) -
+			   offsetof(CommitTsIndexFileHeader, indexStartXid));
+	COMP_CRC32(checksum, entries, sizeof(CommitTsIndexEntry) * hdr.nentries);
+	FIN_CRC32(checksum);
+
+	if (!EQ_CRC32(checksum, hdr.checksum))
+	{
+		pfree(entries);
+		ereport(LOG,
+				(errmsg("ignoring commit timestamp index file \"%s\" with invalid checksum",
+						COMMITTS_INDEX_FILE)));
+		return;
+	}
+
+	nfirst = Min(hdr.nentries, COMMITTS_INDEX_ENTRIES - hdr.firstEntry);
+	memcpy(&commitTsIndex[hdr.firstEntry], entries,
+		   sizeof(CommitTsIndexEntry) * nfirst);
+	memcpy(commitTsIndex, entries + nfirst,
+		   sizeof(CommitTsIndexEntry) * (hdr.nentries - nfirst));
+	commitTsShared->indexStartXid = hdr.indexStartXid;
+
+	pfree(entries);
 }
 
 /*
@@ -641,12 +1157,12 @@ ExtendCommitTs(TransactionId newestXact)
 
 	pageno = TransactionIdToCTsPage(newestXact);
 
-	LWLockAcquire(CommitTsControlLock, LW_EXCLUSIVE);
+	LWLockAcquire(SimpleLruGetBankLock(CommitTsCtl, pageno), LW_EXCLUSIVE);
 
 	/* Zero the page and make an XLOG entry about it */
 	ZeroCommitTsPage(pageno, !InRecovery);
 
-	LWLockRelease(CommitTsControlLock);
+	LWLockRelease(SimpleLruGetBankLock(CommitTsCtl, pageno));
 }
 
 /*
@@ -687,7 +1203,7 @@ SetCommitTsLimit(TransactionId oldestXact)
 	 * Be careful not to overwrite values that are either further into the
 	 * "future" or signal a disabled committs.
 	 */
-	LWLockAcquire(CommitTsControlLock, LW_EXCLUSIVE);
+	LWLockAcquire(CommitTsLock, LW_EXCLUSIVE);
 	if (ShmemVariableCache->oldestCommitTs != InvalidTransactionId)
 	{
 		if (TransactionIdPrecedes(ShmemVariableCache->oldestCommitTs, oldestXact))
@@ -695,7 +1211,7 @@ SetCommitTsLimit(TransactionId oldestXact)
 	}
 	else
 		ShmemVariableCache->oldestCommitTs = oldestXact;
-	LWLockRelease(CommitTsControlLock);
+	LWLockRelease(CommitTsLock);
 }
 
 /*
@@ -796,13 +1312,13 @@ committs_redo(XLogRecPtr lsn, XLogRecord *record)
 
 		memcpy(&pageno, XLogRecGetData(record), sizeof(int));
 
-		LWLockAcquire(CommitTsControlLock, LW_EXCLUSIVE);
+		LWLockAcquire(SimpleLruGetBankLock(CommitTsCtl, pageno), LW_EXCLUSIVE);
 
 		slotno = ZeroCommitTsPage(pageno, false);
 		SimpleLruWritePage(CommitTsCtl, slotno);
 		Assert(!CommitTsCtl->shared->page_dirty[slotno]);
 
-		LWLockRelease(CommitTsControlLock);
+		LWLockRelease(SimpleLruGetBankLock(CommitTsCtl, pageno));
 	}
 	else if (info == COMMITTS_TRUNCATE)
 	{
@@ -23,6 +23,13 @@
  * SimpleLruReadPage_ReadOnly(); see comments for SlruRecentlyUsed() for
  * the implications of that.
  *
+ * An SLRU set up with SimpleLruInitBanked() divides its buffers into banks,
+ * each with its own control lock; a page can only be stored in the bank
+ * selected by its page number.  For those, "the control lock" refers to the
+ * lock of the bank of the page (or slot) in question, which callers obtain
+ * with SimpleLruGetBankLock().  Using a single lock for a larger number of
+ * buffers would make the linear searches, and the lock itself, bottlenecks.
+ *
  * When initiating I/O on a buffer, we acquire the per-buffer lock exclusively
  * before releasing the control lock.  The per-buffer lock is released after
  * completing the I/O, re-acquiring the control lock, and updating the shared
@@ -62,6 +69,19 @@
 #define SlruFileName(ctl, path, seg) \
 	snprintf(path, MAXPGPATH, "%s/%04X", (ctl)->Dir, seg)
 
+/* bank a buffer slot belongs to, and the lock protecting it */
+#define SlruBankOfSlot(shared, slotno) ((slotno) / (shared)->bank_size)
+#define SlruBankLockOfSlot(shared, slotno) \
+	((shared)->bank_locks[SlruBankOfSlot(shared, slotno)])
+
+/*
+ * SLRUs set up in this process, so pg_stat_slru can find them.
+ */
+#define MAX_REGISTERED_SLRUS	16
+
+static SlruShared RegisteredSlrus[MAX_REGISTERED_SLRUS];
+static int	NumRegisteredSlrus = 0;
+
 /*
  * During SimpleLruFlush(), we will usually not need to write/fsync more
  * than one or two physical files, but we may need to write several pages
@@ -101,9 +121,10 @@ typedef struct SlruFlushData *SlruFlush;
  */
 #define SlruRecentlyUsed(shared, slotno)	\
 	do { \
-		int		new_lru_count = (shared)->cur_lru_count; \
+		int		bankno = SlruBankOfSlot(shared, slotno); \
+		int		new_lru_count = (shared)->cur_lru_count[bankno]; \
 		if (new_lru_count != (shared)->page_lru_count[slotno]) { \
-			(shared)->cur_lru_count = ++new_lru_count; \
+			(shared)->cur_lru_count[bankno] = ++new_lru_count; \
 			(shared)->page_lru_count[slotno] = new_lru_count; \
 		} \
 	} while (0)
@@ -134,6 +155,10 @@ static int	SlruSelectLRUPage(SlruCtl ctl, int pageno);
 
 static bool SlruScanDirCbDeleteCutoff(SlruCtl ctl, char *filename,
 						  int segpage, void *data);
+static void SlruRegister(SlruShared shared);
+static bool SlruTruncateBank(SlruCtl ctl, int bankno, int cutoffPage);
+static void SlruInitInternal(SlruCtl ctl, const char *name, int nslots,
+				 int nbanks, int nlsns, LWLock *ctllock, const char *subdir);
 
 /*
  * Initialization of shared memory
@@ -143,6 +168,7 @@ Size
 SimpleLruShmemSize(int nslots, int nlsns)
 {
 	Size		sz;
+	int			nbanks = SimpleLruNumBanks(nslots);
 
 	/* we assume nslots isn't so large as to risk overflow */
 	sz = MAXALIGN(sizeof(SlruSharedData));
@@ -152,6 +178,9 @@ SimpleLruShmemSize(int nslots, int nlsns)
 	sz += MAXALIGN(nslots * sizeof(int));		/* page_number[] */
 	sz += MAXALIGN(nslots * sizeof(int));		/* page_lru_count[] */
 	sz += MAXALIGN(nslots * sizeof(LWLock *));	/* buffer_locks[] */
+	sz += MAXALIGN(nbanks * sizeof(LWLock *));	/* bank_locks[] */
+	sz += MAXALIGN(nbanks * sizeof(SlruBankStats));	/* bank_stats[] */
+	sz += MAXALIGN(nbanks * sizeof(int));		/* cur_lru_count[] */
 
 	if (nlsns > 0)
 		sz += MAXALIGN(nslots * nlsns * sizeof(XLogRecPtr));	/* group_lsn[] */
@@ -159,9 +188,45 @@ SimpleLruShmemSize(int nslots, int nlsns)
 	return BUFFERALIGN(sz) + BLCKSZ * nslots;
 }
 
+/*
+ * Number of banks SimpleLruInitBanked() divides nslots buffers into.
+ */
+int
+SimpleLruNumBanks(int nslots)
+{
+	return Max(1, nslots / SLRU_BANK_SIZE);
+}
+
+/*
+ * Set up an SLRU whose nslots buffers all are protected by ctllock.
+ */
 void
 SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
 			  LWLock *ctllock, const char *subdir)
+{
+	SlruInitInternal(ctl, name, nslots, 1, nlsns, ctllock, subdir);
+}
+
+/*
+ * Set up an SLRU whose buffers are divided into SimpleLruNumBanks(nslots)
+ * banks.  ctllock protects the first bank, the locks of the others are
+ * assigned here; NumLWLocks() has to account for them.  nslots has to be a
+ * multiple of SLRU_BANK_SIZE if there's more than one bank.
+ */
+void
+SimpleLruInitBanked(SlruCtl ctl, const char *name, int nslots, int nlsns,
+					LWLock *ctllock, const char *subdir)
+{
+	int			nbanks = SimpleLruNumBanks(nslots);
+
+	Assert(nbanks == 1 || nslots % SLRU_BANK_SIZE == 0);
+
+	SlruInitInternal(ctl, name, nslots, nbanks, nlsns, ctllock, subdir);
+}
+
+static void
+SlruInitInternal(SlruCtl ctl, const char *name, int nslots, int nbanks,
+				 int nlsns, LWLock *ctllock, const char *subdir)
 {
 	SlruShared	shared;
 	bool		found;
@@ -176,6 +241,7 @@ SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
 		char	   *ptr;
 		Size		offset;
 		int			slotno;
+		int			bankno;
 
 		Assert(!found);
 
@@ -184,9 +250,11 @@ SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
 		shared->ControlLock = ctllock;
 
 		shared->num_slots = nslots;
+		shared->num_banks = nbanks;
+		shared->bank_size = nslots / nbanks;
 		shared->lsn_groups_per_page = nlsns;
 
-		shared->cur_lru_count = 0;
+		StrNCpy(shared->name, subdir, sizeof(shared->name));
 
 		/* shared->latest_page_number will be set later */
 
@@ -204,6 +272,12 @@ SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
 		offset += MAXALIGN(nslots * sizeof(int));
 		shared->buffer_locks = (LWLock **) (ptr + offset);
 		offset += MAXALIGN(nslots * sizeof(LWLock *));
+		shared->bank_locks = (LWLock **) (ptr + offset);
+		offset += MAXALIGN(nbanks * sizeof(LWLock *));
+		shared->bank_stats = (SlruBankStats *) (ptr + offset);
+		offset += MAXALIGN(nbanks * sizeof(SlruBankStats));
+		shared->cur_lru_count = (int *) (ptr + offset);
+		offset += MAXALIGN(nbanks * sizeof(int));
 
 		if (nlsns > 0)
 		{
@@ -221,10 +295,20 @@ SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
 			shared->buffer_locks[slotno] = LWLockAssign();
 			ptr += BLCKSZ;
 		}
+
+		for (bankno = 0; bankno < nbanks; bankno++)
+		{
+			shared->bank_locks[bankno] =
+				bankno == 0 ? ctllock : LWLockAssign();
+			memset(&shared->bank_stats[bankno], 0, sizeof(SlruBankStats));
+			shared->cur_lru_count[bankno] = 0;
+		}
 	}
 	else
 		Assert(found);
 
+	SlruRegister(shared);
+
 	/*
 	 * Initialize the unshared control struct, including directory path. We
 	 * assume caller set PagePrecedes.
@@ -263,6 +347,7 @@ SimpleLruZeroPage(SlruCtl ctl, int pageno)
 
 	/* Set the buffer to zeroes */
 	MemSet(shared->page_buffer[slotno], 0, BLCKSZ);
+	shared->bank_stats[SlruBankOfSlot(shared, slotno)].blks_zeroed++;
 
 	/* Set the LSNs for this new page to zero */
 	SimpleLruZeroLSNs(ctl, slotno);
@@ -304,12 +389,13 @@ static void
 SimpleLruWaitIO(SlruCtl ctl, int slotno)
 {
 	SlruShared	shared = ctl->shared;
+	LWLock	   *banklock = SlruBankLockOfSlot(shared, slotno);
 
 	/* See notes at top of file */
-	LWLockRelease(shared->ControlLock);
+	LWLockRelease(banklock);
 	LWLockAcquire(shared->buffer_locks[slotno], LW_SHARED);
 	LWLockRelease(shared->buffer_locks[slotno]);
-	LWLockAcquire(shared->ControlLock, LW_EXCLUSIVE);
+	LWLockAcquire(banklock, LW_EXCLUSIVE);
 
 	/*
 	 * If the slot is still in an io-in-progress state, then either someone
@@ -359,6 +445,7 @@ SimpleLruReadPage(SlruCtl ctl, int pageno, bool write_ok,
 				  TransactionId xid)
 {
 	SlruShared	shared = ctl->shared;
+	LWLock	   *banklock = SimpleLruGetBankLock(ctl, pageno);
 
 	/* Outer loop handles restart if we must wait for someone else's I/O */
 	for (;;)
@@ -387,6 +474,7 @@ SimpleLruReadPage(SlruCtl ctl, int pageno, bool write_ok,
 			}
 			/* Otherwise, it's ready to use */
 			SlruRecentlyUsed(shared, slotno);
+			shared->bank_stats[SlruBankOfSlot(shared, slotno)].blks_hit++;
 			return slotno;
 		}
 
@@ -403,8 +491,10 @@ SimpleLruReadPage(SlruCtl ctl, int pageno, bool write_ok,
 		/* Acquire per-buffer lock (cannot deadlock, see notes at top) */
 		LWLockAcquire(shared->buffer_locks[slotno], LW_EXCLUSIVE);
 
+		shared->bank_stats[SlruBankOfSlot(shared, slotno)].blks_read++;
+
 		/* Release control lock while doing I/O */
-		LWLockRelease(shared->ControlLock);
+		LWLockRelease(banklock);
 
 		/* Do the read */
 		ok = SlruPhysicalReadPage(ctl, pageno, slotno);
@@ -413,7 +503,7 @@ SimpleLruReadPage(SlruCtl ctl, int pageno, bool write_ok,
 		SimpleLruZeroLSNs(ctl, slotno);
 
 		/* Re-acquire control lock and update page state */
-		LWLockAcquire(shared->ControlLock, LW_EXCLUSIVE);
+		LWLockAcquire(banklock, LW_EXCLUSIVE);
 
 		Assert(shared->page_number[slotno] == pageno &&
 			   shared->page_status[slotno] == SLRU_PAGE_READ_IN_PROGRESS &&
@@ -444,19 +534,24 @@ SimpleLruReadPage(SlruCtl ctl, int pageno, bool write_ok,
  * The buffer's LRU access info is updated.
  *
  * Control lock must NOT be held at entry, but will be held at exit.
- * It is unspecified whether the lock will be shared or exclusive.
+ * It is unspecified whether the lock will be shared or exclusive.  For banked
+ * SLRUs, that's the lock of the page's bank.
  */
 int
 SimpleLruReadPage_ReadOnly(SlruCtl ctl, int pageno, TransactionId xid)
 {
 	SlruShared	shared = ctl->shared;
+	int			bankno = SlruBankOfPage(shared, pageno);
+	LWLock	   *banklock = shared->bank_locks[bankno];
+	int			bankstart = bankno * shared->bank_size;
+	int			bankend = bankstart + shared->bank_size;
 	int			slotno;
 
 	/* Try to find the page while holding only shared lock */
-	LWLockAcquire(shared->ControlLock, LW_SHARED);
+	LWLockAcquire(banklock, LW_SHARED);
 
 	/* See if page is already in a buffer */
-	for (slotno = 0; slotno < shared->num_slots; slotno++)
+	for (slotno = bankstart; slotno < bankend; slotno++)
 	{
 		if (shared->page_number[slotno] == pageno &&
 			shared->page_status[slotno] != SLRU_PAGE_EMPTY &&
@@ -464,13 +559,14 @@ SimpleLruReadPage_ReadOnly(SlruCtl ctl, int pageno, TransactionId xid)
 		{
 			/* See comments for SlruRecentlyUsed macro */
 			SlruRecentlyUsed(shared, slotno);
+			shared->bank_stats[bankno].blks_hit++;
 			return slotno;
 		}
 	}
 
 	/* No luck, so switch to normal exclusive lock and do regular read */
-	LWLockRelease(shared->ControlLock);
-	LWLockAcquire(shared->ControlLock, LW_EXCLUSIVE);
+	LWLockRelease(banklock);
+	LWLockAcquire(banklock, LW_EXCLUSIVE);
 
 	return SimpleLruReadPage(ctl, pageno, true, xid);
 }
@@ -490,6 +586,7 @@ static void
 SlruInternalWritePage(SlruCtl ctl, int slotno, SlruFlush fdata)
 {
 	SlruShared	shared = ctl->shared;
+	LWLock	   *banklock = SlruBankLockOfSlot(shared, slotno);
 	int			pageno = shared->page_number[slotno];
 	bool		ok;
 
@@ -519,8 +616,10 @@ SlruInternalWritePage(SlruCtl ctl, int slotno, SlruFlush fdata)
 	/* Acquire per-buffer lock (cannot deadlock, see notes at top) */
 	LWLockAcquire(shared->buffer_locks[slotno], LW_EXCLUSIVE);
 
+	shared->bank_stats[SlruBankOfSlot(shared, slotno)].blks_written++;
+
 	/* Release control lock while doing I/O */
-	LWLockRelease(shared->ControlLock);
+	LWLockRelease(banklock);
 
 	/* Do the write */
 	ok = SlruPhysicalWritePage(ctl, pageno, slotno, fdata);
@@ -535,7 +634,7 @@ SlruInternalWritePage(SlruCtl ctl, int slotno, SlruFlush fdata)
 	}
 
 	/* Re-acquire control lock and update page state */
-	LWLockAcquire(shared->ControlLock, LW_EXCLUSIVE);
+	LWLockAcquire(banklock, LW_EXCLUSIVE);
 
 	Assert(shared->page_number[slotno] == pageno &&
 		   shared->page_status[slotno] == SLRU_PAGE_WRITE_IN_PROGRESS);
@@ -941,6 +1040,9 @@ static int
 SlruSelectLRUPage(SlruCtl ctl, int pageno)
 {
 	SlruShared	shared = ctl->shared;
+	int			bankno = SlruBankOfPage(shared, pageno);
+	int			bankstart = bankno * shared->bank_size;
+	int			bankend = bankstart + shared->bank_size;
 
 	/* Outer loop handles restart after I/O */
 	for (;;)
@@ -955,7 +1057,7 @@ SlruSelectLRUPage(SlruCtl ctl, int pageno)
 		int			best_invalid_page_number = 0;		/* keep compiler quiet */
 
 		/* See if page already has a buffer assigned */
-		for (slotno = 0; slotno < shared->num_slots; slotno++)
+		for (slotno = bankstart; slotno < bankend; slotno++)
 		{
 			if (shared->page_number[slotno] == pageno &&
 				shared->page_status[slotno] != SLRU_PAGE_EMPTY)
@@ -963,8 +1065,8 @@ SlruSelectLRUPage(SlruCtl ctl, int pageno)
 		}
 
 		/*
-		 * If we find any EMPTY slot, just select that one. Else choose a
-		 * victim page to replace.  We normally take the least recently used
+		 * If we find any EMPTY slot in the page's bank, just select that one.
+		 * Else choose a victim page of the bank to replace.  We normally take the least recently used
 		 * valid page, but we will never take the slot containing
 		 * latest_page_number, even if it appears least recently used.  We
 		 * will select a slot that is already I/O busy only if there is no
@@ -989,8 +1091,8 @@ SlruSelectLRUPage(SlruCtl ctl, int pageno)
 		 * That gets us back on the path to having good data when there are
 		 * multiple pages with the same lru_count.
 		 */
-		cur_count = (shared->cur_lru_count)++;
-		for (slotno = 0; slotno < shared->num_slots; slotno++)
+		cur_count = (shared->cur_lru_count[bankno])++;
+		for (slotno = bankstart; slotno < bankend; slotno++)
 		{
 			int			this_delta;
 			int			this_page_number;
@@ -1085,14 +1187,15 @@ SimpleLruFlush(SlruCtl ctl, bool checkpoint)
 	bool		ok;
 
 	/*
-	 * Find and write dirty pages
+	 * Find and write dirty pages, one bank at a time
 	 */
 	fdata.num_files = 0;
 
-	LWLockAcquire(shared->ControlLock, LW_EXCLUSIVE);
-
 	for (slotno = 0; slotno < shared->num_slots; slotno++)
 	{
+		if (slotno % shared->bank_size == 0)
+			LWLockAcquire(SlruBankLockOfSlot(shared, slotno), LW_EXCLUSIVE);
+
 		SlruInternalWritePage(ctl, slotno, &fdata);
 
 		/*
@@ -1104,9 +1207,10 @@ SimpleLruFlush(SlruCtl ctl, bool checkpoint)
 			   shared->page_status[slotno] == SLRU_PAGE_EMPTY ||
 			   (shared->page_status[slotno] == SLRU_PAGE_VALID &&
 				!shared->page_dirty[slotno]));
-	}
 
-	LWLockRelease(shared->ControlLock);
+		if ((slotno + 1) % shared->bank_size == 0)
+			LWLockRelease(SlruBankLockOfSlot(shared, slotno));
+	}
 
 	/*
 	 * Now fsync and close any files that were open
@@ -1141,7 +1245,7 @@ void
 SimpleLruTruncate(SlruCtl ctl, int cutoffPage)
 {
 	SlruShared	shared = ctl->shared;
-	int			slotno;
+	int			bankno;
 
 	/*
 	 * The cutoff point is the start of the segment containing cutoffPage.
@@ -1152,9 +1256,33 @@ SimpleLruTruncate(SlruCtl ctl, int cutoffPage)
 	 * Scan shared memory and remove any pages preceding the cutoff page, to
 	 * ensure we won't rewrite them later.  (Since this is normally called in
 	 * or just after a checkpoint, any dirty pages should have been flushed
-	 * already ... we're just being extra careful here.)
+	 * already ... we're just being extra careful here.)  That's done one bank
+	 * at a time.
 	 */
-	LWLockAcquire(shared->ControlLock, LW_EXCLUSIVE);
+	for (bankno = 0; bankno < shared->num_banks; bankno++)
+	{
+		if (!SlruTruncateBank(ctl, bankno, cutoffPage))
+			return;
+	}
+
+	/* Now we can remove the old segment(s) */
+	(void) SlruScanDirectory(ctl, SlruScanDirCbDeleteCutoff, &cutoffPage);
+}
+
+/*
+ * Remove the pages of one bank preceding cutoffPage from shared memory, see
+ * SimpleLruTruncate().  Returns false if truncation has to be skipped.
+ */
+static bool
+SlruTruncateBank(SlruCtl ctl, int bankno, int cutoffPage)
+{
+	SlruShared	shared = ctl->shared;
+	LWLock	   *banklock = shared->bank_locks[bankno];
+	int			bankstart = bankno * shared->bank_size;
+	int			bankend = bankstart + shared->bank_size;
+	int			slotno;
+
+	LWLockAcquire(banklock, LW_EXCLUSIVE);
 
 restart:;
 
@@ -1166,14 +1294,14 @@ restart:;
 	 */
 	if (ctl->PagePrecedes(shared->latest_page_number, cutoffPage))
 	{
-		LWLockRelease(shared->ControlLock);
+		LWLockRelease(banklock);
 		ereport(LOG,
 		  (errmsg("could not truncate directory \"%s\": apparent wraparound",
 				  ctl->Dir)));
-		return;
+		return false;
 	}
 
-	for (slotno = 0; slotno < shared->num_slots; slotno++)
+	for (slotno = bankstart; slotno < bankend; slotno++)
 	{
 		if (shared->page_status[slotno] == SLRU_PAGE_EMPTY)
 			continue;
@@ -1204,10 +1332,9 @@ restart:;
 		goto restart;
 	}
 
-	LWLockRelease(shared->ControlLock);
+	LWLockRelease(banklock);
 
-	/* Now we can remove the old segment(s) */
-	(void) SlruScanDirectory(ctl, SlruScanDirCbDeleteCutoff, &cutoffPage);
+	return true;
 }
 
 void
@@ -1314,3 +1441,38 @@ SlruScanDirectory(SlruCtl ctl, SlruScanCallback callback, void *data)
 
 	return retval;
 }
+
+/*
+ * Remember an SLRU set up in this process, for pg_stat_slru.
+ */
+static void
+SlruRegister(SlruShared shared)
+{
+	int			i;
+
+	/* after a crash restart, the postmaster sets up the SLRUs again */
+	for (i = 0; i < NumRegisteredSlrus; i++)
+	{
+		if (strcmp(RegisteredSlrus[i]->name, shared->name) == 0)
+		{
+			RegisteredSlrus[i] = shared;
+			return;
+		}
+	}
+
+	if (NumRegisteredSlrus >= MAX_REGISTERED_SLRUS)
+		elog(ERROR, "too many SLRUs registered");
+
+	RegisteredSlrus[NumRegisteredSlrus++] = shared;
+}
+
+/*
+ * Return the i-th SLRU set up in this process, or NULL if there are fewer.
+ */
+SlruShared
+SimpleLruGetRegistered(int i)
+{
+	if (i < 0 || i >= NumRegisteredSlrus)
+		return NULL;
+	return RegisteredSlrus[i];
+}
@@ -453,7 +453,7 @@ AssignTransactionId(TransactionState s)
 {
 	bool		isSubXact = (s->parent != NULL);
 	ResourceOwner currentOwner;
-	bool		log_unknown_top = false;
+	bool		log_assignment = false;
 
 	/* Assert that caller didn't screw up */
 	Assert(!TransactionIdIsValid(s->transactionId));
@@ -490,17 +490,15 @@ AssignTransactionId(TransactionState s)
 
 	/*
 	 * When wal_level=logical, guarantee that a subtransaction's xid can only
-	 * be seen in the WAL stream if its toplevel xid has been logged before.
-	 * If necessary we log a xact_assignment record with fewer than
-	 * PGPROC_MAX_CACHED_SUBXIDS. Note that it is fine if didLogXid isn't set
-	 * for a transaction even though it appears in a WAL record, we just might
-	 * superfluously log something. That can happen when an xid is included
-	 * somewhere inside a wal record, but not in XLogRecord->xl_xid, like in
-	 * xl_standby_locks.
+	 * be seen in the WAL stream after its assignment to the toplevel xid has
+	 * been logged, so we log a xact_assignment record with fewer than
+	 * PGPROC_MAX_CACHED_SUBXIDS entries for every subtransaction.  Logical
+	 * decoding needs to know which toplevel transaction a change belongs to
+	 * before the commit record is seen, to be able to stream large
+	 * in-progress transactions to output plugins.
 	 */
-	if (isSubXact && XLogLogicalInfoActive() &&
-		!TopTransactionStateData.didLogXid)
-		log_unknown_top = true;
+	if (isSubXact && XLogLogicalInfoActive())
+		log_assignment = true;
 
 	/*
 	 * Generate a new Xid and record it in PG_PROC and pg_subtrans.
@@ -570,7 +568,7 @@ AssignTransactionId(TransactionState s)
 		 * RecoverPreparedTransactions()
 		 */
 		if (nUnreportedXids >= PGPROC_MAX_CACHED_SUBXIDS ||
-			log_unknown_top)
+			log_assignment)
 		{
 			XLogRecData rdata[2];
 			xl_xact_assignment xlrec;
@@ -1138,11 +1136,13 @@ RecordTransactionCommit(void)
 				rdata[3].buffer = InvalidBuffer;
 				lastrdata = 3;
 			}
-			/* dump transaction origin information */
+			/*
+			 * dump transaction origin information; the origin's node id is
+			 * in the record header already
+			 */
 			if (replication_origin_id != InvalidRepNodeId)
 			{
 				xlrec.xinfo |= XACT_CONTAINS_ORIGIN;
-				origin.origin_node_id = replication_origin_id;
 				origin.origin_lsn = replication_origin_lsn;
 				origin.origin_timestamp = replication_origin_timestamp;
 
@@ -4754,6 +4754,7 @@ xact_redo_commit_internal(TransactionId xid, XLogRecPtr lsn,
 						  RelFileNode *xnodes, int nrels,
 						  Oid dbId, Oid tsId,
 						  uint32 xinfo,
+						  RepNodeId origin_id,
 						  xl_xact_origin *origin)
 {
 	TransactionId max_xid;
@@ -4782,7 +4783,7 @@ xact_redo_commit_internal(TransactionId xid, XLogRecPtr lsn,
 
 	if (xinfo & XACT_CONTAINS_ORIGIN)
 	{
-		origin_node_id = origin->origin_node_id;
+		origin_node_id = origin_id;
 		commit_time = origin->origin_timestamp;
 	}
 
@@ -4794,7 +4795,7 @@ xact_redo_commit_internal(TransactionId xid, XLogRecPtr lsn,
 	if (xinfo & XACT_CONTAINS_ORIGIN)
 	{
 		/* recover apply progress */
-		AdvanceReplicationIdentifier(origin->origin_node_id,
+		AdvanceReplicationIdentifier(origin_id,
 									 origin->origin_lsn,
 									 lsn);
 	}
@@ -4900,18 +4901,23 @@ xact_redo_commit_internal(TransactionId xid, XLogRecPtr lsn,
  */
 static void
 xact_redo_commit(xl_xact_commit *xlrec,
-				 TransactionId xid, XLogRecPtr lsn)
+				 TransactionId xid, XLogRecPtr lsn, RepNodeId origin_id)
 {
 	TransactionId *subxacts;
 	SharedInvalidationMessage *inval_msgs;
+	xl_xact_origin origin_data;
 	xl_xact_origin *origin = NULL;
 	/* subxid array follows relfilenodes */
 	subxacts = (TransactionId *) &(xlrec->xnodes[xlrec->nrels]);
 	/* invalidation messages array follows subxids */
 	inval_msgs = (SharedInvalidationMessage *) &(subxacts[xlrec->nsubxacts]);
-
+	/* origin follows invalidation messages, possibly unaligned */
 	if (xlrec->xinfo & XACT_CONTAINS_ORIGIN)
-		origin = (xl_xact_origin *) &(inval_msgs[xlrec->nmsgs]);
+	{
+		memcpy(&origin_data, &(inval_msgs[xlrec->nmsgs]),
+			   sizeof(xl_xact_origin));
+		origin = &origin_data;
+	}
 
 	xact_redo_commit_internal(xid, lsn, xlrec->xact_time,
 							  subxacts, xlrec->nsubxacts,
@@ -4920,6 +4926,7 @@ xact_redo_commit(xl_xact_commit *xlrec,
 							  xlrec->dbId,
 							  xlrec->tsId,
 							  xlrec->xinfo,
+							  origin_id,
 							  origin);
 }
 
@@ -4937,6 +4944,7 @@ xact_redo_commit_compact(xl_xact_commit_compact *xlrec,
 							  InvalidOid,		/* dbId */
 							  InvalidOid,		/* tsId */
 							  0,		/* xinfo */
+							  InvalidRepNodeId,	/* origin_id */
 							  NULL		/* origin */);
 }
 
@@ -5032,7 +5040,7 @@ xact_redo(XLogRecPtr lsn, XLogRecord *record)
 	{
 		xl_xact_commit *xlrec = (xl_xact_commit *) XLogRecGetData(record);
 
-		xact_redo_commit(xlrec, record->xl_xid, lsn);
+		xact_redo_commit(xlrec, record->xl_xid, lsn, record->xl_origin_id);
 	}
 	else if (info == XLOG_XACT_ABORT)
 	{
@@ -5050,7 +5058,8 @@ xact_redo(XLogRecPtr lsn, XLogRecord *record)
 	{
 		xl_xact_commit_prepared *xlrec = (xl_xact_commit_prepared *) XLogRecGetData(record);
 
-		xact_redo_commit(&xlrec->crec, xlrec->xid, lsn);
+		xact_redo_commit(&xlrec->crec, xlrec->xid, lsn,
+						 record->xl_origin_id);
 		RemoveTwoPhaseFile(xlrec->xid, false);
 	}
 	else if (info == XLOG_XACT_ABORT_PREPARED)
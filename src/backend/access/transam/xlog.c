@@ -1318,17 +1318,23 @@ begin:;
 			/*
 			 * We have to piece together the WAL record data from the
 			 * XLogRecData entries, so that we can pass it to the rm_desc
-			 * function as one contiguous chunk. (but we can leave out any
-			 * extra entries we created for backup blocks)
+			 * function as one contiguous chunk, following the record header.
+			 * (but we can leave out any extra entries we created for backup
+			 * blocks)
 			 */
 			rdt_lastnormal->next = NULL;
 
 			initStringInfo(&recordbuf);
+			appendBinaryStringInfo(&recordbuf, (char *) rechdr,
+								   sizeof(XLogRecord));
+			while (recordbuf.len < SizeOfXLogRecord)
+				appendStringInfoChar(&recordbuf, '\0');
 			for (; rdata != NULL; rdata = rdata->next)
 				appendBinaryStringInfo(&recordbuf, rdata->data, rdata->len);
 
 			appendStringInfoString(&buf, " - ");
-			RmgrTable[rechdr->xl_rmid].rm_desc(&buf, rechdr->xl_info, recordbuf.data);
+			RmgrTable[rechdr->xl_rmid].rm_desc(&buf, rechdr->xl_info,
+											   XLogRecGetData(recordbuf.data));
 			pfree(recordbuf.data);
 		}
 		elog(LOG, "%s", buf.data);
@@ -2936,7 +2942,7 @@ XLogFlush(XLogRecPtr record)
 	END_CRIT_SECTION();
 
 	/* wake up walsenders now that we've released heavily contended locks */
-	WalSndWakeupProcessRequests();
+	WalSndWakeupProcessRequests(LogwrtResult.Flush);
 
 	/*
 	 * If we still haven't flushed to the request point then we have a
@@ -3065,7 +3071,7 @@ XLogBackgroundFlush(void)
 	END_CRIT_SECTION();
 
 	/* wake up walsenders now that we've released heavily contended locks */
-	WalSndWakeupProcessRequests();
+	WalSndWakeupProcessRequests(LogwrtResult.Flush);
 
 	/*
 	 * Great, done. To take some work off the critical path, try to initialize
@@ -6519,6 +6525,7 @@ StartupXLOG(void)
 	SetTransactionIdLimit(checkPoint.oldestXid, checkPoint.oldestXidDB);
 	SetMultiXactIdLimit(checkPoint.oldestMulti, checkPoint.oldestMultiDB);
 	SetCommitTsLimit(checkPoint.oldestCommitTs);
+	StartupCommitTsIndex();
 	MultiXactSetSafeTruncate(checkPoint.oldestMulti);
 	XLogCtl->ckptXidEpoch = checkPoint.nextXidEpoch;
 	XLogCtl->ckptXid = checkPoint.nextXid;
@@ -8417,9 +8424,9 @@ CreateCheckPoint(int flags)
 	checkPoint.oldestXidDB = ShmemVariableCache->oldestXidDB;
 	LWLockRelease(XidGenLock);
 
-	LWLockAcquire(CommitTsControlLock, LW_SHARED);
+	LWLockAcquire(CommitTsLock, LW_SHARED);
 	checkPoint.oldestCommitTs = ShmemVariableCache->oldestCommitTs;
-	LWLockRelease(CommitTsControlLock);
+	LWLockRelease(CommitTsLock);
 
 	/* Increase XID epoch if we've wrapped around since last checkpoint */
 	checkPoint.nextXidEpoch = ControlFile->checkPointCopy.nextXidEpoch;
@@ -31,6 +31,7 @@
 
 #include "access/htup_details.h"
 #include "access/multixact.h"
+#include "access/seqam.h"
 #include "access/sysattr.h"
 #include "access/transam.h"
 #include "access/xact.h"
@@ -1737,11 +1738,13 @@ void
 heap_drop_with_catalog(Oid relid)
 {
 	Relation	rel;
+	char		relkind;
 
 	/*
 	 * Open and lock the relation.
 	 */
 	rel = relation_open(relid, AccessExclusiveLock);
+	relkind = rel->rd_rel->relkind;
 
 	/*
 	 * There can no longer be anyone *else* touching the relation, but we
@@ -1800,6 +1803,12 @@ heap_drop_with_catalog(Oid relid)
 	 */
 	remove_on_commit_action(relid);
 
+	/*
+	 * Forget any range of values cached for a sequence in shared memory
+	 */
+	if (relkind == RELKIND_SEQUENCE)
+		sequence_shared_forget(relid);
+
 	/*
 	 * Flush the relation from the relcache.  We want to do this before
 	 * starting to remove catalog entries, just to be certain that no relcache
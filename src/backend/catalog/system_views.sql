@@ -610,7 +610,20 @@ CREATE VIEW pg_stat_replication AS
             W.flush_location,
             W.replay_location,
             W.sync_priority,
-            W.sync_state
+            W.sync_state,
+            W.spill_txns,
+            W.spill_count,
+            W.spill_bytes,
+            W.spill_disk_bytes,
+            W.wal_reads,
+            W.wal_read_bytes,
+            W.wal_prefetches,
+            W.wal_read_time,
+            W.rel_cache_hits,
+            W.rel_cache_misses,
+            W.output_messages,
+            W.output_bytes,
+            W.output_flushes
     FROM pg_stat_get_activity(NULL) AS S, pg_authid U,
             pg_stat_get_wal_senders() AS W
     WHERE S.usesysid = U.oid AND
@@ -700,6 +713,31 @@ CREATE VIEW pg_stat_archiver AS
         s.stats_reset
     FROM pg_stat_get_archiver() s;
 
+CREATE VIEW pg_stat_slru AS
+    SELECT
+        s.name,
+        s.buffers,
+        s.banks,
+        s.blks_zeroed,
+        s.blks_hit,
+        s.blks_read,
+        s.blks_written
+    FROM pg_stat_get_slru() s;
+
+CREATE VIEW pg_stat_sequence_refill AS
+    SELECT
+        s.relid,
+        n.nspname AS schemaname,
+        c.relname,
+        s.refill_requests,
+        s.refills,
+        s.stalls,
+        s.stall_time,
+        s.last_refill
+    FROM pg_stat_get_sequence_refill() s
+         JOIN pg_class c ON c.oid = s.relid
+         LEFT JOIN pg_namespace n ON n.oid = c.relnamespace;
+
 CREATE VIEW pg_stat_bgwriter AS
     SELECT
         pg_stat_get_bgwriter_timed_checkpoints() AS checkpoints_timed,
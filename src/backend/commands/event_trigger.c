@@ -36,7 +36,7 @@
 #include "utils/builtins.h"
 #include "utils/evtcache.h"
 #include "utils/fmgroids.h"
-#include "utils/json.h"
+#include "utils/jsonb.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
@@ -1632,7 +1632,7 @@ pg_event_trigger_get_creation_commands(PG_FUNCTION_ARGS)
 	foreach(lc, currentEventTriggerState->stash)
 	{
 		StashedCommand *cmd = lfirst(lc);
-		char	   *command;
+		Jsonb	   *command;
 
 		/*
 		 * For IF NOT EXISTS commands that attempt to create an existing
@@ -1750,7 +1750,7 @@ pg_event_trigger_get_creation_commands(PG_FUNCTION_ARGS)
 				/* in_extension */
 				values[i++] = BoolGetDatum(cmd->in_extension);
 				/* command */
-				values[i++] = CStringGetTextDatum(command);
+				values[i++] = JsonbGetDatum(command);
 			}
 			else
 			{
@@ -1773,7 +1773,7 @@ pg_event_trigger_get_creation_commands(PG_FUNCTION_ARGS)
 				/* in_extension */
 				values[i++] = BoolGetDatum(cmd->in_extension);
 				/* command */
-				values[i++] = CStringGetTextDatum(command);
+				values[i++] = JsonbGetDatum(command);
 			}
 
 			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
@@ -1813,74 +1813,71 @@ typedef enum
 	SpecIdentifier
 } convSpecifier;
 
+static void expand_jsonb_recursive(StringInfo buf, JsonbContainer *container);
+
 /*
- * Extract the named json field, which must be of type string, from the given
- * JSON datum, which must be of type object.  If the field doesn't exist,
- * NULL is returned.  Otherwise the string value is returned.
+ * Find the named element in the given jsonb object.  If the element doesn't
+ * exist, NULL is returned.
  */
-static char *
-expand_get_strval(Datum json, char *field_name)
+static JsonbValue *
+expand_get_field(JsonbContainer *container, char *field_name)
 {
-	FunctionCallInfoData fcinfo;
-	Datum		result;
-	char	   *value_str;
+	JsonbValue	key;
 
-	InitFunctionCallInfoData(fcinfo, NULL, 2, InvalidOid, NULL, NULL);
+	key.type = jbvString;
+	key.val.string.val = field_name;
+	key.val.string.len = strlen(field_name);
 
-	fcinfo.arg[0] = json;
-	fcinfo.argnull[0] = false;
-	fcinfo.arg[1] = CStringGetTextDatum(field_name);
-	fcinfo.argnull[1] = false;
+	return findJsonbValueFromContainer(container, JB_FOBJECT, &key);
+}
 
-	result = (*json_object_field_text) (&fcinfo);
+/*
+ * Extract the named json field, which must be of type string, from the given
+ * jsonb object.  If the field doesn't exist or is null, NULL is returned.
+ * Otherwise the string value is returned.
+ */
+static char *
+expand_get_strval(JsonbContainer *container, char *field_name)
+{
+	JsonbValue *value;
 
-	if (fcinfo.isnull)
+	value = expand_get_field(container, field_name);
+	if (value == NULL || value->type == jbvNull)
 		return NULL;
 
-	value_str = TextDatumGetCString(result);
-
-	pfree(DatumGetPointer(result));
+	if (value->type != jbvString)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("element \"%s\" is not a JSON string", field_name)));
 
-	return value_str;
+	return pnstrdup(value->val.string.val, value->val.string.len);
 }
 
 /*
  * Extract the named json field, which must be of type boolean, from the given
- * JSON datum, which must be of type object.  If the field doesn't exist,
- * isnull is set to TRUE and the return value should not be consulted.
- * Otherwise the boolean value is returned.
+ * jsonb object.  If the field doesn't exist, isnull is set to TRUE and the
+ * return value should not be consulted.  Otherwise the boolean value is
+ * returned.
  */
 static bool
-expand_get_boolval(Datum json, char *field_name, bool *isnull)
+expand_get_boolval(JsonbContainer *container, char *field_name, bool *isnull)
 {
-	FunctionCallInfoData fcinfo;
-	Datum		result;
-	char	   *value_str;
+	JsonbValue *value;
 
-	*isnull = false;
-
-	InitFunctionCallInfoData(fcinfo, NULL, 2, InvalidOid, NULL, NULL);
-
-	fcinfo.arg[0] = json;
-	fcinfo.argnull[0] = false;
-	fcinfo.arg[1] = CStringGetTextDatum(field_name);
-	fcinfo.argnull[1] = false;
-
-	result = (*json_object_field_text) (&fcinfo);
-
-	if (fcinfo.isnull)
+	value = expand_get_field(container, field_name);
+	if (value == NULL || value->type == jbvNull)
 	{
 		*isnull = true;
 		return false;
 	}
 
-	value_str = TextDatumGetCString(result);
-
-	if (strcmp(value_str, "true") == 0)
-		return true;
+	if (value->type != jbvBool)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("element \"%s\" is not a JSON boolean", field_name)));
 
-	Assert(strcmp(value_str, "false") == 0);
-	return false;
+	*isnull = false;
+	return value->val.boolean;
 }
 
 /*
@@ -1890,110 +1887,60 @@ expand_get_boolval(Datum json, char *field_name, bool *isnull)
  * error reporting).
  */
 static JsonType
-jsonval_get_type(Datum jsonval, char **typename)
+jsonval_get_type(JsonbValue *jsonval, char **typename)
 {
 	JsonType	json_elt_type;
-	Datum		paramtype_datum;
 	char	   *paramtype;
 
-	paramtype_datum = DirectFunctionCall1(json_typeof, jsonval);
-	paramtype = TextDatumGetCString(paramtype_datum);
-
-	if (strcmp(paramtype, "array") == 0)
-		json_elt_type = JsonTypeArray;
-	else if (strcmp(paramtype, "object") == 0)
-		json_elt_type = JsonTypeObject;
-	else if (strcmp(paramtype, "string") == 0)
-		json_elt_type = JsonTypeString;
-	else if (strcmp(paramtype, "number") == 0)
-		json_elt_type = JsonTypeNumber;
-	else
-		/* XXX improve this; need to specify array index or param name */
-		elog(ERROR, "unexpected JSON element type %s",
-			 paramtype);
-
-	if (typename)
-		*typename = pstrdup(paramtype);
-
-	return json_elt_type;
-}
-
-/*
- * dequote_jsonval
- *		Take a string value extracted from a JSON object, and return a copy of it
- *		with the quoting removed.
- *
- * Another alternative to this would be to run the extraction routine again,
- * using the "_text" variant which returns the value without quotes; but this
- * is expensive, and moreover it complicates the logic a lot because not all
- * values are extracted in the same way (some are extracted using
- * json_object_field, others using json_array_element).  Dequoting the object
- * already at hand is a lot easier.
- */
-static char *
-dequote_jsonval(char *jsonval)
-{
-	char	   *result;
-	int			inputlen = strlen(jsonval);
-	int			i;
-	int			j = 0;
-
-	result = palloc(strlen(jsonval) + 1);
-
-	/* skip the start and end quotes right away */
-	for (i = 1; i < inputlen - 1; i++)
+	switch (jsonval->type)
 	{
-		if (jsonval[i] == '\\')
-		{
-			i++;
-
-			/* This uses same logic as json.c */
-			switch (jsonval[i])
+		case jbvBinary:
+			if (jsonval->val.binary.data->header & JB_FARRAY)
 			{
-				case 'b':
-					result[j++] = '\b';
-					continue;
-				case 'f':
-					result[j++] = '\f';
-					continue;
-				case 'n':
-					result[j++] = '\n';
-					continue;
-				case 'r':
-					result[j++] = '\r';
-					continue;
-				case 't':
-					result[j++] = '\t';
-					continue;
-				case '"':
-				case '\\':
-				case '/':
-					break;
-				default:
-					/* XXX: ERROR? */
-					break;
+				json_elt_type = JsonTypeArray;
+				paramtype = "array";
 			}
-		}
-
-		result[j++] = jsonval[i];
+			else
+			{
+				json_elt_type = JsonTypeObject;
+				paramtype = "object";
+			}
+			break;
+		case jbvString:
+			json_elt_type = JsonTypeString;
+			paramtype = "string";
+			break;
+		case jbvNumeric:
+			json_elt_type = JsonTypeNumber;
+			paramtype = "number";
+			break;
+		case jbvBool:
+			/* XXX improve this; need to specify array index or param name */
+			elog(ERROR, "unexpected JSON element type boolean");
+			break;
+		default:
+			elog(ERROR, "unexpected JSON element type null");
+			break;
 	}
-	result[j] = '\0';
 
-	return result;
+	if (typename)
+		*typename = paramtype;
+
+	return json_elt_type;
 }
 
 /*
  * Expand a json value as an identifier.  The value must be of type string.
  */
 static void
-expand_jsonval_identifier(StringInfo buf, Datum jsonval)
+expand_jsonval_identifier(StringInfo buf, JsonbValue *jsonval)
 {
-	char	   *unquoted;
+	char	   *str;
 
-	unquoted = dequote_jsonval(TextDatumGetCString(jsonval));
-	appendStringInfo(buf, "%s", quote_identifier(unquoted));
+	str = pnstrdup(jsonval->val.string.val, jsonval->val.string.len);
+	appendStringInfoString(buf, quote_identifier(str));
 
-	pfree(unquoted);
+	pfree(str);
 }
 
 /*
@@ -2004,7 +1951,7 @@ expand_jsonval_identifier(StringInfo buf, Datum jsonval)
  * XXX do we need a "catalogname" as well?
  */
 static void
-expand_jsonval_dottedname(StringInfo buf, Datum jsonval)
+expand_jsonval_dottedname(StringInfo buf, JsonbContainer *container)
 {
 	char	   *schema;
 	char	   *objname;
@@ -2012,8 +1959,8 @@ expand_jsonval_dottedname(StringInfo buf, Datum jsonval)
 	const char *qschema;
 	const char *qname;
 
-	schema = expand_get_strval(jsonval, "schemaname");
-	objname = expand_get_strval(jsonval, "objname");
+	schema = expand_get_strval(container, "schemaname");
+	objname = expand_get_strval(container, "objname");
 	if (objname == NULL)
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
@@ -2033,7 +1980,7 @@ expand_jsonval_dottedname(StringInfo buf, Datum jsonval)
 		pfree(schema);
 	}
 
-	attrname = expand_get_strval(jsonval, "attrname");
+	attrname = expand_get_strval(container, "attrname");
 	if (attrname)
 	{
 		const char *qattr;
@@ -2054,7 +2001,7 @@ expand_jsonval_dottedname(StringInfo buf, Datum jsonval)
  * expand a json value as a type name.
  */
 static void
-expand_jsonval_typename(StringInfo buf, Datum jsonval)
+expand_jsonval_typename(StringInfo buf, JsonbContainer *container)
 {
 	char	   *schema = NULL;
 	char	   *typename;
@@ -2062,14 +2009,14 @@ expand_jsonval_typename(StringInfo buf, Datum jsonval)
 	bool		array_isnull;
 	bool		is_array;
 
-	typename = expand_get_strval(jsonval, "typename");
+	typename = expand_get_strval(container, "typename");
 	if (typename == NULL)
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("invalid NULL type name in %%T element")));
-	typmodstr = expand_get_strval(jsonval, "typmod");	/* OK if null */
-	is_array = expand_get_boolval(jsonval, "is_array", &array_isnull);
-	schema = expand_get_strval(jsonval, "schemaname");
+	typmodstr = expand_get_strval(container, "typmod");	/* OK if null */
+	is_array = expand_get_boolval(container, "is_array", &array_isnull);
+	schema = expand_get_strval(container, "schemaname");
 
 	/*
 	 * If schema is NULL, then don't schema qualify, but do quote the type
@@ -2099,17 +2046,17 @@ expand_jsonval_typename(StringInfo buf, Datum jsonval)
  * Expand a json value as an operator name
  */
 static void
-expand_jsonval_operator(StringInfo buf, Datum jsonval)
+expand_jsonval_operator(StringInfo buf, JsonbContainer *container)
 {
 	char	   *schema = NULL;
 	char	   *operator;
 
-	operator = expand_get_strval(jsonval, "objname");
+	operator = expand_get_strval(container, "objname");
 	if (operator == NULL)
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("invalid NULL operator name in %%O element")));
-	schema = expand_get_strval(jsonval, "schemaname");
+	schema = expand_get_strval(container, "schemaname");
 
 	/* schema might be NULL or empty */
 	if (schema == NULL || schema[0] == '\0')
@@ -2127,76 +2074,64 @@ expand_jsonval_operator(StringInfo buf, Datum jsonval)
  * and it is set to false, the expansion is the empty string.
  */
 static void
-expand_jsonval_string(StringInfo buf, Datum jsonval, JsonType json_elt_type)
+expand_jsonval_string(StringInfo buf, JsonbValue *jsonval,
+					  JsonType json_elt_type)
 {
 	if (json_elt_type == JsonTypeString)
 	{
-		char	   *str;
-		char	   *unquoted;
-
-		str = TextDatumGetCString(jsonval);
-		unquoted = dequote_jsonval(str);
-		appendStringInfo(buf, "%s", unquoted);
-		pfree(str);
-		pfree(unquoted);
+		appendBinaryStringInfo(buf, jsonval->val.string.val,
+							   jsonval->val.string.len);
 	}
 	else if (json_elt_type == JsonTypeObject)
 	{
 		bool		present;
 		bool		isnull;
 
-		present = expand_get_boolval(jsonval, "present", &isnull);
+		present = expand_get_boolval(jsonval->val.binary.data, "present",
+									 &isnull);
 
 		if (isnull || present)
-		{
-			Datum		inner;
-			char	   *str;
-
-			inner = DirectFunctionCall1(pg_event_trigger_expand_command,
-										jsonval);
-			str = TextDatumGetCString(inner);
-
-			appendStringInfoString(buf, str);
-			pfree(DatumGetPointer(inner));
-			pfree(str);
-		}
+			expand_jsonb_recursive(buf, jsonval->val.binary.data);
 	}
 }
 
 static void
-expand_jsonval_number(StringInfo buf, Datum jsonval)
+expand_jsonval_number(StringInfo buf, JsonbValue *jsonval)
 {
-	appendStringInfoString(buf, TextDatumGetCString(jsonval));
+	char	   *str;
+
+	str = DatumGetCString(DirectFunctionCall1(numeric_out,
+							  NumericGetDatum(jsonval->val.numeric)));
+	appendStringInfoString(buf, str);
+	pfree(str);
 }
 
 /*
  * Expand a json value as a string literal
  */
 static void
-expand_jsonval_strlit(StringInfo buf, Datum jsonval)
+expand_jsonval_strlit(StringInfo buf, JsonbValue *jsonval)
 {
 	char   *str;
-	char   *unquoted;
 	StringInfoData dqdelim;
 	static const char dqsuffixes[] = "_XYZZYX_";
 	int         dqnextchar = 0;
 
-	/* obtain the string, and remove the JSON quotes and stuff */
-	str = TextDatumGetCString(jsonval);
-	unquoted = dequote_jsonval(str);
+	/* obtain the string */
+	str = pnstrdup(jsonval->val.string.val, jsonval->val.string.len);
 
 	/* easy case: if there are no ' and no \, just use a single quote */
-	if (strchr(unquoted, '\'') == NULL &&
-		strchr(unquoted, '\\') == NULL)
+	if (strchr(str, '\'') == NULL &&
+		strchr(str, '\\') == NULL)
 	{
-		appendStringInfo(buf, "'%s'", unquoted);
+		appendStringInfo(buf, "'%s'", str);
 		return;
 	}
 
 	/* Find a useful dollar-quote delimiter */
 	initStringInfo(&dqdelim);
 	appendStringInfoString(&dqdelim, "$");
-	while (strstr(unquoted, dqdelim.data) != NULL)
+	while (strstr(str, dqdelim.data) != NULL)
 	{
 		appendStringInfoChar(&dqdelim, dqsuffixes[dqnextchar++]);
 		dqnextchar %= sizeof(dqsuffixes) - 1;
@@ -2205,7 +2140,7 @@ expand_jsonval_strlit(StringInfo buf, Datum jsonval)
 	appendStringInfoChar(&dqdelim, '$');
 
 	/* And finally produce the quoted literal into the output StringInfo */
-	appendStringInfo(buf, "%s%s%s", dqdelim.data, unquoted, dqdelim.data);
+	appendStringInfo(buf, "%s%s%s", dqdelim.data, str, dqdelim.data);
 }
 
 /*
@@ -2213,7 +2148,7 @@ expand_jsonval_strlit(StringInfo buf, Datum jsonval)
  */
 static void
 expand_one_element(StringInfo buf, char *param,
-				   Datum jsonval, char *valtype, JsonType json_elt_type,
+				   JsonbValue *jsonval, char *valtype, JsonType json_elt_type,
 				   convSpecifier specifier)
 {
 	/*
@@ -2266,7 +2201,7 @@ expand_one_element(StringInfo buf, char *param,
 			break;
 
 		case SpecDottedName:
-			expand_jsonval_dottedname(buf, jsonval);
+			expand_jsonval_dottedname(buf, jsonval->val.binary.data);
 			break;
 
 		case SpecString:
@@ -2282,11 +2217,11 @@ expand_one_element(StringInfo buf, char *param,
 			break;
 
 		case SpecTypename:
-			expand_jsonval_typename(buf, jsonval);
+			expand_jsonval_typename(buf, jsonval->val.binary.data);
 			break;
 
 		case SpecOperatorname:
-			expand_jsonval_operator(buf, jsonval);
+			expand_jsonval_operator(buf, jsonval->val.binary.data);
 			break;
 	}
 }
@@ -2295,16 +2230,14 @@ expand_one_element(StringInfo buf, char *param,
  * Expand one JSON array element according to rules.
  */
 static void
-expand_one_array_element(StringInfo buf, Datum array, int idx, char *param,
-						 convSpecifier specifier)
+expand_one_array_element(StringInfo buf, JsonbContainer *array, int idx,
+						 char *param, convSpecifier specifier)
 {
-	Datum		elemval;
+	JsonbValue *elemval;
 	JsonType	json_elt_type;
 	char	   *elemtype;
 
-	elemval = DirectFunctionCall2(json_array_element,
-								  PointerGetDatum(array),
-								  Int32GetDatum(idx));
+	elemval = getIthJsonbValueFromContainer(array, idx);
 	json_elt_type = jsonval_get_type(elemval, &elemtype);
 
 	expand_one_element(buf, param,
@@ -2321,7 +2254,7 @@ expand_one_array_element(StringInfo buf, Datum array, int idx, char *param,
 	} while (0)
 
 /*------
- * Returns a formatted string from a JSON object.
+ * Expand a JSON object into buf.
  *
  * The starting point is the element named "fmt" (which must be a string).
  * This format string may contain zero or more %-escapes, which consist of an
@@ -2341,25 +2274,20 @@ expand_one_array_element(StringInfo buf, Datum array, int idx, char *param,
  * by a colon.	Its presence indicates that the element is expected to be
  * an array; the specified separator is used to join the array elements.
  *
- * XXX the current implementation works fine, but is likely to be slow: for
- * each element found in the fmt string we parse the JSON object once.	It
- * might be better to use jsonapi.h directly so that we build a hash or tree of
- * elements and their values once before parsing the fmt string, and later scan
- * fmt using the tree.
+ * Elements are looked up in the jsonb object directly, without parsing any
+ * JSON text, and nested objects are expanded in place.
  *------
  */
-Datum
-pg_event_trigger_expand_command(PG_FUNCTION_ARGS)
+static void
+expand_jsonb_recursive(StringInfo buf, JsonbContainer *container)
 {
-	text	   *json = PG_GETARG_TEXT_P(0);
 	char	   *fmt_str;
 	int			fmt_len;
 	const char *cp;
 	const char *start_ptr;
 	const char *end_ptr;
-	StringInfoData str;
 
-	fmt_str = expand_get_strval(PointerGetDatum(json), "fmt");
+	fmt_str = expand_get_strval(container, "fmt");
 	if (fmt_str == NULL)
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
@@ -2368,7 +2296,6 @@ pg_event_trigger_expand_command(PG_FUNCTION_ARGS)
 
 	start_ptr = fmt_str;
 	end_ptr = start_ptr + fmt_len;
-	initStringInfo(&str);
 
 	for (cp = start_ptr; cp < end_ptr; cp++)
 	{
@@ -2376,13 +2303,13 @@ pg_event_trigger_expand_command(PG_FUNCTION_ARGS)
 		bool		is_array;
 		char	   *param = NULL;
 		char	   *arraysep = NULL;
-		Datum		paramval;
+		JsonbValue *paramval;
 		char	   *paramtype;
 		JsonType	json_elt_type;
 
 		if (*cp != '%')
 		{
-			appendStringInfoCharMacro(&str, *cp);
+			appendStringInfoCharMacro(buf, *cp);
 			continue;
 		}
 
@@ -2393,7 +2320,7 @@ pg_event_trigger_expand_command(PG_FUNCTION_ARGS)
 		/* Easy case: %% outputs a single % */
 		if (*cp == '%')
 		{
-			appendStringInfoCharMacro(&str, *cp);
+			appendStringInfoCharMacro(buf, *cp);
 			continue;
 		}
 
@@ -2483,30 +2410,13 @@ pg_event_trigger_expand_command(PG_FUNCTION_ARGS)
 						 errmsg("invalid conversion specifier \"%c\"", *cp)));
 		}
 
-		/*
-		 * Obtain the element to be expanded.  Note we cannot use
-		 * DirectFunctionCall here, because the element might not exist.
-		 */
-		{
-			FunctionCallInfoData fcinfo;
-
-			InitFunctionCallInfoData(fcinfo, NULL, 2, InvalidOid, NULL, NULL);
-
-			fcinfo.arg[0] = PointerGetDatum(json);
-			fcinfo.argnull[0] = false;
-			fcinfo.arg[1] = CStringGetTextDatum(param);
-			fcinfo.argnull[1] = false;
-
-			paramval = (*json_object_field) (&fcinfo);
-
-			if (fcinfo.isnull)
-			{
-				ereport(ERROR,
-						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-						 errmsg("non-existant element \"%s\" in JSON formatting object",
-								param)));
-			}
-		}
+		/* Obtain the element to be expanded */
+		paramval = expand_get_field(container, param);
+		if (paramval == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("non-existant element \"%s\" in JSON formatting object",
+							param)));
 
 		/* figure out its type */
 		json_elt_type = jsonval_get_type(paramval, &paramtype);
@@ -2521,27 +2431,41 @@ pg_event_trigger_expand_command(PG_FUNCTION_ARGS)
 		/* And finally print out the data */
 		if (is_array)
 		{
+			JsonbContainer *array = paramval->val.binary.data;
 			int			count;
 			bool		putsep = false;
 			int			i;
 
-			count = DatumGetInt32(DirectFunctionCall1(json_array_length,
-													  paramval));
+			count = array->header & JB_CMASK;
 			for (i = 0; i < count; i++)
 			{
 				if (putsep)
-					appendStringInfoString(&str, arraysep);
+					appendStringInfoString(buf, arraysep);
 				putsep = true;
 
-				expand_one_array_element(&str, paramval, i, param, specifier);
+				expand_one_array_element(buf, array, i, param, specifier);
 			}
 		}
 		else
 		{
-			expand_one_element(&str, param, paramval, paramtype, json_elt_type,
+			expand_one_element(buf, param, paramval, paramtype, json_elt_type,
 							   specifier);
 		}
 	}
+}
+
+/*
+ * Returns a formatted string from a JSON object produced by
+ * deparse_utility_command; see expand_jsonb_recursive.
+ */
+Datum
+pg_event_trigger_expand_command(PG_FUNCTION_ARGS)
+{
+	Jsonb	   *json = PG_GETARG_JSONB(0);
+	StringInfoData str;
+
+	initStringInfo(&str);
+	expand_jsonb_recursive(&str, &json->root);
 
-	PG_RETURN_TEXT_P(CStringGetTextDatum(str.data));
+	PG_RETURN_TEXT_P(cstring_to_text_with_len(str.data, str.len));
 }
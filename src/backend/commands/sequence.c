@@ -77,8 +77,9 @@ static void init_params(List *options, bool isInit,
 			Form_pg_sequence new, List **owned_by);
 static void do_setval(Oid relid, int64 next, bool iscalled);
 static void process_owned_by(Relation seqrel, List *owned_by);
-static void seqrel_update_relam(Oid seqoid, Oid seqamid);
-static Oid init_options(Oid oldAM, char *accessMethod, List *options);
+static void seqrel_update_relam(Oid seqoid, Oid seqamid, Datum *reloptions);
+static Oid init_options(Oid oldAM, char *accessMethod, List *options,
+			 Datum *reloptions);
 
 
 /*
@@ -94,6 +95,7 @@ DefineSequence(CreateSeqStmt *seq)
 	CreateStmt *stmt = makeNode(CreateStmt);
 	Oid			seqoid;
 	Oid			seqamid;
+	Datum		reloptions;
 	Relation	rel;
 	HeapTuple	tuple;
 	TupleDesc	tupDesc;
@@ -114,7 +116,8 @@ DefineSequence(CreateSeqStmt *seq)
 	/* Check and set all param values */
 	init_params(seq->options, true, &new, &owned_by);
 
-	seqamid = init_options(InvalidOid, seq->accessMethod, seq->amoptions);
+	seqamid = init_options(InvalidOid, seq->accessMethod, seq->amoptions,
+						   &reloptions);
 
 	/* change statement to reflect the seqam for deparsing */
 	tuple = SearchSysCache1(SEQAMOID, ObjectIdGetDatum(seqamid));
@@ -221,11 +224,12 @@ DefineSequence(CreateSeqStmt *seq)
 
 	/*
 	 * After we've created the sequence's relation in pg_class, update
-	 * the relam to a non-default value, if requested. We perform this
-	 * as a separate update to avoid invasive changes in normal code
-	 * paths and to keep the code similar between CREATE and ALTER.
+	 * the relam to a non-default value, if requested, and store the AM's
+	 * options. We perform this as a separate update to avoid invasive
+	 * changes in normal code paths and to keep the code similar between
+	 * CREATE and ALTER.
 	 */
-	seqrel_update_relam(seqoid, seqamid);
+	seqrel_update_relam(seqoid, seqamid, &reloptions);
 
 	rel = heap_open(seqoid, AccessExclusiveLock);
 	tupDesc = RelationGetDescr(rel);
@@ -405,6 +409,7 @@ AlterSequence(AlterSeqStmt *stmt)
 {
 	Oid			relid;
 	Oid			seqamid;
+	Datum		reloptions;
 	SeqTable	elm;
 	Relation	seqrel;
 	Buffer		buf;
@@ -443,7 +448,8 @@ AlterSequence(AlterSeqStmt *stmt)
 
 	/* Check and set new values */
 	init_params(stmt->options, false, new, &owned_by);
-	seqamid = init_options(seqrel->rd_rel->relam, stmt->accessMethod, stmt->amoptions);
+	seqamid = init_options(seqrel->rd_rel->relam, stmt->accessMethod,
+						   stmt->amoptions, &reloptions);
 
 	/* Clear local cache so that we don't think we have cached numbers */
 	/* Note that we do not change the currval() state */
@@ -464,9 +470,19 @@ AlterSequence(AlterSeqStmt *stmt)
 		process_owned_by(seqrel, owned_by);
 
 	/*
-	 * Change the SeqAm, if requested, using a transactional update.
+	 * A range the shared SeqAm kept from before the sequence used a
+	 * different AM is stale; forget it before the shared SeqAm can see it
+	 * again.
 	 */
-	seqrel_update_relam(relid, seqamid);
+	if (seqamid != seqrel->rd_rel->relam)
+		sequence_shared_invalidate(seqrel);
+
+	/*
+	 * Change the SeqAm, if requested, using a transactional update.  USING
+	 * replaces the AM's options; without it they're kept as they are.
+	 */
+	seqrel_update_relam(relid, seqamid,
+						stmt->accessMethod != NULL ? &reloptions : NULL);
 
 	InvokeObjectPostAlterHook(RelationRelationId, relid, 0);
 
@@ -523,6 +539,7 @@ nextval_internal(Oid relid)
 	Buffer		buf;
 	HeapTupleData seqtuple;
 	int64		result;
+	TimestampTz stall_start = 0;
 
 	/* common code path for all sequence AMs */
 
@@ -551,6 +568,22 @@ nextval_internal(Oid relid)
 		return elm->last;
 	}
 
+	/* let the AM return values it caches itself, without locking the page */
+	if (sequence_nextval(seqrel, elm))
+	{
+		Assert(elm->last_valid);
+		relation_close(seqrel, NoLock);
+		last_used_seq = elm;
+		return elm->last;
+	}
+
+	/*
+	 * If the AM refills its cache in the background, having to lock the page
+	 * means that the refill didn't keep up; account for the stall.
+	 */
+	if (sequence_has_refill(seqrel))
+		stall_start = GetCurrentTimestamp();
+
 	/* lock page' buffer and read tuple */
 	read_seq_tuple(elm, seqrel, &buf, &seqtuple);
 
@@ -563,6 +596,9 @@ nextval_internal(Oid relid)
 
 	UnlockReleaseBuffer(buf);
 
+	if (stall_start != 0)
+		sequence_report_stall(seqrel, stall_start);
+
 	relation_close(seqrel, NoLock);
 
 	return result;
@@ -1374,7 +1410,8 @@ pg_sequence_parameters(PG_FUNCTION_ARGS)
 }
 
 /*
- * Update pg_class row for sequence to record change in relam.
+ * Update pg_class row for sequence to record change in relam and, unless
+ * reloptions is NULL, to store the AM's options.
  *
  * Call only while holding AccessExclusiveLock on sequence.
  *
@@ -1383,11 +1420,16 @@ pg_sequence_parameters(PG_FUNCTION_ARGS)
  * heap, as occurs elsewhere in this module.
  */
 static void
-seqrel_update_relam(Oid seqoid, Oid seqamid)
+seqrel_update_relam(Oid seqoid, Oid seqamid, Datum *reloptions)
 {
 	Relation	rd;
 	HeapTuple	ctup;
+	HeapTuple	newtuple;
 	Form_pg_class pgcform;
+	Datum		repl_val[Natts_pg_class];
+	bool		repl_null[Natts_pg_class];
+	bool		repl_repl[Natts_pg_class];
+	bool		isnull;
 
 	rd = heap_open(RelationRelationId, RowExclusiveLock);
 
@@ -1398,11 +1440,32 @@ seqrel_update_relam(Oid seqoid, Oid seqamid)
 						seqoid);
 	pgcform = (Form_pg_class) GETSTRUCT(ctup);
 
-	if (pgcform->relam != seqamid)
+	memset(repl_val, 0, sizeof(repl_val));
+	memset(repl_null, false, sizeof(repl_null));
+	memset(repl_repl, false, sizeof(repl_repl));
+
+	if (reloptions != NULL)
 	{
-		pgcform->relam = seqamid;
-		simple_heap_update(rd, &ctup->t_self, ctup);
-		CatalogUpdateIndexes(rd, ctup);
+		(void) SysCacheGetAttr(RELOID, ctup, Anum_pg_class_reloptions,
+							   &isnull);
+		if (*reloptions != (Datum) 0 || !isnull)
+		{
+			if (*reloptions != (Datum) 0)
+				repl_val[Anum_pg_class_reloptions - 1] = *reloptions;
+			else
+				repl_null[Anum_pg_class_reloptions - 1] = true;
+			repl_repl[Anum_pg_class_reloptions - 1] = true;
+		}
+	}
+
+	if (pgcform->relam != seqamid || repl_repl[Anum_pg_class_reloptions - 1])
+	{
+		newtuple = heap_modify_tuple(ctup, RelationGetDescr(rd),
+									 repl_val, repl_null, repl_repl);
+		((Form_pg_class) GETSTRUCT(newtuple))->relam = seqamid;
+		simple_heap_update(rd, &newtuple->t_self, newtuple);
+		CatalogUpdateIndexes(rd, newtuple);
+		heap_freetuple(newtuple);
 	}
 
 	heap_freetuple(ctup);
@@ -1479,11 +1542,14 @@ ResetSequenceCaches(void)
 	last_used_seq = NULL;
 }
 
+/*
+ * Determine the SeqAm of a sequence and validate its options; the options
+ * in text array form are returned in *reloptions, or (Datum) 0 if none.
+ */
 static Oid
-init_options(Oid oldAM, char *accessMethod, List *options)
+init_options(Oid oldAM, char *accessMethod, List *options, Datum *reloptions)
 {
 	Oid         seqamid;
-	Datum       reloptions;
 	Form_pg_seqam seqamForm;
 	HeapTuple   tuple = NULL;
 	char	   *validnsps[] = {NULL, NULL};
@@ -1508,10 +1574,10 @@ init_options(Oid oldAM, char *accessMethod, List *options)
 	  *  Parse AM-specific options, convert to text array form,
 	  *  retrieve the AM-option function and then validate.
 	  */
-	reloptions = transformRelOptions((Datum) NULL, options,
-									 NULL, validnsps, false, false);
+	*reloptions = transformRelOptions((Datum) 0, options,
+									  NULL, validnsps, false, false);
 
-	(void) sequence_reloptions(seqamForm->seqamoptions, reloptions, true);
+	(void) sequence_reloptions(seqamForm->seqamoptions, *reloptions, true);
 
 	ReleaseSysCache(tuple);
 
@@ -5580,6 +5580,29 @@ BackgroundWorkerInitializeConnection(char *dbname, char *username)
 	SetProcessingMode(NormalProcessing);
 }
 
+/*
+ * Connect background worker to a database using its OID.
+ */
+void
+BackgroundWorkerInitializeConnectionByOid(Oid dboid, char *username)
+{
+	BackgroundWorker *worker = MyBgworkerEntry;
+
+	/* XXX is this the right errcode? */
+	if (!(worker->bgw_flags & BGWORKER_BACKEND_DATABASE_CONNECTION))
+		ereport(FATAL,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("database connection requirement not indicated during registration")));
+
+	InitPostgres(NULL, dboid, username, NULL);
+
+	/* it had better not gotten out of "init" mode yet */
+	if (!IsInitProcessingMode())
+		ereport(ERROR,
+				(errmsg("invalid processing mode in background worker")));
+	SetProcessingMode(NormalProcessing);
+}
+
 /*
  * Block/unblock signals in a background worker
  */
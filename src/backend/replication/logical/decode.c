@@ -72,8 +72,13 @@ static void DecodeCommit(LogicalDecodingContext *ctx, XLogRecordBuffer *buf,
 static void DecodeAbort(LogicalDecodingContext *ctx, XLogRecPtr lsn,
 			TransactionId xid, TransactionId *sub_xids, int nsubxacts);
 
+/* common function to decide whether a change needs to be decoded */
+static bool FilterChange(LogicalDecodingContext *ctx, RelFileNode *rnode,
+			 RepNodeId origin_id);
+
 /* common function to decode tuples */
 static void DecodeXLogTuple(char *data, Size len, ReorderBufferTupleBuf *tup);
+static int32 DecodeToastChunkSeq(char *data);
 
 /*
  * Take every XLogReadRecord()ed record and perform the actions required to
@@ -220,6 +225,7 @@ DecodeXactOp(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 				xl_xact_commit *xlrec;
 				TransactionId *subxacts = NULL;
 				SharedInvalidationMessage *invals = NULL;
+				xl_xact_origin origin_data;
 				xl_xact_origin *origin = NULL;
 
 				xlrec = (xl_xact_commit *) buf->record_data;
@@ -228,7 +234,11 @@ DecodeXactOp(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 				invals = (SharedInvalidationMessage *) &(subxacts[xlrec->nsubxacts]);
 
 				if (xlrec->xinfo & XACT_CONTAINS_ORIGIN)
-					origin = (xl_xact_origin *) &(invals[xlrec->nmsgs]);
+				{
+					memcpy(&origin_data, &(invals[xlrec->nmsgs]),
+						   sizeof(xl_xact_origin));
+					origin = &origin_data;
+				}
 
 				DecodeCommit(ctx, buf, r->xl_xid, xlrec->dbId,
 							 xlrec->xact_time,
@@ -243,6 +253,7 @@ DecodeXactOp(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 				xl_xact_commit *xlrec;
 				TransactionId *subxacts;
 				SharedInvalidationMessage *invals = NULL;
+				xl_xact_origin origin_data;
 				xl_xact_origin *origin = NULL;
 
 				/* Prepared commits contain a normal commit record... */
@@ -253,7 +264,11 @@ DecodeXactOp(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 				invals = (SharedInvalidationMessage *) &(subxacts[xlrec->nsubxacts]);
 
 				if (xlrec->xinfo & XACT_CONTAINS_ORIGIN)
-					origin = (xl_xact_origin *) &(invals[xlrec->nmsgs]);
+				{
+					memcpy(&origin_data, &(invals[xlrec->nmsgs]),
+						   sizeof(xl_xact_origin));
+					origin = &origin_data;
+				}
 
 				DecodeCommit(ctx, buf, prec->xid, xlrec->dbId,
 							 xlrec->xact_time,
@@ -607,7 +622,7 @@ DecodeCommit(LogicalDecodingContext *ctx, XLogRecordBuffer *buf,
 
 	if (origin != NULL)
 	{
-		origin_id = origin->origin_node_id;
+		origin_id = buf->record.xl_origin_id;
 		origin_lsn = origin->origin_lsn;
 	}
 
@@ -658,8 +673,16 @@ DecodeInsert(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 	if (!(xlrec->flags & XLOG_HEAP_CONTAINS_NEW_TUPLE))
 		return;
 
-	/* only interested in our database */
-	if (xlrec->target.node.dbNode != ctx->slot->data.database)
+	/* only interested in our database, and what the plugin wants */
+	if (FilterChange(ctx, &xlrec->target.node, r->xl_origin_id))
+		return;
+
+	/*
+	 * Nor in TOAST chunks that won't be reassembled. The first chunk of each
+	 * value is still queued though, so the value can be reported as changed.
+	 */
+	if (ReorderBufferSkipToastChunk(ctx->reorder, &xlrec->target.node) &&
+		DecodeToastChunkSeq((char *) xlrec + SizeOfHeapInsert) != 0)
 		return;
 
 	change = ReorderBufferGetChange(ctx->reorder);
@@ -700,8 +723,8 @@ DecodeUpdate(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 
 	xlrec = (xl_heap_update *) buf->record_data;
 
-	/* only interested in our database */
-	if (xlrec->target.node.dbNode != ctx->slot->data.database)
+	/* only interested in our database, and what the plugin wants */
+	if (FilterChange(ctx, &xlrec->target.node, r->xl_origin_id))
 		return;
 
 	change = ReorderBufferGetChange(ctx->reorder);
@@ -789,8 +812,8 @@ DecodeDelete(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 
 	xlrec = (xl_heap_delete *) buf->record_data;
 
-	/* only interested in our database */
-	if (xlrec->target.node.dbNode != ctx->slot->data.database)
+	/* only interested in our database, and what the plugin wants */
+	if (FilterChange(ctx, &xlrec->target.node, r->xl_origin_id))
 		return;
 
 	change = ReorderBufferGetChange(ctx->reorder);
@@ -835,8 +858,8 @@ DecodeMultiInsert(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 
 	xlrec = (xl_heap_multi_insert *) buf->record_data;
 
-	/* only interested in our database */
-	if (xlrec->node.dbNode != ctx->slot->data.database)
+	/* only interested in our database, and what the plugin wants */
+	if (FilterChange(ctx, &xlrec->node, r->xl_origin_id))
 		return;
 
 	data = buf->record_data + SizeOfHeapMultiInsert;
@@ -921,6 +944,30 @@ DecodeMultiInsert(LogicalDecodingContext *ctx, XLogRecordBuffer *buf)
 	}
 }
 
+/*
+ * Decide whether a change to the relation rnode, originating from origin_id,
+ * can be skipped. This is checked before anything is allocated for the
+ * change, so changes the output plugin would throw away anyway - like those
+ * that were replicated to us from the very node we're sending to - don't
+ * incur the cost of being copied, queued and reassembled.
+ */
+static bool
+FilterChange(LogicalDecodingContext *ctx, RelFileNode *rnode,
+			 RepNodeId origin_id)
+{
+	/* only interested in our database */
+	if (rnode->dbNode != ctx->slot->data.database)
+		return true;
+
+	if (FilterByOrigin(ctx, origin_id))
+		return true;
+
+	if (FilterByRelation(ctx, rnode))
+		return true;
+
+	return false;
+}
+
 /*
  * Read a HeapTuple as WAL logged by heap_insert, heap_update and heap_delete
  * (but not by heap_multi_insert) into a tuplebuf.
@@ -961,3 +1008,25 @@ DecodeXLogTuple(char *data, Size len, ReorderBufferTupleBuf *tuple)
 	header->t_infomask2 = xlhdr.t_infomask2;
 	header->t_hoff = xlhdr.t_hoff;
 }
+
+/*
+ * Read chunk_seq from a TOAST chunk's tuple data, laid out as expected by
+ * DecodeXLogTuple(). TOAST tables always start with the fixed-width chunk_id
+ * and chunk_seq columns, so no tuple descriptor is needed to find it.
+ */
+static int32
+DecodeToastChunkSeq(char *data)
+{
+	xl_heap_header xlhdr;
+	int32		chunk_seq;
+
+	/* data is not stored aligned, copy to aligned storage */
+	memcpy((char *) &xlhdr, data, SizeOfHeapHeader);
+	memcpy((char *) &chunk_seq,
+		   data + SizeOfHeapHeader +
+		   (xlhdr.t_hoff - offsetof(HeapTupleHeaderData, t_bits)) +
+		   sizeof(Oid),
+		   sizeof(int32));
+
+	return chunk_seq;
+}
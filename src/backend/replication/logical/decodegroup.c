@@ -0,0 +1,1048 @@
+/*-------------------------------------------------------------------------
+ * decodegroup.c
+ *	   Sharing of logical decoding between walsenders
+ *
+ * Copyright (c) 2012-2014, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/replication/logical/decodegroup.c
+ *
+ * NOTES
+ *	  Every logical walsender normally reads and decodes WAL by itself. With
+ *	  several slots on one database using the same output plugin, that means
+ *	  the same WAL is read, decoded and reassembled into transactions once per
+ *	  slot, only for the results to be handed to different instances of the
+ *	  same output plugin.
+ *
+ *	  With shared_logical_decoding enabled, walsenders streaming from the same
+ *	  database with the same output plugin form groups instead. The group's
+ *	  leader keeps decoding WAL. For every member it additionally runs the
+ *	  member's output plugin, with the member's options, on the transactions
+ *	  reassembled in its own reorder buffer (see the callback wrappers in
+ *	  logical.c). The resulting CopyData payloads are passed to the member
+ *	  through a shm_mq, and the member just forwards them to its client. The
+ *	  catalog xmin and restart candidates computed by the leader are passed on
+ *	  through the same queue, so each member's slot keeps being advanced based
+ *	  on its own client's feedback, just like when decoding by itself.
+ *
+ *	  A walsender only asks to join once it has caught up with the flushed
+ *	  WAL. The leader only accepts if it has reached a consistent state and
+ *	  has not decoded past the position the joining walsender has decoded up
+ *	  to itself, so no transaction is lost; transactions ending before that
+ *	  position have already been sent by the member and are not passed to it
+ *	  again. The leader also must not lag too far behind, otherwise the
+ *	  member's client would have to wait for it to catch up. Requests are
+ *	  only handled between records.
+ *
+ *	  To avoid cycles, a walsender only asks to join a peer that already
+ *	  leads a group, or one using a lower walsender slot, and a walsender with
+ *	  a request of its own outstanding rejects requests from others.
+ *
+ *	  A member that goes away is simply dropped by its leader. If the leader
+ *	  exits, its members error out and their clients have to reconnect, as
+ *	  after any other walsender error. A member that doesn't keep up holds up
+ *	  its whole group, until wal_sender_timeout terminates it.
+ *
+ *	  Every walsender has a queue of shared_logical_decoding_queue_size
+ *	  reserved in shared memory, in which it receives changes while it is a
+ *	  member. Streaming of in-progress transactions is not used with
+ *	  shared_logical_decoding, as partial transactions can neither be passed
+ *	  to a member, nor may a member have sent some before joining.
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "miscadmin.h"
+
+#include "access/xlog_internal.h"
+
+#include "nodes/makefuncs.h"
+
+#include "replication/decodegroup.h"
+#include "replication/logical.h"
+#include "replication/walsender.h"
+#include "replication/walsender_private.h"
+
+#include "storage/ipc.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+/* space for a walsender's serialized output plugin options */
+#define DECODING_GROUP_OPTIONS_SIZE 1024
+
+/* ms after which an unanswered join request is withdrawn */
+#define DECODING_GROUP_JOIN_TIMEOUT 1000
+
+/* ms to wait before asking to join again */
+#define DECODING_GROUP_JOIN_RETRY 1000
+
+/* how far a leader may lag behind a walsender joining it */
+#define DECODING_GROUP_MAX_LAG XLogSegSize
+
+/*
+ * Messages in a member's queue are either data, which is forwarded to the
+ * client as it is (the walsender's CopyData payloads start with 'w'), or one
+ * of these, carrying a DecodingGroupSlotUpdate.
+ */
+#define DECODING_GROUP_MSG_XMIN		'x'
+#define DECODING_GROUP_MSG_RESTART	'r'
+
+typedef struct DecodingGroupSlotUpdate
+{
+	char		type;
+	XLogRecPtr	current_lsn;
+	TransactionId xmin;
+	XLogRecPtr	restart_lsn;
+} DecodingGroupSlotUpdate;
+
+typedef enum DecodingGroupRole
+{
+	DECODING_GROUP_NONE,
+	DECODING_GROUP_LEADER,
+	DECODING_GROUP_MEMBER
+} DecodingGroupRole;
+
+typedef enum DecodingGroupJoinState
+{
+	DECODING_GROUP_JOIN_NONE,
+	DECODING_GROUP_JOIN_REQUESTED,	/* waiting for the leader */
+	DECODING_GROUP_JOIN_ACCEPTING,	/* leader is setting up, can't withdraw */
+	DECODING_GROUP_JOIN_ACCEPTED,
+	DECODING_GROUP_JOIN_REJECTED
+} DecodingGroupJoinState;
+
+/*
+ * Shared state of each walsender, indexed like WalSndCtl->walsnds.
+ */
+typedef struct DecodingGroupPeer
+{
+	/* pid of the walsender, or 0 if it isn't streaming logical changes */
+	pid_t		pid;
+
+	/* database and output plugin, together determining possible peers */
+	Oid			database;
+	NameData	plugin;
+
+	DecodingGroupRole role;
+
+	/* for a member, the index of its leader */
+	int			leader;
+
+	/* for a leader, all output for WAL up to here has been queued */
+	XLogRecPtr	decoded_upto;
+
+	/* for a leader, somebody posted a join request to it */
+	bool		join_pending;
+
+	/* join request posted by this walsender */
+	DecodingGroupJoinState join_state;
+	int			join_target;
+	XLogRecPtr	join_lsn;
+	ReplicationSlot *join_slot;
+
+	/* this walsender's queue is still in use by a leader */
+	bool		queue_in_use;
+
+	/* serialized output plugin options, or -1 if they didn't fit */
+	int			options_len;
+	char		options[DECODING_GROUP_OPTIONS_SIZE];
+
+	/* Protects the fields shown above. */
+	slock_t		mutex;
+} DecodingGroupPeer;
+
+/*
+ * A member of a group led by this walsender.
+ */
+typedef struct DecodingGroupMember
+{
+	int			index;			/* into DecodingGroupPeers */
+	shm_mq_handle *mqh;
+	LogicalDecodingContext *ctx;
+	bool		detached;		/* the member has gone away */
+} DecodingGroupMember;
+
+/* GUCs */
+bool		shared_logical_decoding = false;
+int			shared_logical_decoding_queue_size = 1024;
+
+static DecodingGroupPeer *DecodingGroupPeers = NULL;
+static char *DecodingGroupQueues = NULL;
+
+/* our index into DecodingGroupPeers, or -1 if not registered */
+static int	MyGroupIndex = -1;
+
+/* our decoding context, and how member contexts should write */
+static LogicalDecodingContext *group_ctx = NULL;
+static LogicalOutputPluginWriterPrepareWrite group_prepare_write;
+static LogicalOutputPluginWriterWrite group_write;
+static DecodingGroupWaitCB group_wait;
+
+/* leader: list of DecodingGroupMember, and the last published position */
+static List *group_members = NIL;
+static XLogRecPtr group_published_upto = InvalidXLogRecPtr;
+
+/* member, or join request outstanding: our queue */
+static shm_mq_handle *group_mqh = NULL;
+static int	group_leader = -1;
+static bool join_outstanding = false;
+static TimestampTz join_requested_at = 0;
+static TimestampTz next_join_attempt = 0;
+
+static bool exit_callback_registered = false;
+
+static Size DecodingGroupQueueSize(void);
+static shm_mq *DecodingGroupQueue(int index);
+static void DecodingGroupShmemExit(int code, Datum arg);
+static int	DecodingGroupSerializeOptions(List *options, char *buf);
+static List *DecodingGroupDeserializeOptions(char *buf, int len);
+static void DecodingGroupProcessJoins(XLogRecPtr decoded_upto);
+static void DecodingGroupDropMember(DecodingGroupMember *member);
+static void DecodingGroupSend(DecodingGroupMember *member, Size nbytes,
+				  void *data);
+
+#define PeerLatch(index) (&WalSndCtl->walsnds[(index)].latch)
+
+static Size
+DecodingGroupQueueSize(void)
+{
+	return MAXALIGN((Size) shared_logical_decoding_queue_size * 1024);
+}
+
+static shm_mq *
+DecodingGroupQueue(int index)
+{
+	return (shm_mq *) (DecodingGroupQueues +
+					   index * DecodingGroupQueueSize());
+}
+
+/*
+ * Report shared-memory space needed by DecodingGroupShmemInit.
+ */
+Size
+DecodingGroupShmemSize(void)
+{
+	Size		size;
+
+	if (!shared_logical_decoding)
+		return 0;
+
+	size = mul_size(max_wal_senders, sizeof(DecodingGroupPeer));
+	size = add_size(size, mul_size(max_wal_senders, DecodingGroupQueueSize()));
+
+	return size;
+}
+
+/*
+ * Allocate and initialize the shared state of decoding groups.
+ */
+void
+DecodingGroupShmemInit(void)
+{
+	bool		found;
+	int			i;
+
+	if (!shared_logical_decoding || max_wal_senders == 0)
+		return;
+
+	DecodingGroupPeers = (DecodingGroupPeer *)
+		ShmemInitStruct("Logical Decoding Groups",
+						mul_size(max_wal_senders, sizeof(DecodingGroupPeer)),
+						&found);
+
+	if (!found)
+	{
+		MemSet(DecodingGroupPeers, 0,
+			   mul_size(max_wal_senders, sizeof(DecodingGroupPeer)));
+
+		for (i = 0; i < max_wal_senders; i++)
+		{
+			DecodingGroupPeer *peer = &DecodingGroupPeers[i];
+
+			peer->role = DECODING_GROUP_NONE;
+			peer->leader = -1;
+			peer->join_state = DECODING_GROUP_JOIN_NONE;
+			peer->join_target = -1;
+			SpinLockInit(&peer->mutex);
+		}
+	}
+
+	DecodingGroupQueues = (char *)
+		ShmemInitStruct("Logical Decoding Group Queues",
+						mul_size(max_wal_senders, DecodingGroupQueueSize()),
+						&found);
+}
+
+/*
+ * Make the walsender using ctx available for sharing decoding.
+ *
+ * output_plugin_options are passed to the output plugin when some other
+ * walsender decodes for us. prepare_write and do_write are used for the
+ * contexts of members of a group we lead, and wait_cb is called when one of
+ * them has no space left in its queue.
+ */
+void
+DecodingGroupStartup(LogicalDecodingContext *ctx,
+					 List *output_plugin_options,
+					 LogicalOutputPluginWriterPrepareWrite prepare_write,
+					 LogicalOutputPluginWriterWrite do_write,
+					 DecodingGroupWaitCB wait_cb)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile DecodingGroupPeer *me;
+	char		options[DECODING_GROUP_OPTIONS_SIZE];
+	int			options_len;
+
+	Assert(shared_logical_decoding);
+	Assert(MyWalSnd != NULL);
+	Assert(MyGroupIndex == -1);
+
+	options_len = DecodingGroupSerializeOptions(output_plugin_options,
+												options);
+	if (options_len < 0)
+		elog(DEBUG1, "output plugin options too long to share logical decoding of slot \"%s\"",
+			 NameStr(ctx->slot->data.name));
+
+	MyGroupIndex = MyWalSnd - WalSndCtl->walsnds;
+	me = &DecodingGroupPeers[MyGroupIndex];
+
+	SpinLockAcquire(&me->mutex);
+	me->pid = MyProcPid;
+	me->database = ctx->slot->data.database;
+	memcpy((char *) &me->plugin, &ctx->slot->data.plugin, sizeof(NameData));
+	me->role = DECODING_GROUP_NONE;
+	me->leader = -1;
+	me->decoded_upto = InvalidXLogRecPtr;
+	me->join_pending = false;
+	me->join_state = DECODING_GROUP_JOIN_NONE;
+	me->join_target = -1;
+	me->options_len = options_len;
+	if (options_len > 0)
+		memcpy((char *) me->options, options, options_len);
+	SpinLockRelease(&me->mutex);
+
+	group_ctx = ctx;
+	group_prepare_write = prepare_write;
+	group_write = do_write;
+	group_wait = wait_cb;
+	next_join_attempt = 0;
+
+	if (!exit_callback_registered)
+	{
+		on_shmem_exit(DecodingGroupShmemExit, 0);
+		exit_callback_registered = true;
+	}
+}
+
+/*
+ * Leave our group, if any, and stop sharing decoding.
+ *
+ * Members of a group we lead are detached from, which makes them error out.
+ * Safe to call in error cleanup, and if DecodingGroupStartup() hasn't been
+ * called. The decoding contexts of former members are left to
+ * FreeDecodingContext().
+ */
+void
+DecodingGroupRelease(void)
+{
+	volatile DecodingGroupPeer *me;
+	ListCell   *lc;
+	int			wake = -1;
+	int			i;
+
+	if (MyGroupIndex < 0)
+		return;
+
+	me = &DecodingGroupPeers[MyGroupIndex];
+
+	/* let the members of our group go */
+	foreach(lc, group_members)
+	{
+		DecodingGroupMember *member = lfirst(lc);
+		volatile DecodingGroupPeer *peer = &DecodingGroupPeers[member->index];
+
+		shm_mq_detach(DecodingGroupQueue(member->index));
+
+		SpinLockAcquire(&peer->mutex);
+		peer->queue_in_use = false;
+		SpinLockRelease(&peer->mutex);
+
+		SetLatch(PeerLatch(member->index));
+		pfree(member->mqh);
+		pfree(member);
+	}
+	list_free(group_members);
+	group_members = NIL;
+
+	/* reject requests still addressed to us */
+	for (i = 0; i < max_wal_senders; i++)
+	{
+		volatile DecodingGroupPeer *peer = &DecodingGroupPeers[i];
+		bool		rejected = false;
+
+		if (i == MyGroupIndex)
+			continue;
+
+		SpinLockAcquire(&peer->mutex);
+		if (peer->join_target == MyGroupIndex &&
+			(peer->join_state == DECODING_GROUP_JOIN_REQUESTED ||
+			 peer->join_state == DECODING_GROUP_JOIN_ACCEPTING))
+		{
+			peer->join_state = DECODING_GROUP_JOIN_REJECTED;
+			peer->queue_in_use = false;
+			rejected = true;
+		}
+		SpinLockRelease(&peer->mutex);
+
+		if (rejected)
+			SetLatch(PeerLatch(i));
+	}
+
+	/* withdraw our own request, or leave the group we're a member of */
+	SpinLockAcquire(&me->mutex);
+	if (me->role == DECODING_GROUP_MEMBER)
+		wake = me->leader;
+	else if (me->join_state != DECODING_GROUP_JOIN_NONE)
+		wake = me->join_target;
+	me->pid = 0;
+	me->role = DECODING_GROUP_NONE;
+	me->leader = -1;
+	me->decoded_upto = InvalidXLogRecPtr;
+	me->join_pending = false;
+	me->join_state = DECODING_GROUP_JOIN_NONE;
+	me->join_target = -1;
+	SpinLockRelease(&me->mutex);
+
+	if (group_mqh != NULL)
+	{
+		shm_mq_detach(DecodingGroupQueue(MyGroupIndex));
+		pfree(group_mqh);
+		group_mqh = NULL;
+	}
+
+	if (wake >= 0)
+		SetLatch(PeerLatch(wake));
+
+	MyGroupIndex = -1;
+	group_ctx = NULL;
+	group_published_upto = InvalidXLogRecPtr;
+	group_leader = -1;
+	join_outstanding = false;
+}
+
+static void
+DecodingGroupShmemExit(int code, Datum arg)
+{
+	DecodingGroupRelease();
+}
+
+/*
+ * Serialize a list of output plugin options, as produced by the replication
+ * command parser, into buf. Returns the length used, or -1 if the options
+ * don't fit.
+ */
+static int
+DecodingGroupSerializeOptions(List *options, char *buf)
+{
+	ListCell   *lc;
+	int			len = 0;
+
+	foreach(lc, options)
+	{
+		DefElem    *elem = lfirst(lc);
+		int			namelen = strlen(elem->defname) + 1;
+		int			vallen = elem->arg != NULL ? strlen(strVal(elem->arg)) + 1 : 0;
+
+		if (len + namelen + 1 + vallen > DECODING_GROUP_OPTIONS_SIZE)
+			return -1;
+
+		memcpy(buf + len, elem->defname, namelen);
+		len += namelen;
+		buf[len++] = elem->arg != NULL;
+		if (elem->arg != NULL)
+			memcpy(buf + len, strVal(elem->arg), vallen);
+		len += vallen;
+	}
+
+	return len;
+}
+
+static List *
+DecodingGroupDeserializeOptions(char *buf, int len)
+{
+	List	   *options = NIL;
+	int			off = 0;
+
+	while (off < len)
+	{
+		char	   *name = buf + off;
+		Node	   *arg = NULL;
+
+		off += strlen(name) + 1;
+		if (buf[off++])
+		{
+			arg = (Node *) makeString(pstrdup(buf + off));
+			off += strlen(buf + off) + 1;
+		}
+		options = lappend(options, makeDefElem(pstrdup(name), arg));
+	}
+
+	return options;
+}
+
+/*
+ * Called by a walsender between two records it decoded.
+ *
+ * Publishes how far our decoding got to the members of our group, drops
+ * members that went away, and handles requests to join us. With wakeup the
+ * members are also woken, to notice our progress even without new data.
+ */
+void
+DecodingGroupLeaderAdvance(bool wakeup)
+{
+	volatile DecodingGroupPeer *me;
+	XLogRecPtr	decoded_upto;
+
+	if (MyGroupIndex < 0)
+		return;
+
+	me = &DecodingGroupPeers[MyGroupIndex];
+	decoded_upto = group_ctx->reader->EndRecPtr;
+
+	if (group_members != NIL)
+	{
+		ListCell   *lc;
+		List	   *dropped = NIL;
+
+		/*
+		 * Unlocked checks for members that are gone are fine, a member can't
+		 * rejoin before we've cleaned up after it.
+		 */
+		foreach(lc, group_members)
+		{
+			DecodingGroupMember *member = lfirst(lc);
+			volatile DecodingGroupPeer *peer = &DecodingGroupPeers[member->index];
+
+			if (member->detached ||
+				peer->role != DECODING_GROUP_MEMBER ||
+				peer->leader != MyGroupIndex)
+				dropped = lappend(dropped, member);
+		}
+		foreach(lc, dropped)
+			DecodingGroupDropMember(lfirst(lc));
+		list_free(dropped);
+
+		if (decoded_upto > group_published_upto)
+		{
+			SpinLockAcquire(&me->mutex);
+			me->decoded_upto = decoded_upto;
+			SpinLockRelease(&me->mutex);
+
+			group_published_upto = decoded_upto;
+
+			if (wakeup)
+			{
+				foreach(lc, group_members)
+					SetLatch(PeerLatch(((DecodingGroupMember *) lfirst(lc))->index));
+			}
+		}
+	}
+
+	/* unlocked check, we'll see a request later if we miss it now */
+	if (me->join_pending)
+		DecodingGroupProcessJoins(decoded_upto);
+}
+
+/*
+ * Handle requests to join our group. Pass an invalid decoded_upto to reject
+ * them all.
+ */
+static void
+DecodingGroupProcessJoins(XLogRecPtr decoded_upto)
+{
+	volatile DecodingGroupPeer *me = &DecodingGroupPeers[MyGroupIndex];
+	int			i;
+
+	SpinLockAcquire(&me->mutex);
+	me->join_pending = false;
+	SpinLockRelease(&me->mutex);
+
+	for (i = 0; i < max_wal_senders; i++)
+	{
+		volatile DecodingGroupPeer *peer = &DecodingGroupPeers[i];
+		DecodingGroupMember *member = NULL;
+		XLogRecPtr	join_lsn;
+		ReplicationSlot *join_slot;
+		char		options[DECODING_GROUP_OPTIONS_SIZE];
+		int			options_len;
+		bool		accept;
+		bool		joined;
+
+		if (i == MyGroupIndex)
+			continue;
+
+		SpinLockAcquire(&peer->mutex);
+		if (peer->join_state != DECODING_GROUP_JOIN_REQUESTED ||
+			peer->join_target != MyGroupIndex)
+		{
+			SpinLockRelease(&peer->mutex);
+			continue;
+		}
+
+		/* from here on the requester can't withdraw, nor reuse its queue */
+		peer->join_state = DECODING_GROUP_JOIN_ACCEPTING;
+		peer->queue_in_use = true;
+		join_lsn = peer->join_lsn;
+		join_slot = peer->join_slot;
+		options_len = peer->options_len;
+		if (options_len > 0)
+			memcpy(options, (char *) peer->options, options_len);
+		SpinLockRelease(&peer->mutex);
+
+		/*
+		 * We must not have decoded past the requester, as it wouldn't see
+		 * transactions ending in between otherwise.
+		 */
+		accept = !XLogRecPtrIsInvalid(decoded_upto) &&
+			!join_outstanding &&
+			group_leader < 0 &&
+			DecodingContextReady(group_ctx) &&
+			decoded_upto <= join_lsn &&
+			join_lsn - decoded_upto <= DECODING_GROUP_MAX_LAG;
+
+		if (accept)
+		{
+			shm_mq	   *mq = DecodingGroupQueue(i);
+			MemoryContext oldcontext;
+
+			shm_mq_set_sender(mq, MyProc);
+
+			oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+			member = palloc0(sizeof(DecodingGroupMember));
+			member->index = i;
+			member->mqh = shm_mq_attach(mq, NULL, NULL);
+			MemoryContextSwitchTo(oldcontext);
+
+			member->ctx = CreateDecodingGroupMemberContext(group_ctx,
+														   join_slot,
+														   join_lsn,
+								DecodingGroupDeserializeOptions(options,
+																options_len),
+														 group_prepare_write,
+														   group_write);
+			member->ctx->output_writer_private = member;
+		}
+
+		SpinLockAcquire(&peer->mutex);
+		joined = accept && peer->join_state == DECODING_GROUP_JOIN_ACCEPTING;
+		if (joined)
+		{
+			peer->join_state = DECODING_GROUP_JOIN_ACCEPTED;
+			peer->role = DECODING_GROUP_MEMBER;
+			peer->leader = MyGroupIndex;
+		}
+		else
+		{
+			if (peer->join_state == DECODING_GROUP_JOIN_ACCEPTING)
+				peer->join_state = DECODING_GROUP_JOIN_REJECTED;
+			if (!accept)
+				peer->queue_in_use = false;
+		}
+		SpinLockRelease(&peer->mutex);
+
+		if (joined)
+		{
+			MemoryContext oldcontext;
+
+			SpinLockAcquire(&me->mutex);
+			me->role = DECODING_GROUP_LEADER;
+			if (decoded_upto > me->decoded_upto)
+				me->decoded_upto = decoded_upto;
+			SpinLockRelease(&me->mutex);
+
+			if (decoded_upto > group_published_upto)
+				group_published_upto = decoded_upto;
+
+			oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+			group_members = lappend(group_members, member);
+			MemoryContextSwitchTo(oldcontext);
+
+			elog(DEBUG1, "slot \"%s\" joined logical decoding of slot \"%s\" at %X/%X",
+				 NameStr(join_slot->data.name),
+				 NameStr(group_ctx->slot->data.name),
+				 (uint32) (join_lsn >> 32), (uint32) join_lsn);
+		}
+		else if (accept)
+		{
+			/* the requester went away while we were setting up */
+			member->detached = true;
+			DecodingGroupDropMember(member);
+		}
+
+		SetLatch(PeerLatch(i));
+	}
+}
+
+/*
+ * Stop feeding a member of our group, and release its queue.
+ */
+static void
+DecodingGroupDropMember(DecodingGroupMember *member)
+{
+	volatile DecodingGroupPeer *peer = &DecodingGroupPeers[member->index];
+
+	FreeDecodingGroupMemberContext(group_ctx, member->ctx);
+
+	shm_mq_detach(DecodingGroupQueue(member->index));
+	pfree(member->mqh);
+
+	SpinLockAcquire(&peer->mutex);
+	peer->queue_in_use = false;
+	SpinLockRelease(&peer->mutex);
+
+	group_members = list_delete_ptr(group_members, member);
+	pfree(member);
+
+	/* without members we may join another group ourselves */
+	if (group_members == NIL)
+	{
+		volatile DecodingGroupPeer *me = &DecodingGroupPeers[MyGroupIndex];
+
+		SpinLockAcquire(&me->mutex);
+		me->role = DECODING_GROUP_NONE;
+		SpinLockRelease(&me->mutex);
+	}
+}
+
+/*
+ * Queue a message for a member, waiting as long as its queue is full.
+ */
+static void
+DecodingGroupSend(DecodingGroupMember *member, Size nbytes, void *data)
+{
+	for (;;)
+	{
+		shm_mq_result res;
+
+		if (member->detached)
+			return;
+
+		res = shm_mq_send(member->mqh, nbytes, data, true);
+
+		if (res == SHM_MQ_SUCCESS)
+			break;
+		else if (res == SHM_MQ_DETACHED)
+		{
+			/* cleaned up in DecodingGroupLeaderAdvance() */
+			member->detached = true;
+			return;
+		}
+
+		/* queue is full, make sure the member is consuming it, and wait */
+		SetLatch(PeerLatch(member->index));
+		group_wait();
+	}
+
+	SetLatch(PeerLatch(member->index));
+}
+
+/*
+ * Pass the output prepared in a member's context on to the member.
+ */
+void
+DecodingGroupSendData(LogicalDecodingContext *ctx)
+{
+	DecodingGroupMember *member = ctx->output_writer_private;
+
+	Assert(ctx->out->len > 0 &&
+		   ctx->out->data[0] != DECODING_GROUP_MSG_XMIN &&
+		   ctx->out->data[0] != DECODING_GROUP_MSG_RESTART);
+
+	DecodingGroupSend(member, ctx->out->len, ctx->out->data);
+}
+
+/*
+ * Pass a new catalog xmin candidate for our slot on to the members of our
+ * group, see LogicalIncreaseXminForSlot().
+ */
+void
+DecodingGroupForwardXmin(XLogRecPtr current_lsn, TransactionId xmin)
+{
+	DecodingGroupSlotUpdate msg;
+	ListCell   *lc;
+
+	if (group_members == NIL)
+		return;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = DECODING_GROUP_MSG_XMIN;
+	msg.current_lsn = current_lsn;
+	msg.xmin = xmin;
+
+	foreach(lc, group_members)
+		DecodingGroupSend(lfirst(lc), sizeof(msg), &msg);
+}
+
+/*
+ * Pass a new restart candidate for our slot on to the members of our group,
+ * see LogicalIncreaseRestartDecodingForSlot().
+ */
+void
+DecodingGroupForwardRestart(XLogRecPtr current_lsn, XLogRecPtr restart_lsn)
+{
+	DecodingGroupSlotUpdate msg;
+	ListCell   *lc;
+
+	if (group_members == NIL)
+		return;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = DECODING_GROUP_MSG_RESTART;
+	msg.current_lsn = current_lsn;
+	msg.restart_lsn = restart_lsn;
+
+	foreach(lc, group_members)
+		DecodingGroupSend(lfirst(lc), sizeof(msg), &msg);
+}
+
+/*
+ * Try to have another walsender decode for us, instead of decoding WAL
+ * ourselves.
+ *
+ * A request to join is only posted when caught_up is set. While it is
+ * outstanding, DECODING_GROUP_PENDING is returned and we must not decode any
+ * further, as the leader relies on the position we posted. Once it has been
+ * accepted, DECODING_GROUP_JOINED is returned, and changes have to be read
+ * with DecodingGroupReceive() from there on.
+ */
+DecodingGroupJoinResult
+DecodingGroupTryJoin(bool caught_up)
+{
+	volatile DecodingGroupPeer *me;
+	XLogRecPtr	decoded_upto;
+	TimestampTz now;
+	shm_mq	   *mq;
+	MemoryContext oldcontext;
+	int			target = -1;
+	bool		found_leader = false;
+	int			i;
+
+	if (MyGroupIndex < 0)
+		return DECODING_GROUP_DECODE;
+
+	if (group_leader >= 0)
+		return DECODING_GROUP_JOINED;
+
+	me = &DecodingGroupPeers[MyGroupIndex];
+
+	if (join_outstanding)
+	{
+		DecodingGroupJoinState state;
+
+		/* don't keep others waiting for us meanwhile */
+		if (me->join_pending)
+			DecodingGroupProcessJoins(InvalidXLogRecPtr);
+
+		now = GetCurrentTimestamp();
+
+		SpinLockAcquire(&me->mutex);
+		state = me->join_state;
+		if (state == DECODING_GROUP_JOIN_ACCEPTED)
+		{
+			group_leader = me->leader;
+			me->join_state = DECODING_GROUP_JOIN_NONE;
+		}
+		else if (state == DECODING_GROUP_JOIN_REJECTED ||
+				 (state == DECODING_GROUP_JOIN_REQUESTED &&
+				  TimestampDifferenceExceeds(join_requested_at, now,
+											 DECODING_GROUP_JOIN_TIMEOUT)))
+		{
+			state = DECODING_GROUP_JOIN_REJECTED;
+			me->join_state = DECODING_GROUP_JOIN_NONE;
+		}
+		SpinLockRelease(&me->mutex);
+
+		if (state == DECODING_GROUP_JOIN_ACCEPTED)
+		{
+			join_outstanding = false;
+
+			ereport(LOG,
+					(errmsg("logical decoding for slot \"%s\" is now shared with walsender process %d",
+							NameStr(group_ctx->slot->data.name),
+							(int) DecodingGroupPeers[group_leader].pid)));
+
+			return DECODING_GROUP_JOINED;
+		}
+		else if (state == DECODING_GROUP_JOIN_REJECTED)
+		{
+			join_outstanding = false;
+			next_join_attempt =
+				TimestampTzPlusMilliseconds(now, DECODING_GROUP_JOIN_RETRY);
+
+			shm_mq_detach(DecodingGroupQueue(MyGroupIndex));
+			pfree(group_mqh);
+			group_mqh = NULL;
+
+			return DECODING_GROUP_DECODE;
+		}
+
+		return DECODING_GROUP_PENDING;
+	}
+
+	decoded_upto = group_ctx->reader->EndRecPtr;
+
+	/*
+	 * Only ask when we have caught up, and don't have members or a leader
+	 * still using our queue. The unlocked checks of our own state are fine,
+	 * we'll just try again later.
+	 */
+	if (!caught_up ||
+		group_members != NIL ||
+		me->queue_in_use ||
+		me->options_len < 0 ||
+		XLogRecPtrIsInvalid(decoded_upto) ||
+		decoded_upto < group_ctx->slot->data.confirmed_flush ||
+		!DecodingContextReady(group_ctx))
+		return DECODING_GROUP_DECODE;
+
+	now = GetCurrentTimestamp();
+	if (now < next_join_attempt)
+		return DECODING_GROUP_DECODE;
+	next_join_attempt = TimestampTzPlusMilliseconds(now,
+													DECODING_GROUP_JOIN_RETRY);
+
+	/* prefer an existing leader, otherwise the lowest eligible walsender */
+	for (i = 0; i < max_wal_senders && !found_leader; i++)
+	{
+		volatile DecodingGroupPeer *peer = &DecodingGroupPeers[i];
+
+		if (i == MyGroupIndex)
+			continue;
+
+		SpinLockAcquire(&peer->mutex);
+		if (peer->pid != 0 &&
+			peer->database == group_ctx->slot->data.database &&
+			strcmp(NameStr(*(NameData *) &peer->plugin),
+				   NameStr(group_ctx->slot->data.plugin)) == 0 &&
+			peer->join_state == DECODING_GROUP_JOIN_NONE)
+		{
+			if (peer->role == DECODING_GROUP_LEADER)
+			{
+				target = i;
+				found_leader = true;
+			}
+			else if (peer->role == DECODING_GROUP_NONE &&
+					 i < MyGroupIndex && target < 0)
+				target = i;
+		}
+		SpinLockRelease(&peer->mutex);
+	}
+
+	if (target < 0)
+		return DECODING_GROUP_DECODE;
+
+	mq = shm_mq_create(DecodingGroupQueue(MyGroupIndex),
+					   DecodingGroupQueueSize());
+	shm_mq_set_receiver(mq, MyProc);
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	group_mqh = shm_mq_attach(mq, NULL, NULL);
+	MemoryContextSwitchTo(oldcontext);
+
+	SpinLockAcquire(&me->mutex);
+	me->join_state = DECODING_GROUP_JOIN_REQUESTED;
+	me->join_target = target;
+	me->join_lsn = decoded_upto;
+	me->join_slot = group_ctx->slot;
+	SpinLockRelease(&me->mutex);
+
+	SpinLockAcquire(&DecodingGroupPeers[target].mutex);
+	DecodingGroupPeers[target].join_pending = true;
+	SpinLockRelease(&DecodingGroupPeers[target].mutex);
+
+	SetLatch(PeerLatch(target));
+
+	join_outstanding = true;
+	join_requested_at = now;
+
+	return DECODING_GROUP_PENDING;
+}
+
+/*
+ * Returns the position up to which our leader has queued all changes for us.
+ *
+ * Read this before DecodingGroupReceive() reported an empty queue, to know
+ * how far we've been sent everything.
+ */
+XLogRecPtr
+DecodingGroupLeaderPosition(void)
+{
+	volatile DecodingGroupPeer *leader;
+	XLogRecPtr	decoded_upto;
+
+	Assert(group_leader >= 0);
+
+	leader = &DecodingGroupPeers[group_leader];
+
+	SpinLockAcquire(&leader->mutex);
+	decoded_upto = leader->decoded_upto;
+	SpinLockRelease(&leader->mutex);
+
+	return decoded_upto;
+}
+
+/*
+ * Receive the next data message our leader queued for us, without waiting.
+ *
+ * Slot updates queued by the leader are applied to our slot on the way.
+ * Returns SHM_MQ_WOULD_BLOCK if the queue is empty, and SHM_MQ_DETACHED if
+ * the leader has gone away.
+ */
+shm_mq_result
+DecodingGroupReceive(Size *nbytes, void **data)
+{
+	Assert(group_leader >= 0);
+
+	/* we don't lead a group while being a member */
+	if (DecodingGroupPeers[MyGroupIndex].join_pending)
+		DecodingGroupProcessJoins(InvalidXLogRecPtr);
+
+	for (;;)
+	{
+		shm_mq_result res;
+		char		type;
+
+		res = shm_mq_receive(group_mqh, nbytes, data, true);
+		if (res != SHM_MQ_SUCCESS)
+			return res;
+
+		/* the leader might be waiting for space */
+		SetLatch(PeerLatch(group_leader));
+
+		type = *(char *) *data;
+
+		if (*nbytes == sizeof(DecodingGroupSlotUpdate) &&
+			(type == DECODING_GROUP_MSG_XMIN ||
+			 type == DECODING_GROUP_MSG_RESTART))
+		{
+			DecodingGroupSlotUpdate msg;
+
+			/* the data in the queue isn't necessarily aligned */
+			memcpy(&msg, *data, sizeof(msg));
+
+			if (type == DECODING_GROUP_MSG_XMIN)
+				LogicalIncreaseXminForSlot(msg.current_lsn, msg.xmin);
+			else
+				LogicalIncreaseRestartDecodingForSlot(msg.current_lsn,
+													  msg.restart_lsn);
+			continue;
+		}
+
+		return SHM_MQ_SUCCESS;
+	}
+}
@@ -33,6 +33,7 @@
 #include "access/xact.h"
 
 #include "replication/decode.h"
+#include "replication/decodegroup.h"
 #include "replication/logical.h"
 #include "replication/reorderbuffer.h"
 #include "replication/replication_identifier.h"
@@ -68,6 +69,33 @@ static void change_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
 static void message_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
 				  XLogRecPtr message_lsn, bool transactional, Size sz,
 				  const char *message);
+static void begin_cb_call(LogicalDecodingContext *ctx, ReorderBufferTXN *txn);
+static void commit_cb_call(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+			   XLogRecPtr commit_lsn);
+static void change_cb_call(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+			   Relation relation, ReorderBufferChange *change);
+static bool filter_by_origin_cb_call(LogicalDecodingContext *ctx,
+						 RepNodeId origin_id);
+static bool filter_relation_cb_call(LogicalDecodingContext *ctx,
+						RelFileNode *rnode);
+static bool change_filtered(LogicalDecodingContext *ctx, Relation relation,
+				ReorderBufferChange *change);
+static bool filter_relation_wrapper(ReorderBuffer *cache, RelFileNode *rnode);
+static void SetupToastFilter(LogicalDecodingContext *ctx);
+static void message_cb_call(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+				XLogRecPtr message_lsn, bool transactional, Size sz,
+				const char *message);
+static void stream_start_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn);
+static void stream_stop_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn);
+static void stream_change_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
+						 Relation relation, ReorderBufferChange *change);
+static void stream_message_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
+						  XLogRecPtr message_lsn, bool transactional, Size sz,
+						  const char *message);
+static void stream_abort_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
+						XLogRecPtr abort_lsn);
+static void stream_commit_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
+						 XLogRecPtr commit_lsn);
 
 static void LoadOutputPlugin(OutputPluginCallbacks *callbacks, char *plugin);
 
@@ -151,6 +179,12 @@ StartupDecodingContext(List *output_plugin_options,
 	 */
 	LoadOutputPlugin(&ctx->callbacks, NameStr(slot->data.plugin));
 
+	/*
+	 * Stream large in-progress transactions if the output plugin supports
+	 * it. The plugin can still disable that in its startup callback.
+	 */
+	ctx->streaming = ctx->callbacks.stream_start_cb != NULL;
+
 	/*
 	 * Now that the slot's xmin has been set, we can announce ourselves as a
 	 * logical decoding backend which doesn't need to be checked individually
@@ -192,6 +226,12 @@ StartupDecodingContext(List *output_plugin_options,
 	ctx->reorder->apply_change = change_cb_wrapper;
 	ctx->reorder->commit = commit_cb_wrapper;
 	ctx->reorder->message = message_cb_wrapper;
+	ctx->reorder->stream_start = stream_start_cb_wrapper;
+	ctx->reorder->stream_stop = stream_stop_cb_wrapper;
+	ctx->reorder->stream_change = stream_change_cb_wrapper;
+	ctx->reorder->stream_message = stream_message_cb_wrapper;
+	ctx->reorder->stream_abort = stream_abort_cb_wrapper;
+	ctx->reorder->stream_commit = stream_commit_cb_wrapper;
 
 	ctx->out = makeStringInfo();
 	ctx->prepare_write = prepare_write;
@@ -365,6 +405,8 @@ CreateInitDecodingContext(char *plugin,
 		startup_cb_wrapper(ctx, &ctx->options, true);
 	MemoryContextSwitchTo(old_context);
 
+	SetupToastFilter(ctx);
+
 	return ctx;
 }
 
@@ -446,6 +488,8 @@ CreateDecodingContext(XLogRecPtr start_lsn,
 		startup_cb_wrapper(ctx, &ctx->options, false);
 	MemoryContextSwitchTo(old_context);
 
+	SetupToastFilter(ctx);
+
 	ereport(LOG,
 			(errmsg("starting logical decoding for slot \"%s\"",
 					NameStr(slot->data.name)),
@@ -516,6 +560,10 @@ DecodingContextFindStartpoint(LogicalDecodingContext *ctx)
 void
 FreeDecodingContext(LogicalDecodingContext *ctx)
 {
+	while (ctx->group_members != NIL)
+		FreeDecodingGroupMemberContext(ctx,
+									   linitial(ctx->group_members));
+
 	if (ctx->callbacks.shutdown_cb != NULL)
 		shutdown_cb_wrapper(ctx);
 
@@ -525,6 +573,87 @@ FreeDecodingContext(LogicalDecodingContext *ctx)
 	MemoryContextDelete(ctx->context);
 }
 
+/*
+ * Create a decoding context for another walsender's slot, which will be fed
+ * from the reorder buffer of the leader context, instead of decoding WAL
+ * itself. See decodegroup.c.
+ *
+ * start_lsn is the position up to which the member has already decoded WAL;
+ * only transactions ending after it are passed to the member's output plugin,
+ * whose startup callback is invoked with output_plugin_options.
+ */
+LogicalDecodingContext *
+CreateDecodingGroupMemberContext(LogicalDecodingContext *leader,
+								 ReplicationSlot *slot,
+								 XLogRecPtr start_lsn,
+								 List *output_plugin_options,
+						  LogicalOutputPluginWriterPrepareWrite prepare_write,
+						  LogicalOutputPluginWriterWrite do_write)
+{
+	MemoryContext context,
+				old_context;
+	LogicalDecodingContext *ctx;
+
+	Assert(slot->data.database == leader->slot->data.database);
+	Assert(strcmp(NameStr(slot->data.plugin),
+				  NameStr(leader->slot->data.plugin)) == 0);
+
+	context = AllocSetContextCreate(leader->context,
+									"Logical Decoding Group Member Context",
+									ALLOCSET_DEFAULT_MINSIZE,
+									ALLOCSET_DEFAULT_INITSIZE,
+									ALLOCSET_DEFAULT_MAXSIZE);
+	old_context = MemoryContextSwitchTo(context);
+	ctx = palloc0(sizeof(LogicalDecodingContext));
+
+	ctx->context = context;
+
+	LoadOutputPlugin(&ctx->callbacks, NameStr(slot->data.plugin));
+
+	/* the member shares all the decoding infrastructure with the leader */
+	ctx->slot = slot;
+	ctx->reader = leader->reader;
+	ctx->reorder = leader->reorder;
+	ctx->snapshot_builder = leader->snapshot_builder;
+	ctx->streaming = false;
+
+	ctx->out = makeStringInfo();
+	ctx->prepare_write = prepare_write;
+	ctx->write = do_write;
+
+	ctx->output_plugin_options = copyObject(output_plugin_options);
+	ctx->group_start_lsn = start_lsn;
+
+	if (ctx->callbacks.startup_cb != NULL)
+		startup_cb_wrapper(ctx, &ctx->options, false);
+
+	MemoryContextSwitchTo(leader->context);
+	leader->group_members = lappend(leader->group_members, ctx);
+
+	MemoryContextSwitchTo(old_context);
+
+	SetupToastFilter(leader);
+
+	return ctx;
+}
+
+/*
+ * Free a context created by CreateDecodingGroupMemberContext(), invoking the
+ * member's shutdown callback if necessary.
+ */
+void
+FreeDecodingGroupMemberContext(LogicalDecodingContext *leader,
+							   LogicalDecodingContext *ctx)
+{
+	if (ctx->callbacks.shutdown_cb != NULL)
+		shutdown_cb_wrapper(ctx);
+
+	leader->group_members = list_delete_ptr(leader->group_members, ctx);
+	MemoryContextDelete(ctx->context);
+
+	SetupToastFilter(leader);
+}
+
 /*
  * Prepare a write using the context's output routine.
  */
@@ -575,6 +704,21 @@ LoadOutputPlugin(OutputPluginCallbacks *callbacks, char *plugin)
 		elog(ERROR, "output plugins have to register a change callback");
 	if (callbacks->commit_cb == NULL)
 		elog(ERROR, "output plugins have to register a commit callback");
+
+	/* streaming is optional, but if supported, it has to be done fully */
+	if (callbacks->stream_start_cb != NULL ||
+		callbacks->stream_stop_cb != NULL ||
+		callbacks->stream_change_cb != NULL ||
+		callbacks->stream_abort_cb != NULL ||
+		callbacks->stream_commit_cb != NULL)
+	{
+		if (callbacks->stream_start_cb == NULL ||
+			callbacks->stream_stop_cb == NULL ||
+			callbacks->stream_change_cb == NULL ||
+			callbacks->stream_abort_cb == NULL ||
+			callbacks->stream_commit_cb == NULL)
+			elog(ERROR, "output plugins supporting streaming have to register stream start, stop, change, abort and commit callbacks");
+	}
 }
 
 static void
@@ -651,11 +795,109 @@ shutdown_cb_wrapper(LogicalDecodingContext *ctx)
 /*
  * Callbacks for ReorderBuffer which add in some more information and then call
  * output_plugin.h plugins.
+ *
+ * The non-streaming callbacks are also passed on to the contexts of other
+ * slots sharing this context's decoding (see decodegroup.c), unless the
+ * member has already seen the transaction by decoding WAL itself. Streaming
+ * isn't used while decoding is shared.
  */
 static void
 begin_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn)
 {
 	LogicalDecodingContext *ctx = cache->private_data;
+	ListCell   *lc;
+
+	begin_cb_call(ctx, txn);
+
+	foreach(lc, ctx->group_members)
+	{
+		LogicalDecodingContext *member = lfirst(lc);
+
+		if (txn->end_lsn > member->group_start_lsn)
+			begin_cb_call(member, txn);
+	}
+}
+
+static void
+commit_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
+				  XLogRecPtr commit_lsn)
+{
+	LogicalDecodingContext *ctx = cache->private_data;
+	ListCell   *lc;
+
+	commit_cb_call(ctx, txn, commit_lsn);
+
+	foreach(lc, ctx->group_members)
+	{
+		LogicalDecodingContext *member = lfirst(lc);
+
+		if (txn->end_lsn > member->group_start_lsn)
+			commit_cb_call(member, txn, commit_lsn);
+	}
+}
+
+static void
+change_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
+				  Relation relation, ReorderBufferChange *change)
+{
+	LogicalDecodingContext *ctx = cache->private_data;
+	ListCell   *lc;
+
+	/*
+	 * While decoding is shared, decode.c only skips changes all members
+	 * filter, so each of them has to be asked again before passing the
+	 * change on. Otherwise decode.c already asked ctx's plugin.
+	 */
+	if (ctx->group_members == NIL ||
+		!change_filtered(ctx, relation, change))
+		change_cb_call(ctx, txn, relation, change);
+
+	foreach(lc, ctx->group_members)
+	{
+		LogicalDecodingContext *member = lfirst(lc);
+
+		if (txn->end_lsn > member->group_start_lsn &&
+			!change_filtered(member, relation, change))
+			change_cb_call(member, txn, relation, change);
+	}
+}
+
+/*
+ * Does ctx's output plugin want to skip change, either because of its origin
+ * or because of the relation it modifies?
+ */
+static bool
+change_filtered(LogicalDecodingContext *ctx, Relation relation,
+				ReorderBufferChange *change)
+{
+	return filter_by_origin_cb_call(ctx, change->origin_id) ||
+		filter_relation_cb_call(ctx, &relation->rd_node);
+}
+
+static void
+message_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
+				   XLogRecPtr message_lsn, bool transactional, Size sz,
+				   const char *message)
+{
+	LogicalDecodingContext *ctx = cache->private_data;
+	ListCell   *lc;
+
+	message_cb_call(ctx, txn, message_lsn, transactional, sz, message);
+
+	foreach(lc, ctx->group_members)
+	{
+		LogicalDecodingContext *member = lfirst(lc);
+
+		if (transactional ? txn->end_lsn > member->group_start_lsn :
+			message_lsn >= member->group_start_lsn)
+			message_cb_call(member, txn, message_lsn, transactional, sz,
+							message);
+	}
+}
+
+static void
+begin_cb_call(LogicalDecodingContext *ctx, ReorderBufferTXN *txn)
+{
 	LogicalErrorCallbackState state;
 	ErrorContextCallback errcallback;
 
@@ -681,10 +923,9 @@ begin_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn)
 }
 
 static void
-commit_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
-				  XLogRecPtr commit_lsn)
+commit_cb_call(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+			   XLogRecPtr commit_lsn)
 {
-	LogicalDecodingContext *ctx = cache->private_data;
 	LogicalErrorCallbackState state;
 	ErrorContextCallback errcallback;
 
@@ -710,10 +951,9 @@ commit_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
 }
 
 static void
-change_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
-				  Relation relation, ReorderBufferChange *change)
+change_cb_call(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+			   Relation relation, ReorderBufferChange *change)
 {
-	LogicalDecodingContext *ctx = cache->private_data;
 	LogicalErrorCallbackState state;
 	ErrorContextCallback errcallback;
 
@@ -744,12 +984,11 @@ change_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
 	error_context_stack = errcallback.previous;
 }
 
-static void message_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
-							   XLogRecPtr message_lsn,
-							   bool transactional, Size sz,
-							   const char *message)
+static void
+message_cb_call(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+				XLogRecPtr message_lsn, bool transactional, Size sz,
+				const char *message)
 {
-	LogicalDecodingContext *ctx = cache->private_data;
 	LogicalErrorCallbackState state;
 	ErrorContextCallback errcallback;
 
@@ -778,6 +1017,320 @@ static void message_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
 	error_context_stack = errcallback.previous;
 }
 
+/*
+ * Ask the output plugin whether changes originating from origin_id can be
+ * skipped while decoding WAL. If other slots share this context's decoding,
+ * the change is only skipped if all of their plugins agree; the others are
+ * filtered per plugin by change_cb_wrapper().
+ */
+bool
+FilterByOrigin(LogicalDecodingContext *ctx, RepNodeId origin_id)
+{
+	ListCell   *lc;
+
+	if (!filter_by_origin_cb_call(ctx, origin_id))
+		return false;
+
+	foreach(lc, ctx->group_members)
+	{
+		if (!filter_by_origin_cb_call(lfirst(lc), origin_id))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Like FilterByOrigin(), but for changes to the relation stored in rnode.
+ */
+bool
+FilterByRelation(LogicalDecodingContext *ctx, RelFileNode *rnode)
+{
+	ListCell   *lc;
+
+	if (!filter_relation_cb_call(ctx, rnode))
+		return false;
+
+	foreach(lc, ctx->group_members)
+	{
+		if (!filter_relation_cb_call(lfirst(lc), rnode))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Tell the reorder buffer which TOAST chunks it needs to keep: none if the
+ * output plugins of all slots sharing ctx's decoding set
+ * skip_toast_reassembly in their startup callback, otherwise those of
+ * relations not filtered by FilterByRelation().
+ */
+static void
+SetupToastFilter(LogicalDecodingContext *ctx)
+{
+	bool		skip_reassembly = ctx->options.skip_toast_reassembly;
+	bool		filter_relation = ctx->callbacks.filter_relation_cb != NULL;
+	ListCell   *lc;
+
+	foreach(lc, ctx->group_members)
+	{
+		LogicalDecodingContext *member = lfirst(lc);
+
+		skip_reassembly &= member->options.skip_toast_reassembly;
+		filter_relation &= member->callbacks.filter_relation_cb != NULL;
+	}
+
+	ReorderBufferSetupToastFilter(ctx->reorder, skip_reassembly,
+						filter_relation ? filter_relation_wrapper : NULL);
+}
+
+static bool
+filter_relation_wrapper(ReorderBuffer *cache, RelFileNode *rnode)
+{
+	return FilterByRelation(cache->private_data, rnode);
+}
+
+static bool
+filter_by_origin_cb_call(LogicalDecodingContext *ctx, RepNodeId origin_id)
+{
+	LogicalErrorCallbackState state;
+	ErrorContextCallback errcallback;
+	bool		ret;
+
+	if (ctx->callbacks.filter_by_origin_cb == NULL)
+		return false;
+
+	/* Push callback + info on the error context stack */
+	state.ctx = ctx;
+	state.callback_name = "filter_by_origin";
+	state.report_location = InvalidXLogRecPtr;
+	errcallback.callback = output_plugin_error_callback;
+	errcallback.arg = (void *) &state;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	/* set output state */
+	ctx->accept_writes = false;
+
+	/* do the actual work: call callback */
+	ret = ctx->callbacks.filter_by_origin_cb(ctx, origin_id);
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+
+	return ret;
+}
+
+static bool
+filter_relation_cb_call(LogicalDecodingContext *ctx, RelFileNode *rnode)
+{
+	LogicalErrorCallbackState state;
+	ErrorContextCallback errcallback;
+	bool		ret;
+
+	if (ctx->callbacks.filter_relation_cb == NULL)
+		return false;
+
+	/* Push callback + info on the error context stack */
+	state.ctx = ctx;
+	state.callback_name = "filter_relation";
+	state.report_location = InvalidXLogRecPtr;
+	errcallback.callback = output_plugin_error_callback;
+	errcallback.arg = (void *) &state;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	/* set output state */
+	ctx->accept_writes = false;
+
+	/* do the actual work: call callback */
+	ret = ctx->callbacks.filter_relation_cb(ctx, rnode);
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+
+	return ret;
+}
+
+static void
+stream_start_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn)
+{
+	LogicalDecodingContext *ctx = cache->private_data;
+	LogicalErrorCallbackState state;
+	ErrorContextCallback errcallback;
+
+	/* Push callback + info on the error context stack */
+	state.ctx = ctx;
+	state.callback_name = "stream_start";
+	state.report_location = txn->first_lsn;
+	errcallback.callback = output_plugin_error_callback;
+	errcallback.arg = (void *) &state;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	/* set output state */
+	ctx->accept_writes = true;
+	ctx->write_xid = txn->xid;
+	ctx->write_location = txn->first_lsn;
+
+	/* do the actual work: call callback */
+	ctx->callbacks.stream_start_cb(ctx, txn);
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+}
+
+static void
+stream_stop_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn)
+{
+	LogicalDecodingContext *ctx = cache->private_data;
+	LogicalErrorCallbackState state;
+	ErrorContextCallback errcallback;
+
+	/* Push callback + info on the error context stack */
+	state.ctx = ctx;
+	state.callback_name = "stream_stop";
+	state.report_location = txn->first_lsn;
+	errcallback.callback = output_plugin_error_callback;
+	errcallback.arg = (void *) &state;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	/*
+	 * Set output state. Keep reporting the location of the last streamed
+	 * change, nothing later has been sent.
+	 */
+	ctx->accept_writes = true;
+	ctx->write_xid = txn->xid;
+
+	/* do the actual work: call callback */
+	ctx->callbacks.stream_stop_cb(ctx, txn);
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+}
+
+static void
+stream_change_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
+						 Relation relation, ReorderBufferChange *change)
+{
+	LogicalDecodingContext *ctx = cache->private_data;
+	LogicalErrorCallbackState state;
+	ErrorContextCallback errcallback;
+
+	/* Push callback + info on the error context stack */
+	state.ctx = ctx;
+	state.callback_name = "stream_change";
+	state.report_location = change->lsn;
+	errcallback.callback = output_plugin_error_callback;
+	errcallback.arg = (void *) &state;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	/* set output state */
+	ctx->accept_writes = true;
+	ctx->write_xid = txn->xid;
+	ctx->write_location = change->lsn;
+
+	ctx->callbacks.stream_change_cb(ctx, txn, relation, change);
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+}
+
+static void
+stream_message_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
+						  XLogRecPtr message_lsn, bool transactional, Size sz,
+						  const char *message)
+{
+	LogicalDecodingContext *ctx = cache->private_data;
+	LogicalErrorCallbackState state;
+	ErrorContextCallback errcallback;
+
+	if (ctx->callbacks.stream_message_cb == NULL)
+		return;
+
+	/* Push callback + info on the error context stack */
+	state.ctx = ctx;
+	state.callback_name = "stream_message";
+	state.report_location = message_lsn;
+	errcallback.callback = output_plugin_error_callback;
+	errcallback.arg = (void *) &state;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	/* set output state */
+	ctx->accept_writes = true;
+	ctx->write_xid = txn->xid;
+	ctx->write_location = message_lsn;
+
+	/* do the actual work: call callback */
+	ctx->callbacks.stream_message_cb(ctx, txn, message_lsn, transactional,
+									 sz, message);
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+}
+
+static void
+stream_abort_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
+						XLogRecPtr abort_lsn)
+{
+	LogicalDecodingContext *ctx = cache->private_data;
+	LogicalErrorCallbackState state;
+	ErrorContextCallback errcallback;
+
+	/* Push callback + info on the error context stack */
+	state.ctx = ctx;
+	state.callback_name = "stream_abort";
+	state.report_location = abort_lsn;
+	errcallback.callback = output_plugin_error_callback;
+	errcallback.arg = (void *) &state;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	/* set output state */
+	ctx->accept_writes = true;
+	ctx->write_xid = txn->xid;
+	ctx->write_location = abort_lsn;
+
+	/* do the actual work: call callback */
+	ctx->callbacks.stream_abort_cb(ctx, txn, abort_lsn);
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+}
+
+static void
+stream_commit_cb_wrapper(ReorderBuffer *cache, ReorderBufferTXN *txn,
+						 XLogRecPtr commit_lsn)
+{
+	LogicalDecodingContext *ctx = cache->private_data;
+	LogicalErrorCallbackState state;
+	ErrorContextCallback errcallback;
+
+	/* Push callback + info on the error context stack */
+	state.ctx = ctx;
+	state.callback_name = "stream_commit";
+	state.report_location = txn->final_lsn;		/* beginning of commit record */
+	errcallback.callback = output_plugin_error_callback;
+	errcallback.arg = (void *) &state;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	/* set output state */
+	ctx->accept_writes = true;
+	ctx->write_xid = txn->xid;
+	ctx->write_location = txn->end_lsn; /* points to the end of the record */
+
+	/* do the actual work: call callback */
+	ctx->callbacks.stream_commit_cb(ctx, txn, commit_lsn);
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+}
+
 /*
  * Set the required catalog xmin horizon for historic snapshots in the current
  * replication slot.
@@ -834,6 +1387,9 @@ LogicalIncreaseXminForSlot(XLogRecPtr current_lsn, TransactionId xmin)
 	/* candidate already valid with the current flush position, apply */
 	if (updated_xmin)
 		LogicalConfirmReceivedLocation(slot->data.confirmed_flush);
+
+	/* slots fed by our decoding need the same horizon */
+	DecodingGroupForwardXmin(current_lsn, xmin);
 }
 
 /*
@@ -907,6 +1463,9 @@ LogicalIncreaseRestartDecodingForSlot(XLogRecPtr current_lsn, XLogRecPtr restart
 	/* candidates are already valid with the current flush position, apply */
 	if (updated_lsn)
 		LogicalConfirmReceivedLocation(slot->data.confirmed_flush);
+
+	/* slots fed by our decoding can restart from the same point */
+	DecodingGroupForwardRestart(current_lsn, restart_lsn);
 }
 
 /*
@@ -923,6 +1482,8 @@ LogicalConfirmReceivedLocation(XLogRecPtr lsn)
 	{
 		bool		updated_xmin = false;
 		bool		updated_restart = false;
+		TransactionId old_catalog_xmin;
+		XLogRecPtr	old_restart_lsn;
 
 		/* use volatile pointer to prevent code rearrangement */
 		volatile ReplicationSlot *slot = MyReplicationSlot;
@@ -930,6 +1491,8 @@ LogicalConfirmReceivedLocation(XLogRecPtr lsn)
 		SpinLockAcquire(&slot->mutex);
 
 		slot->data.confirmed_flush = lsn;
+		old_catalog_xmin = slot->effective_catalog_xmin;
+		old_restart_lsn = slot->data.restart_lsn;
 
 		/* if were past the location required for bumping xmin, do so */
 		if (slot->candidate_xmin_lsn != InvalidXLogRecPtr &&
@@ -979,17 +1542,24 @@ LogicalConfirmReceivedLocation(XLogRecPtr lsn)
 		 * Now the new xmin is safely on disk, we can let the global value
 		 * advance. We do not take ProcArrayLock or similar since we only
 		 * advance xmin here and there's not much harm done by a concurrent
-		 * computation missing that.
+		 * computation missing that.  Unless this slot was holding back the
+		 * global values, they don't even need to be recomputed.
 		 */
 		if (updated_xmin)
 		{
+			TransactionId new_catalog_xmin;
+
 			SpinLockAcquire(&slot->mutex);
 			slot->effective_catalog_xmin = slot->data.catalog_xmin;
+			new_catalog_xmin = slot->effective_catalog_xmin;
 			SpinLockRelease(&slot->mutex);
 
-			ReplicationSlotsComputeRequiredXmin(false);
-			ReplicationSlotsComputeRequiredLSN();
+			ReplicationSlotsUpdateRequiredXmin(old_catalog_xmin,
+											   new_catalog_xmin, true);
 		}
+		if (updated_restart)
+			ReplicationSlotsUpdateRequiredLSN(old_restart_lsn,
+											  slot->data.restart_lsn);
 	}
 	else
 	{
@@ -41,6 +41,7 @@
 #include "replication/logical.h"
 #include "replication/logicalfuncs.h"
 
+#include "storage/bufmgr.h"
 #include "storage/fd.h"
 #include "storage/standby.h"
 
@@ -101,6 +102,185 @@ LogicalOutputWrite(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xi
 	p->returned_rows++;
 }
 
+/* GUC */
+int			logical_decoding_readahead = 128;
+
+/*
+ * State of the readahead buffer used by LogicalReadAheadPage(). A backend
+ * only ever decodes using one reader at a time, so a single buffer suffices.
+ */
+static char *readahead_buf = NULL;
+static Size readahead_bufsize = 0;
+static XLogRecPtr readahead_start = InvalidXLogRecPtr;
+static Size readahead_len = 0;
+static XLogRecPtr readahead_valid_upto = InvalidXLogRecPtr;
+static TimeLineID readahead_tli = 0;
+static XLogSegNo readahead_prefetched_seg = 0;
+
+/* counters, see LogicalReadAheadGetStats() */
+static LogicalReadAheadStats readahead_stats;
+
+static void LogicalReadAheadPrefetch(TimeLineID tli, XLogRecPtr startptr,
+						 XLogRecPtr flushptr);
+
+/*
+ * Read the WAL page at targetPagePtr into cur_page, of which at least the
+ * first count bytes are needed, through the readahead buffer.
+ *
+ * Instead of reading WAL one page at a time, read_cb is called to read up to
+ * logical_decoding_readahead bytes of the WAL flushed up to flushptr at
+ * once, and following page requests are served from that buffer. Whenever
+ * reading enters a new segment, the kernel is asked to prefetch the rest of
+ * it, and the next segment if it's already been written, so that a reader
+ * catching up on a lot of WAL doesn't wait for the disk on every read.
+ *
+ * Data beyond flushptr that happened to be read is never used: a request for
+ * it will read the page again.
+ */
+void
+LogicalReadAheadPage(char *cur_page, XLogRecPtr targetPagePtr, Size count,
+					 XLogRecPtr flushptr, TimeLineID tli,
+					 LogicalReadAheadReadCB read_cb)
+{
+	Size		size;
+	XLogRecPtr	endptr;
+	XLogRecPtr	segendptr;
+	XLogSegNo	segno;
+	instr_time	start;
+	instr_time	duration;
+
+	Assert(targetPagePtr % XLOG_BLCKSZ == 0);
+	Assert(count <= XLOG_BLCKSZ);
+
+	/* serve the page from the buffer, if possible */
+	if (readahead_len > 0 &&
+		tli == readahead_tli &&
+		targetPagePtr >= readahead_start &&
+		targetPagePtr + XLOG_BLCKSZ <= readahead_start + readahead_len &&
+		targetPagePtr + count <= readahead_valid_upto)
+	{
+		memcpy(cur_page, readahead_buf + (targetPagePtr - readahead_start),
+			   XLOG_BLCKSZ);
+		return;
+	}
+
+	/* how much to read; never cross a segment boundary */
+	size = (Size) logical_decoding_readahead * 1024;
+	size -= size % XLOG_BLCKSZ;
+	size = Max(size, XLOG_BLCKSZ);
+
+	XLByteToSeg(targetPagePtr, segno);
+	segendptr = (segno + 1) * XLogSegSize;
+
+	endptr = Min(targetPagePtr + size, segendptr);
+	/* and don't read pages that haven't been written yet */
+	if (flushptr % XLOG_BLCKSZ != 0)
+		endptr = Min(endptr, flushptr + XLOG_BLCKSZ - flushptr % XLOG_BLCKSZ);
+	else
+		endptr = Min(endptr, flushptr);
+	endptr = Max(endptr, targetPagePtr + XLOG_BLCKSZ);
+	size = endptr - targetPagePtr;
+
+	if (readahead_bufsize < size)
+	{
+		if (readahead_buf != NULL)
+			pfree(readahead_buf);
+		readahead_buf = MemoryContextAlloc(TopMemoryContext, size);
+		readahead_bufsize = size;
+	}
+
+	/* forget about the buffer's contents, in case reading fails */
+	readahead_len = 0;
+
+	if (segno + 1 > readahead_prefetched_seg || tli != readahead_tli)
+		LogicalReadAheadPrefetch(tli, targetPagePtr, flushptr);
+
+	if (track_io_timing)
+		INSTR_TIME_SET_CURRENT(start);
+
+	read_cb(readahead_buf, tli, targetPagePtr, size);
+
+	if (track_io_timing)
+	{
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+		INSTR_TIME_ADD(readahead_stats.read_time, duration);
+	}
+
+	readahead_stats.reads++;
+	readahead_stats.read_bytes += size;
+
+	readahead_start = targetPagePtr;
+	readahead_len = size;
+	readahead_valid_upto = flushptr;
+	readahead_tli = tli;
+
+	memcpy(cur_page, readahead_buf, XLOG_BLCKSZ);
+}
+
+/*
+ * Ask the kernel to prefetch the part of the segment containing startptr
+ * following it, and the next segment if WAL has been flushed into it, up to
+ * flushptr.
+ */
+static void
+LogicalReadAheadPrefetch(TimeLineID tli, XLogRecPtr startptr,
+						 XLogRecPtr flushptr)
+{
+#if defined(USE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+	XLogSegNo	segno;
+	XLogSegNo	flushsegno;
+	XLogSegNo	lastsegno;
+
+	XLByteToSeg(startptr, segno);
+	XLByteToSeg(flushptr, flushsegno);
+	lastsegno = Min(segno + 1, flushsegno);
+
+	for (; segno <= lastsegno; segno++)
+	{
+		char		path[MAXPGPATH];
+		uint32		startoff;
+		uint32		endoff;
+		int			fd;
+
+		/* already requested earlier */
+		if (segno <= readahead_prefetched_seg && tli == readahead_tli)
+			continue;
+
+		startoff = Max(startptr, segno * XLogSegSize) % XLogSegSize;
+		if (segno == flushsegno)
+			endoff = flushptr % XLogSegSize;
+		else
+			endoff = XLogSegSize;
+
+		if (endoff <= startoff)
+			continue;
+
+		/* failures here don't matter, the actual read will report them */
+		XLogFilePath(path, tli, segno);
+		fd = BasicOpenFile(path, O_RDONLY | PG_BINARY, 0);
+		if (fd < 0)
+			continue;
+
+		(void) posix_fadvise(fd, startoff, endoff - startoff,
+							 POSIX_FADV_WILLNEED);
+		close(fd);
+
+		readahead_stats.prefetches++;
+		readahead_prefetched_seg = segno;
+	}
+#endif
+}
+
+/*
+ * Return the counters of LogicalReadAheadPage() in this backend.
+ */
+void
+LogicalReadAheadGetStats(LogicalReadAheadStats *stats)
+{
+	*stats = readahead_stats;
+}
+
 /*
  * TODO: This is duplicate code with pg_xlogdump, similar to walsender.c, but
  * we currently don't have the infrastructure (elog!) to share it.
@@ -266,7 +446,8 @@ logical_read_local_xlog_page(XLogReaderState *state, XLogRecPtr targetPagePtr,
 	else
 		count = flushptr - targetPagePtr;
 
-	XLogRead(cur_page, *pageTLI, targetPagePtr, XLOG_BLCKSZ);
+	LogicalReadAheadPage(cur_page, targetPagePtr, count, flushptr, *pageTLI,
+						 XLogRead);
 
 	return count;
 }
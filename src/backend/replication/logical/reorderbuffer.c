@@ -32,9 +32,16 @@
  *
  *	  In order to cope with large transactions - which can be several times as
  *	  big as the available memory - this module supports spooling the contents
- *	  of a large transactions to disk. When the transaction is replayed the
- *	  contents of individual (sub-)transactions will be read from disk in
- *	  chunks.
+ *	  of a large transactions to disk. The memory used by all transactions
+ *	  is tracked, and once it exceeds logical_decoding_work_mem the largest
+ *	  transaction is spooled to disk. Spilled changes are written in blocks,
+ *	  optionally compressed (c.f. logical_decoding_spill_compression). When
+ *	  the transaction is replayed the contents of individual
+ *	  (sub-)transactions will be read from disk in chunks. If the output
+ *	  plugin supports it, large transactions are instead streamed to it in
+ *	  blocks of changes while still in progress, so the receiver can start
+ *	  applying them before the commit is decoded (c.f.
+ *	  ReorderBufferStreamTXN()).
  *
  *	  This module also has to deal with reassembling toast records from the
  *	  individual chunks stored in WAL. When a new (or initial) version of a
@@ -50,11 +57,16 @@
 #include <unistd.h>
 #include <sys/stat.h>
 
+#include "access/genam.h"
+#include "access/heapam.h"
 #include "access/rewriteheap.h"
 #include "access/transam.h"
 #include "access/tuptoaster.h"
 #include "access/xact.h"
 #include "catalog/catalog.h"
+#include "catalog/dependency.h"
+#include "catalog/indexing.h"
+#include "catalog/pg_depend.h"
 #include "lib/binaryheap.h"
 #include "miscadmin.h"
 #include "replication/logical.h"
@@ -66,8 +78,10 @@
 #include "storage/sinval.h"
 #include "utils/builtins.h"
 #include "utils/combocid.h"
+#include "utils/fmgroids.h"
 #include "utils/memdebug.h"
 #include "utils/memutils.h"
+#include "utils/pg_lzcompress.h"
 #include "utils/relcache.h"
 #include "utils/relfilenodemap.h"
 #include "utils/tqual.h"
@@ -95,14 +109,24 @@ typedef struct ReorderBufferTupleCidEnt
 	CommandId	combocid;		/* just for debugging */
 } ReorderBufferTupleCidEnt;
 
+/* state of reading back a (sub-)transaction's spill files */
+typedef struct ReorderBufferSpillFile
+{
+	int			fd;				/* currently open segment file, or -1 */
+	XLogSegNo	segno;			/* segment number of that file */
+	char	   *block;			/* changes of the current block, uncompressed */
+	Size		blocksize;		/* allocated size of block */
+	Size		len;			/* valid bytes in block */
+	Size		off;			/* offset of the next change in block */
+} ReorderBufferSpillFile;
+
 /* k-way in-order change iteration support structures */
 typedef struct ReorderBufferIterTXNEntry
 {
 	XLogRecPtr	lsn;
 	ReorderBufferChange *change;
 	ReorderBufferTXN *txn;
-	int			fd;
-	XLogSegNo	segno;
+	ReorderBufferSpillFile file;
 } ReorderBufferIterTXNEntry;
 
 typedef struct ReorderBufferIterTXNState
@@ -121,11 +145,34 @@ typedef struct ReorderBufferToastEnt
 								 * have seen */
 	Size		num_chunks;		/* number of chunks we've already seen */
 	Size		size;			/* combined size of chunks seen */
+	bool		incomplete;		/* some chunks were skipped */
 	dlist_head	chunks;			/* linked list of chunks */
 	struct varlena *reconstructed;		/* reconstructed varlena now pointed
 										 * to in main tup */
 } ReorderBufferToastEnt;
 
+/* relfilenode => relation OID cache, see ReorderBufferOpenRelation */
+typedef struct ReorderBufferRelfilenodeEnt
+{
+	RelFileNode node;			/* lookup key - must be first */
+	Oid			relid;			/* pg_class.oid */
+} ReorderBufferRelfilenodeEnt;
+
+/* entry in rb->catalog_snapshots */
+typedef struct ReorderBufferCatalogSnapshot
+{
+	XLogRecPtr	lsn;			/* LSN of the catalog-modifying commit */
+	Snapshot	snapshot;		/* catalog snapshot as of that commit */
+	dlist_node	node;
+} ReorderBufferCatalogSnapshot;
+
+/* TOAST table => whether its chunks are needed, see toast_filter */
+typedef struct ReorderBufferToastFilterEnt
+{
+	RelFileNode node;			/* the TOAST table's relfilenode */
+	bool		skip;			/* don't keep its chunks */
+} ReorderBufferToastFilterEnt;
+
 /* Disk serialization support datastructures */
 typedef struct ReorderBufferDiskChange
 {
@@ -135,29 +182,36 @@ typedef struct ReorderBufferDiskChange
 } ReorderBufferDiskChange;
 
 /*
- * Maximum number of changes kept in memory, per transaction. After that,
- * changes are spooled to disk.
- *
- * The current value should be sufficient to decode the entire transaction
- * without hitting disk in OLTP workloads, while starting to spool to disk in
- * other workloads reasonably fast.
- *
- * At some point in the future it probaly makes sense to have a more elaborate
- * resource management here, but it's not entirely clear what that would look
- * like.
+ * Spill files consist of blocks of changes, each preceded by this header.
+ * Within a block every change starts at a MAXALIGNed offset.  If the block
+ * is compressed, the data stored on disk is the pglz compressed form of the
+ * block's changes, including its PGLZ_Header.
+ */
+typedef struct ReorderBufferDiskBlock
+{
+	uint32		rawsize;		/* size of the block's changes */
+	uint32		disksize;		/* size of the data stored on disk */
+	bool		compressed;		/* is the data pglz compressed? */
+	/* data follows */
+} ReorderBufferDiskBlock;
+
+/* GUC variables */
+int			logical_decoding_work_mem;
+bool		logical_decoding_spill_compression = false;
+
+/*
+ * Maximum number of changes restored from disk into memory at once, per
+ * transaction. How many changes are kept in memory while decoding is limited
+ * by logical_decoding_work_mem instead.
  */
 static const Size max_changes_in_memory = 4096;
 
 /*
- * We use a very simple form of a slab allocator for frequently allocated
- * objects, simply keeping a fixed number in a linked list when unused,
- * instead pfree()ing them. Without that in many workloads aset.c becomes a
- * major bottleneck, especially when spilling to disk while decoding batch
- * workloads.
+ * Spilled changes are collected in a buffer and written out (and compressed)
+ * once it reaches this size.  Reading them back then takes one read() per
+ * block instead of two per change.
  */
-static const Size max_cached_changes = 4096 * 2;
-static const Size max_cached_tuplebufs = 4096 * 2;		/* ~8MB */
-static const Size max_cached_transactions = 512;
+static const Size spill_block_size = 64 * 1024;
 
 
 /* ---------------------------------------
@@ -169,6 +223,9 @@ static void ReorderBufferReturnTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
 static ReorderBufferTXN *ReorderBufferTXNByXid(ReorderBuffer *rb,
 					  TransactionId xid, bool create, bool *is_new,
 					  XLogRecPtr lsn, bool create_as_top);
+static Size ReorderBufferChangeSize(ReorderBufferChange *change);
+static void ReorderBufferChangeMemoryUpdate(ReorderBuffer *rb,
+								ReorderBufferChange *change, bool addition);
 static void ReorderBufferTransferSnapToParent(ReorderBufferTXN *txn,
 								  ReorderBufferTXN *subtxn);
 
@@ -188,18 +245,37 @@ static ReorderBufferChange *
 static void ReorderBufferIterTXNFinish(ReorderBuffer *rb,
 						   ReorderBufferIterTXNState *state);
 static void ReorderBufferExecuteInvalidations(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static void ReorderBufferProcessTXN(ReorderBuffer *rb, ReorderBufferTXN *txn,
+						XLogRecPtr commit_lsn,
+						volatile Snapshot snapshot_now,
+						volatile CommandId command_id,
+						bool streaming);
+
+/* ---------------------------------------
+ * Streaming support functions
+ * ---------------------------------------
+ */
+static bool ReorderBufferCanStreamTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static void ReorderBufferStreamTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static void ReorderBufferStreamCommit(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static void ReorderBufferTruncateTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
 
 /*
  * ---------------------------------------
  * Disk serialization support functions
  * ---------------------------------------
  */
-static void ReorderBufferCheckSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static ReorderBufferTXN *ReorderBufferLargestTXN(ReorderBuffer *rb);
+static void ReorderBufferCheckMemoryLimit(ReorderBuffer *rb, bool allow_stream);
 static void ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
 static void ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 							 int fd, ReorderBufferChange *change);
+static void ReorderBufferSerializeFlush(ReorderBuffer *rb, ReorderBufferTXN *txn,
+							int fd);
 static Size ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
-							int *fd, XLogSegNo *segno);
+							ReorderBufferSpillFile *file);
+static bool ReorderBufferRestoreBlock(ReorderBuffer *rb, ReorderBufferTXN *txn,
+						  ReorderBufferSpillFile *file);
 static void ReorderBufferRestoreChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 						   char *change);
 static void ReorderBufferRestoreCleanup(ReorderBuffer *rb, ReorderBufferTXN *txn);
@@ -208,6 +284,17 @@ static void ReorderBufferSerializedPath(char *path, ReplicationSlot *slot,
 							TransactionId xid, XLogSegNo segno);
 
 static void ReorderBufferFreeSnap(ReorderBuffer *rb, Snapshot snap);
+static Snapshot ReorderBufferSwitchSnapshot(ReorderBuffer *rb,
+							ReorderBufferTXN *txn, Snapshot snapshot_now,
+							Snapshot new_snap, CommandId command_id);
+static ReorderBufferCatalogSnapshot *ReorderBufferNextCatalogSnapshot(
+								 ReorderBuffer *rb,
+								 ReorderBufferCatalogSnapshot *prev,
+								 XLogRecPtr lsn);
+static Relation ReorderBufferOpenRelation(ReorderBuffer *rb, RelFileNode *rnode,
+						  Oid *relid);
+static void ReorderBufferInvalidationKey(const SharedInvalidationMessage *msg,
+							 SharedInvalidationMessage *key);
 static Snapshot ReorderBufferCopySnap(ReorderBuffer *rb, Snapshot orig_snap,
 					  ReorderBufferTXN *txn, CommandId cid);
 
@@ -221,6 +308,10 @@ static void ReorderBufferToastReplace(ReorderBuffer *rb, ReorderBufferTXN *txn,
 						  Relation relation, ReorderBufferChange *change);
 static void ReorderBufferToastAppendChunk(ReorderBuffer *rb, ReorderBufferTXN *txn,
 							  Relation relation, ReorderBufferChange *change);
+static bool ReorderBufferToastSkipRelation(ReorderBuffer *rb, Relation relation);
+static void ReorderBufferToastSkipChunk(ReorderBuffer *rb, ReorderBufferTXN *txn,
+							Relation relation, ReorderBufferChange *change);
+static Oid	ReorderBufferToastOwner(Oid toastrelid);
 
 
 /*
@@ -250,6 +341,26 @@ ReorderBufferAllocate(void)
 
 	buffer->context = new_ctx;
 
+	/*
+	 * Changes and transactions are fixed-size and very frequently allocated
+	 * and freed, so use slab contexts for them.  Tuples vary in size, but are
+	 * mostly freed in roughly the order they were allocated, which is what
+	 * generation contexts are good at.
+	 */
+	buffer->change_context = SlabContextCreate(new_ctx,
+											   "Change",
+											   SLAB_DEFAULT_BLOCK_SIZE,
+											   sizeof(ReorderBufferChange));
+
+	buffer->txn_context = SlabContextCreate(new_ctx,
+											"TXN",
+											SLAB_DEFAULT_BLOCK_SIZE,
+											sizeof(ReorderBufferTXN));
+
+	buffer->tup_context = GenerationContextCreate(new_ctx,
+												  "Tuples",
+												  SLAB_LARGE_BLOCK_SIZE);
+
 	hash_ctl.keysize = sizeof(TransactionId);
 	hash_ctl.entrysize = sizeof(ReorderBufferTXNByIdEnt);
 	hash_ctl.hash = tag_hash;
@@ -261,20 +372,34 @@ ReorderBufferAllocate(void)
 	buffer->by_txn_last_xid = InvalidTransactionId;
 	buffer->by_txn_last_txn = NULL;
 
-	buffer->nr_cached_transactions = 0;
-	buffer->nr_cached_changes = 0;
-	buffer->nr_cached_tuplebufs = 0;
-
 	buffer->outbuf = NULL;
 	buffer->outbufsize = 0;
 
+	buffer->spillbuf = NULL;
+	buffer->spillbufsize = 0;
+	buffer->spillbuflen = 0;
+
+	buffer->size = 0;
+
+	buffer->spillTxns = 0;
+	buffer->spillCount = 0;
+	buffer->spillBytes = 0;
+	buffer->spillDiskBytes = 0;
+
+	buffer->relfilenode_cache = NULL;
+	buffer->relCacheHits = 0;
+	buffer->relCacheMisses = 0;
+
 	buffer->current_restart_decoding_lsn = InvalidXLogRecPtr;
 
+	buffer->skip_toast_reassembly = false;
+	buffer->filter_relation = NULL;
+	buffer->toast_chunks_dropped = false;
+	buffer->toast_filter = NULL;
+
 	dlist_init(&buffer->toplevel_by_lsn);
 	dlist_init(&buffer->txns_by_base_snapshot_lsn);
-	dlist_init(&buffer->cached_transactions);
-	dlist_init(&buffer->cached_changes);
-	slist_init(&buffer->cached_tuplebufs);
+	dlist_init(&buffer->catalog_snapshots);
 
 	/*
 	 * Ensure there's no stale data from prior uses of this slot, in case some
@@ -305,26 +430,15 @@ ReorderBufferFree(ReorderBuffer *rb)
 }
 
 /*
- * Get a unused, possibly preallocated, ReorderBufferTXN.
+ * Get an unused ReorderBufferTXN.
  */
 static ReorderBufferTXN *
 ReorderBufferGetTXN(ReorderBuffer *rb)
 {
 	ReorderBufferTXN *txn;
 
-	/* check the slab cache */
-	if (rb->nr_cached_transactions > 0)
-	{
-		rb->nr_cached_transactions--;
-		txn = (ReorderBufferTXN *)
-			dlist_container(ReorderBufferTXN, node,
-							dlist_pop_head_node(&rb->cached_transactions));
-	}
-	else
-	{
-		txn = (ReorderBufferTXN *)
-			MemoryContextAlloc(rb->context, sizeof(ReorderBufferTXN));
-	}
+	txn = (ReorderBufferTXN *)
+		MemoryContextAlloc(rb->txn_context, sizeof(ReorderBufferTXN));
 
 	memset(txn, 0, sizeof(ReorderBufferTXN));
 
@@ -337,9 +451,6 @@ ReorderBufferGetTXN(ReorderBuffer *rb)
 
 /*
  * Free a ReorderBufferTXN.
- *
- * Deallocation might be delayed for efficiency purposes, for details check
- * the comments above max_cached_changes's definition.
  */
 static void
 ReorderBufferReturnTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
@@ -365,41 +476,19 @@ ReorderBufferReturnTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
 		txn->invalidations = NULL;
 	}
 
-	/* check whether to put into the slab cache */
-	if (rb->nr_cached_transactions < max_cached_transactions)
-	{
-		rb->nr_cached_transactions++;
-		dlist_push_head(&rb->cached_transactions, &txn->node);
-		VALGRIND_MAKE_MEM_UNDEFINED(txn, sizeof(ReorderBufferTXN));
-		VALGRIND_MAKE_MEM_DEFINED(&txn->node, sizeof(txn->node));
-	}
-	else
-	{
-		pfree(txn);
-	}
+	pfree(txn);
 }
 
 /*
- * Get a unused, possibly preallocated, ReorderBufferChange.
+ * Get an unused ReorderBufferChange.
  */
 ReorderBufferChange *
 ReorderBufferGetChange(ReorderBuffer *rb)
 {
 	ReorderBufferChange *change;
 
-	/* check the slab cache */
-	if (rb->nr_cached_changes)
-	{
-		rb->nr_cached_changes--;
-		change = (ReorderBufferChange *)
-			dlist_container(ReorderBufferChange, node,
-							dlist_pop_head_node(&rb->cached_changes));
-	}
-	else
-	{
-		change = (ReorderBufferChange *)
-			MemoryContextAlloc(rb->context, sizeof(ReorderBufferChange));
-	}
+	change = (ReorderBufferChange *)
+		MemoryContextAlloc(rb->change_context, sizeof(ReorderBufferChange));
 
 	memset(change, 0, sizeof(ReorderBufferChange));
 	return change;
@@ -407,13 +496,14 @@ ReorderBufferGetChange(ReorderBuffer *rb)
 
 /*
  * Free an ReorderBufferChange.
- *
- * Deallocation might be delayed for efficiency purposes, for details check
- * the comments above max_cached_changes's definition.
  */
 void
 ReorderBufferReturnChange(ReorderBuffer *rb, ReorderBufferChange *change)
 {
+	/* update memory accounting info */
+	if (change->txn != NULL)
+		ReorderBufferChangeMemoryUpdate(rb, change, false);
+
 	/* free contained data */
 	switch (change->action)
 	{
@@ -450,24 +540,13 @@ ReorderBufferReturnChange(ReorderBuffer *rb, ReorderBufferChange *change)
 			break;
 	}
 
-	/* check whether to put into the slab cache */
-	if (rb->nr_cached_changes < max_cached_changes)
-	{
-		rb->nr_cached_changes++;
-		dlist_push_head(&rb->cached_changes, &change->node);
-		VALGRIND_MAKE_MEM_UNDEFINED(change, sizeof(ReorderBufferChange));
-		VALGRIND_MAKE_MEM_DEFINED(&change->node, sizeof(change->node));
-	}
-	else
-	{
-		pfree(change);
-	}
+	pfree(change);
 }
 
 
 /*
- * Get an unused, possibly preallocated, ReorderBufferTupleBuf fitting at
- * least a tuple of size tuple_len (excluding header overhead).
+ * Get a ReorderBufferTupleBuf fitting at least a tuple of size tuple_len
+ * (excluding header overhead).
  */
 ReorderBufferTupleBuf *
 ReorderBufferGetTupleBuf(ReorderBuffer *rb, Size tuple_len)
@@ -477,70 +556,23 @@ ReorderBufferGetTupleBuf(ReorderBuffer *rb, Size tuple_len)
 
 	alloc_len = tuple_len + offsetof(HeapTupleHeaderData, t_bits);
 
-	/*
-	 * Most tuples are below MaxHeapTupleSize, so we use a slab allocator for
-	 * those. Thus always allocate at least MaxHeapTupleSize. Note that tuples
-	 * tuples generated for oldtuples can be bigger, as they don't have
-	 * out-of-line toast columns.
-	 */
-	if (alloc_len < MaxHeapTupleSize)
-		alloc_len = MaxHeapTupleSize;
-
-
-	/* if small enough, check the slab cache */
-	if (alloc_len <= MaxHeapTupleSize && rb->nr_cached_tuplebufs)
-	{
-		rb->nr_cached_tuplebufs--;
-		tuple = slist_container(ReorderBufferTupleBuf, node,
-								slist_pop_head_node(&rb->cached_tuplebufs));
-		Assert(tuple->alloc_tuple_size == MaxHeapTupleSize);
-#ifdef USE_ASSERT_CHECKING
-		memset(&tuple->tuple, 0xa9, sizeof(HeapTupleData));
-		VALGRIND_MAKE_MEM_UNDEFINED(&tuple->tuple, sizeof(HeapTupleData));
-#endif
-		tuple->tuple.t_data = ReorderBufferTupleBufData(tuple);
-#ifdef USE_ASSERT_CHECKING
-		memset(tuple->tuple.t_data, 0xa8, tuple->alloc_tuple_size);
-		VALGRIND_MAKE_MEM_UNDEFINED(tuple->tuple.t_data, tuple->alloc_tuple_size);
-#endif
-	}
-	else
-	{
-		tuple = (ReorderBufferTupleBuf *)
-			MemoryContextAlloc(rb->context,
-							   sizeof(ReorderBufferTupleBuf) +
-							   MAXIMUM_ALIGNOF + alloc_len);
-		tuple->alloc_tuple_size = alloc_len;
-		tuple->tuple.t_data = ReorderBufferTupleBufData(tuple);
-	}
+	tuple = (ReorderBufferTupleBuf *)
+		MemoryContextAlloc(rb->tup_context,
+						   sizeof(ReorderBufferTupleBuf) +
+						   MAXIMUM_ALIGNOF + alloc_len);
+	tuple->alloc_tuple_size = alloc_len;
+	tuple->tuple.t_data = ReorderBufferTupleBufData(tuple);
 
 	return tuple;
 }
 
 /*
  * Free an ReorderBufferTupleBuf.
- *
- * Deallocation might be delayed for efficiency purposes, for details check
- * the comments above max_cached_changes's definition.
  */
 void
 ReorderBufferReturnTupleBuf(ReorderBuffer *rb, ReorderBufferTupleBuf *tuple)
 {
-	/* check whether to put into the slab cache, oversized tuples never are */
-	if (tuple->alloc_tuple_size == MaxHeapTupleSize &&
-		rb->nr_cached_tuplebufs < max_cached_tuplebufs)
-	{
-		rb->nr_cached_tuplebufs++;
-		slist_push_head(&rb->cached_tuplebufs, &tuple->node);
-		VALGRIND_MAKE_MEM_UNDEFINED(tuple->tuple.t_data, tuple->alloc_tuple_size);
-		VALGRIND_MAKE_MEM_UNDEFINED(tuple, sizeof(ReorderBufferTupleBuf));
-		VALGRIND_MAKE_MEM_DEFINED(&tuple->node, sizeof(tuple->node));
-		VALGRIND_MAKE_MEM_DEFINED(&tuple->alloc_tuple_size, sizeof(tuple->alloc_tuple_size));
-	}
-	else
-	{
-		pfree(tuple);
-	}
+	pfree(tuple);
 }
 
 /*
@@ -641,12 +673,27 @@ ReorderBufferQueueChange(ReorderBuffer *rb, TransactionId xid, XLogRecPtr lsn,
 	txn = ReorderBufferTXNByXid(rb, xid, true, NULL, lsn, true);
 
 	change->lsn = lsn;
+	change->txn = txn;
 	Assert(InvalidXLogRecPtr != lsn);
 	dlist_push_tail(&txn->changes, &change->node);
 	txn->nentries++;
 	txn->nentries_mem++;
 
-	ReorderBufferCheckSerializeTXN(rb, txn);
+	/* update memory accounting information */
+	ReorderBufferChangeMemoryUpdate(rb, change, true);
+
+	/*
+	 * Only consider streaming transactions when a data change is
+	 * queued. Internal changes are also queued while processing other
+	 * transactions' commit records (c.f. SnapBuildDistributeNewCatalogSnapshot),
+	 * before the invalidations of the committing transaction have been
+	 * executed.
+	 */
+	ReorderBufferCheckMemoryLimit(rb,
+						change->action == REORDER_BUFFER_CHANGE_INSERT ||
+						change->action == REORDER_BUFFER_CHANGE_UPDATE ||
+						change->action == REORDER_BUFFER_CHANGE_DELETE ||
+						change->action == REORDER_BUFFER_CHANGE_MESSAGE);
 }
 
 void
@@ -820,6 +867,16 @@ ReorderBufferAssignChild(ReorderBuffer *rb, TransactionId xid,
 			/* already associated, nothing to do */
 			return;
 		}
+		else if (subtxn->streamed)
+		{
+			/*
+			 * Subtransactions are assigned to their toplevel transaction
+			 * before their first change is logged when wal_level=logical,
+			 * so this can't happen unless the WAL was written otherwise.
+			 */
+			elog(ERROR, "subtransaction %u has been streamed as a toplevel transaction",
+				 subxid);
+		}
 		else
 		{
 			/*
@@ -1020,8 +1077,8 @@ ReorderBufferIterTXNInit(ReorderBuffer *rb, ReorderBufferTXN *txn)
 
 	for (off = 0; off < state->nr_txns; off++)
 	{
-		state->entries[off].fd = -1;
-		state->entries[off].segno = 0;
+		state->entries[off].file.fd = -1;
+		state->entries[off].file.segno = 0;
 	}
 
 	/* allocate heap */
@@ -1045,8 +1102,7 @@ ReorderBufferIterTXNInit(ReorderBuffer *rb, ReorderBufferTXN *txn)
 		{
 			/* serialize remaining changes */
 			ReorderBufferSerializeTXN(rb, txn);
-			ReorderBufferRestoreChanges(rb, txn, &state->entries[off].fd,
-										&state->entries[off].segno);
+			ReorderBufferRestoreChanges(rb, txn, &state->entries[off].file);
 		}
 
 		cur_change = dlist_head_element(ReorderBufferChange, node,
@@ -1075,8 +1131,7 @@ ReorderBufferIterTXNInit(ReorderBuffer *rb, ReorderBufferTXN *txn)
 				/* serialize remaining changes */
 				ReorderBufferSerializeTXN(rb, cur_txn);
 				ReorderBufferRestoreChanges(rb, cur_txn,
-											&state->entries[off].fd,
-											&state->entries[off].segno);
+											&state->entries[off].file);
 			}
 			cur_change = dlist_head_element(ReorderBufferChange, node,
 											&cur_txn->changes);
@@ -1156,8 +1211,7 @@ ReorderBufferIterTXNNext(ReorderBuffer *rb, ReorderBufferIterTXNState *state)
 		dlist_delete(&change->node);
 		dlist_push_tail(&state->old_change, &change->node);
 
-		if (ReorderBufferRestoreChanges(rb, entry->txn, &entry->fd,
-										&state->entries[off].segno))
+		if (ReorderBufferRestoreChanges(rb, entry->txn, &entry->file))
 		{
 			/* successfully restored changes from disk */
 			ReorderBufferChange *next_change =
@@ -1195,8 +1249,10 @@ ReorderBufferIterTXNFinish(ReorderBuffer *rb,
 
 	for (off = 0; off < state->nr_txns; off++)
 	{
-		if (state->entries[off].fd != -1)
-			CloseTransientFile(state->entries[off].fd);
+		if (state->entries[off].file.fd != -1)
+			CloseTransientFile(state->entries[off].file.fd);
+		if (state->entries[off].file.block != NULL)
+			pfree(state->entries[off].file.block);
 	}
 
 	/* free memory we might have "leaked" in the last *Next call */
@@ -1274,6 +1330,18 @@ ReorderBufferCleanupTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
 		dlist_delete(&txn->base_snapshot_node);
 	}
 
+	/*
+	 * Cleanup the state kept between stream blocks of a streamed
+	 * transaction: its current snapshot, and toast chunks that were still
+	 * waiting for the tuple referencing them.
+	 */
+	if (txn->snapshot_now != NULL)
+	{
+		ReorderBufferFreeSnap(rb, txn->snapshot_now);
+		txn->snapshot_now = NULL;
+	}
+	ReorderBufferToastReset(rb, txn);
+
 	/* delete from list of known subxacts */
 	if (txn->is_known_as_subxact)
 	{
@@ -1453,60 +1521,191 @@ ReorderBufferFreeSnap(ReorderBuffer *rb, Snapshot snap)
 }
 
 /*
- * Perform the replay of a transaction and its non-aborted subtransactions.
- *
- * Subtransactions previously have to be processed by
- * ReorderBufferCommitChild(), even if previously assigned to the toplevel
- * transaction with ReorderBufferAssignChild.
+ * Switch the historic snapshot used for replaying txn from snapshot_now to
+ * new_snap, keeping the current CommandId, and return the one to use.
+ */
+static Snapshot
+ReorderBufferSwitchSnapshot(ReorderBuffer *rb, ReorderBufferTXN *txn,
+							Snapshot snapshot_now, Snapshot new_snap,
+							CommandId command_id)
+{
+	/* get rid of the old */
+	TeardownHistoricSnapshot(false);
+
+	if (snapshot_now->copied)
+	{
+		ReorderBufferFreeSnap(rb, snapshot_now);
+		snapshot_now = ReorderBufferCopySnap(rb, new_snap, txn, command_id);
+	}
+
+	/*
+	 * Restored from disk, need to be careful not to double free. We could
+	 * introduce refcounting for that, but for now this seems infrequent
+	 * enough not to care.
+	 */
+	else if (new_snap->copied)
+	{
+		snapshot_now = ReorderBufferCopySnap(rb, new_snap, txn, command_id);
+	}
+	else
+	{
+		snapshot_now = new_snap;
+	}
+
+	/* and continue with the new one */
+	SetupHistoricSnapshot(snapshot_now, txn->tuplecid_hash);
+
+	return snapshot_now;
+}
+
+/*
+ * Return the first catalog snapshot after prev, or after the start of
+ * rb->catalog_snapshots if prev is NULL, that was built after lsn.
+ */
+static ReorderBufferCatalogSnapshot *
+ReorderBufferNextCatalogSnapshot(ReorderBuffer *rb,
+								 ReorderBufferCatalogSnapshot *prev,
+								 XLogRecPtr lsn)
+{
+	dlist_node *node;
+
+	if (prev == NULL)
+	{
+		if (dlist_is_empty(&rb->catalog_snapshots))
+			return NULL;
+		node = dlist_head_node(&rb->catalog_snapshots);
+	}
+	else if (dlist_has_next(&rb->catalog_snapshots, &prev->node))
+		node = dlist_next_node(&rb->catalog_snapshots, &prev->node);
+	else
+		return NULL;
+
+	for (;;)
+	{
+		ReorderBufferCatalogSnapshot *snap;
+
+		snap = dlist_container(ReorderBufferCatalogSnapshot, node, node);
+		if (snap->lsn > lsn)
+			return snap;
+
+		if (!dlist_has_next(&rb->catalog_snapshots, node))
+			return NULL;
+		node = dlist_next_node(&rb->catalog_snapshots, node);
+	}
+}
+
+/*
+ * Open the relation stored in rnode, as seen by the current historic
+ * snapshot, and return its OID in *relid. Returns NULL, and InvalidOid in
+ * *relid, if no relation is stored there.
  *
- * We currently can only decode a transaction's contents when its commit
- * record is read because that's the only place where we know about cache
- * invalidations. Thus, once a toplevel commit is read, we iterate over the top
- * and subtransactions (using a k-way merge) and replay the changes in lsn
- * order.
+ * The OIDs of relations found before are remembered in
+ * rb->relfilenode_cache. Its entries aren't flushed by invalidations, like
+ * those of RelidByRelfilenode()'s cache are, but validated against the
+ * descriptor of the relation, which needs to be opened anyway. So after DDL
+ * only the relations whose relfilenode actually changed have to be looked up
+ * in the catalog again.
  */
-void
-ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
-					XLogRecPtr commit_lsn, XLogRecPtr end_lsn,
-					TimestampTz commit_time,
-					RepNodeId origin_id, XLogRecPtr origin_lsn)
+static Relation
+ReorderBufferOpenRelation(ReorderBuffer *rb, RelFileNode *rnode, Oid *relid)
 {
-	ReorderBufferTXN *txn;
-	volatile Snapshot snapshot_now;
-	volatile CommandId command_id = FirstCommandId;
-	bool		using_subtxn;
-	ReorderBufferIterTXNState *volatile iterstate = NULL;
+	ReorderBufferRelfilenodeEnt *ent;
+	Relation	relation;
+	bool		found;
 
-	txn = ReorderBufferTXNByXid(rb, xid, false, NULL, InvalidXLogRecPtr,
-								false);
+	if (rb->relfilenode_cache == NULL)
+	{
+		HASHCTL		hash_ctl;
+
+		memset(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(RelFileNode);
+		hash_ctl.entrysize = sizeof(ReorderBufferRelfilenodeEnt);
+		hash_ctl.hash = tag_hash;
+		hash_ctl.hcxt = rb->context;
+		rb->relfilenode_cache = hash_create("ReorderBufferRelfilenodeCache",
+											64, &hash_ctl,
+											HASH_ELEM | HASH_FUNCTION |
+											HASH_CONTEXT);
+	}
 
-	/* unknown transaction, nothing to replay */
-	if (txn == NULL)
-		return;
+	ent = (ReorderBufferRelfilenodeEnt *)
+		hash_search(rb->relfilenode_cache, (void *) rnode, HASH_FIND, NULL);
 
-	txn->final_lsn = commit_lsn;
-	txn->end_lsn = end_lsn;
-	txn->commit_time = commit_time;
-	txn->origin_id = origin_id;
-	txn->origin_lsn = origin_lsn;
+	if (ent != NULL)
+	{
+		relation = RelationIdGetRelation(ent->relid);
 
-	/*
-	 * If this transaction has no snapshot, it didn't make any changes to the
-	 * database, so there's nothing to decode.  Note that
-	 * ReorderBufferCommitChild will have transferred any snapshots from
-	 * subtransactions if there were any.
-	 */
-	if (txn->base_snapshot == NULL)
+		if (relation != NULL && RelFileNodeEquals(relation->rd_node, *rnode))
+		{
+			rb->relCacheHits++;
+			*relid = ent->relid;
+			return relation;
+		}
+
+		/* the relation has been dropped or rewritten since */
+		if (relation != NULL)
+			RelationClose(relation);
+	}
+
+	rb->relCacheMisses++;
+
+	*relid = RelidByRelfilenode(rnode->spcNode, rnode->relNode);
+
+	if (!OidIsValid(*relid))
 	{
-		Assert(txn->ninvalidations == 0);
-		ReorderBufferCleanupTXN(rb, txn);
-		return;
+		if (ent != NULL)
+			hash_search(rb->relfilenode_cache, (void *) rnode, HASH_REMOVE,
+						NULL);
+		return NULL;
+	}
+
+	relation = RelationIdGetRelation(*relid);
+
+	if (relation != NULL)
+	{
+		ent = (ReorderBufferRelfilenodeEnt *)
+			hash_search(rb->relfilenode_cache, (void *) rnode, HASH_ENTER,
+						&found);
+		ent->relid = *relid;
 	}
 
-	snapshot_now = txn->base_snapshot;
+	return relation;
+}
+
+/*
+ * Replay the changes of a transaction and its non-aborted subtransactions,
+ * starting with the snapshot and CommandId passed in.
+ *
+ * If streaming is false, this is the replay of a committed transaction: the
+ * changes are passed to the begin/change/commit callbacks, and the caller is
+ * responsible for cleaning up the transaction afterwards.
+ *
+ * If streaming is true, the changes currently queued are sent as a single
+ * stream block, enclosed by the stream_start/stream_stop callbacks. The
+ * snapshot and CommandId the block ended with are remembered in the
+ * transaction, so that the next block can continue from there.
+ */
+static void
+ReorderBufferProcessTXN(ReorderBuffer *rb, ReorderBufferTXN *txn,
+						XLogRecPtr commit_lsn,
+						volatile Snapshot snapshot_now,
+						volatile CommandId command_id,
+						bool streaming)
+{
+	bool		using_subtxn;
+	ReorderBufferIterTXNState *volatile iterstate = NULL;
+	ReorderBufferCatalogSnapshot *next_snap;
+	XLogRecPtr	snapshot_lsn;
+
+	/* LSN of the catalog snapshot we start with */
+	if (streaming && txn->snapshot_now != NULL)
+		snapshot_lsn = txn->snapshot_lsn;
+	else
+		snapshot_lsn = txn->base_snapshot_lsn;
 
 	/* build data to be able to lookup the CommandIds of catalog tuples */
-	ReorderBufferBuildTupleCidHash(rb, txn);
+	if (txn->tuplecid_hash == NULL)
+		ReorderBufferBuildTupleCidHash(rb, txn);
 
 	/* setup the initial snapshot */
 	SetupHistoricSnapshot(snapshot_now, txn->tuplecid_hash);
@@ -1528,11 +1727,20 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 		ReorderBufferChange *change;
 
 		if (using_subtxn)
-			BeginInternalSubTransaction("replay");
+			BeginInternalSubTransaction(streaming ? "stream" : "replay");
 		else
 			StartTransactionCommand();
 
-		rb->begin(rb, txn);
+		if (streaming)
+			rb->stream_start(rb, txn);
+		else
+			rb->begin(rb, txn);
+
+		/*
+		 * Catalog snapshots built after the one we start with are not queued
+		 * as changes, but looked up in rb->catalog_snapshots as we go.
+		 */
+		next_snap = ReorderBufferNextCatalogSnapshot(rb, NULL, snapshot_lsn);
 
 		iterstate = ReorderBufferIterTXNInit(rb, txn);
 		while ((change = ReorderBufferIterTXNNext(rb, iterstate)) != NULL)
@@ -1540,6 +1748,17 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 			Relation	relation = NULL;
 			Oid			reloid;
 
+			while (next_snap != NULL && next_snap->lsn < change->lsn)
+			{
+				snapshot_now =
+					ReorderBufferSwitchSnapshot(rb, txn, snapshot_now,
+												next_snap->snapshot,
+												command_id);
+				snapshot_lsn = next_snap->lsn;
+				next_snap = ReorderBufferNextCatalogSnapshot(rb, next_snap,
+															 snapshot_lsn);
+			}
+
 			switch (change->action)
 			{
 				case REORDER_BUFFER_CHANGE_INSERT:
@@ -1547,8 +1766,9 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 				case REORDER_BUFFER_CHANGE_DELETE:
 					Assert(snapshot_now);
 
-					reloid = RelidByRelfilenode(change->data.tp.relnode.spcNode,
-											change->data.tp.relnode.relNode);
+					relation = ReorderBufferOpenRelation(rb,
+												&change->data.tp.relnode,
+														 &reloid);
 
 					/*
 					 * Mapped catalog tuple without data, emitted while
@@ -1571,8 +1791,6 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 							 relpathperm(change->data.tp.relnode,
 										 MAIN_FORKNUM));
 
-					relation = RelationIdGetRelation(reloid);
-
 					if (relation == NULL)
 						elog(ERROR, "could not open relation with OID %u (for filenode \"%s\")",
 							 reloid,
@@ -1594,7 +1812,13 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 						else if (!IsToastRelation(relation))
 						{
 							ReorderBufferToastReplace(rb, txn, relation, change);
-							rb->apply_change(rb, txn, relation, change);
+							if (streaming)
+								rb->stream_change(rb, txn, relation, change);
+							else
+								rb->apply_change(rb, txn, relation, change);
+
+							bms_free(change->data.tp.toast_skipped);
+							change->data.tp.toast_skipped = NULL;
 
 							/*
 							 * Only clear reassembled toast chunks if we're
@@ -1617,11 +1841,21 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 							 *
 							 * But skip doing so if there's no
 							 * tuple-data. That happens if a non-mapped system
-							 * catalog with a toast table is rewritten.
+							 * catalog with a toast table is rewritten. Chunks
+							 * the output plugin doesn't need are only
+							 * remembered as skipped.
 							 */
-							if (change->data.tp.newtuple != NULL)
+							if (change->data.tp.newtuple == NULL)
+								 /* nothing to reassemble */ ;
+							else if (ReorderBufferToastSkipRelation(rb, relation))
+								ReorderBufferToastSkipChunk(rb, txn, relation,
+															change);
+							else
 							{
 								dlist_delete(&change->node);
+								if (change->txn != NULL)
+									ReorderBufferChangeMemoryUpdate(rb, change,
+																	false);
 								ReorderBufferToastAppendChunk(rb, txn, relation,
 															  change);
 							}
@@ -1631,42 +1865,22 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 					RelationClose(relation);
 					break;
 				case REORDER_BUFFER_CHANGE_MESSAGE:
-					rb->message(rb, txn, change->lsn,
-								change->data.msg.transactional,
-								change->data.msg.sz,
-								change->data.msg.message);
+					if (streaming)
+						rb->stream_message(rb, txn, change->lsn,
+										   change->data.msg.transactional,
+										   change->data.msg.sz,
+										   change->data.msg.message);
+					else
+						rb->message(rb, txn, change->lsn,
+									change->data.msg.transactional,
+									change->data.msg.sz,
+									change->data.msg.message);
 					break;
 				case REORDER_BUFFER_CHANGE_INTERNAL_SNAPSHOT:
-					/* get rid of the old */
-					TeardownHistoricSnapshot(false);
-
-					if (snapshot_now->copied)
-					{
-						ReorderBufferFreeSnap(rb, snapshot_now);
-						snapshot_now =
-							ReorderBufferCopySnap(rb, change->data.snapshot,
-												  txn, command_id);
-					}
-
-					/*
-					 * Restored from disk, need to be careful not to double
-					 * free. We could introduce refcounting for that, but for
-					 * now this seems infrequent enough not to care.
-					 */
-					else if (change->data.snapshot->copied)
-					{
-						snapshot_now =
-							ReorderBufferCopySnap(rb, change->data.snapshot,
-												  txn, command_id);
-					}
-					else
-					{
-						snapshot_now = change->data.snapshot;
-					}
-
-
-					/* and continue with the new one */
-					SetupHistoricSnapshot(snapshot_now, txn->tuplecid_hash);
+					snapshot_now =
+						ReorderBufferSwitchSnapshot(rb, txn, snapshot_now,
+													change->data.snapshot,
+													command_id);
 					break;
 
 				case REORDER_BUFFER_CHANGE_INTERNAL_COMMAND_ID:
@@ -1708,8 +1922,11 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 		ReorderBufferIterTXNFinish(rb, iterstate);
 		iterstate = NULL;
 
-		/* call commit callback */
-		rb->commit(rb, txn, commit_lsn);
+		/* call commit or stream stop callback */
+		if (streaming)
+			rb->stream_stop(rb, txn);
+		else
+			rb->commit(rb, txn, commit_lsn);
 
 		/* this is just a sanity check against bad output plugin behaviour */
 		if (GetCurrentTransactionIdIfAny() != InvalidTransactionId)
@@ -1733,11 +1950,18 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 		if (using_subtxn)
 			RollbackAndReleaseCurrentSubTransaction();
 
-		if (snapshot_now->copied)
+		if (streaming)
+		{
+			/* remember where the next stream block has to continue */
+			Assert(snapshot_now->copied);
+			if (txn->snapshot_now != NULL)
+				ReorderBufferFreeSnap(rb, txn->snapshot_now);
+			txn->snapshot_now = snapshot_now;
+			txn->command_id = command_id;
+			txn->snapshot_lsn = snapshot_lsn;
+		}
+		else if (snapshot_now->copied)
 			ReorderBufferFreeSnap(rb, snapshot_now);
-
-		/* remove potential on-disk data, and deallocate */
-		ReorderBufferCleanupTXN(rb, txn);
 	}
 	PG_CATCH();
 	{
@@ -1759,11 +1983,16 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 		if (using_subtxn)
 			RollbackAndReleaseCurrentSubTransaction();
 
-		if (snapshot_now->copied)
+		if (snapshot_now->copied && snapshot_now != txn->snapshot_now)
 			ReorderBufferFreeSnap(rb, snapshot_now);
 
-		/* remove potential on-disk data, and deallocate */
-		ReorderBufferCleanupTXN(rb, txn);
+		/*
+		 * Remove potential on-disk data, and deallocate. A transaction that is
+		 * being streamed is still referenced by later WAL records, so leave it
+		 * to the teardown of the decoding context.
+		 */
+		if (!streaming)
+			ReorderBufferCleanupTXN(rb, txn);
 
 		PG_RE_THROW();
 	}
@@ -1771,35 +2000,101 @@ ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
 }
 
 /*
- * Abort a transaction that possibly has previous changes. Needs to be first
- * called for subtransactions and then for the toplevel xid.
+ * Perform the replay of a transaction and its non-aborted subtransactions.
  *
- * NB: Transactions handled here have to have actively aborted (i.e. have
- * produced an abort record). Implicitly aborted transactions are handled via
- * ReorderBufferAbortOld(); transactions we're just not interested in, but
- * which have committed are handled in ReorderBufferForget().
+ * Subtransactions previously have to be processed by
+ * ReorderBufferCommitChild(), even if previously assigned to the toplevel
+ * transaction with ReorderBufferAssignChild.
  *
- * This function purges this transaction and its contents from memory and
- * disk.
+ * We currently can only decode a transaction's contents when its commit
+ * record is read because that's the only place where we know about cache
+ * invalidations. Thus, once a toplevel commit is read, we iterate over the top
+ * and subtransactions (using a k-way merge) and replay the changes in lsn
+ * order. The exception are transactions which have already been partially
+ * streamed to the output plugin, c.f. ReorderBufferStreamTXN().
  */
 void
-ReorderBufferAbort(ReorderBuffer *rb, TransactionId xid, XLogRecPtr lsn)
+ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
+					XLogRecPtr commit_lsn, XLogRecPtr end_lsn,
+					TimestampTz commit_time,
+					RepNodeId origin_id, XLogRecPtr origin_lsn)
 {
 	ReorderBufferTXN *txn;
 
 	txn = ReorderBufferTXNByXid(rb, xid, false, NULL, InvalidXLogRecPtr,
 								false);
 
-	/* unknown, nothing to remove */
+	/* unknown transaction, nothing to replay */
 	if (txn == NULL)
 		return;
 
-	/* cosmetic... */
-	txn->final_lsn = lsn;
+	txn->final_lsn = commit_lsn;
+	txn->end_lsn = end_lsn;
+	txn->commit_time = commit_time;
+	txn->origin_id = origin_id;
+	txn->origin_lsn = origin_lsn;
 
-	/* remove potential on-disk data, and deallocate */
-	ReorderBufferCleanupTXN(rb, txn);
-}
+	/* send the rest of an already streamed transaction */
+	if (txn->streamed)
+	{
+		ReorderBufferStreamCommit(rb, txn);
+		return;
+	}
+
+	/*
+	 * If this transaction has no snapshot, it didn't make any changes to the
+	 * database, so there's nothing to decode.  Note that
+	 * ReorderBufferCommitChild will have transferred any snapshots from
+	 * subtransactions if there were any.
+	 */
+	if (txn->base_snapshot == NULL)
+	{
+		Assert(txn->ninvalidations == 0);
+		ReorderBufferCleanupTXN(rb, txn);
+		return;
+	}
+
+	ReorderBufferProcessTXN(rb, txn, commit_lsn, txn->base_snapshot,
+							FirstCommandId, false);
+
+	/* remove potential on-disk data, and deallocate */
+	ReorderBufferCleanupTXN(rb, txn);
+}
+
+/*
+ * Abort a transaction that possibly has previous changes. Needs to be first
+ * called for subtransactions and then for the toplevel xid.
+ *
+ * NB: Transactions handled here have to have actively aborted (i.e. have
+ * produced an abort record). Implicitly aborted transactions are handled via
+ * ReorderBufferAbortOld(); transactions we're just not interested in, but
+ * which have committed are handled in ReorderBufferForget().
+ *
+ * This function purges this transaction and its contents from memory and
+ * disk.
+ */
+void
+ReorderBufferAbort(ReorderBuffer *rb, TransactionId xid, XLogRecPtr lsn)
+{
+	ReorderBufferTXN *txn;
+
+	txn = ReorderBufferTXNByXid(rb, xid, false, NULL, InvalidXLogRecPtr,
+								false);
+
+	/* unknown, nothing to remove */
+	if (txn == NULL)
+		return;
+
+	/* cosmetic... */
+	txn->final_lsn = lsn;
+
+	/* make the output plugin discard the changes it already received */
+	if (txn->streamed)
+		rb->stream_abort(rb, txn, lsn);
+
+	/* remove potential on-disk data, and deallocate */
+	ReorderBufferCleanupTXN(rb, txn);
+}
 
 /*
  * Abort all transactions that aren't actually running anymore because the
@@ -1845,6 +2140,9 @@ ReorderBufferAbortOld(ReorderBuffer *rb, TransactionId oldestRunningXid)
 
 			elog(DEBUG2, "aborting old transaction %u", txn->xid);
 
+			if (txn->streamed)
+				rb->stream_abort(rb, txn, txn->final_lsn);
+
 			/* remove potential on-disk data, and deallocate this tx */
 			ReorderBufferCleanupTXN(rb, txn);
 		}
@@ -1881,6 +2179,10 @@ ReorderBufferForget(ReorderBuffer *rb, TransactionId xid, XLogRecPtr lsn)
 	/* cosmetic... */
 	txn->final_lsn = lsn;
 
+	/* the output plugin must not apply changes it already received */
+	if (txn->streamed)
+		rb->stream_abort(rb, txn, lsn);
+
 	/*
 	 * Proccess cache invalidation messages if there are any. Even if we're
 	 * not interested in the transaction's contents, it could have manipulated
@@ -1950,6 +2252,61 @@ ReorderBufferAddSnapshot(ReorderBuffer *rb, TransactionId xid,
 	ReorderBufferQueueChange(rb, xid, lsn, change);
 }
 
+/*
+ * Make a new catalog snapshot, built after the catalog-modifying transaction
+ * committing at lsn, available to all transactions in progress.
+ *
+ * Rather than queueing the snapshot as a change in every transaction that
+ * already has a base snapshot, which costs time and memory proportional to
+ * the number of running transactions for every catalog change, there's a
+ * single list of such snapshots. Replaying a transaction switches to each
+ * snapshot built after its base snapshot before its first change following
+ * the snapshot's LSN, as if it had been queued. Snapshots are released once
+ * no transaction's base snapshot precedes them anymore.
+ *
+ * The caller has to have increased the snapshot's refcount for us.
+ */
+void
+ReorderBufferAddCatalogSnapshot(ReorderBuffer *rb, XLogRecPtr lsn,
+								Snapshot snap)
+{
+	ReorderBufferCatalogSnapshot *ent;
+	XLogRecPtr	oldest_base_lsn = lsn;
+
+	elog(DEBUG2, "adding a new catalog snapshot at %X/%X",
+		 (uint32) (lsn >> 32), (uint32) lsn);
+
+	ent = MemoryContextAlloc(rb->context, sizeof(ReorderBufferCatalogSnapshot));
+	ent->lsn = lsn;
+	ent->snapshot = snap;
+	dlist_push_tail(&rb->catalog_snapshots, &ent->node);
+
+	/*
+	 * Snapshots built before the oldest base snapshot won't be switched to
+	 * by anyone, neither will any if there's no base snapshot at all.
+	 */
+	if (!dlist_is_empty(&rb->txns_by_base_snapshot_lsn))
+	{
+		ReorderBufferTXN *txn;
+
+		txn = dlist_head_element(ReorderBufferTXN, base_snapshot_node,
+								 &rb->txns_by_base_snapshot_lsn);
+		oldest_base_lsn = txn->base_snapshot_lsn;
+	}
+
+	while (!dlist_is_empty(&rb->catalog_snapshots))
+	{
+		ent = dlist_head_element(ReorderBufferCatalogSnapshot, node,
+								 &rb->catalog_snapshots);
+		if (ent->lsn > oldest_base_lsn)
+			break;
+
+		dlist_delete(&ent->node);
+		SnapBuildSnapDecRefcount(ent->snapshot);
+		pfree(ent);
+	}
+}
+
 /*
  * Set up the transaction's base snapshot.
  *
@@ -2045,12 +2402,96 @@ ReorderBufferAddInvalidations(ReorderBuffer *rb, TransactionId xid,
 
 	Assert(nmsgs > 0);
 
-	txn->ninvalidations = nmsgs;
 	txn->invalidations = (SharedInvalidationMessage *)
 		MemoryContextAlloc(rb->context,
 						   sizeof(SharedInvalidationMessage) * nmsgs);
 	memcpy(txn->invalidations, msgs,
 		   sizeof(SharedInvalidationMessage) * nmsgs);
+
+	/*
+	 * DDL tends to invalidate the same cache entries over and over, and all
+	 * of the transaction's invalidations are executed again whenever its
+	 * CommandId is incremented during replay. As they are always executed
+	 * together, and executing a message twice has no further effect, only
+	 * keep the first copy of each. The remaining messages keep the order
+	 * they were logged in, which is the order inval.c would process them in.
+	 */
+	if (nmsgs > 1)
+	{
+		HASHCTL		hash_ctl;
+		HTAB	   *seen;
+		Size		i,
+					n = 0;
+
+		memset(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(SharedInvalidationMessage);
+		hash_ctl.entrysize = sizeof(SharedInvalidationMessage);
+		hash_ctl.hash = tag_hash;
+		hash_ctl.hcxt = rb->context;
+		seen = hash_create("ReorderBufferInvalidations", nmsgs, &hash_ctl,
+						   HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+
+		for (i = 0; i < nmsgs; i++)
+		{
+			SharedInvalidationMessage key;
+			bool		found;
+
+			ReorderBufferInvalidationKey(&txn->invalidations[i], &key);
+			(void) hash_search(seen, (void *) &key, HASH_ENTER, &found);
+			if (!found)
+				txn->invalidations[n++] = txn->invalidations[i];
+		}
+		hash_destroy(seen);
+		nmsgs = n;
+	}
+
+	txn->ninvalidations = nmsgs;
+}
+
+/*
+ * Build a hash key for a SharedInvalidationMessage, copying only the fields
+ * used by the respective message type so that padding and unused union
+ * bytes don't make identical messages look different.
+ */
+static void
+ReorderBufferInvalidationKey(const SharedInvalidationMessage *msg,
+							 SharedInvalidationMessage *key)
+{
+	memset(key, 0, sizeof(SharedInvalidationMessage));
+	key->id = msg->id;
+
+	if (msg->id >= 0)
+	{
+		key->cc.dbId = msg->cc.dbId;
+		key->cc.hashValue = msg->cc.hashValue;
+	}
+	else if (msg->id == SHAREDINVALCATALOG_ID)
+	{
+		key->cat.dbId = msg->cat.dbId;
+		key->cat.catId = msg->cat.catId;
+	}
+	else if (msg->id == SHAREDINVALRELCACHE_ID)
+	{
+		key->rc.dbId = msg->rc.dbId;
+		key->rc.relId = msg->rc.relId;
+	}
+	else if (msg->id == SHAREDINVALSMGR_ID)
+	{
+		key->sm.backend_hi = msg->sm.backend_hi;
+		key->sm.backend_lo = msg->sm.backend_lo;
+		key->sm.rnode = msg->sm.rnode;
+	}
+	else if (msg->id == SHAREDINVALRELMAP_ID)
+	{
+		key->rm.dbId = msg->rm.dbId;
+	}
+	else if (msg->id == SHAREDINVALSNAPSHOT_ID)
+	{
+		key->sn.dbId = msg->sn.dbId;
+		key->sn.relId = msg->sn.relId;
+	}
+	else
+		memcpy(key, msg, sizeof(SharedInvalidationMessage));
 }
 
 /*
@@ -2064,6 +2505,13 @@ ReorderBufferExecuteInvalidations(ReorderBuffer *rb, ReorderBufferTXN *txn)
 
 	for (i = 0; i < txn->ninvalidations; i++)
 		LocalExecuteInvalidationMessage(&txn->invalidations[i]);
+
+	/* TOAST tables might have been rewritten or dropped, relearn them */
+	if (txn->ninvalidations > 0 && rb->toast_filter != NULL)
+	{
+		hash_destroy(rb->toast_filter);
+		rb->toast_filter = NULL;
+	}
 }
 
 /*
@@ -2122,6 +2570,178 @@ ReorderBufferXidHasBaseSnapshot(ReorderBuffer *rb, TransactionId xid)
 }
 
 
+/*
+ * ---------------------------------------
+ * Streaming support
+ *
+ * Instead of spilling large transactions to disk, and only passing them to
+ * the output plugin once their commit record has been read, the changes of
+ * an in-progress toplevel transaction and its subtransactions can be passed
+ * to the output plugin in blocks, each enclosed by the stream_start and
+ * stream_stop callbacks. The output plugin is later told about the fate of
+ * the transaction by the stream_commit or stream_abort callbacks;
+ * stream_abort is also called for subtransactions that abort.
+ *
+ * Changes of catalog modifying transactions can only be decoded once all
+ * their tuplecids and invalidations are known, so such transactions are
+ * spilled to disk as usual, and the rest of their changes is only streamed
+ * when their commit is decoded.
+ * ---------------------------------------
+ */
+
+/*
+ * Can the toplevel transaction txn be streamed to the output plugin?
+ */
+static bool
+ReorderBufferCanStreamTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
+{
+	LogicalDecodingContext *ctx = rb->private_data;
+	dlist_iter	iter;
+
+	Assert(!txn->is_known_as_subxact);
+
+	/* the output plugin doesn't support streaming */
+	if (!ctx->streaming)
+		return false;
+
+	/*
+	 * Only stream if we know the transaction's commit is going to be decoded,
+	 * otherwise the output plugin would see changes whose commit it never
+	 * gets to see.
+	 */
+	if (SnapBuildCurrentState(ctx->snapshot_builder) != SNAPBUILD_CONSISTENT ||
+		SnapBuildXactNeedsSkip(ctx->snapshot_builder, ctx->reader->EndRecPtr))
+		return false;
+
+	/* nothing we could decode the changes with */
+	if (txn->base_snapshot == NULL)
+		return false;
+
+	/* once spilled to disk, a transaction stays there until its commit */
+	if (txn->has_catalog_changes || txn->serialized)
+		return false;
+
+	dlist_foreach(iter, &txn->subtxns)
+	{
+		ReorderBufferTXN *subtxn;
+
+		subtxn = dlist_container(ReorderBufferTXN, node, iter.cur);
+
+		if (subtxn->has_catalog_changes || subtxn->serialized)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Stream the changes queued so far for an in-progress toplevel transaction
+ * and its subtransactions to the output plugin, and release them.
+ */
+static void
+ReorderBufferStreamTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
+{
+	Snapshot	snapshot_now;
+
+	Assert(!txn->is_known_as_subxact);
+	Assert(txn->base_snapshot != NULL);
+
+	elog(DEBUG2, "stream changes of in-progress XID %u", txn->xid);
+
+	/*
+	 * Continue with the snapshot the previous block ended with, if any. Use a
+	 * fresh copy either way, so the snapshot's list of our own xids includes
+	 * all subtransactions known by now.
+	 */
+	snapshot_now = ReorderBufferCopySnap(rb,
+										 txn->snapshot_now != NULL ?
+										 txn->snapshot_now : txn->base_snapshot,
+										 txn, txn->command_id);
+
+	ReorderBufferProcessTXN(rb, txn, InvalidXLogRecPtr, snapshot_now,
+							txn->command_id, true);
+
+	ReorderBufferTruncateTXN(rb, txn);
+	txn->streamed = true;
+}
+
+/*
+ * Finish a streamed transaction after its commit record has been read: send
+ * whatever changes are still left as a final stream block, and tell the
+ * output plugin about the commit.
+ */
+static void
+ReorderBufferStreamCommit(ReorderBuffer *rb, ReorderBufferTXN *txn)
+{
+	dlist_iter	iter;
+	bool		has_changes = txn->nentries > 0;
+
+	Assert(txn->snapshot_now != NULL);
+
+	dlist_foreach(iter, &txn->subtxns)
+	{
+		ReorderBufferTXN *subtxn;
+
+		subtxn = dlist_container(ReorderBufferTXN, node, iter.cur);
+
+		if (subtxn->nentries > 0)
+			has_changes = true;
+	}
+
+	if (has_changes)
+		ReorderBufferProcessTXN(rb, txn, txn->final_lsn,
+								ReorderBufferCopySnap(rb, txn->snapshot_now,
+													  txn, txn->command_id),
+								txn->command_id, true);
+
+	rb->stream_commit(rb, txn, txn->final_lsn);
+
+	/* remove potential on-disk data, and deallocate */
+	ReorderBufferCleanupTXN(rb, txn);
+}
+
+/*
+ * Release the changes of a transaction and its subtransactions after they
+ * have been streamed. Subtransactions that had any changes are remembered
+ * as streamed, so their abort is passed on to the output plugin.
+ */
+static void
+ReorderBufferTruncateTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
+{
+	dlist_mutable_iter iter;
+
+	Assert(!txn->serialized);
+
+	dlist_foreach_modify(iter, &txn->subtxns)
+	{
+		ReorderBufferTXN *subtxn;
+
+		subtxn = dlist_container(ReorderBufferTXN, node, iter.cur);
+
+		Assert(subtxn->is_known_as_subxact);
+		Assert(subtxn->nsubtxns == 0);
+
+		ReorderBufferTruncateTXN(rb, subtxn);
+	}
+
+	dlist_foreach_modify(iter, &txn->changes)
+	{
+		ReorderBufferChange *change;
+
+		change = dlist_container(ReorderBufferChange, node, iter.cur);
+
+		dlist_delete(&change->node);
+		ReorderBufferReturnChange(rb, change);
+	}
+
+	if (txn->nentries > 0)
+		txn->streamed = true;
+
+	txn->nentries = 0;
+	txn->nentries_mem = 0;
+}
+
+
 /*
  * ---------------------------------------
  * Disk serialization support
@@ -2147,18 +2767,141 @@ ReorderBufferSerializeReserve(ReorderBuffer *rb, Size sz)
 }
 
 /*
- * Check whether the transaction tx should spill its data to disk.
+ * Compute the amount of memory used by a change, including the tuples or
+ * message data it references.
+ */
+static Size
+ReorderBufferChangeSize(ReorderBufferChange *change)
+{
+	Size		sz = sizeof(ReorderBufferChange);
+
+	switch (change->action)
+	{
+		case REORDER_BUFFER_CHANGE_INSERT:
+		case REORDER_BUFFER_CHANGE_UPDATE:
+		case REORDER_BUFFER_CHANGE_DELETE:
+			if (change->data.tp.oldtuple)
+				sz += sizeof(ReorderBufferTupleBuf) +
+					change->data.tp.oldtuple->alloc_tuple_size;
+			if (change->data.tp.newtuple)
+				sz += sizeof(ReorderBufferTupleBuf) +
+					change->data.tp.newtuple->alloc_tuple_size;
+			break;
+		case REORDER_BUFFER_CHANGE_MESSAGE:
+			sz += change->data.msg.sz;
+			break;
+		case REORDER_BUFFER_CHANGE_INTERNAL_SNAPSHOT:
+			{
+				Snapshot	snap = change->data.snapshot;
+
+				sz += sizeof(SnapshotData) +
+					sizeof(TransactionId) * snap->xcnt +
+					sizeof(TransactionId) * snap->subxcnt;
+				break;
+			}
+		case REORDER_BUFFER_CHANGE_INTERNAL_COMMAND_ID:
+		case REORDER_BUFFER_CHANGE_INTERNAL_TUPLECID:
+			/* ReorderBufferChange contains everything important */
+			break;
+	}
+
+	return sz;
+}
+
+/*
+ * Add or subtract the size of a change to the memory accounted for its
+ * transaction and the whole reorder buffer.
+ *
+ * A change is accounted for as long as it's part of a transaction's list of
+ * changes kept in memory; change->txn is reset once it's subtracted again.
  */
 static void
-ReorderBufferCheckSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
+ReorderBufferChangeMemoryUpdate(ReorderBuffer *rb,
+								ReorderBufferChange *change, bool addition)
 {
-	/*
-	 * TODO: improve accounting so we cheaply can take subtransactions into
-	 * account here.
-	 */
-	if (txn->nentries_mem >= max_changes_in_memory)
+	ReorderBufferTXN *txn = change->txn;
+	Size		sz;
+
+	Assert(txn != NULL);
+
+	sz = ReorderBufferChangeSize(change);
+
+	if (addition)
+	{
+		txn->size += sz;
+		rb->size += sz;
+	}
+	else
 	{
-		ReorderBufferSerializeTXN(rb, txn);
+		Assert((rb->size >= sz) && (txn->size >= sz));
+		txn->size -= sz;
+		rb->size -= sz;
+		change->txn = NULL;
+	}
+}
+
+/*
+ * Find the transaction (toplevel or subtransaction) using the most memory.
+ *
+ * This simply walks all transactions, which is fine as this is only called
+ * once the memory limit has been reached, and the chosen transaction's
+ * memory is released entirely afterwards.
+ */
+static ReorderBufferTXN *
+ReorderBufferLargestTXN(ReorderBuffer *rb)
+{
+	HASH_SEQ_STATUS hash_seq;
+	ReorderBufferTXNByIdEnt *ent;
+	ReorderBufferTXN *largest = NULL;
+
+	hash_seq_init(&hash_seq, rb->by_txn);
+	while ((ent = hash_seq_search(&hash_seq)) != NULL)
+	{
+		ReorderBufferTXN *txn = ent->txn;
+
+		if (largest == NULL || txn->size > largest->size)
+			largest = txn;
+	}
+
+	Assert(largest != NULL && largest->size > 0);
+
+	return largest;
+}
+
+/*
+ * Check whether the memory used by the reorder buffer exceeds
+ * logical_decoding_work_mem, and if so release memory by spilling the
+ * largest transactions to disk until we're below the limit again.
+ *
+ * If allow_stream is set and the output plugin supports it, the toplevel
+ * transaction of the largest transaction is streamed to the output plugin
+ * instead of being spilled.
+ */
+static void
+ReorderBufferCheckMemoryLimit(ReorderBuffer *rb, bool allow_stream)
+{
+	ReorderBufferTXN *txn;
+
+	while (rb->size >= logical_decoding_work_mem * 1024L)
+	{
+		ReorderBufferTXN *toptxn;
+
+		txn = ReorderBufferLargestTXN(rb);
+
+		toptxn = txn;
+		if (txn->is_known_as_subxact)
+			toptxn = ReorderBufferTXNByXid(rb, txn->toplevel_xid, false,
+										   NULL, InvalidXLogRecPtr, false);
+
+		if (allow_stream && ReorderBufferCanStreamTXN(rb, toptxn))
+		{
+			ReorderBufferStreamTXN(rb, toptxn);
+			Assert(toptxn->size == 0);
+		}
+		else
+			ReorderBufferSerializeTXN(rb, txn);
+
+		Assert(txn->size == 0);
 		Assert(txn->nentries_mem == 0);
 	}
 }
@@ -2187,6 +2930,9 @@ ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
 		ReorderBufferSerializeTXN(rb, subtxn);
 	}
 
+	/* forget about data from a spill that errored out midway */
+	rb->spillbuflen = 0;
+
 	/* serialize changestream */
 	dlist_foreach_modify(change_i, &txn->changes)
 	{
@@ -2203,7 +2949,10 @@ ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
 			char		path[MAXPGPATH];
 
 			if (fd != -1)
+			{
+				ReorderBufferSerializeFlush(rb, txn, fd);
 				CloseTransientFile(fd);
+			}
 
 			XLByteToSeg(change->lsn, curOpenSegNo);
 
@@ -2234,15 +2983,28 @@ ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
 
 	Assert(spilled == txn->nentries_mem);
 	Assert(dlist_is_empty(&txn->changes));
+
+	/* update the statistics, counting each transaction only once */
+	if (spilled > 0)
+	{
+		rb->spillCount++;
+		if (!txn->serialized)
+			rb->spillTxns++;
+	}
+
 	txn->nentries_mem = 0;
 	txn->serialized = true;
 
 	if (fd != -1)
+	{
+		ReorderBufferSerializeFlush(rb, txn, fd);
 		CloseTransientFile(fd);
+	}
 }
 
 /*
- * Serialize individual change to disk.
+ * Serialize individual change, adding it to the block of changes to be
+ * written to disk.
  */
 static void
 ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
@@ -2371,8 +3133,70 @@ ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 
 	ondisk->size = sz;
 
+	Assert(ondisk->change.action == change->action);
+
+	/* append the change to the current block, keeping changes aligned */
+	if (rb->spillbufsize < rb->spillbuflen + MAXALIGN(sz))
+	{
+		Size		newsize = Max(spill_block_size,
+								  rb->spillbuflen + MAXALIGN(sz));
+
+		if (rb->spillbuf == NULL)
+			rb->spillbuf = MemoryContextAlloc(rb->context, newsize);
+		else
+			rb->spillbuf = repalloc(rb->spillbuf, newsize);
+		rb->spillbufsize = newsize;
+	}
+
+	memcpy(rb->spillbuf + rb->spillbuflen, rb->outbuf, sz);
+	memset(rb->spillbuf + rb->spillbuflen + sz, 0, MAXALIGN(sz) - sz);
+	rb->spillbuflen += MAXALIGN(sz);
+
+	rb->spillBytes += sz;
+
+	if (rb->spillbuflen >= spill_block_size)
+		ReorderBufferSerializeFlush(rb, txn, fd);
+}
+
+/*
+ * Write the block of changes collected by ReorderBufferSerializeChange() to
+ * disk, compressing it if logical_decoding_spill_compression is enabled.
+ */
+static void
+ReorderBufferSerializeFlush(ReorderBuffer *rb, ReorderBufferTXN *txn, int fd)
+{
+	ReorderBufferDiskBlock hdr;
+	char	   *data = rb->spillbuf;
+
+	if (rb->spillbuflen == 0)
+		return;
+
+	/* zero the padding, too, so spill files are deterministic */
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.rawsize = rb->spillbuflen;
+	hdr.disksize = rb->spillbuflen;
+	hdr.compressed = false;
+
+	if (logical_decoding_spill_compression)
+	{
+		PGLZ_Header *compressed;
+
+		ReorderBufferSerializeReserve(rb, PGLZ_MAX_OUTPUT(rb->spillbuflen));
+		compressed = (PGLZ_Header *) rb->outbuf;
+
+		/* store the block uncompressed if it doesn't compress well */
+		if (pglz_compress(rb->spillbuf, rb->spillbuflen, compressed,
+						  PGLZ_strategy_default))
+		{
+			hdr.disksize = VARSIZE(compressed);
+			hdr.compressed = true;
+			data = rb->outbuf;
+		}
+	}
+
 	errno = 0;
-	if (write(fd, rb->outbuf, ondisk->size) != ondisk->size)
+	if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+		write(fd, data, hdr.disksize) != hdr.disksize)
 	{
 		int save_errno = errno;
 
@@ -2386,7 +3210,8 @@ ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 						txn->xid)));
 	}
 
-	Assert(ondisk->change.action == change->action);
+	rb->spillDiskBytes += sizeof(hdr) + hdr.disksize;
+	rb->spillbuflen = 0;
 }
 
 /*
@@ -2394,7 +3219,7 @@ ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
  */
 static Size
 ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
-							int *fd, XLogSegNo *segno)
+							ReorderBufferSpillFile *file)
 {
 	Size		restored = 0;
 	XLogSegNo	last_segno;
@@ -2417,101 +3242,157 @@ ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
 
 	XLByteToSeg(txn->final_lsn, last_segno);
 
-	while (restored < max_changes_in_memory && *segno <= last_segno)
+	while (restored < max_changes_in_memory && file->segno <= last_segno)
 	{
-		int			readBytes;
 		ReorderBufferDiskChange *ondisk;
 
-		if (*fd == -1)
+		if (file->fd == -1)
 		{
 			char		path[MAXPGPATH];
 
 			/* first time in */
-			if (*segno == 0)
-				XLByteToSeg(txn->first_lsn, *segno);
+			if (file->segno == 0)
+				XLByteToSeg(txn->first_lsn, file->segno);
 
-			Assert(*segno != 0 || dlist_is_empty(&txn->changes));
+			Assert(file->segno != 0 || dlist_is_empty(&txn->changes));
 
 			/*
 			 * No need to care about TLIs here, only used during a single run,
 			 * so each LSN only maps to a specific WAL record.
 			 */
 			ReorderBufferSerializedPath(path, MyReplicationSlot, txn->xid,
-										*segno);
+										file->segno);
 
-			*fd = OpenTransientFile(path, O_RDONLY | PG_BINARY, 0);
-			if (*fd < 0 && errno == ENOENT)
+			file->fd = OpenTransientFile(path, O_RDONLY | PG_BINARY, 0);
+			if (file->fd < 0 && errno == ENOENT)
 			{
-				*fd = -1;
-				(*segno)++;
+				file->fd = -1;
+				file->segno++;
 				continue;
 			}
-			else if (*fd < 0)
+			else if (file->fd < 0)
 				ereport(ERROR,
 						(errcode_for_file_access(),
 						 errmsg("could not open file \"%s\": %m",
 								path)));
 
+			/* the file is read front to back, let the kernel read ahead */
+#if defined(USE_POSIX_FADVISE) && defined(POSIX_FADV_SEQUENTIAL)
+			(void) posix_fadvise(file->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+			file->len = file->off = 0;
 		}
 
 		/*
-		 * Read the statically sized part of a change which has information
-		 * about the total size. If we couldn't read a record, we're at the
-		 * end of this file.
+		 * Read the next block once all changes of the current one have been
+		 * restored. If there is none, we're at the end of this file.
 		 */
-		ReorderBufferSerializeReserve(rb, sizeof(ReorderBufferDiskChange));
-		readBytes = read(*fd, rb->outbuf, sizeof(ReorderBufferDiskChange));
-
-		/* eof */
-		if (readBytes == 0)
+		if (file->off >= file->len &&
+			!ReorderBufferRestoreBlock(rb, txn, file))
 		{
-			CloseTransientFile(*fd);
-			*fd = -1;
-			(*segno)++;
+			CloseTransientFile(file->fd);
+			file->fd = -1;
+			file->segno++;
 			continue;
 		}
-		else if (readBytes < 0)
-			ereport(ERROR,
-					(errcode_for_file_access(),
-				errmsg("could not read from reorderbuffer spill file: %m")));
-		else if (readBytes != sizeof(ReorderBufferDiskChange))
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
-							readBytes,
-							(uint32) sizeof(ReorderBufferDiskChange))));
-
-		ondisk = (ReorderBufferDiskChange *) rb->outbuf;
-
-		ReorderBufferSerializeReserve(rb,
-							 sizeof(ReorderBufferDiskChange) + ondisk->size);
-		ondisk = (ReorderBufferDiskChange *) rb->outbuf;
 
-		readBytes = read(*fd, rb->outbuf + sizeof(ReorderBufferDiskChange),
-						 ondisk->size - sizeof(ReorderBufferDiskChange));
+		ondisk = (ReorderBufferDiskChange *) (file->block + file->off);
 
-		if (readBytes < 0)
-			ereport(ERROR,
-					(errcode_for_file_access(),
-				errmsg("could not read from reorderbuffer spill file: %m")));
-		else if (readBytes != ondisk->size - sizeof(ReorderBufferDiskChange))
+		if (ondisk->size < sizeof(ReorderBufferDiskChange) ||
+			file->off + ondisk->size > file->len)
 			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
-							readBytes,
-				(uint32) (ondisk->size - sizeof(ReorderBufferDiskChange)))));
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid change of size %zu in reorderbuffer spill file",
+							ondisk->size)));
+
+		file->off += MAXALIGN(ondisk->size);
 
 		/*
-		 * ok, read a full change from disk, now restore it into proper
+		 * ok, got a full change from disk, now restore it into proper
 		 * in-memory format
 		 */
-		ReorderBufferRestoreChange(rb, txn, rb->outbuf);
+		ReorderBufferRestoreChange(rb, txn, (char *) ondisk);
 		restored++;
 	}
 
 	return restored;
 }
 
+/*
+ * Read the next block of changes from a spill file into file->block,
+ * decompressing it if necessary.
+ *
+ * Returns false at the end of the file.
+ */
+static bool
+ReorderBufferRestoreBlock(ReorderBuffer *rb, ReorderBufferTXN *txn,
+						  ReorderBufferSpillFile *file)
+{
+	ReorderBufferDiskBlock hdr;
+	char	   *dest;
+	int			readBytes;
+
+	readBytes = read(file->fd, &hdr, sizeof(hdr));
+
+	/* eof */
+	if (readBytes == 0)
+		return false;
+	else if (readBytes < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: %m")));
+	else if (readBytes != sizeof(hdr))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
+						readBytes, (uint32) sizeof(hdr))));
+
+	if (file->blocksize < hdr.rawsize)
+	{
+		if (file->block != NULL)
+			pfree(file->block);
+		file->block = MemoryContextAlloc(rb->context, hdr.rawsize);
+		file->blocksize = hdr.rawsize;
+	}
+
+	/* compressed data is read into the scratch buffer first */
+	if (hdr.compressed)
+	{
+		ReorderBufferSerializeReserve(rb, hdr.disksize);
+		dest = rb->outbuf;
+	}
+	else
+		dest = file->block;
+
+	readBytes = read(file->fd, dest, hdr.disksize);
+
+	if (readBytes < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: %m")));
+	else if (readBytes != hdr.disksize)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
+						readBytes, hdr.disksize)));
+
+	if (hdr.compressed)
+	{
+		if (PGLZ_RAW_SIZE((PGLZ_Header *) dest) != hdr.rawsize)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid compressed block in reorderbuffer spill file for XID %u",
+							txn->xid)));
+		pglz_decompress((PGLZ_Header *) dest, file->block);
+	}
+
+	file->len = hdr.rawsize;
+	file->off = 0;
+
+	return true;
+}
+
 /*
  * Convert change from its on-disk format to in-memory format and queue it onto
  * the TXN's ->changes list.
@@ -2630,6 +3511,10 @@ ReorderBufferRestoreChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 
 	dlist_push_tail(&txn->changes, &change->node);
 	txn->nentries_mem++;
+
+	/* update memory accounting for the restored change */
+	change->txn = txn;
+	ReorderBufferChangeMemoryUpdate(rb, change, true);
 }
 
 /*
@@ -2813,18 +3698,33 @@ ReorderBufferToastAppendChunk(ReorderBuffer *rb, ReorderBufferTXN *txn,
 	{
 		Assert(ent->chunk_id == chunk_id);
 		ent->num_chunks = 0;
-		ent->last_chunk_seq = 0;
+		ent->last_chunk_seq = -1;
 		ent->size = 0;
+		ent->incomplete = false;
 		ent->reconstructed = NULL;
 		dlist_init(&ent->chunks);
+	}
 
-		if (chunk_seq != 0)
-			elog(ERROR, "got sequence entry %d for toast chunk %u instead of seq 0",
-				 chunk_seq, chunk_id);
+	/*
+	 * If the TOAST filter changed after some of the value's chunks were
+	 * dropped while decoding, e.g. because a decoding group member without
+	 * the filter joined, the remaining ones get here. The value can't be
+	 * reassembled then, and is treated like one whose chunks were all
+	 * skipped, see ReorderBufferToastSkipChunk().
+	 */
+	if (!ent->incomplete && chunk_seq != ent->last_chunk_seq + 1)
+	{
+		if (!rb->toast_chunks_dropped)
+			elog(ERROR, "got sequence entry %d for toast chunk %u instead of seq %d",
+				 chunk_seq, chunk_id, ent->last_chunk_seq + 1);
+		ent->incomplete = true;
+	}
+
+	if (ent->incomplete)
+	{
+		ReorderBufferReturnChange(rb, change);
+		return;
 	}
-	else if (found && chunk_seq != ent->last_chunk_seq + 1)
-		elog(ERROR, "got sequence entry %d for toast chunk %u instead of seq %d",
-			 chunk_seq, chunk_id, ent->last_chunk_seq + 1);
 
 	chunk = DatumGetPointer(fastgetattr(&newtup->tuple, 3, desc, &isnull));
 	Assert(!isnull);
@@ -2844,6 +3744,45 @@ ReorderBufferToastAppendChunk(ReorderBuffer *rb, ReorderBufferTXN *txn,
 	dlist_push_tail(&ent->chunks, &change->node);
 }
 
+/*
+ * Remember that a TOAST chunk wasn't kept for reassembly, so that the value
+ * it belongs to can be reported as such by ReorderBufferToastReplace().
+ * Only the value's first chunk is guaranteed to get here, see DecodeInsert().
+ */
+static void
+ReorderBufferToastSkipChunk(ReorderBuffer *rb, ReorderBufferTXN *txn,
+							Relation relation, ReorderBufferChange *change)
+{
+	ReorderBufferToastEnt *ent;
+	bool		found;
+	bool		isnull;
+	Oid			chunk_id;
+
+	if (txn->toast_hash == NULL)
+		ReorderBufferToastInitHash(rb, txn);
+
+	chunk_id = DatumGetObjectId(fastgetattr(&change->data.tp.newtuple->tuple,
+											1, RelationGetDescr(relation),
+											&isnull));
+	Assert(!isnull);
+
+	ent = (ReorderBufferToastEnt *)
+		hash_search(txn->toast_hash,
+					(void *) &chunk_id,
+					HASH_ENTER,
+					&found);
+
+	if (!found)
+	{
+		ent->num_chunks = 0;
+		ent->last_chunk_seq = -1;
+		ent->size = 0;
+		ent->reconstructed = NULL;
+		dlist_init(&ent->chunks);
+	}
+	ent->incomplete = true;
+}
+
 /*
  * Rejigger change->newtuple to point to in-memory toast tuples instead to
  * on-disk toast tuples that may not longer exist (think DROP TABLE or VACUUM).
@@ -2938,6 +3877,14 @@ ReorderBufferToastReplace(ReorderBuffer *rb, ReorderBufferTXN *txn,
 		if (ent == NULL)
 			continue;
 
+		/* changed, but not all of its chunks were kept */
+		if (ent->incomplete || ent->size != toast_pointer.va_extsize)
+		{
+			change->data.tp.toast_skipped =
+				bms_add_member(change->data.tp.toast_skipped, attr->attnum);
+			continue;
+		}
+
 		new_datum =
 			(struct varlena *) palloc0(INDIRECT_POINTER_SIZE);
 
@@ -2993,9 +3940,34 @@ ReorderBufferToastReplace(ReorderBuffer *rb, ReorderBufferTXN *txn,
 	 * the tuplebuf because attrs[] will point back into the current content.
 	 */
 	tmphtup = heap_form_tuple(desc, attrs, isnull);
-	Assert(newtup->tuple.t_len <= MaxHeapTupleSize);
 	Assert(ReorderBufferTupleBufData(newtup) == newtup->tuple.t_data);
 
+	/*
+	 * Tuple buffers are allocated to fit the original tuple exactly, so get
+	 * a bigger one if the rebuilt tuple doesn't fit.  The change's size is
+	 * accounted for based on its tuples, so update that around the swap.
+	 */
+	if (tmphtup->t_len > newtup->alloc_tuple_size)
+	{
+		ReorderBufferTXN *change_txn = change->txn;
+
+		if (change_txn != NULL)
+			ReorderBufferChangeMemoryUpdate(rb, change, false);
+
+		newtup = ReorderBufferGetTupleBuf(rb, tmphtup->t_len -
+									 offsetof(HeapTupleHeaderData, t_bits));
+		newtup->tuple.t_self = change->data.tp.newtuple->tuple.t_self;
+		newtup->tuple.t_tableOid = change->data.tp.newtuple->tuple.t_tableOid;
+		ReorderBufferReturnTupleBuf(rb, change->data.tp.newtuple);
+		change->data.tp.newtuple = newtup;
+
+		if (change_txn != NULL)
+		{
+			change->txn = change_txn;
+			ReorderBufferChangeMemoryUpdate(rb, change, true);
+		}
+	}
+
 	memcpy(newtup->tuple.t_data, tmphtup->t_data, tmphtup->t_len);
 	newtup->tuple.t_len = tmphtup->t_len;
 
@@ -3052,6 +4024,151 @@ ReorderBufferToastReset(ReorderBuffer *rb, ReorderBufferTXN *txn)
 	txn->toast_hash = NULL;
 }
 
+/*
+ * Set up which TOAST chunks need to be kept for reassembly.
+ *
+ * If skip_reassembly is set, none are, and externally stored values are
+ * passed to the output plugin as they are stored in the tuple, like
+ * unchanged ones; changed ones are listed in the change's toast_skipped.
+ * Otherwise, if filter_relation is given, chunks are only
+ * kept if it doesn't filter the relation owning the TOAST table. To skip
+ * them early, TOAST tables are remembered as their chunks are replayed, and
+ * ReorderBufferSkipToastChunk() checks chunks against them while decoding.
+ */
+void
+ReorderBufferSetupToastFilter(ReorderBuffer *rb, bool skip_reassembly,
+							  ReorderBufferFilterRelationCB filter_relation)
+{
+	rb->skip_toast_reassembly = skip_reassembly;
+	rb->filter_relation = filter_relation;
+
+	if (rb->toast_filter != NULL)
+	{
+		hash_destroy(rb->toast_filter);
+		rb->toast_filter = NULL;
+	}
+}
+
+/*
+ * Check whether a change inserting into the relation stored in rnode is a
+ * TOAST chunk known not to be needed, so it doesn't need to be queued. If so,
+ * remember that the chunks of a value may now be incomplete.
+ */
+bool
+ReorderBufferSkipToastChunk(ReorderBuffer *rb, RelFileNode *rnode)
+{
+	ReorderBufferToastFilterEnt *ent;
+
+	if (rb->toast_filter == NULL)
+		return false;
+
+	ent = (ReorderBufferToastFilterEnt *)
+		hash_search(rb->toast_filter, (void *) rnode, HASH_FIND, NULL);
+
+	if (ent == NULL || !ent->skip)
+		return false;
+
+	rb->toast_chunks_dropped = true;
+	return true;
+}
+
+/*
+ * Check whether the chunks of the TOAST table relation need to be kept,
+ * and remember the result for ReorderBufferSkipToastChunk().
+ */
+static bool
+ReorderBufferToastSkipRelation(ReorderBuffer *rb, Relation relation)
+{
+	ReorderBufferToastFilterEnt *ent;
+	bool		found;
+
+	if (!rb->skip_toast_reassembly && rb->filter_relation == NULL)
+		return false;
+
+	if (rb->toast_filter == NULL)
+	{
+		HASHCTL		hash_ctl;
+
+		memset(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(RelFileNode);
+		hash_ctl.entrysize = sizeof(ReorderBufferToastFilterEnt);
+		hash_ctl.hash = tag_hash;
+		hash_ctl.hcxt = rb->context;
+		rb->toast_filter = hash_create("ReorderBufferToastFilter", 32,
+									   &hash_ctl,
+									   HASH_ELEM | HASH_FUNCTION |
+									   HASH_CONTEXT);
+	}
+
+	ent = (ReorderBufferToastFilterEnt *)
+		hash_search(rb->toast_filter, (void *) &relation->rd_node,
+					HASH_ENTER, &found);
+	if (found)
+		return ent->skip;
+
+	ent->skip = rb->skip_toast_reassembly;
+
+	if (!ent->skip)
+	{
+		Oid			owner = ReorderBufferToastOwner(RelationGetRelid(relation));
+		Relation	ownerrel;
+
+		ownerrel = OidIsValid(owner) ? RelationIdGetRelation(owner) : NULL;
+		if (ownerrel != NULL)
+		{
+			ent->skip = rb->filter_relation(rb, &ownerrel->rd_node);
+			RelationClose(ownerrel);
+		}
+	}
+
+	return ent->skip;
+}
+
+/*
+ * Find the relation owning a TOAST table, using the internal dependency
+ * recorded when the TOAST table was created.
+ */
+static Oid
+ReorderBufferToastOwner(Oid toastrelid)
+{
+	Relation	depRel;
+	ScanKeyData key[2];
+	SysScanDesc scan;
+	HeapTuple	tup;
+	Oid			owner = InvalidOid;
+
+	depRel = heap_open(DependRelationId, AccessShareLock);
+
+	ScanKeyInit(&key[0],
+				Anum_pg_depend_classid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(RelationRelationId));
+	ScanKeyInit(&key[1],
+				Anum_pg_depend_objid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(toastrelid));
+
+	scan = systable_beginscan(depRel, DependDependerIndexId, true,
+							  NULL, 2, key);
+
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+	{
+		Form_pg_depend dep = (Form_pg_depend) GETSTRUCT(tup);
+
+		if (dep->refclassid == RelationRelationId &&
+			dep->deptype == DEPENDENCY_INTERNAL)
+		{
+			owner = dep->refobjid;
+			break;
+		}
+	}
+
+	systable_endscan(scan);
+	heap_close(depRel, AccessShareLock);
+
+	return owner;
+}
+
 
 /* ---------------------------------------
  * Visibility support for logical decoding
@@ -33,9 +33,13 @@
 
 #include "storage/fd.h"
 #include "storage/copydir.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
 
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
+#include "utils/hsearch.h"
 #include "utils/rel.h"
 #include "utils/syscache.h"
 #include "utils/tqual.h"
@@ -46,7 +50,7 @@
 typedef struct ReplicationState
 {
 	/*
-	 * Local identifier for the remote node.
+	 * Local identifier for the remote node, InvalidRepNodeId if unused.
 	 */
 	RepNodeId	local_identifier;
 
@@ -61,8 +65,39 @@ typedef struct ReplicationState
 	 * disk.
 	 */
 	XLogRecPtr	local_lsn;
+
+	/*
+	 * Has the state changed since the last checkpoint?
+	 */
+	bool		dirty;
+
+	/*
+	 * Protects the above fields; the identifier may only be changed while
+	 * also holding the hash partition lock of the identifier.
+	 */
+	slock_t		mutex;
 } ReplicationState;
 
+/*
+ * On disk representation of a ReplicationState, see
+ * CheckPointReplicationIdentifier().
+ */
+typedef struct ReplicationStateOnDisk
+{
+	RepNodeId	local_identifier;
+	XLogRecPtr	remote_lsn;
+	XLogRecPtr	local_lsn;		/* always InvalidXLogRecPtr */
+} ReplicationStateOnDisk;
+
+/*
+ * Entry of the hash table mapping RepNodeIds to their ReplicationState.
+ */
+typedef struct ReplicationStateLookupEnt
+{
+	RepNodeId	local_identifier;	/* hash key, has to be first */
+	ReplicationState *state;
+} ReplicationStateLookupEnt;
+
 /*
  * Base address into a shared memory array of replication states of size
  * max_replication_slots.
@@ -70,6 +105,19 @@ typedef struct ReplicationState
  */
 static ReplicationState *ReplicationStates;
 
+/*
+ * Shared hash table to look up the ReplicationStates entry of a RepNodeId.
+ * It's partitioned, like the buffer mapping table, so that looking up
+ * different nodes doesn't contend on a single lock. Lookups need the
+ * partition lock in shared mode, adding and removing entries in exclusive
+ * mode.
+ */
+static HTAB *ReplicationStateHash;
+
+#define ReplicationStatePartitionLock(hashcode) \
+	(&MainLWLockArray[REPLICATION_IDENTIFIER_LWLOCK_OFFSET + \
+		(hashcode) % NUM_REPLICATION_IDENTIFIER_PARTITIONS].lock)
+
 /*
  * Backend-local, cached element from ReplicationStates for use in a backend
  * replaying remote commits, so we don't have to search ReplicationStates for
@@ -77,6 +125,15 @@ static ReplicationState *ReplicationStates;
  */
 static ReplicationState *local_replication_state = NULL;
 
+static ReplicationState *ReplicationStateLookup(RepNodeId node, bool create);
+static void ReplicationStateRelease(RepNodeId node);
+static void ReplicationStateAdvance(ReplicationState *state,
+						XLogRecPtr remote_commit,
+						XLogRecPtr local_commit);
+static void ReplicationStateAdvanceLocked(ReplicationState *state,
+							 XLogRecPtr remote_commit,
+							 XLogRecPtr local_commit);
+
 /* Magic for on disk files. */
 #define REPLICATION_STATE_MAGIC (uint32)0x1257DADE
 
@@ -224,7 +281,6 @@ DropReplicationIdentifier(RepNodeId riident)
 	SnapshotData SnapshotDirty;
 	SysScanDesc scan;
 	ScanKeyData key;
-	int			i;
 
 	Assert(IsTransactionState());
 
@@ -233,15 +289,8 @@ DropReplicationIdentifier(RepNodeId riident)
 	rel = heap_open(ReplicationIdentifierRelationId, ExclusiveLock);
 
 	/* cleanup the slot state info */
-	for (i = 0; i < max_replication_slots; i++)
-	{
-		/* found our slot */
-		if (ReplicationStates[i].local_identifier == riident)
-		{
-			memset(&ReplicationStates[i], 0, sizeof(ReplicationState));
-			break;
-		}
-	}
+	if (max_replication_slots > 0)
+		ReplicationStateRelease(riident);
 
 	ScanKeyInit(&key,
 				Anum_pg_replication_riident,
@@ -459,29 +508,37 @@ pg_get_replication_identifier_progress(PG_FUNCTION_ARGS)
 
 	/*
 	 * Iterate through all possible ReplicationStates, display if they are
-	 * filled. Note that we do not take any locks, so slightly corrupted/out
-	 * of date values are a possibility.
+	 * filled. Every state is copied under its own spinlock, so the values of
+	 * different nodes might not be from the same point in time.
 	 */
 	for (i = 0; i < max_replication_slots; i++)
 	{
 		ReplicationState *state;
+		ReplicationState local_state;
 		Datum		values[REPLICATION_IDENTIFIER_PROGRESS_COLS];
 		bool		nulls[REPLICATION_IDENTIFIER_PROGRESS_COLS];
 		char		location[MAXFNAMELEN];
-		char		*riname;
+		char		*riname = NULL;
 
 		state = &ReplicationStates[i];
 
+		SpinLockAcquire(&state->mutex);
+		local_state.local_identifier = state->local_identifier;
+		local_state.remote_lsn = state->remote_lsn;
+		local_state.local_lsn = state->local_lsn;
+		SpinLockRelease(&state->mutex);
+
 		/* unused slot, nothing to display */
-		if (state->local_identifier == InvalidRepNodeId)
+		if (local_state.local_identifier == InvalidRepNodeId)
 			continue;
 
 		memset(values, 0, sizeof(values));
 		memset(nulls, 0, sizeof(nulls));
 
-		values[ 0] = ObjectIdGetDatum(state->local_identifier);
+		values[ 0] = ObjectIdGetDatum(local_state.local_identifier);
 
-		GetReplicationInfoByIdentifier(state->local_identifier, true, &riname);
+		GetReplicationInfoByIdentifier(local_state.local_identifier, true,
+									   &riname);
 
 		/*
 		 * We're not preventing the identifier to be dropped concurrently, so
@@ -493,10 +550,12 @@ pg_get_replication_identifier_progress(PG_FUNCTION_ARGS)
 		values[ 1] = CStringGetTextDatum(riname);
 
 		snprintf(location, sizeof(location), "%X/%X",
-				 (uint32) (state->remote_lsn >> 32), (uint32) state->remote_lsn);
+				 (uint32) (local_state.remote_lsn >> 32),
+				 (uint32) local_state.remote_lsn);
 		values[ 2] = CStringGetTextDatum(location);
 		snprintf(location, sizeof(location), "%X/%X",
-				 (uint32) (state->local_lsn >> 32), (uint32) state->local_lsn);
+				 (uint32) (local_state.local_lsn >> 32),
+				 (uint32) local_state.local_lsn);
 		values[ 3] = CStringGetTextDatum(location);
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
@@ -592,12 +651,16 @@ ReplicationIdentifierShmemSize(void)
 
 	size = add_size(size,
 					mul_size(max_replication_slots, sizeof(ReplicationState)));
+	size = add_size(size,
+					hash_estimate_size(max_replication_slots,
+									   sizeof(ReplicationStateLookupEnt)));
 	return size;
 }
 
 void
 ReplicationIdentifierShmemInit(void)
 {
+	HASHCTL		info;
 	bool		found;
 
 	if (max_replication_slots == 0)
@@ -605,13 +668,152 @@ ReplicationIdentifierShmemInit(void)
 
 	ReplicationStates = (ReplicationState *)
 		ShmemInitStruct("ReplicationIdentifierState",
-						ReplicationIdentifierShmemSize(),
+						mul_size(max_replication_slots,
+								 sizeof(ReplicationState)),
 						&found);
 
 	if (!found)
 	{
-		MemSet(ReplicationStates, 0, ReplicationIdentifierShmemSize());
+		int			i;
+
+		MemSet(ReplicationStates, 0,
+			   mul_size(max_replication_slots, sizeof(ReplicationState)));
+
+		for (i = 0; i < max_replication_slots; i++)
+			SpinLockInit(&ReplicationStates[i].mutex);
+	}
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(RepNodeId);
+	info.entrysize = sizeof(ReplicationStateLookupEnt);
+	info.hash = tag_hash;
+	info.num_partitions = NUM_REPLICATION_IDENTIFIER_PARTITIONS;
+
+	ReplicationStateHash = ShmemInitHash("ReplicationIdentifierState Hash",
+										 max_replication_slots,
+										 max_replication_slots,
+										 &info,
+									HASH_ELEM | HASH_FUNCTION | HASH_PARTITION);
+}
+
+/*
+ * Find the ReplicationState of a node, setting up a new one if 'create' is
+ * true and there is none yet. Returns NULL if there is no state for the node
+ * and none could be created because all are in use.
+ */
+static ReplicationState *
+ReplicationStateLookup(RepNodeId node, bool create)
+{
+	ReplicationStateLookupEnt *ent;
+	ReplicationState *state = NULL;
+	uint32		hashcode;
+	LWLock	   *partitionLock;
+	int			i;
+
+	Assert(node != InvalidRepNodeId);
+
+	hashcode = get_hash_value(ReplicationStateHash, &node);
+	partitionLock = ReplicationStatePartitionLock(hashcode);
+
+	/* the common case: the node's state already exists */
+	LWLockAcquire(partitionLock, LW_SHARED);
+	ent = (ReplicationStateLookupEnt *)
+		hash_search_with_hash_value(ReplicationStateHash, &node, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+		state = ent->state;
+	LWLockRelease(partitionLock);
+
+	if (state != NULL || !create)
+		return state;
+
+	/* need to create it, recheck while preventing concurrent creation */
+	LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+	ent = (ReplicationStateLookupEnt *)
+		hash_search_with_hash_value(ReplicationStateHash, &node, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+	{
+		state = ent->state;
+		LWLockRelease(partitionLock);
+		return state;
+	}
+
+	/*
+	 * Claim a free state. Nodes of other partitions might concurrently do
+	 * the same, so check for it being unused again while holding its lock.
+	 */
+	for (i = 0; i < max_replication_slots; i++)
+	{
+		ReplicationState *curstate = &ReplicationStates[i];
+
+		if (curstate->local_identifier != InvalidRepNodeId)
+			continue;
+
+		SpinLockAcquire(&curstate->mutex);
+		if (curstate->local_identifier == InvalidRepNodeId)
+		{
+			curstate->local_identifier = node;
+			curstate->remote_lsn = InvalidXLogRecPtr;
+			curstate->local_lsn = InvalidXLogRecPtr;
+			curstate->dirty = true;
+			state = curstate;
+		}
+		SpinLockRelease(&curstate->mutex);
+
+		if (state != NULL)
+			break;
+	}
+
+	/*
+	 * There are at most as many entries as claimed states, so there always
+	 * is space for the new one.
+	 */
+	if (state != NULL)
+	{
+		ent = (ReplicationStateLookupEnt *)
+			hash_search_with_hash_value(ReplicationStateHash, &node, hashcode,
+										HASH_ENTER, NULL);
+		ent->state = state;
 	}
+
+	LWLockRelease(partitionLock);
+
+	return state;
+}
+
+/*
+ * Forget about the replay progress of a node, if it's known.
+ */
+static void
+ReplicationStateRelease(RepNodeId node)
+{
+	ReplicationStateLookupEnt *ent;
+	uint32		hashcode;
+	LWLock	   *partitionLock;
+
+	hashcode = get_hash_value(ReplicationStateHash, &node);
+	partitionLock = ReplicationStatePartitionLock(hashcode);
+
+	LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+	ent = (ReplicationStateLookupEnt *)
+		hash_search_with_hash_value(ReplicationStateHash, &node, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+	{
+		ReplicationState *state = ent->state;
+
+		SpinLockAcquire(&state->mutex);
+		state->local_identifier = InvalidRepNodeId;
+		state->remote_lsn = InvalidXLogRecPtr;
+		state->local_lsn = InvalidXLogRecPtr;
+		state->dirty = false;
+		SpinLockRelease(&state->mutex);
+
+		hash_search_with_hash_value(ReplicationStateHash, &node, hashcode,
+									HASH_REMOVE, NULL);
+	}
+	LWLockRelease(partitionLock);
 }
 
 /* ---------------------------------------------------------------------------
@@ -626,8 +828,12 @@ ReplicationIdentifierShmemInit(void)
  * +-------+-------------------------+-------------------------+-----+
  *
  * So its just the magic, followed by the statically sized
- * ReplicationStates. Note that the maximum number of ReplicationStates is
- * determined by max_replication_slots.
+ * ReplicationStateOnDisks. Note that the maximum number of ReplicationStates
+ * is determined by max_replication_slots.
+ *
+ * Every checkpoint file contains the state of all nodes, but only the states
+ * that changed since the last checkpoint need their commit records to be
+ * flushed; that's done with a single XLogFlush() up to the newest of them.
  *
  * FIXME: Add a CRC32 to the end.
  * ---------------------------------------------------------------------------
@@ -641,6 +847,9 @@ CheckPointReplicationIdentifier(XLogRecPtr ckpt)
 	int tmpfd;
 	int i;
 	uint32 magic = REPLICATION_STATE_MAGIC;
+	ReplicationStateOnDisk *disk_states;
+	int			ndisk_states = 0;
+	XLogRecPtr	flush_upto = InvalidXLogRecPtr;
 
 	if (max_replication_slots == 0)
 		return;
@@ -703,32 +912,52 @@ CheckPointReplicationIdentifier(XLogRecPtr ckpt)
 						tmppath)));
 	}
 
-	/* write actual data */
+	/* collect actual data */
+	disk_states = (ReplicationStateOnDisk *)
+		palloc(sizeof(ReplicationStateOnDisk) * max_replication_slots);
+
 	for (i = 0; i < max_replication_slots; i++)
 	{
-		ReplicationState local_state;
+		ReplicationState *state = &ReplicationStates[i];
+		ReplicationStateOnDisk *disk_state = &disk_states[ndisk_states];
 
-		if (ReplicationStates[i].local_identifier == InvalidRepNodeId)
+		SpinLockAcquire(&state->mutex);
+		if (state->local_identifier == InvalidRepNodeId)
+		{
+			SpinLockRelease(&state->mutex);
 			continue;
+		}
 
-		local_state.local_identifier = ReplicationStates[i].local_identifier;
-		local_state.remote_lsn = ReplicationStates[i].remote_lsn;
-		local_state.local_lsn = InvalidXLogRecPtr;
+		disk_state->local_identifier = state->local_identifier;
+		disk_state->remote_lsn = state->remote_lsn;
+		disk_state->local_lsn = InvalidXLogRecPtr;
 
-		/* make sure we only write out a commit that's persistent */
-		XLogFlush(ReplicationStates[i].local_lsn);
+		/* the commit records of unchanged states have been flushed before */
+		if (state->dirty && state->local_lsn > flush_upto)
+			flush_upto = state->local_lsn;
+		state->dirty = false;
+		SpinLockRelease(&state->mutex);
 
-		if ((write(tmpfd, &local_state, sizeof(ReplicationState))) !=
-			sizeof(ReplicationState))
-		{
-			CloseTransientFile(tmpfd);
-			ereport(PANIC,
-					(errcode_for_file_access(),
-					 errmsg("could not write replication identifier checkpoint \"%s\": %m",
-							tmppath)));
-		}
+		ndisk_states++;
+	}
+
+	/* make sure we only write out commits that are persistent */
+	XLogFlush(flush_upto);
+
+	/* write actual data */
+	if (ndisk_states > 0 &&
+		(write(tmpfd, disk_states, sizeof(ReplicationStateOnDisk) * ndisk_states)) !=
+		sizeof(ReplicationStateOnDisk) * ndisk_states)
+	{
+		CloseTransientFile(tmpfd);
+		ereport(PANIC,
+				(errcode_for_file_access(),
+				 errmsg("could not write replication identifier checkpoint \"%s\": %m",
+						tmppath)));
 	}
 
+	pfree(disk_states);
+
 	/* fsync the file */
 	if (pg_fsync(tmpfd) != 0)
 	{
@@ -836,7 +1065,6 @@ StartupReplicationIdentifier(XLogRecPtr ckpt)
 	int fd;
 	int readBytes;
 	uint32 magic = REPLICATION_STATE_MAGIC;
-	int last_state = 0;
 
 	/* don't want to overwrite already existing state */
 #ifdef USE_ASSERT_CHECKING
@@ -883,7 +1111,9 @@ StartupReplicationIdentifier(XLogRecPtr ckpt)
 	/* recover individual states, until there are no more to be found */
 	while (true)
 	{
-		ReplicationState local_state;
+		ReplicationStateOnDisk local_state;
+		ReplicationState *state;
+
 		readBytes = read(fd, &local_state, sizeof(local_state));
 
 		/* no further data */
@@ -906,13 +1136,18 @@ StartupReplicationIdentifier(XLogRecPtr ckpt)
 							path, readBytes, sizeof(local_state))));
 		}
 
-		if (last_state == max_replication_slots)
+		state = ReplicationStateLookup(local_state.local_identifier, true);
+		if (state == NULL)
 			ereport(PANIC,
 					(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
 					 errmsg("no free replication state could be found, increase max_replication_slots")));
 
 		/* copy data shared memory */
-		ReplicationStates[last_state++] = local_state;
+		SpinLockAcquire(&state->mutex);
+		state->remote_lsn = local_state.remote_lsn;
+		state->local_lsn = InvalidXLogRecPtr;
+		state->dirty = false;
+		SpinLockRelease(&state->mutex);
 
 		elog(LOG, "recovered replication state of node %u to %X/%X",
 			 local_state.local_identifier,
@@ -923,6 +1158,39 @@ StartupReplicationIdentifier(XLogRecPtr ckpt)
 	CloseTransientFile(fd);
 }
 
+/*
+ * Move the progress of a replication state forward.
+ */
+static void
+ReplicationStateAdvance(ReplicationState *state,
+						XLogRecPtr remote_commit,
+						XLogRecPtr local_commit)
+{
+	SpinLockAcquire(&state->mutex);
+	ReplicationStateAdvanceLocked(state, remote_commit, local_commit);
+	SpinLockRelease(&state->mutex);
+}
+
+/*
+ * Like ReplicationStateAdvance(), with the state's mutex already held.
+ */
+static void
+ReplicationStateAdvanceLocked(ReplicationState *state,
+							  XLogRecPtr remote_commit,
+							  XLogRecPtr local_commit)
+{
+	/*
+	 * Due to - harmless - race conditions during a checkpoint we could see
+	 * values here that are older than the ones we already have in
+	 * memory. Don't overwrite those.
+	 */
+	if (state->remote_lsn < remote_commit)
+		state->remote_lsn = remote_commit;
+	if (state->local_lsn < local_commit)
+		state->local_lsn = local_commit;
+	state->dirty = true;
+}
+
 /*
  * Tell the replication identifier machinery that a commit from 'node' that
  * originated at the LSN remote_commit on the remote node was replayed
@@ -939,9 +1207,7 @@ AdvanceReplicationIdentifier(RepNodeId node,
 							 XLogRecPtr remote_commit,
 							 XLogRecPtr local_commit)
 {
-	int i;
-	int free_slot = -1;
-	ReplicationState *replication_state = NULL;
+	ReplicationState *replication_state;
 
 	Assert(node != InvalidRepNodeId);
 
@@ -949,63 +1215,38 @@ AdvanceReplicationIdentifier(RepNodeId node,
 	if (node == DoNotReplicateRepNodeId)
 		return;
 
-	/*
-	 * XXX: should we restore into a hashtable and dump into shmem only after
-	 * recovery finished?
-	 */
-
-	/* check whether slot already exists */
-	for (i = 0; i < max_replication_slots; i++)
+	for (;;)
 	{
-		/* remember where to insert if necessary */
-		if (ReplicationStates[i].local_identifier == InvalidRepNodeId &&
-			free_slot == -1)
-		{
-			free_slot = i;
-			continue;
-		}
-
-		/* not our slot */
-		if (ReplicationStates[i].local_identifier != node)
-			continue;
+		replication_state = ReplicationStateLookup(node, true);
 
-		/* ok, found slot */
-		replication_state = &ReplicationStates[i];
-		break;
-	}
+		if (replication_state == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+					 errmsg("no free replication state could be found for %u, increase max_replication_slots",
+							node)));
 
-	if (replication_state == NULL && free_slot == -1)
-		ereport(ERROR,
-				(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
-				 errmsg("no free replication state could be found for %u, increase max_replication_slots",
-						node)));
-	/* initialize new slot */
-	else if (replication_state == NULL)
-	{
-		replication_state = &ReplicationStates[free_slot];
-		Assert(replication_state->remote_lsn == InvalidXLogRecPtr);
-		Assert(replication_state->local_lsn == InvalidXLogRecPtr);
-		replication_state->local_identifier = node;
+		/*
+		 * The partition lock isn't held anymore, so the state might have
+		 * been released and claimed for another node in the meantime. Only
+		 * advance it if it still belongs to ours, otherwise look it up again.
+		 */
+		SpinLockAcquire(&replication_state->mutex);
+		if (replication_state->local_identifier == node)
+		{
+			ReplicationStateAdvanceLocked(replication_state,
+										  remote_commit, local_commit);
+			SpinLockRelease(&replication_state->mutex);
+			break;
+		}
+		SpinLockRelease(&replication_state->mutex);
 	}
-
-	Assert(replication_state->local_identifier != InvalidRepNodeId);
-
-	/*
-	 * Due to - harmless - race conditions during a checkpoint we could see
-	 * values here that are older than the ones we already have in
-	 * memory. Don't overwrite those.
-	 */
-	if (replication_state->remote_lsn < remote_commit)
-		replication_state->remote_lsn = remote_commit;
-	if (replication_state->local_lsn < local_commit)
-		replication_state->local_lsn = local_commit;
 }
 
 
 /*
  * Setup a replication identifier in the shared memory struct if it doesn't
- * already exists and cache access to the specific ReplicationSlot so the
- * array doesn't have to be searched when calling
+ * already exists and cache access to the specific ReplicationSlot so it
+ * doesn't have to be looked up when calling
  * AdvanceCachedReplicationIdentifier().
  *
  * Obviously only one such cached identifier can exist per process and the
@@ -1015,10 +1256,6 @@ AdvanceReplicationIdentifier(RepNodeId node,
 void
 SetupCachedReplicationIdentifier(RepNodeId node)
 {
-	int i;
-	int free_slot = -1;
-
-
 	Assert(max_replication_slots > 0);
 
 	if (local_replication_state != NULL)
@@ -1026,42 +1263,14 @@ SetupCachedReplicationIdentifier(RepNodeId node)
 				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
 				 errmsg("cannot setup replication origin when one is already setup")));
 
-	/*
-	 * Search for either an existing slot for that identifier or a free one we
-	 * can use.
-	 */
-	for (i = 0; i < max_replication_slots; i++)
-	{
-		/* remember where to insert if necessary */
-		if (ReplicationStates[i].local_identifier == InvalidRepNodeId &&
-			free_slot == -1)
-		{
-			free_slot = i;
-			continue;
-		}
+	/* find either an existing state for that identifier or set up a new one */
+	local_replication_state = ReplicationStateLookup(node, true);
 
-		/* not our slot */
-		if (ReplicationStates[i].local_identifier != node)
-			continue;
-
-		local_replication_state = &ReplicationStates[i];
-	}
-
-
-	if (local_replication_state == NULL && free_slot == -1)
+	if (local_replication_state == NULL)
 		ereport(ERROR,
 				(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
 				 errmsg("no free replication state could be found for %u, increase max_replication_slots",
 						node)));
-	else if (local_replication_state == NULL)
-	{
-		local_replication_state = &ReplicationStates[free_slot];
-		local_replication_state->local_identifier = node;
-		Assert(local_replication_state->remote_lsn == InvalidXLogRecPtr);
-		Assert(local_replication_state->local_lsn == InvalidXLogRecPtr);
-	}
-
-	Assert(local_replication_state->local_identifier != InvalidRepNodeId);
 }
 
 /*
@@ -1094,10 +1303,8 @@ AdvanceCachedReplicationIdentifier(XLogRecPtr remote_commit,
 								   XLogRecPtr local_commit)
 {
 	Assert(local_replication_state != NULL);
-	if (local_replication_state->local_lsn < local_commit)
-		local_replication_state->local_lsn = local_commit;
-	if (local_replication_state->remote_lsn < remote_commit)
-		local_replication_state->remote_lsn = remote_commit;
+	ReplicationStateAdvance(local_replication_state,
+							remote_commit, local_commit);
 }
 
 /*
@@ -1107,6 +1314,13 @@ AdvanceCachedReplicationIdentifier(XLogRecPtr remote_commit,
 XLogRecPtr
 RemoteCommitFromCachedReplicationIdentifier(void)
 {
+	XLogRecPtr	remote_lsn;
+
 	Assert(local_replication_state != NULL);
-	return local_replication_state->remote_lsn;
+
+	SpinLockAcquire(&local_replication_state->mutex);
+	remote_lsn = local_replication_state->remote_lsn;
+	SpinLockRelease(&local_replication_state->mutex);
+
+	return remote_lsn;
 }
@@ -135,6 +135,7 @@
 #include "utils/memutils.h"
 #include "utils/snapshot.h"
 #include "utils/snapmgr.h"
+#include "utils/timestamp.h"
 #include "utils/tqual.h"
 
 #include "storage/block.h"		/* debugging output */
@@ -142,8 +143,25 @@
 #include "storage/lmgr.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
+#include "storage/spin.h"
 #include "storage/standby.h"
 
+/*
+ * Word of the sparse bitmap of committed transactions, see
+ * SnapBuild->committed. Bit n of 'bits' is set if base + n committed; 'base'
+ * is a multiple of SNAPBUILD_XIDS_PER_WORD.
+ */
+typedef struct SnapBuildXidWord
+{
+	TransactionId base;
+	uint32		bits;
+} SnapBuildXidWord;
+
+#define SNAPBUILD_XIDS_PER_WORD 32
+#define SnapBuildXidWordBase(xid) ((xid) & ~(SNAPBUILD_XIDS_PER_WORD - 1))
+#define SnapBuildXidWordBit(xid) \
+	(((uint32) 1) << ((xid) % SNAPBUILD_XIDS_PER_WORD))
+
 /*
  * This struct contains the current state of the snapshot building
  * machinery. Besides a forward declaration in the header, it is not exposed
@@ -189,6 +207,16 @@ struct SnapBuild
 	 */
 	XLogRecPtr	last_serialized_snapshot;
 
+	/*
+	 * Location of a snapshot that has been written out, by us or, if
+	 * pending_shared is set, by another decoder, but that isn't known to be
+	 * safely on disk yet, and when we last serialized a snapshot.  Only used
+	 * in memory.
+	 */
+	XLogRecPtr	pending_snapshot;
+	bool		pending_shared;
+	TimestampTz last_serialization;
+
 	/*
 	 * The reorderbuffer we need to update with usable snapshots et al.
 	 */
@@ -215,16 +243,16 @@ struct SnapBuild
 	}			was_running;
 
 	/*
-	 * Array of transactions which could have catalog changes that committed
+	 * Set of transactions which could have catalog changes that committed
 	 * between xmin and xmax.
 	 */
 	struct
 	{
-		/* number of committed transactions */
-		size_t		xcnt;
+		/* number of used words */
+		size_t		nwords;
 
-		/* available space for committed transactions */
-		size_t		xcnt_space;
+		/* available space for words */
+		size_t		nwords_space;
 
 		/*
 		 * Until we reach a CONSISTENT state, we record commits of all
@@ -234,23 +262,41 @@ struct SnapBuild
 		bool		includes_all_transactions;
 
 		/*
-		 * Array of committed transactions that have modified the catalog.
+		 * Committed transactions that have modified the catalog, as a sparse
+		 * bitmap: each word covers SNAPBUILD_XIDS_PER_WORD consecutive xids,
+		 * and the words are kept sorted by their base xid using the same
+		 * order as xidComparator.
 		 *
-		 * As this array is frequently modified we do *not* keep it in
-		 * xidComparator order. Instead we sort the array when building &
-		 * distributing a snapshot.
-		 *
-		 * TODO: It's unclear whether that reasoning has much merit. Every
-		 * time we add something here after becoming consistent will also
-		 * require distributing a snapshot. Storing them sorted would
-		 * potentially also make it easier to purge (but more complicated wrt
-		 * wraparound?). Should be improved if sorting while building the
-		 * snapshot shows up in profiles.
+		 * Commits mostly arrive in xid order, so adding an xid usually just
+		 * sets a bit in the last word, and workloads committing lots of
+		 * catalog modifying transactions (e.g. creating temporary tables)
+		 * need a fraction of the memory an array of xids would. Keeping the
+		 * words sorted means snapshots can be built by copying them.
 		 */
-		TransactionId *xip;
+		SnapBuildXidWord *words;
 	}			committed;
 };
 
+/*
+ * Shared state letting decoders reaching a serialization point at the same
+ * LSN serialize only one snapshot between them.
+ */
+typedef struct SnapBuildSharedState
+{
+	slock_t		mutex;
+
+	/* snapshot some decoder is writing out currently */
+	XLogRecPtr	writing_lsn;
+
+	/* snapshot most recently made durable by some decoder */
+	XLogRecPtr	durable_lsn;
+} SnapBuildSharedState;
+
+static SnapBuildSharedState *SnapBuildShared = NULL;
+
+/* GUCs */
+int			logical_decoding_serialize_interval = 1000;
+
 /*
  * Starting a transaction -- which we need to do while exporting a snapshot --
  * removes knowledge about the previously used resowner, so we save it here.
@@ -276,6 +322,7 @@ static void SnapBuildWaitSnapshot(xl_running_xacts *running, TransactionId cutof
 
 /* serialization functions */
 static void SnapBuildSerialize(SnapBuild *builder, XLogRecPtr lsn);
+static void SnapBuildFinishSerialize(SnapBuild *builder);
 static bool SnapBuildRestore(SnapBuild *builder, XLogRecPtr lsn);
 
 /*
@@ -337,10 +384,10 @@ AllocateSnapshotBuilder(ReorderBuffer *reorder,
 	builder->reorder = reorder;
 	/* Other struct members initialized by zeroing via palloc0 above */
 
-	builder->committed.xcnt = 0;
-	builder->committed.xcnt_space = 128;		/* arbitrary number */
-	builder->committed.xip =
-		palloc0(builder->committed.xcnt_space * sizeof(TransactionId));
+	builder->committed.nwords = 0;
+	builder->committed.nwords_space = 128;		/* arbitrary number */
+	builder->committed.words =
+		palloc0(builder->committed.nwords_space * sizeof(SnapBuildXidWord));
 	builder->committed.includes_all_transactions = true;
 
 	builder->initial_xmin_horizon = xmin_horizon;
@@ -360,6 +407,15 @@ FreeSnapshotBuilder(SnapBuild *builder)
 {
 	MemoryContext context = builder->context;
 
+	/*
+	 * Finish a snapshot we have written out but not made durable yet.
+	 * Otherwise a decoding session reaching at most one serialization point,
+	 * e.g. a short pg_logical_slot_get_changes() call, would never leave a
+	 * snapshot the slot's restart point can advance to next time.
+	 */
+	if (builder->pending_snapshot != InvalidXLogRecPtr)
+		SnapBuildFinishSerialize(builder);
+
 	/* free snapshot explicitly, that contains some error checking */
 	if (builder->snapshot != NULL)
 	{
@@ -473,7 +529,7 @@ SnapBuildBuildSnapshot(SnapBuild *builder, TransactionId xid)
 	Assert(builder->state >= SNAPBUILD_FULL_SNAPSHOT);
 
 	ssize = sizeof(SnapshotData)
-		+ sizeof(TransactionId) * builder->committed.xcnt
+		+ sizeof(SnapBuildXidWord) * builder->committed.nwords
 		+ sizeof(TransactionId) * 1 /* toplevel xid */ ;
 
 	snapshot = MemoryContextAllocZero(builder->context, ssize);
@@ -487,7 +543,10 @@ SnapBuildBuildSnapshot(SnapBuild *builder, TransactionId xid)
 	 * In the 'xip' array we store transactions that have to be treated as
 	 * committed. Since we will only ever look at tuples from transactions
 	 * that have modified the catalog it's more efficient to store those few
-	 * that exist between xmin and xmax (frequently there are none).
+	 * that exist between xmin and xmax (frequently there are none). They are
+	 * stored in the same sparse bitmap format as builder->committed, each
+	 * word taking up two xip entries, so 'xcnt' is twice the number of
+	 * words; use SnapBuildXidCommitted() to search it.
 	 *
 	 * Snapshots that are used in transactions that have modified the catalog
 	 * also use the 'subxip' array to store their toplevel xid and all the
@@ -499,7 +558,7 @@ SnapBuildBuildSnapshot(SnapBuild *builder, TransactionId xid)
 	 * doesn't need to treat any uncommitted rows as visible, so there is no
 	 * need for those xids.
 	 *
-	 * Both arrays are qsort'ed so that we can use bsearch() on them.
+	 * Both arrays are sorted so that we can binary search them.
 	 */
 	Assert(TransactionIdIsNormal(builder->xmin));
 	Assert(TransactionIdIsNormal(builder->xmax));
@@ -507,16 +566,18 @@ SnapBuildBuildSnapshot(SnapBuild *builder, TransactionId xid)
 	snapshot->xmin = builder->xmin;
 	snapshot->xmax = builder->xmax;
 
-	/* store all transactions to be treated as committed by this snapshot */
+	/*
+	 * store all transactions to be treated as committed by this snapshot;
+	 * the words already are in the right order
+	 */
+	StaticAssertStmt(sizeof(SnapBuildXidWord) == 2 * sizeof(TransactionId),
+					 "SnapBuildXidWord has to fit in two xip entries");
 	snapshot->xip =
 		(TransactionId *) ((char *) snapshot + sizeof(SnapshotData));
-	snapshot->xcnt = builder->committed.xcnt;
+	snapshot->xcnt = builder->committed.nwords * 2;
 	memcpy(snapshot->xip,
-		   builder->committed.xip,
-		   builder->committed.xcnt * sizeof(TransactionId));
-
-	/* sort so we can bsearch() */
-	qsort(snapshot->xip, snapshot->xcnt, sizeof(TransactionId), xidComparator);
+		   builder->committed.words,
+		   builder->committed.nwords * sizeof(SnapBuildXidWord));
 
 	/*
 	 * Initially, subxip is empty, i.e. it's a snapshot to be used by
@@ -616,16 +677,11 @@ SnapBuildExportSnapshot(SnapBuild *builder)
 	 */
 	for (xid = snap->xmin; NormalTransactionIdPrecedes(xid, snap->xmax);)
 	{
-		void	   *test;
-
 		/*
 		 * Check whether transaction committed using the decoding snapshot
 		 * meaning of ->xip.
 		 */
-		test = bsearch(&xid, snap->xip, snap->xcnt,
-					   sizeof(TransactionId), xidComparator);
-
-		if (test == NULL)
+		if (!SnapBuildXidCommitted(snap, xid))
 		{
 			if (newxcnt >= GetMaxSnapshotXidCount())
 				elog(ERROR, "snapshot too large");
@@ -767,54 +823,73 @@ SnapBuildProcessNewCid(SnapBuild *builder, TransactionId xid,
 }
 
 /*
- * Add a new Snapshot to all transactions we're decoding that currently are
- * in-progress so they can see new catalog contents made by the transaction
- * that just committed. This is necessary because those in-progress
- * transactions will use the new catalog's contents from here on (at the very
- * least everything they do needs to be compatible with newer catalog
- * contents).
+ * Make the new Snapshot available to all transactions we're decoding that
+ * currently are in-progress so they can see new catalog contents made by the
+ * transaction that just committed. This is necessary because those
+ * in-progress transactions will use the new catalog's contents from here on
+ * (at the very least everything they do needs to be compatible with newer
+ * catalog contents).
+ *
+ * Transactions without a base snapshot yet don't have any changes, which in
+ * turn implies they don't need a snapshot at all yet. They'll get a base
+ * snapshot when their first change gets queued, and will only switch to
+ * snapshots built after that. The snapshot is shared by all transactions,
+ * see ReorderBufferAddCatalogSnapshot().
  */
 static void
 SnapBuildDistributeNewCatalogSnapshot(SnapBuild *builder, XLogRecPtr lsn)
 {
-	dlist_iter	txn_i;
-	ReorderBufferTXN *txn;
+	/* increase the snapshot's refcount for the reorder buffer */
+	SnapBuildSnapIncRefcount(builder->snapshot);
+	ReorderBufferAddCatalogSnapshot(builder->reorder, lsn, builder->snapshot);
+}
 
-	/*
-	 * Iterate through all toplevel transactions. This can include
-	 * subtransactions which we just don't yet know to be that, but that's
-	 * fine, they will just get an unneccesary snapshot queued.
-	 */
-	dlist_foreach(txn_i, &builder->reorder->toplevel_by_lsn)
+/*
+ * Binary search the sorted words for the one with the given base. Returns its
+ * position if found, otherwise the position it would have to be inserted at.
+ */
+static size_t
+SnapBuildFindXidWord(SnapBuildXidWord *words, size_t nwords,
+					 TransactionId base, bool *found)
+{
+	size_t		low = 0;
+	size_t		high = nwords;
+
+	while (low < high)
 	{
-		txn = dlist_container(ReorderBufferTXN, node, txn_i.cur);
+		size_t		mid = low + (high - low) / 2;
 
-		Assert(TransactionIdIsValid(txn->xid));
+		if (words[mid].base == base)
+		{
+			*found = true;
+			return mid;
+		}
+		else if (words[mid].base < base)
+			low = mid + 1;
+		else
+			high = mid;
+	}
 
-		/*
-		 * If we don't have a base snapshot yet, there are no changes in this
-		 * transaction which in turn implies we don't yet need a snapshot at
-		 * all. We'll add a snapshot when the first change gets queued.
-		 *
-		 * NB: This works correctly even for subtransactions because
-		 * ReorderBufferAssignChild() takes care to transfer the base snapshot
-		 * to the top-level transaction, and while iterating the changequeue
-		 * we'll get the change from the subtxn.
-		 */
-		if (!ReorderBufferXidHasBaseSnapshot(builder->reorder, txn->xid))
-			continue;
+	*found = false;
+	return low;
+}
 
-		elog(DEBUG2, "adding a new snapshot to %u at %X/%X",
-			 txn->xid, (uint32) (lsn >> 32), (uint32) lsn);
+/*
+ * Check whether xid is to be treated as committed by the historic snapshot
+ * snap, i.e. whether it is in the sparse bitmap stored in snap->xip (see
+ * SnapBuildBuildSnapshot()).
+ */
+bool
+SnapBuildXidCommitted(Snapshot snap, TransactionId xid)
+{
+	SnapBuildXidWord *words = (SnapBuildXidWord *) snap->xip;
+	size_t		off;
+	bool		found;
 
-		/*
-		 * increase the snapshot's refcount for the transaction we are handing
-		 * it out to
-		 */
-		SnapBuildSnapIncRefcount(builder->snapshot);
-		ReorderBufferAddSnapshot(builder->reorder, txn->xid, lsn,
-								 builder->snapshot);
-	}
+	off = SnapBuildFindXidWord(words, snap->xcnt / 2,
+							   SnapBuildXidWordBase(xid), &found);
+
+	return found && (words[off].bits & SnapBuildXidWordBit(xid)) != 0;
 }
 
 /*
@@ -823,68 +898,81 @@ SnapBuildDistributeNewCatalogSnapshot(SnapBuild *builder, XLogRecPtr lsn)
 static void
 SnapBuildAddCommittedTxn(SnapBuild *builder, TransactionId xid)
 {
+	SnapBuildXidWord *words = builder->committed.words;
+	TransactionId base = SnapBuildXidWordBase(xid);
+	size_t		off;
+	bool		found;
+
 	Assert(TransactionIdIsValid(xid));
 
-	if (builder->committed.xcnt == builder->committed.xcnt_space)
+	/* fast path: transactions mostly commit in xid order */
+	if (builder->committed.nwords > 0 &&
+		words[builder->committed.nwords - 1].base == base)
 	{
-		builder->committed.xcnt_space = builder->committed.xcnt_space * 2 + 1;
+		words[builder->committed.nwords - 1].bits |= SnapBuildXidWordBit(xid);
+		return;
+	}
 
-		elog(DEBUG1, "increasing space for committed transactions to %u",
-			 (uint32) builder->committed.xcnt_space);
+	off = SnapBuildFindXidWord(words, builder->committed.nwords, base, &found);
+	if (found)
+	{
+		words[off].bits |= SnapBuildXidWordBit(xid);
+		return;
+	}
+
+	if (builder->committed.nwords == builder->committed.nwords_space)
+	{
+		builder->committed.nwords_space = builder->committed.nwords_space * 2 + 1;
+
+		elog(DEBUG1, "increasing space for committed transactions to %u words",
+			 (uint32) builder->committed.nwords_space);
 
-		builder->committed.xip = repalloc(builder->committed.xip,
-					  builder->committed.xcnt_space * sizeof(TransactionId));
+		builder->committed.words = words =
+			repalloc(words,
+				builder->committed.nwords_space * sizeof(SnapBuildXidWord));
 	}
 
-	/*
-	 * TODO: It might make sense to keep the array sorted here instead of
-	 * doing it every time we build a new snapshot. On the other hand this
-	 * gets called repeatedly when a transaction with subtransactions commits.
-	 */
-	builder->committed.xip[builder->committed.xcnt++] = xid;
+	memmove(&words[off + 1], &words[off],
+			(builder->committed.nwords - off) * sizeof(SnapBuildXidWord));
+	words[off].base = base;
+	words[off].bits = SnapBuildXidWordBit(xid);
+	builder->committed.nwords++;
 }
 
 /*
  * Remove knowledge about transactions we treat as committed that are smaller
- * than ->xmin. Those won't ever get checked via the ->commited array but via
+ * than ->xmin. Those won't ever get checked via the ->commited set but via
  * the clog machinery, so we don't need to waste memory on them.
+ *
+ * Only words consisting entirely of such xids are removed; bits below ->xmin
+ * in the remaining words are harmless.
  */
 static void
 SnapBuildPurgeCommittedTxn(SnapBuild *builder)
 {
-	int			off;
-	TransactionId *workspace;
-	int			surviving_xids = 0;
+	SnapBuildXidWord *words = builder->committed.words;
+	size_t		off;
+	size_t		surviving_words = 0;
 
 	/* not ready yet */
 	if (!TransactionIdIsNormal(builder->xmin))
 		return;
 
-	/* TODO: Neater algorithm than just copying and iterating? */
-	workspace =
-		MemoryContextAlloc(builder->context,
-						   builder->committed.xcnt * sizeof(TransactionId));
-
-	/* copy xids that still are interesting to workspace */
-	for (off = 0; off < builder->committed.xcnt; off++)
+	/* compact the words that still are interesting in place */
+	for (off = 0; off < builder->committed.nwords; off++)
 	{
-		if (NormalTransactionIdPrecedes(builder->committed.xip[off],
-										builder->xmin))
+		TransactionId last = words[off].base + SNAPBUILD_XIDS_PER_WORD - 1;
+
+		if (TransactionIdPrecedes(last, builder->xmin))
 			;					/* remove */
 		else
-			workspace[surviving_xids++] = builder->committed.xip[off];
+			words[surviving_words++] = words[off];
 	}
 
-	/* copy workspace back to persistent state */
-	memcpy(builder->committed.xip, workspace,
-		   surviving_xids * sizeof(TransactionId));
-
-	elog(DEBUG3, "purged committed transactions from %u to %u, xmin: %u, xmax: %u",
-		 (uint32) builder->committed.xcnt, (uint32) surviving_xids,
+	elog(DEBUG3, "purged committed transactions from %u to %u words, xmin: %u, xmax: %u",
+		 (uint32) builder->committed.nwords, (uint32) surviving_words,
 		 builder->xmin, builder->xmax);
-	builder->committed.xcnt = surviving_xids;
-
-	pfree(workspace);
+	builder->committed.nwords = surviving_words;
 }
 
 /*
@@ -1392,7 +1480,7 @@ SnapBuildWaitSnapshot(xl_running_xacts *running, TransactionId cutoff)
  *
  * struct SnapBuildOnDisk;
  * TransactionId * running.xcnt_space;
- * TransactionId * committed.xcnt; (*not xcnt_space*)
+ * SnapBuildXidWord * committed.nwords; (*not nwords_space*)
  *
  */
 typedef struct SnapBuildOnDisk
@@ -1413,7 +1501,7 @@ typedef struct SnapBuildOnDisk
 	/* version dependent part */
 	SnapBuild	builder;
 
-	/* variable amount of TransactionIds follows */
+	/* variable amount of TransactionIds and SnapBuildXidWords follows */
 } SnapBuildOnDisk;
 
 #define SnapBuildOnDiskConstantSize \
@@ -1422,7 +1510,35 @@ typedef struct SnapBuildOnDisk
 	offsetof(SnapBuildOnDisk, version)
 
 #define SNAPBUILD_MAGIC 0x51A1E001
-#define SNAPBUILD_VERSION 2
+#define SNAPBUILD_VERSION 4
+
+/*
+ * Report shared memory space needed by SnapBuildShmemInit.
+ */
+Size
+SnapBuildShmemSize(void)
+{
+	return sizeof(SnapBuildSharedState);
+}
+
+/*
+ * Allocate and initialize the state shared between snapshot builders.
+ */
+void
+SnapBuildShmemInit(void)
+{
+	bool		found;
+
+	SnapBuildShared = (SnapBuildSharedState *)
+		ShmemInitStruct("Logical Decoding Snapshot Builder",
+						SnapBuildShmemSize(), &found);
+
+	if (!found)
+	{
+		MemSet(SnapBuildShared, 0, SnapBuildShmemSize());
+		SpinLockInit(&SnapBuildShared->mutex);
+	}
+}
 
 /*
  * Store/Load a snapshot from disk, depending on the snapshot builder's state.
@@ -1442,6 +1558,14 @@ SnapBuildSerializationPoint(SnapBuild *builder, XLogRecPtr lsn)
 /*
  * Serialize the snapshot 'builder' at the location 'lsn' if it hasn't already
  * been done by another decoding process.
+ *
+ * To keep fsyncs out of the way of decoding, the snapshot is only written
+ * out here, and the kernel is asked to start writing it back.  Only once we
+ * reach the next serialization point, when that normally has been done, or
+ * the snapshot builder is freed, it is fsynced and renamed into place by
+ * SnapBuildFinishSerialize(), and becomes usable as a restart point.  Snapshots are serialized at most every
+ * logical_decoding_serialize_interval, and if another decoder already writes
+ * out the snapshot at the same location, we use that one.
  */
 static void
 SnapBuildSerialize(SnapBuild *builder, XLogRecPtr lsn)
@@ -1455,6 +1579,9 @@ SnapBuildSerialize(SnapBuild *builder, XLogRecPtr lsn)
 	int			ret;
 	struct stat stat_buf;
 	Size		sz;
+	TimestampTz now;
+	bool		durable;
+	bool		writing;
 
 	Assert(lsn != InvalidXLogRecPtr);
 	Assert(builder->last_serialized_snapshot == InvalidXLogRecPtr ||
@@ -1467,6 +1594,43 @@ SnapBuildSerialize(SnapBuild *builder, XLogRecPtr lsn)
 	if (builder->state < SNAPBUILD_CONSISTENT)
 		return;
 
+	/* the previously written snapshot should be on disk by now, finish it */
+	if (builder->pending_snapshot != InvalidXLogRecPtr)
+		SnapBuildFinishSerialize(builder);
+
+	/* don't serialize more often than configured */
+	now = GetCurrentTimestamp();
+	if (builder->last_serialization != 0 &&
+		!TimestampDifferenceExceeds(builder->last_serialization, now,
+									logical_decoding_serialize_interval))
+		goto out;
+
+	builder->last_serialization = now;
+
+	/*
+	 * Check whether another decoder already serialized this location, or is
+	 * doing so right now.  Otherwise, announce that we do.
+	 */
+	SpinLockAcquire(&SnapBuildShared->mutex);
+	durable = SnapBuildShared->durable_lsn == lsn;
+	writing = SnapBuildShared->writing_lsn == lsn;
+	if (!durable && !writing)
+		SnapBuildShared->writing_lsn = lsn;
+	SpinLockRelease(&SnapBuildShared->mutex);
+
+	if (durable)
+	{
+		builder->last_serialized_snapshot = lsn;
+		goto out;
+	}
+	else if (writing)
+	{
+		/* use the other decoder's snapshot once it's on disk */
+		builder->pending_snapshot = lsn;
+		builder->pending_shared = true;
+		goto out;
+	}
+
 	/*
 	 * We identify snapshots by the LSN they are valid for. We don't need to
 	 * include timelines in the name as each LSN maps to exactly one timeline
@@ -1478,8 +1642,9 @@ SnapBuildSerialize(SnapBuild *builder, XLogRecPtr lsn)
 
 	/*
 	 * first check whether some other backend already has written the snapshot
-	 * for this LSN. It's perfectly fine if there's none, so we accept ENOENT
-	 * as a valid state. Everything else is an unexpected error.
+	 * for this LSN, e.g. before a restart. It's perfectly fine if there's
+	 * none, so we accept ENOENT as a valid state. Everything else is an
+	 * unexpected error.
 	 */
 	ret = stat(path, &stat_buf);
 
@@ -1502,6 +1667,12 @@ SnapBuildSerialize(SnapBuild *builder, XLogRecPtr lsn)
 		fsync_fname(path, false);
 		fsync_fname("pg_logical/snapshots", true);
 
+		SpinLockAcquire(&SnapBuildShared->mutex);
+		SnapBuildShared->durable_lsn = lsn;
+		if (SnapBuildShared->writing_lsn == lsn)
+			SnapBuildShared->writing_lsn = InvalidXLogRecPtr;
+		SpinLockRelease(&SnapBuildShared->mutex);
+
 		builder->last_serialized_snapshot = lsn;
 		goto out;
 	}
@@ -1531,7 +1702,7 @@ SnapBuildSerialize(SnapBuild *builder, XLogRecPtr lsn)
 				 errmsg("could not remove file \"%s\": %m", tmppath)));
 
 	needed_length = sizeof(SnapBuildOnDisk) +
-		sizeof(TransactionId) * builder->committed.xcnt;
+		sizeof(SnapBuildXidWord) * builder->committed.nwords;
 
 	ondisk_c = MemoryContextAllocZero(builder->context, needed_length);
 	ondisk = (SnapBuildOnDisk *) ondisk_c;
@@ -1549,7 +1720,10 @@ SnapBuildSerialize(SnapBuild *builder, XLogRecPtr lsn)
 	ondisk->builder.context = NULL;
 	ondisk->builder.snapshot = NULL;
 	ondisk->builder.reorder = NULL;
-	ondisk->builder.committed.xip = NULL;
+	ondisk->builder.committed.words = NULL;
+	ondisk->builder.pending_snapshot = InvalidXLogRecPtr;
+	ondisk->builder.pending_shared = false;
+	ondisk->builder.last_serialization = 0;
 
 	COMP_CRC32(ondisk->checksum,
 			   &ondisk->builder,
@@ -1559,8 +1733,8 @@ SnapBuildSerialize(SnapBuild *builder, XLogRecPtr lsn)
 	Assert(builder->was_running.was_xcnt == 0);
 
 	/* copy committed xacts */
-	sz = sizeof(TransactionId) * builder->committed.xcnt;
-	memcpy(ondisk_c, builder->committed.xip, sz);
+	sz = sizeof(SnapBuildXidWord) * builder->committed.nwords;
+	memcpy(ondisk_c, builder->committed.words, sz);
 	COMP_CRC32(ondisk->checksum, ondisk_c, sz);
 	ondisk_c += sz;
 
@@ -1590,29 +1764,84 @@ SnapBuildSerialize(SnapBuild *builder, XLogRecPtr lsn)
 	}
 
 	/*
-	 * fsync the file before renaming so that even if we crash after this we
-	 * have either a fully valid file or nothing.
-	 *
-	 * It's safe to just ERROR on fsync() here because we'll retry the whole
-	 * operation including the writes.
-	 *
-	 * TODO: Do the fsync() via checkpoints/restartpoints, doing it here has
-	 * some noticeable overhead since it's performed synchronously during
-	 * decoding?
+	 * Don't fsync the file yet, but have the kernel start writing it back;
+	 * SnapBuildFinishSerialize() will fsync it before renaming it into
+	 * place, so that even if we crash after that we have either a fully
+	 * valid file or nothing.
 	 */
-	if (pg_fsync(fd) != 0)
+	pg_flush_data(fd, 0, needed_length);
+	CloseTransientFile(fd);
+
+	pfree(ondisk);
+
+	builder->pending_snapshot = lsn;
+	builder->pending_shared = false;
+
+out:
+	if (builder->last_serialized_snapshot != InvalidXLogRecPtr)
+		ReorderBufferSetRestartPoint(builder->reorder,
+									 builder->last_serialized_snapshot);
+}
+
+/*
+ * Make the snapshot previously written out by SnapBuildSerialize() durable,
+ * and use it as the new serialization point.
+ *
+ * If another decoder was writing out the snapshot, we only use it if that
+ * decoder made it durable by now.
+ */
+static void
+SnapBuildFinishSerialize(SnapBuild *builder)
+{
+	XLogRecPtr	lsn = builder->pending_snapshot;
+	char		tmppath[MAXPGPATH];
+	char		path[MAXPGPATH];
+
+	Assert(lsn != InvalidXLogRecPtr);
+
+	builder->pending_snapshot = InvalidXLogRecPtr;
+
+	sprintf(path, "pg_logical/snapshots/%X-%X.snap",
+			(uint32) (lsn >> 32), (uint32) lsn);
+
+	if (builder->pending_shared)
 	{
-		int			save_errno = errno;
+		bool		durable;
 
-		CloseTransientFile(fd);
-		errno = save_errno;
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not fsync file \"%s\": %m", tmppath)));
+		SpinLockAcquire(&SnapBuildShared->mutex);
+		durable = SnapBuildShared->durable_lsn == lsn;
+		SpinLockRelease(&SnapBuildShared->mutex);
+
+		/* it might have been finished before the one we know about */
+		if (!durable)
+		{
+			struct stat stat_buf;
+
+			if (stat(path, &stat_buf) == 0)
+			{
+				fsync_fname(path, false);
+				fsync_fname("pg_logical/snapshots", true);
+				durable = true;
+			}
+			else if (errno != ENOENT)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not stat file \"%s\": %m", path)));
+		}
+
+		if (durable)
+			builder->last_serialized_snapshot = lsn;
+		return;
 	}
-	CloseTransientFile(fd);
 
-	fsync_fname("pg_logical/snapshots", true);
+	sprintf(tmppath, "pg_logical/snapshots/%X-%X.snap.%u.tmp",
+			(uint32) (lsn >> 32), (uint32) lsn, MyProcPid);
+
+	/*
+	 * It's safe to just ERROR on fsync() here because we'll just serialize
+	 * the next snapshot instead.
+	 */
+	fsync_fname(tmppath, false);
 
 	/*
 	 * We may overwrite the work from some other backend, but that's ok, our
@@ -1627,18 +1856,19 @@ SnapBuildSerialize(SnapBuild *builder, XLogRecPtr lsn)
 	}
 
 	/* make sure we persist */
-	fsync_fname(path, false);
 	fsync_fname("pg_logical/snapshots", true);
 
+	SpinLockAcquire(&SnapBuildShared->mutex);
+	SnapBuildShared->durable_lsn = lsn;
+	if (SnapBuildShared->writing_lsn == lsn)
+		SnapBuildShared->writing_lsn = InvalidXLogRecPtr;
+	SpinLockRelease(&SnapBuildShared->mutex);
+
 	/*
 	 * Now there's no way we can loose the dumped state anymore, remember this
 	 * as a serialization point.
 	 */
 	builder->last_serialized_snapshot = lsn;
-
-out:
-	ReorderBufferSetRestartPoint(builder->reorder,
-								 builder->last_serialized_snapshot);
 }
 
 /*
@@ -1748,9 +1978,9 @@ SnapBuildRestore(SnapBuild *builder, XLogRecPtr lsn)
 	COMP_CRC32(checksum, ondisk.builder.was_running.was_xip, sz);
 
 	/* restore committed xacts information */
-	sz = sizeof(TransactionId) * ondisk.builder.committed.xcnt;
-	ondisk.builder.committed.xip = MemoryContextAllocZero(builder->context, sz);
-	readBytes = read(fd, ondisk.builder.committed.xip, sz);
+	sz = sizeof(SnapBuildXidWord) * ondisk.builder.committed.nwords;
+	ondisk.builder.committed.words = MemoryContextAllocZero(builder->context, sz);
+	readBytes = read(fd, ondisk.builder.committed.words, sz);
 	if (readBytes != sz)
 	{
 		int			save_errno = errno;
@@ -1762,7 +1992,7 @@ SnapBuildRestore(SnapBuild *builder, XLogRecPtr lsn)
 				 errmsg("could not read file \"%s\", read %d of %d: %m",
 						path, readBytes, (int) sz)));
 	}
-	COMP_CRC32(checksum, ondisk.builder.committed.xip, sz);
+	COMP_CRC32(checksum, ondisk.builder.committed.words, sz);
 
 	CloseTransientFile(fd);
 
@@ -1801,16 +2031,16 @@ SnapBuildRestore(SnapBuild *builder, XLogRecPtr lsn)
 	builder->xmax = ondisk.builder.xmax;
 	builder->state = ondisk.builder.state;
 
-	builder->committed.xcnt = ondisk.builder.committed.xcnt;
-	/* We only allocated/stored xcnt, not xcnt_space xids ! */
-	/* don't overwrite preallocated xip, if we don't have anything here */
-	if (builder->committed.xcnt > 0)
+	builder->committed.nwords = ondisk.builder.committed.nwords;
+	/* We only allocated/stored nwords, not nwords_space words ! */
+	/* don't overwrite preallocated words, if we don't have anything here */
+	if (builder->committed.nwords > 0)
 	{
-		pfree(builder->committed.xip);
-		builder->committed.xcnt_space = ondisk.builder.committed.xcnt;
-		builder->committed.xip = ondisk.builder.committed.xip;
+		pfree(builder->committed.words);
+		builder->committed.nwords_space = ondisk.builder.committed.nwords;
+		builder->committed.words = ondisk.builder.committed.words;
 	}
-	ondisk.builder.committed.xip = NULL;
+	ondisk.builder.committed.words = NULL;
 
 	/* our snapshot is not interesting anymore, build a new one */
 	if (builder->snapshot != NULL)
@@ -1831,8 +2061,8 @@ SnapBuildRestore(SnapBuild *builder, XLogRecPtr lsn)
 	return true;
 
 snapshot_not_interesting:
-	if (ondisk.builder.committed.xip != NULL)
-		pfree(ondisk.builder.committed.xip);
+	if (ondisk.builder.committed.words != NULL)
+		pfree(ondisk.builder.committed.words);
 	return false;
 }
 
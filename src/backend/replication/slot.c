@@ -31,6 +31,12 @@
  * to iterate over the slots, and in exclusive mode to change the in_use flag
  * of a slot.  The remaining data in each slot is protected by its mutex.
  *
+ * The oldest xmin and restart LSN required by any slot are cached in the
+ * control area.  Consumers confirm progress frequently, and mostly only for
+ * slots that aren't holding back those minima; in that case there's no need
+ * to scan all slots and to install the (unchanged) minima again, which for
+ * the xmin would require acquiring ProcArrayLock exclusively.
+ *
  *-------------------------------------------------------------------------
  */
 
@@ -86,6 +92,9 @@ typedef struct ReplicationSlotOnDisk
 #define SLOT_MAGIC		0x1051CA1		/* format identifier */
 #define SLOT_VERSION	2				/* version for new files */
 
+/* number of dirty slots CheckPointReplicationSlots() writes out at once */
+#define SLOT_CHECKPOINT_BATCH_SIZE	16
+
 /* Control array for replication slot management */
 ReplicationSlotCtlData *ReplicationSlotCtl = NULL;
 
@@ -97,11 +106,19 @@ int			max_replication_slots = 0;	/* the maximum number of replication
 										 * slots */
 
 static void ReplicationSlotDropAcquired(void);
+static void ReplicationSlotsAggregateXmin(TransactionId *agg_xmin,
+							  TransactionId *agg_catalog_xmin);
 
 /* internal persistency functions */
 static void RestoreSlotFromDisk(const char *name);
 static void CreateSlotOnDisk(ReplicationSlot *slot);
 static void SaveSlotToPath(ReplicationSlot *slot, const char *path, int elevel);
+static void SaveSlotBatch(ReplicationSlot **slots, int nslots);
+static bool SlotNeedsSave(ReplicationSlot *slot);
+static void SlotSaved(ReplicationSlot *slot);
+static bool WriteSlotStateFile(ReplicationSlot *slot, const char *tmppath,
+				   bool sync, int elevel);
+static bool SyncSlotStateFile(const char *tmppath, int elevel);
 
 /*
  * Report shared-memory space needed by ReplicationSlotShmemInit.
@@ -143,6 +160,9 @@ ReplicationSlotsShmemInit(void)
 		/* First time through, so initialize */
 		MemSet(ReplicationSlotCtl, 0, ReplicationSlotsShmemSize());
 
+		SpinLockInit(&ReplicationSlotCtl->mutex);
+		ReplicationSlotCtl->compute_lock = LWLockAssign();
+
 		for (i = 0; i < max_replication_slots; i++)
 		{
 			ReplicationSlot *slot = &ReplicationSlotCtl->replication_slots[i];
@@ -603,12 +623,115 @@ ReplicationSlotPersist(void)
 void
 ReplicationSlotsComputeRequiredXmin(bool already_locked)
 {
-	int			i;
-	TransactionId agg_xmin = InvalidTransactionId;
-	TransactionId agg_catalog_xmin = InvalidTransactionId;
+	/* use volatile pointer to prevent code rearrangement */
+	volatile ReplicationSlotCtlData *ctl = ReplicationSlotCtl;
+	TransactionId agg_xmin;
+	TransactionId agg_catalog_xmin;
+	bool		changed;
+
+	Assert(ReplicationSlotCtl != NULL);
+	Assert(!already_locked || LWLockHeldByMe(ProcArrayLock));
+
+	/*
+	 * We can't wait for compute_lock while holding ProcArrayLock, it's
+	 * acquired in the opposite order below.  But holding ProcArrayLock
+	 * exclusively prevents anybody else from installing a new minimum while
+	 * we compute ours, so that's not needed either.
+	 */
+	if (!already_locked)
+		LWLockAcquire(ctl->compute_lock, LW_EXCLUSIVE);
+
+	SpinLockAcquire(&ctl->mutex);
+	ctl->computing++;
+	SpinLockRelease(&ctl->mutex);
+
+	ReplicationSlotsAggregateXmin(&agg_xmin, &agg_catalog_xmin);
+
+	SpinLockAcquire(&ctl->mutex);
+	changed = !TransactionIdEquals(agg_xmin, ctl->required_xmin) ||
+		!TransactionIdEquals(agg_catalog_xmin, ctl->required_catalog_xmin);
+	SpinLockRelease(&ctl->mutex);
+
+	/* only bother the procarray if the minimum changed */
+	if (changed || already_locked)
+	{
+		if (!already_locked)
+		{
+			LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+
+			/*
+			 * Somebody else might have changed a slot's xmin while holding
+			 * ProcArrayLock after we computed ours, so compute again while
+			 * holding the lock ourselves.
+			 */
+			ReplicationSlotsAggregateXmin(&agg_xmin, &agg_catalog_xmin);
+		}
+
+		ProcArraySetReplicationSlotXmin(agg_xmin, agg_catalog_xmin, true);
+
+		/* keep the cached minimum in sync with the procarray's */
+		SpinLockAcquire(&ctl->mutex);
+		ctl->required_xmin = agg_xmin;
+		ctl->required_catalog_xmin = agg_catalog_xmin;
+		SpinLockRelease(&ctl->mutex);
+
+		if (!already_locked)
+			LWLockRelease(ProcArrayLock);
+	}
+
+	SpinLockAcquire(&ctl->mutex);
+	ctl->computing--;
+	SpinLockRelease(&ctl->mutex);
+
+	if (!already_locked)
+		LWLockRelease(ctl->compute_lock);
+}
+
+/*
+ * Update the minimum xmin across all slots after the effective xmin, or the
+ * effective catalog xmin if catalog is true, of a single slot changed from
+ * old_xmin to new_xmin.
+ *
+ * Unless the slot was holding back the minimum, or now is, the minimum can't
+ * have changed, and we can avoid recomputing it.
+ */
+void
+ReplicationSlotsUpdateRequiredXmin(TransactionId old_xmin,
+								   TransactionId new_xmin, bool catalog)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile ReplicationSlotCtlData *ctl = ReplicationSlotCtl;
+	TransactionId required;
+	bool		skip;
 
 	Assert(ReplicationSlotCtl != NULL);
 
+	SpinLockAcquire(&ctl->mutex);
+	required = catalog ? ctl->required_catalog_xmin : ctl->required_xmin;
+	skip = ctl->computing == 0 &&
+		TransactionIdIsValid(required) &&
+		(!TransactionIdIsValid(old_xmin) ||
+		 TransactionIdFollows(old_xmin, required)) &&
+		(!TransactionIdIsValid(new_xmin) ||
+		 TransactionIdFollowsOrEquals(new_xmin, required));
+	SpinLockRelease(&ctl->mutex);
+
+	if (!skip)
+		ReplicationSlotsComputeRequiredXmin(false);
+}
+
+/*
+ * Compute the oldest effective xmin and catalog xmin across all slots.
+ */
+static void
+ReplicationSlotsAggregateXmin(TransactionId *agg_xmin,
+							  TransactionId *agg_catalog_xmin)
+{
+	int			i;
+
+	*agg_xmin = InvalidTransactionId;
+	*agg_catalog_xmin = InvalidTransactionId;
+
 	LWLockAcquire(ReplicationSlotControlLock, LW_SHARED);
 
 	for (i = 0; i < max_replication_slots; i++)
@@ -631,20 +754,18 @@ ReplicationSlotsComputeRequiredXmin(bool already_locked)
 
 		/* check the data xmin */
 		if (TransactionIdIsValid(effective_xmin) &&
-			(!TransactionIdIsValid(agg_xmin) ||
-			 TransactionIdPrecedes(effective_xmin, agg_xmin)))
-			agg_xmin = effective_xmin;
+			(!TransactionIdIsValid(*agg_xmin) ||
+			 TransactionIdPrecedes(effective_xmin, *agg_xmin)))
+			*agg_xmin = effective_xmin;
 
 		/* check the catalog xmin */
 		if (TransactionIdIsValid(effective_catalog_xmin) &&
-			(!TransactionIdIsValid(agg_catalog_xmin) ||
-			 TransactionIdPrecedes(effective_catalog_xmin, agg_catalog_xmin)))
-			agg_catalog_xmin = effective_catalog_xmin;
+			(!TransactionIdIsValid(*agg_catalog_xmin) ||
+			 TransactionIdPrecedes(effective_catalog_xmin, *agg_catalog_xmin)))
+			*agg_catalog_xmin = effective_catalog_xmin;
 	}
 
 	LWLockRelease(ReplicationSlotControlLock);
-
-	ProcArraySetReplicationSlotXmin(agg_xmin, agg_catalog_xmin, already_locked);
 }
 
 /*
@@ -653,11 +774,20 @@ ReplicationSlotsComputeRequiredXmin(bool already_locked)
 void
 ReplicationSlotsComputeRequiredLSN(void)
 {
+	/* use volatile pointer to prevent code rearrangement */
+	volatile ReplicationSlotCtlData *ctl = ReplicationSlotCtl;
 	int			i;
 	XLogRecPtr	min_required = InvalidXLogRecPtr;
+	bool		changed;
 
 	Assert(ReplicationSlotCtl != NULL);
 
+	LWLockAcquire(ctl->compute_lock, LW_EXCLUSIVE);
+
+	SpinLockAcquire(&ctl->mutex);
+	ctl->computing++;
+	SpinLockRelease(&ctl->mutex);
+
 	LWLockAcquire(ReplicationSlotControlLock, LW_SHARED);
 	for (i = 0; i < max_replication_slots; i++)
 	{
@@ -682,7 +812,48 @@ ReplicationSlotsComputeRequiredLSN(void)
 	}
 	LWLockRelease(ReplicationSlotControlLock);
 
-	XLogSetReplicationSlotMinimumLSN(min_required);
+	SpinLockAcquire(&ctl->mutex);
+	changed = min_required != ctl->required_lsn;
+	SpinLockRelease(&ctl->mutex);
+
+	if (changed)
+		XLogSetReplicationSlotMinimumLSN(min_required);
+
+	SpinLockAcquire(&ctl->mutex);
+	ctl->required_lsn = min_required;
+	ctl->computing--;
+	SpinLockRelease(&ctl->mutex);
+
+	LWLockRelease(ctl->compute_lock);
+}
+
+/*
+ * Update the minimum restart LSN across all slots after the restart LSN of a
+ * single slot changed from old_lsn to new_lsn.
+ *
+ * Like ReplicationSlotsUpdateRequiredXmin(), this avoids recomputing the
+ * minimum unless the slot was holding it back, or now is.
+ */
+void
+ReplicationSlotsUpdateRequiredLSN(XLogRecPtr old_lsn, XLogRecPtr new_lsn)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile ReplicationSlotCtlData *ctl = ReplicationSlotCtl;
+	XLogRecPtr	required;
+	bool		skip;
+
+	Assert(ReplicationSlotCtl != NULL);
+
+	SpinLockAcquire(&ctl->mutex);
+	required = ctl->required_lsn;
+	skip = ctl->computing == 0 &&
+		required != InvalidXLogRecPtr &&
+		(old_lsn == InvalidXLogRecPtr || old_lsn > required) &&
+		(new_lsn == InvalidXLogRecPtr || new_lsn >= required);
+	SpinLockRelease(&ctl->mutex);
+
+	if (!skip)
+		ReplicationSlotsComputeRequiredLSN();
 }
 
 /*
@@ -822,6 +993,8 @@ CheckSlotRequirements(void)
 void
 CheckPointReplicationSlots(void)
 {
+	ReplicationSlot *batch[SLOT_CHECKPOINT_BATCH_SIZE];
+	int			nbatch = 0;
 	int			i;
 
 	elog(DEBUG1, "performing replication slot checkpoint");
@@ -838,15 +1011,25 @@ CheckPointReplicationSlots(void)
 	for (i = 0; i < max_replication_slots; i++)
 	{
 		ReplicationSlot *s = &ReplicationSlotCtl->replication_slots[i];
-		char		path[MAXPGPATH];
 
 		if (!s->in_use)
 			continue;
 
-		/* save the slot to disk, locking is handled in SaveSlotToPath() */
-		sprintf(path, "pg_replslot/%s", NameStr(s->data.name));
-		SaveSlotToPath(s, path, LOG);
+		/* skip slots that haven't changed since they were last saved */
+		if (!SlotNeedsSave(s))
+			continue;
+
+		/* save the dirty slots to disk, in batches */
+		batch[nbatch++] = s;
+		if (nbatch == SLOT_CHECKPOINT_BATCH_SIZE)
+		{
+			SaveSlotBatch(batch, nbatch);
+			nbatch = 0;
+		}
 	}
+	if (nbatch > 0)
+		SaveSlotBatch(batch, nbatch);
+
 	LWLockRelease(ReplicationSlotAllocationLock);
 }
 
@@ -979,33 +1162,185 @@ SaveSlotToPath(ReplicationSlot *slot, const char *dir, int elevel)
 {
 	char		tmppath[MAXPGPATH];
 	char		path[MAXPGPATH];
-	int			fd;
-	ReplicationSlotOnDisk cp;
-	bool		was_dirty;
 
-	/* first check whether there's something to write out */
-	{
-		volatile ReplicationSlot *vslot = slot;
+	/* don't do anything if there's nothing to write */
+	if (!SlotNeedsSave(slot))
+		return;
 
-		SpinLockAcquire(&vslot->mutex);
-		was_dirty = vslot->dirty;
-		vslot->just_dirtied = false;
-		SpinLockRelease(&vslot->mutex);
+	LWLockAcquire(slot->io_in_progress_lock, LW_EXCLUSIVE);
+
+	sprintf(tmppath, "%s/state.tmp", dir);
+	sprintf(path, "%s/state", dir);
+
+	if (!WriteSlotStateFile(slot, tmppath, true, elevel))
+	{
+		LWLockRelease(slot->io_in_progress_lock);
+		return;
 	}
 
-	/* and don't do anything if there's nothing to write */
-	if (!was_dirty)
+	/* rename to permanent file, fsync file and directory */
+	if (rename(tmppath, path) != 0)
+	{
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not rename file \"%s\" to \"%s\": %m",
+						tmppath, path)));
+		LWLockRelease(slot->io_in_progress_lock);
 		return;
+	}
 
-	LWLockAcquire(slot->io_in_progress_lock, LW_EXCLUSIVE);
+	/* Check CreateSlot() for the reasoning of using a crit. section. */
+	START_CRIT_SECTION();
+
+	fsync_fname(path, false);
+	fsync_fname(dir, true);
+	fsync_fname("pg_replslot", true);
+
+	END_CRIT_SECTION();
+
+	SlotSaved(slot);
+
+	LWLockRelease(slot->io_in_progress_lock);
+}
+
+/*
+ * Save the state of several dirty slots at once, as SaveSlotToPath(..., LOG)
+ * would, for CheckPointReplicationSlots().
+ *
+ * All state files are written before any of them is fsynced, which lets the
+ * kernel write them out together, and pg_replslot is only fsynced once for
+ * all of them.  The renamed state files need no fsync of their own, the
+ * temporary files they were renamed from have been fsynced already.
+ */
+static void
+SaveSlotBatch(ReplicationSlot **slots, int nslots)
+{
+	char		tmppath[MAXPGPATH];
+	char		path[MAXPGPATH];
+	bool		written[SLOT_CHECKPOINT_BATCH_SIZE];
+	bool		any_written = false;
+	int			i;
+
+	Assert(nslots <= SLOT_CHECKPOINT_BATCH_SIZE);
+
+	/* first write out all state files, without fsyncing them */
+	for (i = 0; i < nslots; i++)
+	{
+		LWLockAcquire(slots[i]->io_in_progress_lock, LW_EXCLUSIVE);
+
+		sprintf(tmppath, "pg_replslot/%s/state.tmp",
+				NameStr(slots[i]->data.name));
+		written[i] = WriteSlotStateFile(slots[i], tmppath, false, LOG);
+	}
+
+	/* then fsync them, and rename them into place */
+	for (i = 0; i < nslots; i++)
+	{
+		if (!written[i])
+			continue;
+
+		sprintf(tmppath, "pg_replslot/%s/state.tmp",
+				NameStr(slots[i]->data.name));
+		sprintf(path, "pg_replslot/%s/state", NameStr(slots[i]->data.name));
+
+		if (!SyncSlotStateFile(tmppath, LOG))
+		{
+			written[i] = false;
+			continue;
+		}
+
+		if (rename(tmppath, path) != 0)
+		{
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not rename file \"%s\" to \"%s\": %m",
+							tmppath, path)));
+			written[i] = false;
+			continue;
+		}
+
+		any_written = true;
+	}
+
+	/* Check CreateSlot() for the reasoning of using a crit. section. */
+	if (any_written)
+	{
+		START_CRIT_SECTION();
+
+		for (i = 0; i < nslots; i++)
+		{
+			if (!written[i])
+				continue;
+
+			sprintf(path, "pg_replslot/%s", NameStr(slots[i]->data.name));
+			fsync_fname(path, true);
+		}
+		fsync_fname("pg_replslot", true);
+
+		END_CRIT_SECTION();
+	}
+
+	for (i = 0; i < nslots; i++)
+	{
+		if (written[i])
+			SlotSaved(slots[i]);
+
+		LWLockRelease(slots[i]->io_in_progress_lock);
+	}
+}
+
+/*
+ * Check whether a slot has been modified since it was last saved.
+ *
+ * If it has, the caller has to save it; modifications made from now on will
+ * keep it marked dirty even once that's done.
+ */
+static bool
+SlotNeedsSave(ReplicationSlot *slot)
+{
+	volatile ReplicationSlot *vslot = slot;
+	bool		was_dirty;
+
+	SpinLockAcquire(&vslot->mutex);
+	was_dirty = vslot->dirty;
+	vslot->just_dirtied = false;
+	SpinLockRelease(&vslot->mutex);
+
+	return was_dirty;
+}
+
+/*
+ * Successfully saved a slot, unset dirty bit, unless somebody dirtied it
+ * again already.
+ */
+static void
+SlotSaved(ReplicationSlot *slot)
+{
+	volatile ReplicationSlot *vslot = slot;
+
+	SpinLockAcquire(&vslot->mutex);
+	if (!vslot->just_dirtied)
+		vslot->dirty = false;
+	SpinLockRelease(&vslot->mutex);
+}
+
+/*
+ * Write a slot's state to tmppath, fsyncing it if sync is true.
+ *
+ * Errors are reported at elevel; returns whether the file has been written.
+ * The caller has to hold the slot's io_in_progress_lock.
+ */
+static bool
+WriteSlotStateFile(ReplicationSlot *slot, const char *tmppath, bool sync,
+				   int elevel)
+{
+	int			fd;
+	ReplicationSlotOnDisk cp;
 
 	/* silence valgrind :( */
 	memset(&cp, 0, sizeof(ReplicationSlotOnDisk));
 
-	sprintf(tmppath, "%s/state.tmp", dir);
-	sprintf(path, "%s/state", dir);
-
-	fd = OpenTransientFile(tmppath,
+	fd = OpenTransientFile((char *) tmppath,
 						   O_CREAT | O_EXCL | O_WRONLY | PG_BINARY,
 						   S_IRUSR | S_IWUSR);
 	if (fd < 0)
@@ -1014,7 +1349,7 @@ SaveSlotToPath(ReplicationSlot *slot, const char *dir, int elevel)
 				(errcode_for_file_access(),
 				 errmsg("could not create file \"%s\": %m",
 						tmppath)));
-		return;
+		return false;
 	}
 
 	cp.magic = SLOT_MAGIC;
@@ -1046,11 +1381,11 @@ SaveSlotToPath(ReplicationSlot *slot, const char *dir, int elevel)
 				(errcode_for_file_access(),
 				 errmsg("could not write to file \"%s\": %m",
 						tmppath)));
-		return;
+		return false;
 	}
 
 	/* fsync the temporary file */
-	if (pg_fsync(fd) != 0)
+	if (sync && pg_fsync(fd) != 0)
 	{
 		int			save_errno = errno;
 
@@ -1060,44 +1395,50 @@ SaveSlotToPath(ReplicationSlot *slot, const char *dir, int elevel)
 				(errcode_for_file_access(),
 				 errmsg("could not fsync file \"%s\": %m",
 						tmppath)));
-		return;
+		return false;
 	}
 
 	CloseTransientFile(fd);
 
-	/* rename to permanent file, fsync file and directory */
-	if (rename(tmppath, path) != 0)
+	return true;
+}
+
+/*
+ * Fsync a state file written by WriteSlotStateFile(..., false, ...).
+ *
+ * Errors are reported at elevel; returns whether the file has been fsynced.
+ */
+static bool
+SyncSlotStateFile(const char *tmppath, int elevel)
+{
+	int			fd;
+
+	fd = OpenTransientFile((char *) tmppath, O_RDWR | PG_BINARY, 0);
+	if (fd < 0)
 	{
 		ereport(elevel,
 				(errcode_for_file_access(),
-				 errmsg("could not rename file \"%s\" to \"%s\": %m",
-						tmppath, path)));
-		return;
+				 errmsg("could not open file \"%s\": %m",
+						tmppath)));
+		return false;
 	}
 
-	/* Check CreateSlot() for the reasoning of using a crit. section. */
-	START_CRIT_SECTION();
-
-	fsync_fname(path, false);
-	fsync_fname(dir, true);
-	fsync_fname("pg_replslot", true);
-
-	END_CRIT_SECTION();
-
-	/*
-	 * Successfully wrote, unset dirty bit, unless somebody dirtied again
-	 * already.
-	 */
+	if (pg_fsync(fd) != 0)
 	{
-		volatile ReplicationSlot *vslot = slot;
+		int			save_errno = errno;
 
-		SpinLockAcquire(&vslot->mutex);
-		if (!vslot->just_dirtied)
-			vslot->dirty = false;
-		SpinLockRelease(&vslot->mutex);
+		CloseTransientFile(fd);
+		errno = save_errno;
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not fsync file \"%s\": %m",
+						tmppath)));
+		return false;
 	}
 
-	LWLockRelease(slot->io_in_progress_lock);
+	CloseTransientFile(fd);
+
+	return true;
 }
 
 /*
@@ -29,12 +29,24 @@
  * single ordered queue of waiting backends, so that we can avoid
  * searching the through all waiters each time we receive a reply.
  *
- * In 9.1 we support only a single synchronous standby, chosen from a
+ * By default there is a single synchronous standby, chosen from a
  * priority list of synchronous_standby_names. Before it can become the
  * synchronous standby it must have caught up with the primary; that may
  * take some time. Once caught up, the current highest priority standby
  * will release waiters from the queue.
  *
+ * Alternatively synchronous_standby_names can specify a quorum set,
+ * "ANY k (name, ...)". Then all listed standbys are equal, and a commit
+ * is released once any k of them have confirmed it, i.e. up to the k-th
+ * newest position reported by the connected candidates. Whichever of
+ * their walsenders receives a reply recomputes that position, so waiters
+ * are released without waiting for one particular standby.
+ *
+ * Besides waiting for the standbys to write or flush the commit record,
+ * backends can wait for it to be applied (synchronous_commit =
+ * remote_apply), so that its effects are visible there once the commit
+ * returns.
+ *
  * Portions Copyright (c) 2010-2014, PostgreSQL Global Development Group
  *
  * IDENTIFICATION
@@ -44,6 +56,8 @@
  */
 #include "postgres.h"
 
+#include <ctype.h>
+#include <limits.h>
 #include <unistd.h>
 
 #include "access/xact.h"
@@ -53,13 +67,18 @@
 #include "replication/walsender_private.h"
 #include "storage/pmsignal.h"
 #include "storage/proc.h"
+#include "storage/spin.h"
 #include "tcop/tcopprot.h"
 #include "utils/builtins.h"
+#include "utils/memutils.h"
 #include "utils/ps_status.h"
 
 /* User-settable parameters for sync rep */
 char	   *SyncRepStandbyNames;
 
+/* Parsed form of SyncRepStandbyNames, set by its assign hook */
+SyncRepConfigData *SyncRepConfig = NULL;
+
 #define SyncStandbysDefined() \
 	(SyncRepStandbyNames != NULL && SyncRepStandbyNames[0] != '\0')
 
@@ -72,6 +91,12 @@ static void SyncRepCancelWait(void);
 static int	SyncRepWakeQueue(bool all, int mode);
 
 static int	SyncRepGetStandbyPriority(void);
+static bool SyncRepGetQuorumPositions(XLogRecPtr *writePtr,
+						  XLogRecPtr *flushPtr,
+						  XLogRecPtr *applyPtr);
+static int	SyncRepParseQuorumSet(char *rawstring, int *num_sync,
+					  char **members);
+static int	cmp_lsn_desc(const void *a, const void *b);
 
 #ifdef USE_ASSERT_CHECKING
 static bool SyncRepQueueIsOrderedByLSN(int mode);
@@ -359,8 +384,10 @@ SyncRepInitConfig(void)
 }
 
 /*
- * Update the LSNs on each queue based upon our latest state. This
- * implements a simple policy of first-valid-standby-releases-waiter.
+ * Update the LSNs on each queue based upon our latest state. With a
+ * priority list this implements a simple policy of
+ * first-valid-standby-releases-waiter; with a quorum set any candidate
+ * releases waiters up to the positions confirmed by the quorum.
  *
  * Other policies are possible, which would change what we do here and
  * perhaps also which information we store as well.
@@ -370,8 +397,13 @@ SyncRepReleaseWaiters(void)
 {
 	volatile WalSndCtlData *walsndctl = WalSndCtl;
 	volatile WalSnd *syncWalSnd = NULL;
+	XLogRecPtr	writePtr;
+	XLogRecPtr	flushPtr;
+	XLogRecPtr	applyPtr;
+	bool		quorum;
 	int			numwrite = 0;
 	int			numflush = 0;
+	int			numapply = 0;
 	int			priority = 0;
 	int			i;
 
@@ -388,96 +420,225 @@ SyncRepReleaseWaiters(void)
 		XLogRecPtrIsInvalid(MyWalSnd->flush))
 		return;
 
-	/*
-	 * We're a potential sync standby. Release waiters if we are the highest
-	 * priority standby. If there are multiple standbys with same priorities
-	 * then we use the first mentioned standby. If you change this, also
-	 * change pg_stat_get_wal_senders().
-	 */
+	quorum = (SyncRepConfig != NULL &&
+			  SyncRepConfig->syncrep_method == SYNC_REP_QUORUM);
+
 	LWLockAcquire(SyncRepLock, LW_EXCLUSIVE);
 
-	for (i = 0; i < max_wal_senders; i++)
+	if (quorum)
 	{
-		/* use volatile pointer to prevent code rearrangement */
-		volatile WalSnd *walsnd = &walsndctl->walsnds[i];
-
-		if (walsnd->pid != 0 &&
-			(walsnd->state == WALSNDSTATE_STREAMING ||
-			 walsnd->state == WALSNDSTATE_STOPPING) &&
-			walsnd->sync_standby_priority > 0 &&
-			(priority == 0 ||
-			 priority > walsnd->sync_standby_priority) &&
-			!XLogRecPtrIsInvalid(walsnd->flush))
+		/*
+		 * We're a candidate of the quorum set. Release waiters up to the
+		 * positions that enough candidates have confirmed, if that many are
+		 * connected at all.
+		 */
+		if (!SyncRepGetQuorumPositions(&writePtr, &flushPtr, &applyPtr))
 		{
-			priority = walsnd->sync_standby_priority;
-			syncWalSnd = walsnd;
+			LWLockRelease(SyncRepLock);
+			return;
 		}
 	}
+	else
+	{
+		/*
+		 * We're a potential sync standby. Release waiters if we are the
+		 * highest priority standby. If there are multiple standbys with same
+		 * priorities then we use the first mentioned standby. If you change
+		 * this, also change pg_stat_get_wal_senders().
+		 */
+		for (i = 0; i < max_wal_senders; i++)
+		{
+			/* use volatile pointer to prevent code rearrangement */
+			volatile WalSnd *walsnd = &walsndctl->walsnds[i];
+
+			if (walsnd->pid != 0 &&
+				(walsnd->state == WALSNDSTATE_STREAMING ||
+				 walsnd->state == WALSNDSTATE_STOPPING) &&
+				walsnd->sync_standby_priority > 0 &&
+				(priority == 0 ||
+				 priority > walsnd->sync_standby_priority) &&
+				!XLogRecPtrIsInvalid(walsnd->flush))
+			{
+				priority = walsnd->sync_standby_priority;
+				syncWalSnd = walsnd;
+			}
+		}
 
-	/*
-	 * We should have found ourselves at least.
-	 */
-	Assert(syncWalSnd);
+		/*
+		 * We should have found ourselves at least.
+		 */
+		Assert(syncWalSnd);
 
-	/*
-	 * If we aren't managing the highest priority standby then just leave.
-	 */
-	if (syncWalSnd != MyWalSnd)
-	{
-		LWLockRelease(SyncRepLock);
-		announce_next_takeover = true;
-		return;
+		/*
+		 * If we aren't managing the highest priority standby then just
+		 * leave.
+		 */
+		if (syncWalSnd != MyWalSnd)
+		{
+			LWLockRelease(SyncRepLock);
+			announce_next_takeover = true;
+			return;
+		}
+
+		writePtr = MyWalSnd->write;
+		flushPtr = MyWalSnd->flush;
+		applyPtr = MyWalSnd->apply;
 	}
 
 	/*
 	 * Set the lsn first so that when we wake backends they will release up to
 	 * this location.
 	 */
-	if (walsndctl->lsn[SYNC_REP_WAIT_WRITE] < MyWalSnd->write)
+	if (walsndctl->lsn[SYNC_REP_WAIT_WRITE] < writePtr)
 	{
-		walsndctl->lsn[SYNC_REP_WAIT_WRITE] = MyWalSnd->write;
+		walsndctl->lsn[SYNC_REP_WAIT_WRITE] = writePtr;
 		numwrite = SyncRepWakeQueue(false, SYNC_REP_WAIT_WRITE);
 	}
-	if (walsndctl->lsn[SYNC_REP_WAIT_FLUSH] < MyWalSnd->flush)
+	if (walsndctl->lsn[SYNC_REP_WAIT_FLUSH] < flushPtr)
 	{
-		walsndctl->lsn[SYNC_REP_WAIT_FLUSH] = MyWalSnd->flush;
+		walsndctl->lsn[SYNC_REP_WAIT_FLUSH] = flushPtr;
 		numflush = SyncRepWakeQueue(false, SYNC_REP_WAIT_FLUSH);
 	}
+	if (walsndctl->lsn[SYNC_REP_WAIT_APPLY] < applyPtr)
+	{
+		walsndctl->lsn[SYNC_REP_WAIT_APPLY] = applyPtr;
+		numapply = SyncRepWakeQueue(false, SYNC_REP_WAIT_APPLY);
+	}
 
 	LWLockRelease(SyncRepLock);
 
-	elog(DEBUG3, "released %d procs up to write %X/%X, %d procs up to flush %X/%X",
-		 numwrite, (uint32) (MyWalSnd->write >> 32), (uint32) MyWalSnd->write,
-	   numflush, (uint32) (MyWalSnd->flush >> 32), (uint32) MyWalSnd->flush);
+	elog(DEBUG3, "released %d procs up to write %X/%X, %d procs up to flush %X/%X, %d procs up to apply %X/%X",
+		 numwrite, (uint32) (writePtr >> 32), (uint32) writePtr,
+		 numflush, (uint32) (flushPtr >> 32), (uint32) flushPtr,
+		 numapply, (uint32) (applyPtr >> 32), (uint32) applyPtr);
 
 	/*
 	 * If we are managing the highest priority standby, though we weren't
-	 * prior to this, then announce we are now the sync standby.
+	 * prior to this, then announce we are now the sync standby. Members of a
+	 * quorum set announce once that they take part in releasing waiters.
 	 */
 	if (announce_next_takeover)
 	{
 		announce_next_takeover = false;
-		ereport(LOG,
-				(errmsg("standby \"%s\" is now the synchronous standby with priority %u",
-						application_name, MyWalSnd->sync_standby_priority)));
+		if (quorum)
+			ereport(LOG,
+					(errmsg("standby \"%s\" is now a candidate for quorum synchronous standby",
+							application_name)));
+		else
+			ereport(LOG,
+					(errmsg("standby \"%s\" is now the synchronous standby with priority %u",
+							application_name, MyWalSnd->sync_standby_priority)));
 	}
 }
 
+/*
+ * Compute the write, flush and apply positions confirmed by the quorum,
+ * i.e. the num_sync'th newest positions reported by the connected
+ * candidates. Each of them is computed separately, so they may have been
+ * reported by different standbys.
+ *
+ * Returns false if fewer than num_sync candidates are connected.
+ *
+ * Must hold SyncRepLock.
+ */
+static bool
+SyncRepGetQuorumPositions(XLogRecPtr *writePtr, XLogRecPtr *flushPtr,
+						  XLogRecPtr *applyPtr)
+{
+	static XLogRecPtr *write_array = NULL;
+	static XLogRecPtr *flush_array = NULL;
+	static XLogRecPtr *apply_array = NULL;
+	int			num_sync = SyncRepConfig->num_sync;
+	int			len = 0;
+	int			i;
+
+	/* max_wal_senders can't change, so allocate these once */
+	if (write_array == NULL)
+	{
+		write_array = MemoryContextAlloc(TopMemoryContext,
+										 sizeof(XLogRecPtr) * max_wal_senders);
+		flush_array = MemoryContextAlloc(TopMemoryContext,
+										 sizeof(XLogRecPtr) * max_wal_senders);
+		apply_array = MemoryContextAlloc(TopMemoryContext,
+										 sizeof(XLogRecPtr) * max_wal_senders);
+	}
+
+	for (i = 0; i < max_wal_senders; i++)
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile WalSnd *walsnd = &WalSndCtl->walsnds[i];
+		XLogRecPtr	write;
+		XLogRecPtr	flush;
+		XLogRecPtr	apply;
+		WalSndState state;
+
+		if (walsnd->pid == 0 || walsnd->sync_standby_priority == 0)
+			continue;
+
+		SpinLockAcquire(&walsnd->mutex);
+		state = walsnd->state;
+		write = walsnd->write;
+		flush = walsnd->flush;
+		apply = walsnd->apply;
+		SpinLockRelease(&walsnd->mutex);
+
+		if ((state != WALSNDSTATE_STREAMING &&
+			 state != WALSNDSTATE_STOPPING) ||
+			XLogRecPtrIsInvalid(flush))
+			continue;
+
+		write_array[len] = write;
+		flush_array[len] = flush;
+		apply_array[len] = apply;
+		len++;
+	}
+
+	if (len < num_sync)
+		return false;
+
+	qsort(write_array, len, sizeof(XLogRecPtr), cmp_lsn_desc);
+	qsort(flush_array, len, sizeof(XLogRecPtr), cmp_lsn_desc);
+	qsort(apply_array, len, sizeof(XLogRecPtr), cmp_lsn_desc);
+
+	*writePtr = write_array[num_sync - 1];
+	*flushPtr = flush_array[num_sync - 1];
+	*applyPtr = apply_array[num_sync - 1];
+
+	return true;
+}
+
+/*
+ * qsort comparator to sort XLogRecPtrs in descending order.
+ */
+static int
+cmp_lsn_desc(const void *a, const void *b)
+{
+	XLogRecPtr	lsn1 = *((const XLogRecPtr *) a);
+	XLogRecPtr	lsn2 = *((const XLogRecPtr *) b);
+
+	if (lsn1 > lsn2)
+		return -1;
+	else if (lsn1 == lsn2)
+		return 0;
+	else
+		return 1;
+}
+
 /*
  * Check if we are in the list of sync standbys, and if so, determine
  * priority sequence. Return priority if set, or zero to indicate that
  * we are not a potential sync standby.
  *
- * Compare the parameter SyncRepStandbyNames against the application_name
- * for this WALSender, or allow any name if we find a wildcard "*".
+ * Compare the standby names of SyncRepConfig against the application_name
+ * for this WALSender, or allow any name if we find a wildcard "*". All
+ * members of a quorum set are equal, but we still return their position so
+ * that a nonzero priority identifies candidates.
  */
 static int
 SyncRepGetStandbyPriority(void)
 {
-	char	   *rawstring;
-	List	   *elemlist;
-	ListCell   *l;
-	int			priority = 0;
+	const char *standby_name;
+	int			priority;
 	bool		found = false;
 
 	/*
@@ -487,36 +648,22 @@ SyncRepGetStandbyPriority(void)
 	if (am_cascading_walsender)
 		return 0;
 
-	/* Need a modifiable copy of string */
-	rawstring = pstrdup(SyncRepStandbyNames);
-
-	/* Parse string into list of identifiers */
-	if (!SplitIdentifierString(rawstring, ',', &elemlist))
-	{
-		/* syntax error in list */
-		pfree(rawstring);
-		list_free(elemlist);
-		/* GUC machinery will have already complained - no need to do again */
+	/* The GUC machinery will have complained about invalid settings */
+	if (SyncRepConfig == NULL)
 		return 0;
-	}
 
-	foreach(l, elemlist)
+	standby_name = SyncRepConfig->member_names;
+	for (priority = 1; priority <= SyncRepConfig->nmembers; priority++)
 	{
-		char	   *standby_name = (char *) lfirst(l);
-
-		priority++;
-
 		if (pg_strcasecmp(standby_name, application_name) == 0 ||
 			pg_strcasecmp(standby_name, "*") == 0)
 		{
 			found = true;
 			break;
 		}
+		standby_name += strlen(standby_name) + 1;
 	}
 
-	pfree(rawstring);
-	list_free(elemlist);
-
 	return (found ? priority : 0);
 }
 
@@ -665,17 +812,114 @@ SyncRepQueueIsOrderedByLSN(int mode)
  * ===========================================================
  */
 
+/*
+ * Check whether rawstring is a quorum set, "ANY num_sync [OF] (list)",
+ * with case-insensitive keywords.
+ *
+ * Returns 1 and sets *num_sync and *members if so; the closing parenthesis
+ * is overwritten, so that *members points to the list of standby names.
+ * Returns 0 if rawstring does not start with the ANY keyword, and -1 after
+ * reporting the problem with GUC_check_errdetail if it is malformed.
+ */
+static int
+SyncRepParseQuorumSet(char *rawstring, int *num_sync, char **members)
+{
+	char	   *p = rawstring;
+	char	   *endptr;
+	char	   *close;
+	long		val;
+
+	while (isspace((unsigned char) *p))
+		p++;
+
+	if (pg_strncasecmp(p, "any", 3) != 0 ||
+		!isspace((unsigned char) p[3]))
+		return 0;
+	p += 3;
+
+	while (isspace((unsigned char) *p))
+		p++;
+
+	/* a standby may well be called "any", so insist on a following number */
+	if (!isdigit((unsigned char) *p))
+		return 0;
+
+	errno = 0;
+	val = strtol(p, &endptr, 10);
+	if (errno != 0 || val <= 0 || val > INT_MAX)
+	{
+		GUC_check_errdetail("The number of synchronous standbys must be a positive integer.");
+		return -1;
+	}
+	p = endptr;
+
+	while (isspace((unsigned char) *p))
+		p++;
+
+	if (pg_strncasecmp(p, "of", 2) == 0 &&
+		(isspace((unsigned char) p[2]) || p[2] == '('))
+	{
+		p += 2;
+		while (isspace((unsigned char) *p))
+			p++;
+	}
+
+	close = strrchr(p, ')');
+	if (*p != '(' || close == NULL)
+	{
+		GUC_check_errdetail("The standby names of a quorum set must be enclosed in parentheses.");
+		return -1;
+	}
+
+	/* nothing but whitespace may follow the list */
+	for (endptr = close + 1; *endptr; endptr++)
+	{
+		if (!isspace((unsigned char) *endptr))
+		{
+			GUC_check_errdetail("Unexpected text after the quorum set.");
+			return -1;
+		}
+	}
+
+	*close = '\0';
+	*num_sync = (int) val;
+	*members = p + 1;
+
+	return 1;
+}
+
 bool
 check_synchronous_standby_names(char **newval, void **extra, GucSource source)
 {
 	char	   *rawstring;
+	char	   *members;
 	List	   *elemlist;
+	ListCell   *l;
+	SyncRepConfigData *config;
+	char	   *ptr;
+	int			num_sync = 1;
+	uint8		syncrep_method = SYNC_REP_PRIORITY;
+	bool		has_wildcard = false;
+	int			size;
 
 	/* Need a modifiable copy of string */
 	rawstring = pstrdup(*newval);
+	members = rawstring;
+
+	switch (SyncRepParseQuorumSet(rawstring, &num_sync, &members))
+	{
+		case -1:
+			pfree(rawstring);
+			return false;
+		case 1:
+			syncrep_method = SYNC_REP_QUORUM;
+			break;
+		default:
+			break;
+	}
 
 	/* Parse string into list of identifiers */
-	if (!SplitIdentifierString(rawstring, ',', &elemlist))
+	if (!SplitIdentifierString(members, ',', &elemlist))
 	{
 		/* syntax error in list */
 		GUC_check_errdetail("List syntax is invalid.");
@@ -691,6 +935,59 @@ check_synchronous_standby_names(char **newval, void **extra, GucSource source)
 	 * postmaster at startup, not WALSender, so the application_name is not
 	 * yet correctly set.
 	 */
+	size = offsetof(SyncRepConfigData, member_names);
+	foreach(l, elemlist)
+	{
+		char	   *standby_name = (char *) lfirst(l);
+
+		if (strcmp(standby_name, "*") == 0)
+			has_wildcard = true;
+		size += strlen(standby_name) + 1;
+	}
+
+	if (syncrep_method == SYNC_REP_QUORUM)
+	{
+		if (elemlist == NIL)
+		{
+			GUC_check_errdetail("A quorum set must contain at least one standby name.");
+			pfree(rawstring);
+			list_free(elemlist);
+			return false;
+		}
+
+		/* with a wildcard, any number of standbys could be listed */
+		if (!has_wildcard && num_sync > list_length(elemlist))
+		{
+			GUC_check_errdetail("The number of synchronous standbys (%d) must not exceed the number of standby names (%d).",
+								num_sync, list_length(elemlist));
+			pfree(rawstring);
+			list_free(elemlist);
+			return false;
+		}
+	}
+
+	/* Remember the parsed form, for the assign hook */
+	config = (SyncRepConfigData *) malloc(size);
+	if (config == NULL)
+	{
+		pfree(rawstring);
+		list_free(elemlist);
+		return false;
+	}
+	config->config_size = size;
+	config->num_sync = num_sync;
+	config->syncrep_method = syncrep_method;
+	config->nmembers = list_length(elemlist);
+	ptr = config->member_names;
+	foreach(l, elemlist)
+	{
+		char	   *standby_name = (char *) lfirst(l);
+
+		strcpy(ptr, standby_name);
+		ptr += strlen(standby_name) + 1;
+	}
+
+	*extra = (void *) config;
 
 	pfree(rawstring);
 	list_free(elemlist);
@@ -698,6 +995,12 @@ check_synchronous_standby_names(char **newval, void **extra, GucSource source)
 	return true;
 }
 
+void
+assign_synchronous_standby_names(const char *newval, void *extra)
+{
+	SyncRepConfig = (SyncRepConfigData *) extra;
+}
+
 void
 assign_synchronous_commit(int newval, void *extra)
 {
@@ -709,6 +1012,9 @@ assign_synchronous_commit(int newval, void *extra)
 		case SYNCHRONOUS_COMMIT_REMOTE_FLUSH:
 			SyncRepWaitMode = SYNC_REP_WAIT_FLUSH;
 			break;
+		case SYNCHRONOUS_COMMIT_REMOTE_APPLY:
+			SyncRepWaitMode = SYNC_REP_WAIT_APPLY;
+			break;
 		default:
 			SyncRepWaitMode = SYNC_REP_NO_WAIT;
 			break;
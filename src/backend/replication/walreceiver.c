@@ -998,7 +998,8 @@ XLogWalRcvFlush(bool dying)
 		/* Signal the startup process and walsender that new WAL has arrived */
 		WakeupRecovery();
 		if (AllowCascadeReplication())
-			WalSndWakeup();
+			WalSndWakeupWaiters(LogstreamResult.Flush,
+								WALSND_WAKEUP_PHYSICAL);
 
 		/* Report XLOG streaming progress in PS display */
 		if (update_process_title)
@@ -63,6 +63,7 @@
 #include "nodes/replnodes.h"
 #include "replication/basebackup.h"
 #include "replication/decode.h"
+#include "replication/decodegroup.h"
 #include "replication/logical.h"
 #include "replication/logicalfuncs.h"
 #include "replication/slot.h"
@@ -113,6 +114,8 @@ bool		am_db_walsender = false;	/* Connected to a database? */
 int			max_wal_senders = 0;	/* the maximum number of concurrent walsenders */
 int			wal_sender_timeout = 60 * 1000;		/* maximum time to send one
 												 * WAL data message */
+int			wal_sender_flush_after = 32;	/* in kB */
+int			wal_sender_flush_delay = 5;		/* in ms */
 
 /*
  * State for WalSndWakeupRequest
@@ -176,6 +179,29 @@ static bool streamingDoneReceiving;
 /* Are we there yet? */
 static bool WalSndCaughtUp = false;
 
+/*
+ * The output of logical walsenders is coalesced: instead of trying to send
+ * each message as soon as it's queued, we wait until wal_sender_flush_after
+ * bytes have been queued, wal_sender_flush_delay has passed since the first
+ * of them was, or we're caught up.  Decoded changes are often tiny, so this
+ * saves many syscalls and network packets.
+ */
+static bool coalesce_output = false;
+static Size unflushed_bytes = 0;
+static TimestampTz unflushed_since = 0;
+
+/*
+ * Wait queue we use while waiting for WAL to be flushed, and the location
+ * WalSndLoop should wait for once send_data has caught up, if any.
+ */
+static WalSndWaitQueueKind wait_queue = WALSND_QUEUE_PHYSICAL;
+static XLogRecPtr wait_for_lsn = InvalidXLogRecPtr;
+
+/* Output statistics, published in MyWalSnd when flushing */
+static int64 output_messages = 0;
+static int64 output_bytes = 0;
+static int64 output_flushes = 0;
+
 /* Flags set by signal handlers for later service in main loop */
 static volatile sig_atomic_t got_SIGUSR2 = false;
 static volatile sig_atomic_t got_STOPPING = false;
@@ -202,6 +228,10 @@ static void WalSndKill(int code, Datum arg);
 static void WalSndShutdown(void) __attribute__((noreturn));
 static void XLogSendPhysical(void);
 static void XLogSendLogical(void);
+static void XLogSendLogicalFromGroup(void);
+static void WalSndUpdateSpillStats(LogicalDecodingContext *ctx);
+static void WalSndUpdateReadStats(void);
+static void WalSndUpdateRelCacheStats(LogicalDecodingContext *ctx);
 static void WalSndDone(WalSndSendDataCallback send_data);
 static XLogRecPtr GetStandbyFlushRecPtr(void);
 static void IdentifySystem(void);
@@ -219,9 +249,19 @@ static void WalSndCheckTimeOut(void);
 static long WalSndComputeSleeptime(TimestampTz now);
 static void WalSndPrepareWrite(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid, bool last_write);
 static void WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid, bool last_write);
+static void WalSndGroupWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid, bool last_write);
+static void WalSndGroupWait(void);
 static XLogRecPtr WalSndWaitForWal(XLogRecPtr loc);
+static void WalSndPutData(const char *data, size_t len);
+static bool WalSndFlushDeferred(TimestampTz now);
+static void WalSndFlush(void);
+static void WalSndQueueWait(XLogRecPtr lsn);
+static void WalSndDequeueWait(void);
+static void WalSndWakeRemoteWaiters(XLogRecPtr flushPtr, XLogRecPtr applyPtr);
 
 static void XLogRead(char *buf, XLogRecPtr startptr, Size count);
+static void WalSndReadWAL(char *buf, TimeLineID tli, XLogRecPtr startptr,
+			  Size count);
 
 
 /* Initialize walsender process before entering the main command loop */
@@ -265,9 +305,13 @@ WalSndErrorCleanup()
 		sendFile = -1;
 	}
 
+	DecodingGroupRelease();
+
 	if (MyReplicationSlot != NULL)
 		ReplicationSlotRelease();
 
+	WalSndDequeueWait();
+
 	replication_active = false;
 
 	if (got_STOPPING || got_SIGUSR2)
@@ -639,6 +683,10 @@ StartReplication(StartReplicationCmd *cmd)
 
 	streamingDoneSending = streamingDoneReceiving = false;
 
+	WalSndDequeueWait();
+	wait_queue = WALSND_QUEUE_PHYSICAL;
+	coalesce_output = false;
+
 	/* If there is nothing to stream, don't even enter COPY mode */
 	if (!sendTimeLineIsHistoric || cmd->startpoint < sendTimeLineValidUpto)
 	{
@@ -792,11 +840,24 @@ logical_read_xlog_page(XLogReaderState *state, XLogRecPtr targetPagePtr, int req
 		count = flushptr - targetPagePtr;	/* part of the page available */
 
 	/* now actually read the data, we know it's there */
-	XLogRead(cur_page, targetPagePtr, XLOG_BLCKSZ);
+	LogicalReadAheadPage(cur_page, targetPagePtr, count, flushptr,
+						 sendTimeLine, WalSndReadWAL);
 
 	return count;
 }
 
+/*
+ * Read callback for LogicalReadAheadPage(); XLogRead() always reads from
+ * sendTimeLine.
+ */
+static void
+WalSndReadWAL(char *buf, TimeLineID tli, XLogRecPtr startptr, Size count)
+{
+	Assert(tli == sendTimeLine);
+
+	XLogRead(buf, startptr, count);
+}
+
 /*
  * Create a new replication slot.
  */
@@ -1000,6 +1061,10 @@ StartLogicalReplication(StartReplicationCmd *cmd)
 	sendTimeLineIsHistoric = false;
 	sendTimeLine = ThisTimeLineID;
 
+	WalSndDequeueWait();
+	wait_queue = WALSND_QUEUE_LOGICAL;
+	coalesce_output = true;
+
 	/*
 	 * Initialize position to the last ack'ed one, then the xlog records begin
 	 * to be shipped from that position.
@@ -1009,6 +1074,19 @@ StartLogicalReplication(StartReplicationCmd *cmd)
 												 logical_read_xlog_page,
 										WalSndPrepareWrite, WalSndWriteData);
 
+	/*
+	 * Offer to share our decoding with other walsenders, or to use theirs.
+	 * Partial transactions can't be passed on when sharing, so don't stream
+	 * them.
+	 */
+	if (shared_logical_decoding)
+	{
+		logical_decoding_ctx->streaming = false;
+		DecodingGroupStartup(logical_decoding_ctx, cmd->options,
+							 WalSndPrepareWrite, WalSndGroupWriteData,
+							 WalSndGroupWait);
+	}
+
 	/* Start reading WAL from the oldest required WAL. */
 	logical_startptr = MyReplicationSlot->data.restart_lsn;
 
@@ -1035,6 +1113,7 @@ StartLogicalReplication(StartReplicationCmd *cmd)
 	/* Main loop of walsender */
 	WalSndLoop(XLogSendLogical);
 
+	DecodingGroupRelease();
 	FreeDecodingContext(logical_decoding_ctx);
 	ReplicationSlotRelease();
 
@@ -1089,9 +1168,6 @@ WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid,
 	TimestampTz	now;
 	int64 now_int;
 
-	/* output previously gathered data in a CopyData packet */
-	pq_putmessage_noblock('d', ctx->out->data, ctx->out->len);
-
 	/*
 	 * Fill the send timestamp last, so that it is taken as late as possible.
 	 * This is somewhat ugly, but the protocol's set as it's already used for
@@ -1104,16 +1180,22 @@ WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid,
 	memcpy(&ctx->out->data[1 + sizeof(int64) + sizeof(int64)],
 		   tmpbuf.data, sizeof(int64));
 
+	/* output previously gathered data in a CopyData packet */
+	WalSndPutData(ctx->out->data, ctx->out->len);
+
 	CHECK_FOR_INTERRUPTS();
 
-	/* Try to flush pending output to the client */
-	if (pq_flush_if_writable() != 0)
-		WalSndShutdown();
+	/*
+	 * Try to flush pending output to the client, unless we're collecting
+	 * more of it first.
+	 */
+	if (!WalSndFlushDeferred(now))
+		WalSndFlush();
 
 	/* Try taking fast path unless we get too close to walsender timeout. */
 	if (now < TimestampTzPlusMilliseconds(last_reply_timestamp,
 										  wal_sender_timeout / 2) &&
-		!pq_is_send_pending())
+		(!pq_is_send_pending() || WalSndFlushDeferred(now)))
 	{
 		return;
 	}
@@ -1164,14 +1246,152 @@ WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid,
 		}
 
 		/* Try to flush pending output to the client */
-		if (pq_flush_if_writable() != 0)
-			WalSndShutdown();
+		WalSndFlush();
 	}
 
 	/* reactivate latch so WalSndLoop knows to continue */
 	SetLatch(&MyWalSnd->latch);
 }
 
+/*
+ * LogicalDecodingContext 'write' callback for the contexts of other
+ * walsenders' slots we decode for, see decodegroup.c.
+ *
+ * Hand the data prepared by WalSndPrepareWrite to the walsender serving that
+ * slot, which sends it on to its client as is.
+ */
+static void
+WalSndGroupWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn,
+					 TransactionId xid, bool last_write)
+{
+	/* fill the send timestamp, as WalSndWriteData does */
+	resetStringInfo(&tmpbuf);
+	pq_sendint64(&tmpbuf, GetCurrentIntegerTimestamp());
+	memcpy(&ctx->out->data[1 + sizeof(int64) + sizeof(int64)],
+		   tmpbuf.data, sizeof(int64));
+
+	DecodingGroupSendData(ctx);
+
+	CHECK_FOR_INTERRUPTS();
+}
+
+/*
+ * Wait for a walsender we decode for to make space in its queue. Process
+ * replies from our own client and check timeouts meanwhile, like
+ * WalSndWriteData does.
+ */
+static void
+WalSndGroupWait(void)
+{
+	int			wakeEvents;
+	long		sleeptime;
+
+	/* Check for input from the client */
+	ProcessRepliesIfAny();
+
+	/* die if timeout was reached */
+	WalSndCheckTimeOut();
+
+	/* Send keepalive if the time has come */
+	WalSndKeepaliveIfNecessary();
+
+	sleeptime = WalSndComputeSleeptime(GetCurrentTimestamp());
+
+	wakeEvents = WL_LATCH_SET | WL_POSTMASTER_DEATH |
+		WL_SOCKET_READABLE | WL_TIMEOUT;
+
+	if (pq_is_send_pending())
+		wakeEvents |= WL_SOCKET_WRITEABLE;
+
+	/* Sleep until something happens or we time out */
+	ImmediateInterruptOK = true;
+	CHECK_FOR_INTERRUPTS();
+	WaitLatchOrSocket(&MyWalSnd->latch, wakeEvents,
+					  MyProcPort->sock, sleeptime);
+	ImmediateInterruptOK = false;
+
+	/* the caller rechecks the queue afterwards */
+	ResetLatch(&MyWalSnd->latch);
+
+	/*
+	 * Emergency bailout if postmaster has died.  This is to avoid the
+	 * necessity for manual cleanup of all postmaster children.
+	 */
+	if (!PostmasterIsAlive())
+		exit(1);
+
+	/* Process any requests or signals received recently */
+	if (ConfigReloadPending)
+	{
+		ConfigReloadPending = false;
+		ProcessConfigFile(PGC_SIGHUP);
+		SyncRepInitConfig();
+	}
+
+	/* Try to flush pending output to the client */
+	WalSndFlush();
+}
+
+/*
+ * Queue a CopyData message for the client.
+ */
+static void
+WalSndPutData(const char *data, size_t len)
+{
+	pq_putmessage_noblock('d', data, len);
+
+	if (unflushed_bytes == 0 && coalesce_output)
+		unflushed_since = GetCurrentTimestamp();
+	/* account for the message type and length word, too */
+	unflushed_bytes += 1 + 4 + len;
+
+	output_messages++;
+	output_bytes += len;
+}
+
+/*
+ * Should flushing the queued output be put off, to coalesce it with further
+ * output into larger writes?
+ */
+static bool
+WalSndFlushDeferred(TimestampTz now)
+{
+	if (!coalesce_output || unflushed_bytes == 0)
+		return false;
+
+	if (unflushed_bytes >= (Size) wal_sender_flush_after * 1024)
+		return false;
+
+	return !TimestampDifferenceExceeds(unflushed_since, now,
+									   wal_sender_flush_delay);
+}
+
+/*
+ * Try to flush pending output to the client, and publish the output
+ * statistics if anything has been queued since the last time.
+ */
+static void
+WalSndFlush(void)
+{
+	if (unflushed_bytes > 0)
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile WalSnd *walsnd = MyWalSnd;
+
+		unflushed_bytes = 0;
+		output_flushes++;
+
+		SpinLockAcquire(&walsnd->mutex);
+		walsnd->outputMessages = output_messages;
+		walsnd->outputBytes = output_bytes;
+		walsnd->outputFlushes = output_flushes;
+		SpinLockRelease(&walsnd->mutex);
+	}
+
+	if (pq_flush_if_writable() != 0)
+		WalSndShutdown();
+}
+
 /*
  * Wait till WAL < loc is flushed to disk so it can be safely sent to client.
  *
@@ -1226,6 +1446,13 @@ WalSndWaitForWal(XLogRecPtr loc)
 		/* Clear any already-pending wakeups */
 		ResetLatch(&MyWalSnd->latch);
 
+		/*
+		 * Let walsenders we decode for know how far we got, and let others
+		 * join us while we're idle.
+		 */
+		if (shared_logical_decoding)
+			DecodingGroupLeaderAdvance(true);
+
 		/*
 		 * If we're shutting down, trigger pending WAL to be written out,
 		 * otherwise we'd possibly end up waiting for WAL that never gets
@@ -1234,6 +1461,12 @@ WalSndWaitForWal(XLogRecPtr loc)
 		if (got_STOPPING)
 			XLogBackgroundFlush();
 
+		/*
+		 * Ask to be woken up once loc has been flushed. That has to happen
+		 * before checking the flushed position, lest we miss the wakeup.
+		 */
+		WalSndQueueWait(loc);
+
 		/* Update our idea of the currently flushed position. */
 		if (!RecoveryInProgress())
 			RecentFlushPtr = GetFlushRecPtr();
@@ -1274,8 +1507,7 @@ WalSndWaitForWal(XLogRecPtr loc)
 		/*
 		 * Try to flush any pending output to the client.
 		 */
-		if (pq_flush_if_writable() != 0)
-			WalSndShutdown();
+		WalSndFlush();
 
 		/*
 		 * If we have received CopyDone from the client, sent CopyDone
@@ -1570,12 +1802,14 @@ static void
 PhysicalConfirmReceivedLocation(XLogRecPtr lsn)
 {
 	bool		changed = false;
+	XLogRecPtr	old_lsn;
 
 	/* use volatile pointer to prevent code rearrangement */
 	volatile ReplicationSlot *slot = MyReplicationSlot;
 
 	Assert(lsn != InvalidXLogRecPtr);
 	SpinLockAcquire(&slot->mutex);
+	old_lsn = slot->data.restart_lsn;
 	if (slot->data.restart_lsn != lsn)
 	{
 		changed = true;
@@ -1586,7 +1820,7 @@ PhysicalConfirmReceivedLocation(XLogRecPtr lsn)
 	if (changed)
 	{
 		ReplicationSlotMarkDirty();
-		ReplicationSlotsComputeRequiredLSN();
+		ReplicationSlotsUpdateRequiredLSN(old_lsn, lsn);
 	}
 
 	/*
@@ -1643,6 +1877,9 @@ ProcessStandbyReplyMessage(void)
 	if (!am_cascading_walsender)
 		SyncRepReleaseWaiters();
 
+	/* wake up backends waiting for the standby to reach these positions */
+	WalSndWakeRemoteWaiters(flushPtr, applyPtr);
+
 	/*
 	 * Advance our local xmin horizon when the client confirmed a flush.
 	 */
@@ -1660,10 +1897,12 @@ static void
 PhysicalReplicationSlotNewXmin(TransactionId feedbackXmin)
 {
 	bool		changed = false;
+	TransactionId old_xmin;
 	volatile ReplicationSlot *slot = MyReplicationSlot;
 
 	SpinLockAcquire(&slot->mutex);
 	MyPgXact->xmin = InvalidTransactionId;
+	old_xmin = slot->effective_xmin;
 
 	/*
 	 * For physical replication we don't need the interlock provided by xmin
@@ -1683,7 +1922,7 @@ PhysicalReplicationSlotNewXmin(TransactionId feedbackXmin)
 	if (changed)
 	{
 		ReplicationSlotMarkDirty();
-		ReplicationSlotsComputeRequiredXmin(false);
+		ReplicationSlotsUpdateRequiredXmin(old_xmin, feedbackXmin, false);
 	}
 }
 
@@ -1876,6 +2115,8 @@ WalSndLoop(WalSndSendDataCallback send_data)
 	 */
 	for (;;)
 	{
+		bool		flush_deferred;
+
 		/*
 		 * Emergency bailout if postmaster has died.  This is to avoid the
 		 * necessity for manual cleanup of all postmaster children.
@@ -1909,19 +2150,28 @@ WalSndLoop(WalSndSendDataCallback send_data)
 			break;
 
 		/*
-		 * If we don't have any pending data in the output buffer, try to send
-		 * some more.  If there is some, we don't bother to call send_data
-		 * again until we've flushed it ... but we'd better assume we are not
-		 * caught up.
+		 * If we don't have any pending data in the output buffer, or are
+		 * still collecting output for a larger write, try to send some more.
+		 * If there is some, we don't bother to call send_data again until
+		 * we've flushed it ... but we'd better assume we are not caught up.
 		 */
-		if (!pq_is_send_pending())
+		if (!pq_is_send_pending() ||
+			WalSndFlushDeferred(GetCurrentTimestamp()))
+		{
+			wait_for_lsn = InvalidXLogRecPtr;
 			send_data();
+		}
 		else
 			WalSndCaughtUp = false;
 
-		/* Try to flush pending output to the client */
-		if (pq_flush_if_writable() != 0)
-			WalSndShutdown();
+		/*
+		 * Try to flush pending output to the client, unless we're collecting
+		 * more of it first.  Once we're caught up, send everything.
+		 */
+		flush_deferred = !WalSndCaughtUp &&
+			WalSndFlushDeferred(GetCurrentTimestamp());
+		if (!flush_deferred)
+			WalSndFlush();
 
 		/* If nothing remains to be sent right now ... */
 		if (WalSndCaughtUp && !pq_is_send_pending())
@@ -1965,13 +2215,33 @@ WalSndLoop(WalSndSendDataCallback send_data)
 		 * write-ready.  This test is only needed for the case where the
 		 * send_data callback handled a subset of the available data but then
 		 * pq_flush_if_writable flushed it all --- we should immediately try
-		 * to send more.
+		 * to send more.  Neither should we if we're collecting output.
 		 */
-		if ((WalSndCaughtUp && !streamingDoneSending) || pq_is_send_pending())
+		if ((WalSndCaughtUp && !streamingDoneSending) ||
+			(pq_is_send_pending() && !flush_deferred))
 		{
 			long		sleeptime;
 			int			wakeEvents;
 
+			/*
+			 * If we caught up with the flushed WAL, ask to be woken up once
+			 * there's more, and recheck afterwards so we don't miss a flush
+			 * that happened meanwhile.
+			 */
+			if (WalSndCaughtUp && !XLogRecPtrIsInvalid(wait_for_lsn))
+			{
+				XLogRecPtr	flushed;
+
+				WalSndQueueWait(wait_for_lsn);
+
+				if (am_cascading_walsender)
+					flushed = GetStandbyFlushRecPtr();
+				else
+					flushed = GetFlushRecPtr();
+				if (flushed >= wait_for_lsn)
+					continue;
+			}
+
 			wakeEvents = WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_TIMEOUT |
 				WL_SOCKET_READABLE;
 
@@ -2034,6 +2304,19 @@ InitWalSenderSlot(void)
 			walsnd->write = InvalidXLogRecPtr;
 			walsnd->flush = InvalidXLogRecPtr;
 			walsnd->apply = InvalidXLogRecPtr;
+			walsnd->spillTxns = 0;
+			walsnd->spillCount = 0;
+			walsnd->spillBytes = 0;
+			walsnd->spillDiskBytes = 0;
+			walsnd->walReads = 0;
+			walsnd->walReadBytes = 0;
+			walsnd->walPrefetches = 0;
+			walsnd->walReadTime = 0;
+			walsnd->relCacheHits = 0;
+			walsnd->relCacheMisses = 0;
+			walsnd->outputMessages = 0;
+			walsnd->outputBytes = 0;
+			walsnd->outputFlushes = 0;
 			walsnd->state = WALSNDSTATE_STARTUP;
 			SpinLockRelease(&walsnd->mutex);
 			/* don't need the lock anymore */
@@ -2062,6 +2345,8 @@ WalSndKill(int code, Datum arg)
 
 	Assert(walsnd != NULL);
 
+	WalSndDequeueWait();
+
 	/*
 	 * Clear MyWalSnd first; then disown the latch.  This is so that signal
 	 * handlers won't try to touch the latch after it's no longer ours.
@@ -2075,6 +2360,12 @@ WalSndKill(int code, Datum arg)
 	 * for this.
 	 */
 	walsnd->pid = 0;
+
+	/*
+	 * Backends waiting for all standbys to reach a position might not need
+	 * to wait for us anymore, let them check.
+	 */
+	WalSndWakeRemoteWaiters(PG_UINT64_MAX, PG_UINT64_MAX);
 }
 
 /*
@@ -2406,6 +2697,8 @@ XLogSendPhysical(void)
 	if (SendRqstPtr <= sentPtr)
 	{
 		WalSndCaughtUp = true;
+		if (!sendTimeLineIsHistoric)
+			wait_for_lsn = SendRqstPtr + 1;
 		return;
 	}
 
@@ -2431,7 +2724,10 @@ XLogSendPhysical(void)
 		if (sendTimeLineIsHistoric)
 			WalSndCaughtUp = false;
 		else
+		{
 			WalSndCaughtUp = true;
+			wait_for_lsn = SendRqstPtr + 1;
+		}
 	}
 	else
 	{
@@ -2470,7 +2766,7 @@ XLogSendPhysical(void)
 	memcpy(&output_message.data[1 + sizeof(int64) + sizeof(int64)],
 		   tmpbuf.data, sizeof(int64));
 
-	pq_putmessage_noblock('d', output_message.data, output_message.len);
+	WalSndPutData(output_message.data, output_message.len);
 
 	sentPtr = endptr;
 
@@ -2506,6 +2802,26 @@ XLogSendLogical(void)
 	XLogRecord *record;
 	char	   *errm;
 
+	/*
+	 * When sharing decoding, check whether another walsender decodes for us,
+	 * or whether we have asked one to. We only ask once caught up.
+	 */
+	if (shared_logical_decoding)
+	{
+		switch (DecodingGroupTryJoin(WalSndCaughtUp && !got_STOPPING))
+		{
+			case DECODING_GROUP_JOINED:
+				XLogSendLogicalFromGroup();
+				return;
+			case DECODING_GROUP_PENDING:
+				/* wait for the answer, without decoding further */
+				WalSndCaughtUp = true;
+				return;
+			case DECODING_GROUP_DECODE:
+				break;
+		}
+	}
+
 	/*
 	 * Don't know whether we've caught up yet. We'll set WalSndCaughtUp to
 	 * true in WalSndWaitForWal, if we're actually waiting. We also set to
@@ -2530,22 +2846,35 @@ XLogSendLogical(void)
 
 		sentPtr = logical_decoding_ctx->reader->EndRecPtr;
 
+		WalSndUpdateSpillStats(logical_decoding_ctx);
+		WalSndUpdateReadStats();
+		WalSndUpdateRelCacheStats(logical_decoding_ctx);
+
+		if (shared_logical_decoding)
+			DecodingGroupLeaderAdvance(false);
+
 		/*
 		 * If we have sent a record that is at or beyond the flushed point, we
 		 * have caught up.
 		 */
 		if (sentPtr >= flushPtr)
+		{
 			WalSndCaughtUp = true;
+			wait_for_lsn = flushPtr + 1;
+		}
 	}
 	else
 	{
+		XLogRecPtr	flushPtr = GetFlushRecPtr();
+
 		/*
 		 * If the record we just wanted read is at or beyond the flushed
 		 * point, then we're caught up.
 		 */
-		if (logical_decoding_ctx->reader->EndRecPtr >= GetFlushRecPtr())
+		if (logical_decoding_ctx->reader->EndRecPtr >= flushPtr)
 		{
 			WalSndCaughtUp = true;
+			wait_for_lsn = flushPtr + 1;
 
 			/*
 			 * Have WalSndLoop() terminate the connection in an orderly
@@ -2567,6 +2896,72 @@ XLogSendLogical(void)
 	}
 }
 
+/*
+ * Stream out data another walsender has decoded for us.
+ */
+static void
+XLogSendLogicalFromGroup(void)
+{
+	XLogRecPtr	leaderPtr;
+	Size		sent = 0;
+
+	WalSndCaughtUp = false;
+
+	/* everything up to here has been queued for us */
+	leaderPtr = DecodingGroupLeaderPosition();
+
+	/*
+	 * Forward data as long as there is some, but return to WalSndLoop every
+	 * now and then to flush it and handle replies.
+	 */
+	while (sent < XLOG_BLCKSZ * 16)
+	{
+		shm_mq_result res;
+		Size		nbytes;
+		void	   *data;
+
+		res = DecodingGroupReceive(&nbytes, &data);
+
+		if (res == SHM_MQ_WOULD_BLOCK)
+		{
+			if (leaderPtr > sentPtr)
+				sentPtr = leaderPtr;
+			WalSndCaughtUp = true;
+			break;
+		}
+		else if (res == SHM_MQ_DETACHED)
+		{
+			/*
+			 * At shutdown, the other walsender exits after having queued
+			 * everything, so finish in an orderly manner as well.
+			 */
+			if (got_STOPPING)
+			{
+				WalSndCaughtUp = true;
+				got_SIGUSR2 = true;
+				break;
+			}
+
+			ereport(ERROR,
+					(errmsg("walsender decoding for replication slot \"%s\" has exited",
+							NameStr(MyReplicationSlot->data.name))));
+		}
+
+		WalSndPutData(data, nbytes);
+		sent += nbytes;
+	}
+
+	/* Update shared memory status */
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile WalSnd *walsnd = MyWalSnd;
+
+		SpinLockAcquire(&walsnd->mutex);
+		walsnd->sentPtr = sentPtr;
+		SpinLockRelease(&walsnd->mutex);
+	}
+}
+
 /*
  * Shutdown if the sender is caught up.
  *
@@ -2761,12 +3156,23 @@ WalSndShmemInit(void)
 		for (i = 0; i < NUM_SYNC_REP_WAIT_MODE; i++)
 			SHMQueueInit(&(WalSndCtl->SyncRepQueue[i]));
 
+		for (i = 0; i < NUM_WALSND_WAIT_QUEUES; i++)
+		{
+			SpinLockInit(&WalSndCtl->waitQueueMutex[i]);
+			SHMQueueInit(&(WalSndCtl->waitQueue[i]));
+		}
+
+		SpinLockInit(&WalSndCtl->remoteWaitMutex);
+		for (i = 0; i < NUM_REMOTE_WAIT_MODES; i++)
+			SHMQueueInit(&(WalSndCtl->remoteWaitQueue[i]));
+
 		for (i = 0; i < max_wal_senders; i++)
 		{
 			WalSnd	   *walsnd = &WalSndCtl->walsnds[i];
 
 			SpinLockInit(&walsnd->mutex);
 			InitSharedLatch(&walsnd->latch);
+			SHMQueueElemInit(&(walsnd->waitLinks));
 		}
 	}
 }
@@ -2786,6 +3192,101 @@ WalSndWakeup(void)
 		SetLatch(&WalSndCtl->walsnds[i].latch);
 }
 
+/*
+ * Wake up the walsenders of the given kinds that wait for WAL that has been
+ * flushed up to flushed now.
+ *
+ * As walsenders queue themselves ordered by the location they wait for, we
+ * only need to look at the ones that are actually woken up, instead of
+ * waking up every walsender whenever WAL has been flushed.  The queue lock
+ * is released before setting a walsender's latch.
+ *
+ * This will be called inside critical sections, so throwing an error is not
+ * adviseable.
+ */
+void
+WalSndWakeupWaiters(XLogRecPtr flushed, int kinds)
+{
+	int			i;
+
+	for (i = 0; i < NUM_WALSND_WAIT_QUEUES; i++)
+	{
+		SHM_QUEUE  *queue = &(WalSndCtl->waitQueue[i]);
+		slock_t    *mutex = &(WalSndCtl->waitQueueMutex[i]);
+
+		if (!(kinds & (1 << i)))
+			continue;
+
+		for (;;)
+		{
+			WalSnd	   *walsnd;
+
+			SpinLockAcquire(mutex);
+			walsnd = (WalSnd *) SHMQueueNext(queue, queue,
+											 offsetof(WalSnd, waitLinks));
+			if (walsnd == NULL || walsnd->waitLSN > flushed)
+			{
+				SpinLockRelease(mutex);
+				break;
+			}
+			SHMQueueDelete(&(walsnd->waitLinks));
+			SpinLockRelease(mutex);
+
+			SetLatch(&walsnd->latch);
+		}
+	}
+}
+
+/*
+ * Queue ourselves to be woken up by WalSndWakeupWaiters() once WAL up to lsn
+ * has been flushed, replacing an earlier request.
+ *
+ * Callers have to check the flushed position afterwards, before sleeping.
+ */
+static void
+WalSndQueueWait(XLogRecPtr lsn)
+{
+	SHM_QUEUE  *queue = &(WalSndCtl->waitQueue[wait_queue]);
+	WalSnd	   *walsnd = MyWalSnd;
+	WalSnd	   *prev;
+
+	SpinLockAcquire(&WalSndCtl->waitQueueMutex[wait_queue]);
+
+	if (!SHMQueueIsDetached(&(walsnd->waitLinks)))
+		SHMQueueDelete(&(walsnd->waitLinks));
+	walsnd->waitLSN = lsn;
+
+	/* usually we wait for the newest location, so search from the tail */
+	prev = (WalSnd *) SHMQueuePrev(queue, queue, offsetof(WalSnd, waitLinks));
+	while (prev && prev->waitLSN > lsn)
+		prev = (WalSnd *) SHMQueuePrev(queue, &(prev->waitLinks),
+									   offsetof(WalSnd, waitLinks));
+
+	if (prev)
+		SHMQueueInsertAfter(&(prev->waitLinks), &(walsnd->waitLinks));
+	else
+		SHMQueueInsertAfter(queue, &(walsnd->waitLinks));
+
+	SpinLockRelease(&WalSndCtl->waitQueueMutex[wait_queue]);
+}
+
+/*
+ * Remove ourselves from the wait queue, if we're queued.
+ */
+static void
+WalSndDequeueWait(void)
+{
+	WalSnd	   *walsnd = MyWalSnd;
+
+	if (walsnd == NULL)
+		return;
+
+	SpinLockAcquire(&WalSndCtl->waitQueueMutex[wait_queue]);
+	if (!SHMQueueIsDetached(&(walsnd->waitLinks)))
+		SHMQueueDelete(&(walsnd->waitLinks));
+	SpinLockRelease(&WalSndCtl->waitQueueMutex[wait_queue]);
+}
+
 /*
  * Signal all walsenders to move to stopping state.
  *
@@ -2898,6 +3399,75 @@ WalSndGetStateString(WalSndState state)
 }
 
 
+/*
+ * Publish the reorder buffer's spill statistics in shared memory, so they
+ * can be shown in pg_stat_replication.
+ *
+ * Only we ever change the counters in our WalSnd slot, so checking whether
+ * they changed can be done without holding the spinlock.
+ */
+static void
+WalSndUpdateSpillStats(LogicalDecodingContext *ctx)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile WalSnd *walsnd = MyWalSnd;
+	ReorderBuffer *rb = ctx->reorder;
+
+	if (walsnd->spillCount == rb->spillCount)
+		return;
+
+	SpinLockAcquire(&walsnd->mutex);
+	walsnd->spillTxns = rb->spillTxns;
+	walsnd->spillCount = rb->spillCount;
+	walsnd->spillBytes = rb->spillBytes;
+	walsnd->spillDiskBytes = rb->spillDiskBytes;
+	SpinLockRelease(&walsnd->mutex);
+}
+
+/*
+ * Likewise, publish the statistics about the WAL read by logical decoding.
+ */
+static void
+WalSndUpdateReadStats(void)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile WalSnd *walsnd = MyWalSnd;
+	LogicalReadAheadStats stats;
+
+	LogicalReadAheadGetStats(&stats);
+
+	if (walsnd->walReads == stats.reads)
+		return;
+
+	SpinLockAcquire(&walsnd->mutex);
+	walsnd->walReads = stats.reads;
+	walsnd->walReadBytes = stats.read_bytes;
+	walsnd->walPrefetches = stats.prefetches;
+	walsnd->walReadTime = INSTR_TIME_GET_MILLISEC(stats.read_time);
+	SpinLockRelease(&walsnd->mutex);
+}
+
+/*
+ * Likewise, publish the statistics about the reorder buffer's relfilenode
+ * cache.
+ */
+static void
+WalSndUpdateRelCacheStats(LogicalDecodingContext *ctx)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile WalSnd *walsnd = MyWalSnd;
+	ReorderBuffer *rb = ctx->reorder;
+
+	if (walsnd->relCacheHits == rb->relCacheHits &&
+		walsnd->relCacheMisses == rb->relCacheMisses)
+		return;
+
+	SpinLockAcquire(&walsnd->mutex);
+	walsnd->relCacheHits = rb->relCacheHits;
+	walsnd->relCacheMisses = rb->relCacheMisses;
+	SpinLockRelease(&walsnd->mutex);
+}
+
 /*
  * Returns activity of walsenders, including pids and xlog locations sent to
  * standby servers.
@@ -2905,7 +3475,7 @@ WalSndGetStateString(WalSndState state)
 Datum
 pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_WAL_SENDERS_COLS	8
+#define PG_STAT_GET_WAL_SENDERS_COLS	21
 	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
 	TupleDesc	tupdesc;
 	Tuplestorestate *tupstore;
@@ -2914,6 +3484,7 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 	int		   *sync_priority;
 	int			priority = 0;
 	int			sync_standby = -1;
+	bool		quorum;
 	int			i;
 
 	/* check to see if caller supports us returning a tuplestore */
@@ -2947,6 +3518,8 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 	 * standby. This code must match the code in SyncRepReleaseWaiters().
 	 */
 	sync_priority = palloc(sizeof(int) * max_wal_senders);
+	quorum = (SyncRepConfig != NULL &&
+			  SyncRepConfig->syncrep_method == SYNC_REP_QUORUM);
 	LWLockAcquire(SyncRepLock, LW_SHARED);
 	for (i = 0; i < max_wal_senders; i++)
 	{
@@ -2986,6 +3559,19 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 		XLogRecPtr	write;
 		XLogRecPtr	flush;
 		XLogRecPtr	apply;
+		int64		spillTxns;
+		int64		spillCount;
+		int64		spillBytes;
+		int64		spillDiskBytes;
+		int64		walReads;
+		int64		walReadBytes;
+		int64		walPrefetches;
+		double		walReadTime;
+		int64		relCacheHits;
+		int64		relCacheMisses;
+		int64		outputMessages;
+		int64		outputBytes;
+		int64		outputFlushes;
 		WalSndState state;
 		Datum		values[PG_STAT_GET_WAL_SENDERS_COLS];
 		bool		nulls[PG_STAT_GET_WAL_SENDERS_COLS];
@@ -2999,6 +3585,19 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 		write = walsnd->write;
 		flush = walsnd->flush;
 		apply = walsnd->apply;
+		spillTxns = walsnd->spillTxns;
+		spillCount = walsnd->spillCount;
+		spillBytes = walsnd->spillBytes;
+		spillDiskBytes = walsnd->spillDiskBytes;
+		walReads = walsnd->walReads;
+		walReadBytes = walsnd->walReadBytes;
+		walPrefetches = walsnd->walPrefetches;
+		walReadTime = walsnd->walReadTime;
+		relCacheHits = walsnd->relCacheHits;
+		relCacheMisses = walsnd->relCacheMisses;
+		outputMessages = walsnd->outputMessages;
+		outputBytes = walsnd->outputBytes;
+		outputFlushes = walsnd->outputFlushes;
 		SpinLockRelease(&walsnd->mutex);
 
 		memset(nulls, 0, sizeof(nulls));
@@ -3033,14 +3632,38 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 
 			/*
 			 * More easily understood version of standby state. This is purely
-			 * informational, not different from priority.
+			 * informational, not different from priority. All candidates of
+			 * a quorum set take part in releasing waiters.
 			 */
 			if (sync_priority[i] == 0)
 				values[7] = CStringGetTextDatum("async");
+			else if (quorum)
+				values[7] = CStringGetTextDatum("quorum");
 			else if (i == sync_standby)
 				values[7] = CStringGetTextDatum("sync");
 			else
 				values[7] = CStringGetTextDatum("potential");
+
+			/* spill to disk */
+			values[8] = Int64GetDatum(spillTxns);
+			values[9] = Int64GetDatum(spillCount);
+			values[10] = Int64GetDatum(spillBytes);
+			values[11] = Int64GetDatum(spillDiskBytes);
+
+			/* WAL read by logical decoding */
+			values[12] = Int64GetDatum(walReads);
+			values[13] = Int64GetDatum(walReadBytes);
+			values[14] = Int64GetDatum(walPrefetches);
+			values[15] = Float8GetDatum(walReadTime);
+
+			/* relations looked up by logical decoding */
+			values[16] = Int64GetDatum(relCacheHits);
+			values[17] = Int64GetDatum(relCacheMisses);
+
+			/* data sent to the client */
+			values[18] = Int64GetDatum(outputMessages);
+			values[19] = Int64GetDatum(outputBytes);
+			values[20] = Int64GetDatum(outputFlushes);
 		}
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
@@ -3105,8 +3728,7 @@ WalSndKeepaliveIfNecessary(void)
 		waiting_for_ping_response = true;
 
 		/* Try to flush pending output to the client */
-		if (pq_flush_if_writable() != 0)
-			WalSndShutdown();
+		WalSndFlush();
 	}
 }
 
@@ -3152,38 +3774,203 @@ GetOldestWALSendPointer(void)
 
 #endif
 
+/*
+ * Wake up the backends waiting for a standby to receive WAL up to flushPtr,
+ * or to apply it up to applyPtr.
+ *
+ * The woken up backends are removed from the queue, they'll queue
+ * themselves again if they still have to wait for other standbys.
+ */
 static void
-wait_for_remote_lsn(int32 pid, XLogRecPtr ptr, bool wait_for_apply)
+WalSndWakeRemoteWaiters(XLogRecPtr flushPtr, XLogRecPtr applyPtr)
 {
-	int i;
-	bool done;
+	/* use volatile pointer to prevent code rearrangement */
+	volatile WalSndCtlData *walsndctl = WalSndCtl;
+	int			mode;
 
-	do {
-		done = true;
+	for (mode = 0; mode < NUM_REMOTE_WAIT_MODES; mode++)
+	{
+		SHM_QUEUE  *queue = &(WalSndCtl->remoteWaitQueue[mode]);
+		XLogRecPtr	ptr = mode == REMOTE_WAIT_APPLY ? applyPtr : flushPtr;
 
-		for (i = 0; i < max_wal_senders; i++)
+		for (;;)
 		{
-			volatile WalSnd *walsnd = &WalSndCtl->walsnds[i];
+			PGPROC	   *proc;
 
-			SpinLockAcquire(&walsnd->mutex);
-
-			if (walsnd->pid != 0 && (pid == 0 || pid == walsnd->pid))
+			SpinLockAcquire(&walsndctl->remoteWaitMutex);
+			proc = (PGPROC *) SHMQueueNext(queue, queue,
+										   offsetof(PGPROC, remoteWaitLinks));
+			if (proc == NULL || proc->remoteWaitLSN > ptr)
 			{
-				XLogRecPtr rptr = wait_for_apply ? walsnd->apply : walsnd->flush;
-				if (rptr < ptr)
-					done = false;
+				SpinLockRelease(&walsndctl->remoteWaitMutex);
+				break;
 			}
+			SHMQueueDelete(&(proc->remoteWaitLinks));
+			SpinLockRelease(&walsndctl->remoteWaitMutex);
 
-			SpinLockRelease(&walsnd->mutex);
+			SetLatch(&(proc->procLatch));
+		}
+	}
+}
+
+/*
+ * Queue ourselves to be woken up once a standby reaches ptr, ordered by the
+ * location waited for.
+ */
+static void
+RemoteWaitQueueInsert(WalSndRemoteWaitMode mode, XLogRecPtr ptr)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile WalSndCtlData *walsndctl = WalSndCtl;
+	SHM_QUEUE  *queue = &(WalSndCtl->remoteWaitQueue[mode]);
+	PGPROC	   *proc;
+
+	SpinLockAcquire(&walsndctl->remoteWaitMutex);
+
+	Assert(SHMQueueIsDetached(&(MyProc->remoteWaitLinks)));
+	MyProc->remoteWaitLSN = ptr;
+
+	/* most waiters wait for recent locations, so search from the tail */
+	proc = (PGPROC *) SHMQueuePrev(queue, queue,
+								   offsetof(PGPROC, remoteWaitLinks));
+	while (proc && proc->remoteWaitLSN > ptr)
+		proc = (PGPROC *) SHMQueuePrev(queue, &(proc->remoteWaitLinks),
+									   offsetof(PGPROC, remoteWaitLinks));
+
+	if (proc)
+		SHMQueueInsertAfter(&(proc->remoteWaitLinks),
+							&(MyProc->remoteWaitLinks));
+	else
+		SHMQueueInsertAfter(queue, &(MyProc->remoteWaitLinks));
+
+	SpinLockRelease(&walsndctl->remoteWaitMutex);
+}
+
+/*
+ * Remove ourselves from the queue, unless a walsender already did so.
+ */
+static void
+RemoteWaitQueueDelete(void)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile WalSndCtlData *walsndctl = WalSndCtl;
+
+	SpinLockAcquire(&walsndctl->remoteWaitMutex);
+	if (!SHMQueueIsDetached(&(MyProc->remoteWaitLinks)))
+		SHMQueueDelete(&(MyProc->remoteWaitLinks));
+	SpinLockRelease(&walsndctl->remoteWaitMutex);
+}
+
+/*
+ * Check whether the standbys connected to the walsenders, or only the one
+ * connected to the walsender with the given pid if pid isn't 0, have
+ * received, or applied if wait_for_apply, WAL up to ptr.
+ *
+ * If quorum is > 0 that many of them have to, otherwise all of them.
+ */
+static bool
+remote_lsn_reached(int32 pid, XLogRecPtr ptr, bool wait_for_apply, int quorum)
+{
+	int			nsenders = 0;
+	int			nreached = 0;
+	int			i;
+
+	for (i = 0; i < max_wal_senders; i++)
+	{
+		volatile WalSnd *walsnd = &WalSndCtl->walsnds[i];
+
+		SpinLockAcquire(&walsnd->mutex);
+
+		if (walsnd->pid != 0 && (pid == 0 || pid == walsnd->pid))
+		{
+			XLogRecPtr rptr = wait_for_apply ? walsnd->apply : walsnd->flush;
+
+			nsenders++;
+			if (rptr >= ptr)
+				nreached++;
+		}
+
+		SpinLockRelease(&walsnd->mutex);
+	}
+
+	if (quorum > 0)
+		return nreached >= quorum;
+	return nreached == nsenders;
+}
 
-			if (!done)
+/*
+ * Wait until remote_lsn_reached() is true, for at most timeout milliseconds
+ * unless timeout is 0.  Returns whether it has been reached.
+ *
+ * Instead of polling, we queue ourselves ordered by ptr, and walsenders
+ * wake us up as soon as their standby reports having reached it.
+ */
+static bool
+wait_for_remote_lsn(int32 pid, XLogRecPtr ptr, bool wait_for_apply,
+					int timeout, int quorum)
+{
+	WalSndRemoteWaitMode mode;
+	TimestampTz end = 0;
+	bool		reached;
+
+	if (timeout < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("timeout must not be negative")));
+	if (quorum < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("quorum must not be negative")));
+
+	mode = wait_for_apply ? REMOTE_WAIT_APPLY : REMOTE_WAIT_RECEIVE;
+
+	if (timeout > 0)
+		end = TimestampTzPlusMilliseconds(GetCurrentTimestamp(), timeout);
+
+	for (;;)
+	{
+		long		sleeptime = -1;
+		int			rc;
+
+		ResetLatch(&MyProc->procLatch);
+
+		CHECK_FOR_INTERRUPTS();
+
+		/*
+		 * Queue ourselves before checking, so a standby reaching ptr after
+		 * we've checked will wake us up.
+		 */
+		RemoteWaitQueueInsert(mode, ptr);
+
+		reached = remote_lsn_reached(pid, ptr, wait_for_apply, quorum);
+		if (reached)
+			break;
+
+		if (timeout > 0)
+		{
+			long		secs;
+			int			usecs;
+
+			TimestampDifference(GetCurrentTimestamp(), end, &secs, &usecs);
+			if (secs == 0 && usecs == 0)
 				break;
+			sleeptime = secs * 1000 + (usecs + 999) / 1000;
 		}
 
-		if (!done)
-			pg_usleep(10*1000);
+		rc = WaitLatch(&MyProc->procLatch,
+					   WL_LATCH_SET | WL_POSTMASTER_DEATH |
+					   (timeout > 0 ? WL_TIMEOUT : 0),
+					   sleeptime);
+
+		RemoteWaitQueueDelete();
+
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
 	}
-	while (!done);
+
+	RemoteWaitQueueDelete();
+
+	return reached;
 }
 
 Datum
@@ -3195,7 +3982,7 @@ pg_xlog_wait_remote_apply(PG_FUNCTION_ARGS)
 	if (GetTopTransactionIdIfAny() != InvalidTransactionId)
 		elog(ERROR, "waiting in xact with dml");
 
-	wait_for_remote_lsn(pid, startpos, true);
+	wait_for_remote_lsn(pid, startpos, true, 0, 0);
 
 	PG_RETURN_VOID();
 }
@@ -3206,7 +3993,41 @@ pg_xlog_wait_remote_receive(PG_FUNCTION_ARGS)
 	XLogRecPtr startpos = PG_GETARG_LSN(0);
 	int32 pid = PG_GETARG_INT32(1);
 
-	wait_for_remote_lsn(pid, startpos, false);
+	wait_for_remote_lsn(pid, startpos, false, 0, 0);
 
 	PG_RETURN_VOID();
 }
+
+/*
+ * Like pg_xlog_wait_remote_apply(), but gives up after timeout milliseconds,
+ * unless that's 0, and if quorum is > 0, only waits until that many standbys
+ * applied the WAL.  Returns whether they did.
+ */
+Datum
+pg_xlog_wait_remote_apply_quorum(PG_FUNCTION_ARGS)
+{
+	XLogRecPtr startpos = PG_GETARG_LSN(0);
+	int32 pid = PG_GETARG_INT32(1);
+	int32 timeout = PG_GETARG_INT32(2);
+	int32 quorum = PG_GETARG_INT32(3);
+
+	if (GetTopTransactionIdIfAny() != InvalidTransactionId)
+		elog(ERROR, "waiting in xact with dml");
+
+	PG_RETURN_BOOL(wait_for_remote_lsn(pid, startpos, true, timeout, quorum));
+}
+
+/*
+ * Like pg_xlog_wait_remote_receive(), with timeout and quorum as in
+ * pg_xlog_wait_remote_apply_quorum().
+ */
+Datum
+pg_xlog_wait_remote_receive_quorum(PG_FUNCTION_ARGS)
+{
+	XLogRecPtr startpos = PG_GETARG_LSN(0);
+	int32 pid = PG_GETARG_INT32(1);
+	int32 timeout = PG_GETARG_INT32(2);
+	int32 quorum = PG_GETARG_INT32(3);
+
+	PG_RETURN_BOOL(wait_for_remote_lsn(pid, startpos, false, timeout, quorum));
+}
@@ -19,6 +19,7 @@
 #include "access/heapam.h"
 #include "access/multixact.h"
 #include "access/nbtree.h"
+#include "access/seqam.h"
 #include "access/subtrans.h"
 #include "access/twophase.h"
 #include "commands/async.h"
@@ -28,7 +29,9 @@
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/postmaster.h"
+#include "replication/decodegroup.h"
 #include "replication/slot.h"
+#include "replication/snapbuild.h"
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
 #include "replication/replication_identifier.h"
@@ -132,8 +135,12 @@ CreateSharedMemoryAndSemaphores(int port)
 		size = add_size(size, ReplicationSlotsShmemSize());
 		size = add_size(size, ReplicationIdentifierShmemSize());
 		size = add_size(size, WalSndShmemSize());
+		size = add_size(size, DecodingGroupShmemSize());
+		size = add_size(size, SnapBuildShmemSize());
 		size = add_size(size, WalRcvShmemSize());
 		size = add_size(size, BTreeShmemSize());
+		size = add_size(size, SharedSeqShmemSize());
+		size = add_size(size, SeqRefillShmemSize());
 		size = add_size(size, SyncScanShmemSize());
 		size = add_size(size, AsyncShmemSize());
 #ifdef EXEC_BACKEND
@@ -236,12 +243,16 @@ CreateSharedMemoryAndSemaphores(int port)
 	ReplicationSlotsShmemInit();
 	ReplicationIdentifierShmemInit();
 	WalSndShmemInit();
+	DecodingGroupShmemInit();
+	SnapBuildShmemInit();
 	WalRcvShmemInit();
 
 	/*
 	 * Set up other modules that need some shared memory space
 	 */
 	BTreeShmemInit();
+	SharedSeqShmemInit();
+	SeqRefillShmemInit();
 	SyncScanShmemInit();
 	AsyncShmemInit();
 
@@ -239,8 +239,8 @@ NumLWLocks(void)
 	/* clog.c needs one per CLOG buffer */
 	numLocks += CLOGShmemBuffers();
 
-	/* committs.c needs one per CommitTs buffer */
-	numLocks += CommitTsShmemBuffers();
+	/* committs.c needs one per CommitTs buffer and bank */
+	numLocks += CommitTsNumLWLocks();
 
 	/* subtrans.c needs one per SubTrans buffer */
 	numLocks += NUM_SUBTRANS_BUFFERS;
@@ -254,8 +254,9 @@ NumLWLocks(void)
 	/* predicate.c needs one per old serializable xid buffer */
 	numLocks += NUM_OLDSERXID_BUFFERS;
 
-	/* slot.c needs one for each slot */
-	numLocks += max_replication_slots;
+	/* slot.c needs one for each slot, plus one to compute their minima */
+	if (max_replication_slots > 0)
+		numLocks += max_replication_slots + 1;
 
 	/*
 	 * Add any requested by loadable modules; for backwards-compatibility
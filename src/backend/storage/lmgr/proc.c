@@ -391,6 +391,8 @@ InitProcess(void)
 	MyProc->waitLSN = 0;
 	MyProc->syncRepState = SYNC_REP_NOT_WAITING;
 	SHMQueueElemInit(&(MyProc->syncRepLinks));
+	MyProc->remoteWaitLSN = InvalidXLogRecPtr;
+	SHMQueueElemInit(&(MyProc->remoteWaitLinks));
 
 	/*
 	 * Acquire ownership of the PGPROC's latch, so that we can use WaitLatch.
@@ -76,7 +76,7 @@
 #include "tcop/deparse_utility.h"
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
-#include "utils/json.h"
+#include "utils/jsonb.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
@@ -128,6 +128,49 @@ static void append_string_object(ObjTree *tree, char *name, char *value);
 static void append_object_object(ObjTree *tree, char *name, ObjTree *value);
 static void append_array_object(ObjTree *tree, char *name, List *array);
 static inline void append_premade_object(ObjTree *tree, ObjElem *elem);
+static JsonbValue *objtree_to_jsonb_rec(ObjTree *tree, JsonbParseState **state);
+
+/*
+ * Names of schemas, types and other objects looked up while deparsing a
+ * command are cached, as a command tends to refer to the same few of them
+ * over and over again, e.g. the schema of every column type and constraint
+ * of a table.  The cache lives in the memory context of the command's
+ * deparsing and is discarded along with it, so it never outlives catalog
+ * changes.
+ *
+ * The same object can be looked up in different ways that store different
+ * data in the entry, e.g. a type as a %{}T element or as a plain qualified
+ * name, so the kind of lookup is part of the key.
+ */
+typedef enum DeparseNameKind
+{
+	DEPARSE_NAME_NAMESPACE,		/* deparse_namespace_name() */
+	DEPARSE_NAME_TYPE,			/* new_objtree_for_type() */
+	DEPARSE_NAME_QUALNAME		/* new_objtree_for_qualname_id() */
+} DeparseNameKind;
+
+typedef struct DeparseNameKey
+{
+	DeparseNameKind kind;		/* how the object was looked up */
+	Oid			classId;		/* catalog the object is in */
+	Oid			objectId;		/* OID of the object */
+	int32		typmod;			/* type modifier for types, else -1 */
+} DeparseNameKey;
+
+typedef struct DeparseNameEntry
+{
+	DeparseNameKey key;			/* hash key, must be first */
+	char	   *schemaname;		/* schema name, "pg_temp" or "" */
+	char	   *objname;		/* object name */
+	char	   *typmodstr;		/* types only: typmod as a string */
+	bool		is_array;		/* types only: is it an array type? */
+} DeparseNameEntry;
+
+static HTAB *deparse_name_cache = NULL;
+
+static DeparseNameEntry *deparse_name_lookup(DeparseNameKind kind,
+					Oid classId, Oid objectId, int32 typmod, bool *found);
+static char *deparse_namespace_name(Oid nspid);
 
 /*
  * Allocate a new object tree to store parameter values.
@@ -376,146 +419,103 @@ append_premade_object(ObjTree *tree, ObjElem *elem)
 }
 
 /*
- * Create a JSON blob from our ad-hoc representation.
- *
- * Note this leaks some memory; caller is responsible for later clean up.
- *
- * XXX this implementation will fail if there are more JSON objects in the tree
- * than the maximum number of columns in a heap tuple.  To fix we would first call
- * construct_md_array and then json_object.
+ * Add a parameter value to a jsonb value under construction, as the value of
+ * an object key or as an array element, according to token.
  */
-static char *
-jsonize_objtree(ObjTree *tree)
+static void
+objelem_to_jsonb(JsonbParseState **state, ObjElem *object,
+				 JsonbIteratorToken token)
+{
+	JsonbValue	val;
+	ListCell   *cell;
+
+	switch (object->objtype)
+	{
+		case ObjTypeNull:
+			val.type = jbvNull;
+			pushJsonbValue(state, token, &val);
+			break;
+		case ObjTypeBool:
+			val.type = jbvBool;
+			val.val.boolean = object->bool_value;
+			pushJsonbValue(state, token, &val);
+			break;
+		case ObjTypeString:
+			/* a missing string, such as an absent typmod, becomes null */
+			if (object->str_value == NULL)
+				val.type = jbvNull;
+			else
+			{
+				val.type = jbvString;
+				val.val.string.val = object->str_value;
+				val.val.string.len = strlen(object->str_value);
+			}
+			pushJsonbValue(state, token, &val);
+			break;
+		case ObjTypeInteger:
+			val.type = jbvNumeric;
+			val.val.numeric =
+				DatumGetNumeric(DirectFunctionCall1(int4_numeric,
+											Int32GetDatum(object->int_value)));
+			pushJsonbValue(state, token, &val);
+			break;
+		case ObjTypeArray:
+			/* arrays are stored as Lists of ObjElem up to this point */
+			pushJsonbValue(state, WJB_BEGIN_ARRAY, NULL);
+			foreach(cell, object->array_value)
+				objelem_to_jsonb(state, (ObjElem *) lfirst(cell), WJB_ELEM);
+			pushJsonbValue(state, WJB_END_ARRAY, NULL);
+			break;
+		case ObjTypeObject:
+			objtree_to_jsonb_rec(object->obj_value, state);
+			break;
+		default:
+			elog(ERROR, "unrecognized object type %d", object->objtype);
+	}
+}
+
+/*
+ * Add an object tree to a jsonb value under construction, returning the
+ * resulting object if it is the outermost one.
+ */
+static JsonbValue *
+objtree_to_jsonb_rec(ObjTree *tree, JsonbParseState **state)
 {
-	TupleDesc	tupdesc;
-	Datum	   *values;
-	bool	   *nulls;
 	slist_iter	iter;
-	int			i;
-	HeapTuple	htup;
-	Datum		json;
-	char	   *jsonstr;
 
-	tupdesc = CreateTemplateTupleDesc(tree->numParams, false);
-	values = palloc(sizeof(Datum) * tree->numParams);
-	nulls = palloc(sizeof(bool) * tree->numParams);
+	pushJsonbValue(state, WJB_BEGIN_OBJECT, NULL);
 
-	i = 1;
 	slist_foreach(iter, &tree->params)
 	{
 		ObjElem    *object = slist_container(ObjElem, node, iter.cur);
-		Oid			typeid;
-
-		switch (object->objtype)
-		{
-			case ObjTypeNull:
-			case ObjTypeString:
-				typeid = TEXTOID;
-				break;
-			case ObjTypeBool:
-				typeid = BOOLOID;
-				break;
-			case ObjTypeInteger:
-				typeid = INT8OID;
-				break;
-			case ObjTypeArray:
-			case ObjTypeObject:
-				typeid = JSONOID;
-				break;
-			default:
-				elog(ERROR, "unable to determine type id");
-				typeid = InvalidOid;
-		}
-
-		TupleDescInitEntry(tupdesc, i, object->name, typeid, -1, 0);
-
-		nulls[i - 1] = false;
-		switch (object->objtype)
-		{
-			case ObjTypeNull:
-				nulls[i - 1] = true;
-				break;
-			case ObjTypeBool:
-				values[i - 1] = BoolGetDatum(object->bool_value);
-				break;
-			case ObjTypeString:
-				values[i - 1] = CStringGetTextDatum(object->str_value);
-				break;
-			case ObjTypeInteger:
-				values[i - 1] = Int64GetDatum(object->int_value);
-				break;
-			case ObjTypeArray:
-				{
-					ArrayType  *arrayt;
-					Datum	   *arrvals;
-					Datum		jsonary;
-					ListCell   *cell;
-					int			length = list_length(object->array_value);
-					int			j;
-
-					/*
-					 * Arrays are stored as Lists up to this point, with each
-					 * element being a ObjElem; we need to construct an
-					 * ArrayType with them to turn the whole thing into a JSON
-					 * array.
-					 */
-					j = 0;
-					arrvals = palloc(sizeof(Datum) * length);
-					foreach(cell, object->array_value)
-					{
-						ObjElem    *elem = lfirst(cell);
-
-						switch (elem->objtype)
-						{
-							case ObjTypeString:
-								arrvals[j] =
-									/*
-									 * XXX need quotes around the value.  This
-									 * needs to be handled differently because
-									 * it will fail for values of anything but
-									 * trivial complexity.
-									 */
-									CStringGetTextDatum(psprintf("\"%s\"",
-																 elem->str_value));
-								break;
-							case ObjTypeObject:
-								arrvals[j] =
-									CStringGetTextDatum(jsonize_objtree(elem->obj_value));
-								break;
-							default:
-								/* not worth supporting other cases */
-								elog(ERROR, "unsupported object type %d",
-									 elem->objtype);
-						}
-
-						j++;
-
-					}
-					arrayt = construct_array(arrvals, length,
-											 JSONOID, -1, false, 'i');
+		JsonbValue	key;
 
-					jsonary = DirectFunctionCall1(array_to_json,
-												  (PointerGetDatum(arrayt)));
-
-					values[i - 1] = jsonary;
-				}
-				break;
-			case ObjTypeObject:
-				values[i - 1] =
-					CStringGetTextDatum(jsonize_objtree(object->obj_value));
-				break;
-		}
+		key.type = jbvString;
+		key.val.string.val = object->name;
+		key.val.string.len = strlen(object->name);
+		pushJsonbValue(state, WJB_KEY, &key);
 
-		i++;
+		objelem_to_jsonb(state, object, WJB_VALUE);
 	}
 
-	BlessTupleDesc(tupdesc);
-	htup = heap_form_tuple(tupdesc, values, nulls);
-	json = DirectFunctionCall1(row_to_json, HeapTupleGetDatum(htup));
+	return pushJsonbValue(state, WJB_END_OBJECT, NULL);
+}
 
-	jsonstr = TextDatumGetCString(json);
+/*
+ * Create a jsonb blob from our ad-hoc representation.
+ *
+ * The tree is handed to the jsonb builder directly, so that no JSON text is
+ * produced and parsed again on the way, and consumers can look up elements
+ * in the result without parsing it either.
+ *
+ * Note this leaks some memory; caller is responsible for later clean up.
+ */
+static Jsonb *
+jsonize_objtree(ObjTree *tree)
+{
+	JsonbParseState *state = NULL;
 
-	return jsonstr;
+	return JsonbValueToJsonb(objtree_to_jsonb_rec(tree, &state));
 }
 
 /*
@@ -527,6 +527,68 @@ free_objtree(ObjTree *tree)
 	/* XXX nothing here */
 }
 
+/*
+ * Find the cache entry of an object, creating it if it doesn't exist yet;
+ * *found tells whether the entry is filled in already.
+ */
+static DeparseNameEntry *
+deparse_name_lookup(DeparseNameKind kind, Oid classId, Oid objectId,
+					int32 typmod, bool *found)
+{
+	DeparseNameKey key;
+
+	if (deparse_name_cache == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(DeparseNameKey);
+		ctl.entrysize = sizeof(DeparseNameEntry);
+		ctl.hash = tag_hash;
+		ctl.hcxt = CurrentMemoryContext;
+
+		deparse_name_cache = hash_create("deparse name cache", 64, &ctl,
+										 HASH_ELEM | HASH_FUNCTION |
+										 HASH_CONTEXT);
+	}
+
+	/* zero any padding, as tag_hash hashes the key as a whole */
+	MemSet(&key, 0, sizeof(key));
+	key.kind = kind;
+	key.classId = classId;
+	key.objectId = objectId;
+	key.typmod = typmod;
+
+	return (DeparseNameEntry *) hash_search(deparse_name_cache, &key,
+											HASH_ENTER, found);
+}
+
+/*
+ * Return the name of a schema as it should appear in a deparsed command,
+ * i.e. "pg_temp" for temp schemas.
+ */
+static char *
+deparse_namespace_name(Oid nspid)
+{
+	DeparseNameEntry *entry;
+	bool		found;
+
+	entry = deparse_name_lookup(DEPARSE_NAME_NAMESPACE, NamespaceRelationId,
+								nspid, -1, &found);
+	if (!found)
+	{
+		entry->schemaname = NULL;
+		entry->typmodstr = NULL;
+		entry->is_array = false;
+		if (isAnyTempNamespace(nspid))
+			entry->objname = pstrdup("pg_temp");
+		else
+			entry->objname = get_namespace_name(nspid);
+	}
+
+	return entry->objname;
+}
+
 /*
  * A helper routine to setup %{}T elements.
  */
@@ -534,45 +596,50 @@ static ObjTree *
 new_objtree_for_type(Oid typeId, int32 typmod)
 {
 	ObjTree    *typeParam;
-	Oid			typnspid;
-	char	   *typnsp;
-	char	   *typename;
-	char	   *typmodstr;
-	bool		is_array;
-
-	format_type_detailed(typeId, typmod,
-						 &typnspid, &typename, &typmodstr, &is_array);
-
-	if (!OidIsValid(typnspid))
-		typnsp = pstrdup("");
-	else if (isAnyTempNamespace(typnspid))
-		typnsp = pstrdup("pg_temp");
-	else
-		typnsp = get_namespace_name(typnspid);
+	DeparseNameEntry *entry;
+	bool		found;
 
-	/*
-	 * XXX We need this kludge to support types whose typmods include extra
-	 * verbiage after the parenthised value.  Really, this only applies to
-	 * timestamp and timestamptz, whose typmod take the form "(N) with[out]
-	 * time zone", which causes a syntax error with schema-qualified names
-	 * extracted from pg_type (as opposed to specialized type names defined by
-	 * the SQL standard).
-	 */
-	if (typmodstr)
+	entry = deparse_name_lookup(DEPARSE_NAME_TYPE, TypeRelationId, typeId,
+								typmod, &found);
+	if (!found)
 	{
-		char	*clpar;
+		Oid			typnspid;
+		char	   *typmodstr;
+
+		format_type_detailed(typeId, typmod,
+							 &typnspid, &entry->objname, &typmodstr,
+							 &entry->is_array);
+
+		if (!OidIsValid(typnspid))
+			entry->schemaname = pstrdup("");
+		else
+			entry->schemaname = deparse_namespace_name(typnspid);
+
+		/*
+		 * XXX We need this kludge to support types whose typmods include extra
+		 * verbiage after the parenthised value.  Really, this only applies to
+		 * timestamp and timestamptz, whose typmod take the form "(N) with[out]
+		 * time zone", which causes a syntax error with schema-qualified names
+		 * extracted from pg_type (as opposed to specialized type names defined by
+		 * the SQL standard).
+		 */
+		if (typmodstr)
+		{
+			char	*clpar;
 
-		clpar = strchr(typmodstr, ')');
-		if (clpar)
-			*(clpar + 1) = '\0';
+			clpar = strchr(typmodstr, ')');
+			if (clpar)
+				*(clpar + 1) = '\0';
+		}
+		entry->typmodstr = typmodstr;
 	}
 
 	/* We don't use new_objtree_VA here because types don't have a "fmt" */
 	typeParam = new_objtree();
-	append_string_object(typeParam, "schemaname", typnsp);
-	append_string_object(typeParam, "typename", typename);
-	append_string_object(typeParam, "typmod", typmodstr);
-	append_bool_object(typeParam, "is_array", is_array);
+	append_string_object(typeParam, "schemaname", entry->schemaname);
+	append_string_object(typeParam, "typename", entry->objname);
+	append_string_object(typeParam, "typmod", entry->typmodstr);
+	append_bool_object(typeParam, "is_array", entry->is_array);
 
 	return typeParam;
 }
@@ -591,17 +658,13 @@ static ObjTree *
 new_objtree_for_qualname(Oid nspid, char *name)
 {
 	ObjTree    *qualified;
-	char	   *namespace;
 
 	/*
 	 * We don't use new_objtree_VA here because these names don't have a "fmt"
 	 */
 	qualified = new_objtree();
-	if (isAnyTempNamespace(nspid))
-		namespace = pstrdup("pg_temp");
-	else
-		namespace = get_namespace_name(nspid);
-	append_string_object(qualified, "schemaname", namespace);
+	append_string_object(qualified, "schemaname",
+						 deparse_namespace_name(nspid));
 	append_string_object(qualified, "objname", pstrdup(name));
 
 	return qualified;
@@ -618,37 +681,51 @@ static ObjTree *
 new_objtree_for_qualname_id(Oid classId, Oid objectId)
 {
 	ObjTree    *qualified;
-	Relation	catalog;
-	HeapTuple	catobj;
-	Datum		objnsp;
-	Datum		objname;
-	AttrNumber	Anum_name;
-	AttrNumber	Anum_namespace;
-	bool		isnull;
+	DeparseNameEntry *entry;
+	bool		found;
 
-	catalog = heap_open(classId, AccessShareLock);
+	entry = deparse_name_lookup(DEPARSE_NAME_QUALNAME, classId, objectId, -1,
+								&found);
+	if (!found)
+	{
+		Relation	catalog;
+		HeapTuple	catobj;
+		Datum		objnsp;
+		Datum		objname;
+		AttrNumber	Anum_name;
+		AttrNumber	Anum_namespace;
+		bool		isnull;
 
-	catobj = get_catalog_object_by_oid(catalog, objectId);
-	if (!catobj)
-		elog(ERROR, "cache lookup failed for object %u of catalog \"%s\"",
-			 objectId, RelationGetRelationName(catalog));
-	Anum_name = get_object_attnum_name(classId);
-	Anum_namespace = get_object_attnum_namespace(classId);
+		catalog = heap_open(classId, AccessShareLock);
 
-	objnsp = heap_getattr(catobj, Anum_namespace, RelationGetDescr(catalog),
-						  &isnull);
-	if (isnull)
-		elog(ERROR, "unexpected NULL namespace");
-	objname = heap_getattr(catobj, Anum_name, RelationGetDescr(catalog),
-						   &isnull);
-	if (isnull)
-		elog(ERROR, "unexpected NULL name");
+		catobj = get_catalog_object_by_oid(catalog, objectId);
+		if (!catobj)
+			elog(ERROR, "cache lookup failed for object %u of catalog \"%s\"",
+				 objectId, RelationGetRelationName(catalog));
+		Anum_name = get_object_attnum_name(classId);
+		Anum_namespace = get_object_attnum_namespace(classId);
 
-	qualified = new_objtree_for_qualname(DatumGetObjectId(objnsp),
-										 NameStr(*DatumGetName(objname)));
+		objnsp = heap_getattr(catobj, Anum_namespace, RelationGetDescr(catalog),
+							  &isnull);
+		if (isnull)
+			elog(ERROR, "unexpected NULL namespace");
+		objname = heap_getattr(catobj, Anum_name, RelationGetDescr(catalog),
+							   &isnull);
+		if (isnull)
+			elog(ERROR, "unexpected NULL name");
+
+		entry->schemaname = deparse_namespace_name(DatumGetObjectId(objnsp));
+		entry->objname = pstrdup(NameStr(*DatumGetName(objname)));
+		entry->typmodstr = NULL;
+		entry->is_array = false;
+
+		pfree(catobj);
+		heap_close(catalog, AccessShareLock);
+	}
 
-	pfree(catobj);
-	heap_close(catalog, AccessShareLock);
+	qualified = new_objtree();
+	append_string_object(qualified, "schemaname", entry->schemaname);
+	append_string_object(qualified, "objname", pstrdup(entry->objname));
 
 	return qualified;
 }
@@ -1472,12 +1549,12 @@ deparse_DefineStmt_Type(Oid objectId, DefineStmt *define)
 	return stmt;
 }
 
-static char *
+static Jsonb *
 deparse_DefineStmt(Oid objectId, Node *parsetree)
 {
 	DefineStmt *define = (DefineStmt *) parsetree;
 	ObjTree	   *defStmt;
-	char	   *command;
+	Jsonb	   *command;
 
 	switch (define->kind)
 	{
@@ -1534,7 +1611,7 @@ deparse_DefineStmt(Oid objectId, Node *parsetree)
  * XXX the current representation makes the output command dependant on the
  * installed versions of the extension.  Is this a problem?
  */
-static char *
+static Jsonb *
 deparse_CreateExtensionStmt(Oid objectId, Node *parsetree)
 {
 	CreateExtensionStmt *node = (CreateExtensionStmt *) parsetree;
@@ -1543,7 +1620,7 @@ deparse_CreateExtensionStmt(Oid objectId, Node *parsetree)
 	Form_pg_extension extForm;
 	ObjTree	   *extStmt;
 	ObjTree	   *tmp;
-	char	   *command;
+	Jsonb	   *command;
 	List	   *list;
 	ListCell   *cell;
 
@@ -1603,7 +1680,7 @@ deparse_CreateExtensionStmt(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_AlterExtensionStmt(Oid objectId, Node *parsetree)
 {
 	AlterExtensionStmt *node = (AlterExtensionStmt *) parsetree;
@@ -1611,7 +1688,7 @@ deparse_AlterExtensionStmt(Oid objectId, Node *parsetree)
 	HeapTuple   extTup;
 	Form_pg_extension extForm;
 	ObjTree	   *stmt;
-	char	   *command;
+	Jsonb	   *command;
 	char	   *version = NULL;
 	ListCell   *cell;
 
@@ -1656,13 +1733,13 @@ deparse_AlterExtensionStmt(Oid objectId, Node *parsetree)
  * Given a view OID and the parsetree that created it, return the JSON blob
  * representing the creation command.
  */
-static char *
+static Jsonb *
 deparse_ViewStmt(Oid objectId, Node *parsetree)
 {
 	ViewStmt   *node = (ViewStmt *) parsetree;
 	ObjTree    *viewStmt;
 	ObjTree    *tmp;
-	char	   *command;
+	Jsonb	   *command;
 	Relation	relation;
 
 	relation = relation_open(objectId, AccessShareLock);
@@ -1696,7 +1773,7 @@ deparse_ViewStmt(Oid objectId, Node *parsetree)
  * Given a trigger OID and the parsetree that created it, return the JSON blob
  * representing the creation command.
  */
-static char *
+static Jsonb *
 deparse_CreateTrigStmt(Oid objectId, Node *parsetree)
 {
 	CreateTrigStmt *node = (CreateTrigStmt *) parsetree;
@@ -1708,7 +1785,7 @@ deparse_CreateTrigStmt(Oid objectId, Node *parsetree)
 	int			tgnargs;
 	List	   *list;
 	List	   *events;
-	char	   *command;
+	Jsonb	   *command;
 
 	pg_trigger = heap_open(TriggerRelationId, AccessShareLock);
 
@@ -2260,7 +2337,7 @@ obtainConstraints(List *elements, Oid relationId, Oid domainId)
  * Given a table OID and the parsetree that created it, return the JSON blob
  * representing the creation command.
  */
-static char *
+static Jsonb *
 deparse_CreateStmt(Oid objectId, Node *parsetree)
 {
 	CreateStmt *node = (CreateStmt *) parsetree;
@@ -2270,7 +2347,7 @@ deparse_CreateStmt(Oid objectId, Node *parsetree)
 	ObjTree    *tmp;
 	List	   *list;
 	ListCell   *cell;
-	char	   *command;
+	Jsonb	   *command;
 	char	   *fmtstr;
 
 	/*
@@ -2476,7 +2553,7 @@ deparse_CreateStmt(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_CompositeTypeStmt(Oid objectId, Node *parsetree)
 {
 	CompositeTypeStmt *node = (CompositeTypeStmt *) parsetree;
@@ -2484,7 +2561,7 @@ deparse_CompositeTypeStmt(Oid objectId, Node *parsetree)
 	Relation	typerel = relation_open(objectId, AccessShareLock);
 	List	   *dpcontext;
 	List	   *tableelts = NIL;
-	char	   *command;
+	Jsonb	   *command;
 
 	dpcontext = deparse_context_for(RelationGetRelationName(typerel),
 									objectId);
@@ -2508,12 +2585,12 @@ deparse_CompositeTypeStmt(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_CreateEnumStmt(Oid objectId, Node *parsetree)
 {
 	CreateEnumStmt *node = (CreateEnumStmt *) parsetree;
 	ObjTree	   *enumtype;
-	char	   *command;
+	Jsonb	   *command;
 	List	   *values;
 	ListCell   *cell;
 
@@ -2537,7 +2614,7 @@ deparse_CreateEnumStmt(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_CreateRangeStmt(Oid objectId, Node *parsetree)
 {
 	ObjTree	   *range;
@@ -2548,7 +2625,7 @@ deparse_CreateRangeStmt(Oid objectId, Node *parsetree)
 	Form_pg_range rangeForm;
 	ScanKeyData key[1];
 	SysScanDesc scan;
-	char	   *command;
+	Jsonb	   *command;
 
 	pg_range = heap_open(RangeRelationId, RowExclusiveLock);
 
@@ -2639,12 +2716,12 @@ deparse_CreateRangeStmt(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_CreateDomain(Oid objectId, Node *parsetree)
 {
 	ObjTree	   *createDomain;
 	ObjTree	   *tmp;
-	char	   *command;
+	Jsonb	   *command;
 	HeapTuple	typTup;
 	Form_pg_type typForm;
 	List	   *constraints;
@@ -2704,7 +2781,7 @@ deparse_CreateDomain(Oid objectId, Node *parsetree)
  *
  * XXX this is missing the per-function custom-GUC thing.
  */
-static char *
+static Jsonb *
 deparse_CreateFunction(Oid objectId, Node *parsetree)
 {
 	CreateFunctionStmt *node = (CreateFunctionStmt *) parsetree;
@@ -2714,7 +2791,7 @@ deparse_CreateFunction(Oid objectId, Node *parsetree)
 	Datum		tmpdatum;
 	char	   *fmt;
 	char	   *definition;
-	char	   *command;
+	Jsonb	   *command;
 	char	   *source;
 	char	   *probin;
 	List	   *params;
@@ -3019,13 +3096,13 @@ deparse_CreateFunction(Oid objectId, Node *parsetree)
  *
  * XXX this is missing the per-function custom-GUC thing.
  */
-static char *
+static Jsonb *
 deparse_AlterFunction(Oid objectId, Node *parsetree)
 {
 	AlterFunctionStmt *node = (AlterFunctionStmt *) parsetree;
 	ObjTree	   *alterFunc;
 	ObjTree	   *sign;
-	char	   *command;
+	Jsonb	   *command;
 	HeapTuple	procTup;
 	Form_pg_proc procForm;
 	List	   *params;
@@ -3207,12 +3284,12 @@ stringify_objtype(ObjectType objtype)
 	}
 }
 
-static char *
+static Jsonb *
 deparse_RenameStmt(Oid objectId, Node *parsetree)
 {
 	RenameStmt *node = (RenameStmt *) parsetree;
 	ObjTree	   *renameStmt;
-	char	   *command;
+	Jsonb	   *command;
 	char	   *fmtstr;
 	Relation	relation;
 	Oid			schemaId;
@@ -3607,14 +3684,14 @@ deparse_Seq_OwnedBy(ObjTree *parent, Oid sequenceId)
  * Given a sequence OID and the parsetree that created it, return the JSON blob
  * representing the creation command.
  */
-static char *
+static Jsonb *
 deparse_CreateSeqStmt(Oid objectId, Node *parsetree)
 {
 	CreateSeqStmt *node = (CreateSeqStmt *) parsetree;
 	ObjTree    *createSeq;
 	ObjTree    *tmp;
 	Relation	relation = relation_open(objectId, AccessShareLock);
-	char	   *command;
+	Jsonb	   *command;
 	Form_pg_sequence seqdata;
 	List	   *elems = NIL;
 
@@ -3658,14 +3735,14 @@ deparse_CreateSeqStmt(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_AlterSeqStmt(Oid objectId, Node *parsetree)
 {
 	AlterSeqStmt *node = ((AlterSeqStmt *) parsetree);
 	ObjTree	   *alterSeq;
 	ObjTree	   *tmp;
 	Relation	relation = relation_open(objectId, AccessShareLock);
-	char	   *command;
+	Jsonb	   *command;
 	Form_pg_sequence seqdata;
 	List	   *elems = NIL;
 	ListCell   *cell;
@@ -3732,7 +3809,7 @@ deparse_AlterSeqStmt(Oid objectId, Node *parsetree)
  *
  * If the index corresponds to a constraint, NULL is returned.
  */
-static char *
+static Jsonb *
 deparse_IndexStmt(Oid objectId, Node *parsetree)
 {
 	IndexStmt  *node = (IndexStmt *) parsetree;
@@ -3740,7 +3817,7 @@ deparse_IndexStmt(Oid objectId, Node *parsetree)
 	ObjTree    *tmp;
 	Relation	idxrel;
 	Relation	heaprel;
-	char	   *command;
+	Jsonb	   *command;
 	char	   *index_am;
 	char	   *definition;
 	char	   *reloptions;
@@ -3812,13 +3889,13 @@ deparse_IndexStmt(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_RuleStmt(Oid objectId, Node *parsetree)
 {
 	RuleStmt *node = (RuleStmt *) parsetree;
 	ObjTree	   *ruleStmt;
 	ObjTree	   *tmp;
-	char	   *command;
+	Jsonb	   *command;
 	Relation	pg_rewrite;
 	Form_pg_rewrite rewrForm;
 	HeapTuple	rewrTup;
@@ -3917,13 +3994,13 @@ deparse_RuleStmt(Oid objectId, Node *parsetree)
  * CreateSchemaCommand passes them back to ProcessUtility, which will lead to
  * this file if appropriate.)
  */
-static char *
+static Jsonb *
 deparse_CreateSchemaStmt(Oid objectId, Node *parsetree)
 {
 	CreateSchemaStmt *node = (CreateSchemaStmt *) parsetree;
 	ObjTree    *createSchema;
 	ObjTree    *auth;
-	char	   *command;
+	Jsonb	   *command;
 
 	createSchema =
 		new_objtree_VA("CREATE SCHEMA %{if_not_exists}s %{name}I %{authorization}s",
@@ -3948,13 +4025,13 @@ deparse_CreateSchemaStmt(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_AlterEnumStmt(Oid objectId, Node *parsetree)
 {
 	AlterEnumStmt *node = (AlterEnumStmt *) parsetree;
 	ObjTree	   *alterEnum;
 	ObjTree	   *tmp;
-	char	   *command;
+	Jsonb	   *command;
 
 	alterEnum =
 		new_objtree_VA("ALTER TYPE %{identity}D ADD VALUE %{if_not_exists}s %{value}L %{position}s",
@@ -3985,14 +4062,14 @@ deparse_AlterEnumStmt(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_AlterOwnerStmt(Oid objectId, Node *parsetree)
 {
 	AlterOwnerStmt *node = (AlterOwnerStmt *) parsetree;
 	ObjTree	   *ownerStmt;
 	ObjectAddress addr;
 	char	   *fmt;
-	char	   *command;
+	Jsonb	   *command;
 
 	fmt = psprintf("ALTER %s %%{identity}s OWNER TO %%{newname}I",
 				   stringify_objtype(node->objectType));
@@ -4012,14 +4089,14 @@ deparse_AlterOwnerStmt(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_CommentStmt(Oid objectId, Oid objectSubId, Node *parsetree)
 {
 	CommentStmt *node = (CommentStmt *) parsetree;
 	ObjTree	   *comment;
 	ObjectAddress addr;
 	char	   *fmt;
-	char	   *command;
+	Jsonb	   *command;
 
 	if (node->comment)
 	{
@@ -4048,14 +4125,14 @@ deparse_CommentStmt(Oid objectId, Oid objectSubId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_SecLabelStmt(Oid objectId, Oid objectSubId, Node *parsetree)
 {
 	SecLabelStmt *node = (SecLabelStmt *) parsetree;
 	ObjTree	   *label;
 	ObjectAddress addr;
 	char	   *fmt;
-	char	   *command;
+	Jsonb	   *command;
 
 	Assert(node->provider);
 
@@ -4089,13 +4166,13 @@ deparse_SecLabelStmt(Oid objectId, Oid objectSubId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_CreateConversion(Oid objectId, Node *parsetree)
 {
 	HeapTuple   conTup;
 	Form_pg_conversion conForm;
 	ObjTree	   *ccStmt;
-	char	   *command;
+	Jsonb	   *command;
 
 	conTup = SearchSysCache1(CONOID, ObjectIdGetDatum(objectId));
 	if (!HeapTupleIsValid(conTup))
@@ -4126,7 +4203,7 @@ deparse_CreateConversion(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_CreateOpFamily(Oid objectId, Node *parsetree)
 {
 	HeapTuple   opfTup;
@@ -4135,7 +4212,7 @@ deparse_CreateOpFamily(Oid objectId, Node *parsetree)
 	Form_pg_am  amForm;
 	ObjTree	   *copfStmt;
 	ObjTree	   *tmp;
-	char	   *command;
+	Jsonb	   *command;
 
 	opfTup = SearchSysCache1(OPFAMILYOID, ObjectIdGetDatum(objectId));
 	if (!HeapTupleIsValid(opfTup))
@@ -4165,12 +4242,12 @@ deparse_CreateOpFamily(Oid objectId, Node *parsetree)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_GrantStmt(StashedCommand *cmd)
 {
 	InternalGrant *istmt;
 	ObjTree	   *grantStmt;
-	char	   *command;
+	Jsonb	   *command;
 	char	   *fmt;
 	char	   *objtype;
 	List	   *list;
@@ -4377,7 +4454,7 @@ deparse_GrantStmt(StashedCommand *cmd)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_AlterTableStmt(StashedCommand *cmd)
 {
 	ObjTree	   *alterTableStmt;
@@ -4387,7 +4464,7 @@ deparse_AlterTableStmt(StashedCommand *cmd)
 	Relation	rel;
 	List	   *subcmds = NIL;
 	ListCell   *cell;
-	char	   *command;
+	Jsonb	   *command;
 	AlterTableStmt *node = (AlterTableStmt *) cmd->parsetree;
 
 	rel = heap_open(cmd->d.alterTable.objectId, AccessShareLock);
@@ -4766,13 +4843,13 @@ deparse_AlterTableStmt(StashedCommand *cmd)
 	return command;
 }
 
-static char *
+static Jsonb *
 deparse_parsenode_cmd(StashedCommand *cmd)
 {
 	Oid			objectId;
 	uint32		objectSubId = 0;
 	Node	   *parsetree;
-	char	   *command;
+	Jsonb	   *command;
 
 	parsetree = cmd->parsetree;
 
@@ -4932,18 +5009,19 @@ deparse_parsenode_cmd(StashedCommand *cmd)
 
 /*
  * Given a utility command parsetree and the OID of the corresponding object,
- * return a JSON representation of the command.
+ * return a jsonb representation of the command.
  *
  * The command is expanded fully, so that there are no ambiguities even in the
  * face of search_path changes.
  */
-char *
+Jsonb *
 deparse_utility_command(StashedCommand *cmd)
 {
 	MemoryContext	oldcxt;
 	MemoryContext	tmpcxt;
 	OverrideSearchPath *overridePath;
-	char	   *command;
+	Jsonb	   *command;
+	Jsonb	   *result = NULL;
 
 	/*
 	 * Allocate everything done by the deparsing routines into a temp context,
@@ -4956,6 +5034,9 @@ deparse_utility_command(StashedCommand *cmd)
 								   ALLOCSET_DEFAULT_MAXSIZE);
 	oldcxt = MemoryContextSwitchTo(tmpcxt);
 
+	/* start with an empty name cache, allocated in the temp context */
+	deparse_name_cache = NULL;
+
 	/*
 	 * Many routines underlying this one will invoke ruleutils.c functionality
 	 * in order to obtain deparsed versions of expressions.  In such results,
@@ -4985,14 +5066,15 @@ deparse_utility_command(StashedCommand *cmd)
 
 	PopOverrideSearchPath();
 
-	/*
-	 * XXX to avoid the pstrdup we could have the routines return the
-	 * ObjTree and do the jsonize_objtree() here after changing cxt ...
-	 */
+	/* the jsonb blob is flat, so copying it out is cheap */
 	MemoryContextSwitchTo(oldcxt);
 	if (command != NULL)
-		command = pstrdup(command);
+	{
+		result = palloc(VARSIZE(command));
+		memcpy(result, command, VARSIZE(command));
+	}
+	deparse_name_cache = NULL;
 	MemoryContextDelete(tmpcxt);
 
-	return command;
+	return result;
 }
@@ -413,12 +413,14 @@ AllocateRelationDesc(Form_pg_class relp)
  *
  * tuple is the real pg_class tuple (not rd_rel!) for relation
  *
- * Note: rd_rel and (if an index) rd_am must be valid already
+ * Note: rd_rel and (if an index) rd_am, (if a sequence) rd_seqam must be
+ * valid already
  */
 static void
 RelationParseRelOptions(Relation relation, HeapTuple tuple)
 {
 	bytea	   *options;
+	Oid			amoptions = InvalidOid;
 
 	relation->rd_options = NULL;
 
@@ -431,19 +433,26 @@ RelationParseRelOptions(Relation relation, HeapTuple tuple)
 		case RELKIND_VIEW:
 		case RELKIND_MATVIEW:
 			break;
+		case RELKIND_SEQUENCE:
+			/* sequences without an AM have no options to parse */
+			if (relation->rd_seqam == NULL)
+				return;
+			break;
 		default:
 			return;
 	}
 
+	if (relation->rd_rel->relkind == RELKIND_INDEX)
+		amoptions = relation->rd_am->amoptions;
+	else if (relation->rd_rel->relkind == RELKIND_SEQUENCE)
+		amoptions = relation->rd_seqam->seqamoptions;
+
 	/*
 	 * Fetch reloptions from tuple; have to use a hardwired descriptor because
 	 * we might not have any other for pg_class yet (consider executing this
 	 * code for pg_class itself)
 	 */
-	options = extractRelOptions(tuple,
-								GetPgClassDescriptor(),
-								relation->rd_rel->relkind == RELKIND_INDEX ?
-								relation->rd_am->amoptions : InvalidOid);
+	options = extractRelOptions(tuple, GetPgClassDescriptor(), amoptions);
 
 	/*
 	 * Copy parsed data into CacheMemoryContext.  To guard against the
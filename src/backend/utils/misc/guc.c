@@ -59,8 +59,12 @@
 #include "postmaster/postmaster.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/walwriter.h"
+#include "replication/decodegroup.h"
 #include "replication/logical.h"
+#include "replication/logicalfuncs.h"
+#include "replication/reorderbuffer.h"
 #include "replication/slot.h"
+#include "replication/snapbuild.h"
 #include "replication/syncrep.h"
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
@@ -371,6 +375,7 @@ static const struct config_enum_entry constraint_exclusion_options[] = {
 static const struct config_enum_entry synchronous_commit_options[] = {
 	{"local", SYNCHRONOUS_COMMIT_LOCAL_FLUSH, false},
 	{"remote_write", SYNCHRONOUS_COMMIT_REMOTE_WRITE, false},
+	{"remote_apply", SYNCHRONOUS_COMMIT_REMOTE_APPLY, false},
 	{"on", SYNCHRONOUS_COMMIT_ON, false},
 	{"off", SYNCHRONOUS_COMMIT_OFF, false},
 	{"true", SYNCHRONOUS_COMMIT_ON, true},
@@ -883,6 +888,15 @@ static struct config_bool ConfigureNamesBool[] =
 		false,
 		NULL, NULL, NULL
 	},
+	{
+		{"logical_decoding_spill_compression", PGC_USERSET, RESOURCES_DISK,
+			gettext_noop("Compresses transaction data spilled to disk by logical decoding."),
+			NULL
+		},
+		&logical_decoding_spill_compression,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"full_page_writes", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("Writes full pages to WAL when first modified after a checkpoint."),
@@ -1448,6 +1462,17 @@ static struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"shared_logical_decoding", PGC_POSTMASTER, REPLICATION_SENDING,
+			gettext_noop("Shares WAL decoding between WAL senders streaming changes "
+						 "from the same database with the same output plugin."),
+			NULL
+		},
+		&shared_logical_decoding,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"hot_standby", PGC_POSTMASTER, REPLICATION_STANDBY,
 			gettext_noop("Allows connections and queries during recovery."),
@@ -1798,6 +1823,40 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"logical_decoding_work_mem", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum memory to be used for logical decoding."),
+			gettext_noop("This much memory can be used by each internal "
+						 "reorder buffer before spilling to disk."),
+			GUC_UNIT_KB
+		},
+		&logical_decoding_work_mem,
+		65536, 64, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"logical_decoding_readahead", PGC_USERSET, RESOURCES_DISK,
+			gettext_noop("Sets the amount of WAL logical decoding reads at once."),
+			gettext_noop("Zero reads one WAL page at a time."),
+			GUC_UNIT_KB
+		},
+		&logical_decoding_readahead,
+		128, 0, XLOG_SEG_SIZE / 1024,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"logical_decoding_serialize_interval", PGC_SIGHUP, RESOURCES_DISK,
+			gettext_noop("Sets the minimum time between snapshots serialized by logical decoding."),
+			gettext_noop("Zero serializes a snapshot at every serialization point."),
+			GUC_UNIT_MS
+		},
+		&logical_decoding_serialize_interval,
+		1000, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	/*
 	 * We use the hopefully-safely-small value of 100kB as the compiled-in
 	 * default for max_stack_depth.  InitializeGUCOptions will increase it if
@@ -1920,6 +1979,16 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"max_shared_sequences", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the maximum number of sequences whose values the shared sequence access method caches in shared memory."),
+			NULL
+		},
+		&max_shared_sequences,
+		64, 0, 65536,
+		NULL, NULL, NULL
+	},
+
 #ifdef LOCK_DEBUG
 	{
 		{"trace_lock_oidmin", PGC_SUSET, DEVELOPER_OPTIONS,
@@ -1965,6 +2034,16 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"shared_sequence_block_size", PGC_SIGHUP, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the number of values the shared sequence access method reserves at once."),
+			NULL
+		},
+		&shared_sequence_block_size,
+		1024, 1, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"vacuum_freeze_min_age", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Minimum age at which VACUUM should freeze a table row."),
@@ -2110,6 +2189,17 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"commit_ts_buffers", PGC_POSTMASTER, REPLICATION,
+			gettext_noop("Sets the number of disk-page buffers in shared memory for commit timestamps."),
+			gettext_noop("0 sets it based on shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&commit_ts_buffers,
+		0, 0, 131072,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_buffers", PGC_POSTMASTER, WAL_SETTINGS,
 			gettext_noop("Sets the number of disk-page buffers in shared memory for WAL."),
@@ -2165,6 +2255,42 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"wal_sender_flush_after", PGC_SIGHUP, REPLICATION_SENDING,
+			gettext_noop("Sets the amount of output a logical WAL sender "
+						 "collects before sending it."),
+			gettext_noop("0 sends every message immediately."),
+			GUC_UNIT_KB
+		},
+		&wal_sender_flush_after,
+		32, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"wal_sender_flush_delay", PGC_SIGHUP, REPLICATION_SENDING,
+			gettext_noop("Sets the maximum time a logical WAL sender delays "
+						 "sending output to collect more of it."),
+			gettext_noop("0 sends every message immediately."),
+			GUC_UNIT_MS
+		},
+		&wal_sender_flush_delay,
+		5, 0, 10000,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"shared_logical_decoding_queue_size", PGC_POSTMASTER, REPLICATION_SENDING,
+			gettext_noop("Sets the size of the queue in which a WAL sender receives "
+						 "changes decoded by another one."),
+			NULL,
+			GUC_UNIT_KB
+		},
+		&shared_logical_decoding_queue_size,
+		1024, 64, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"commit_delay", PGC_SUSET, WAL_SETTINGS,
 			gettext_noop("Sets the delay in microseconds between transaction commit and "
@@ -3224,7 +3350,7 @@ static struct config_string ConfigureNamesString[] =
 		},
 		&SyncRepStandbyNames,
 		"",
-		check_synchronous_standby_names, NULL, NULL
+		check_synchronous_standby_names, assign_synchronous_standby_names, NULL
 	},
 
 	{
@@ -60,6 +60,7 @@
 #include "access/subtrans.h"
 #include "access/transam.h"
 #include "access/xact.h"
+#include "replication/snapbuild.h"
 #include "storage/bufmgr.h"
 #include "storage/procarray.h"
 #include "utils/builtins.h"
@@ -1639,7 +1640,7 @@ HeapTupleSatisfiesHistoricMVCC(HeapTuple htup, Snapshot snapshot,
 		return false;
 	}
 	/* check if it's a committed transaction in [xmin, xmax) */
-	else if (TransactionIdInArray(xmin, snapshot->xip, snapshot->xcnt))
+	else if (SnapBuildXidCommitted(snapshot, xmin))
 	{
 		/* fall through */
 	}
@@ -1709,8 +1710,8 @@ HeapTupleSatisfiesHistoricMVCC(HeapTuple htup, Snapshot snapshot,
 	/* above xmax horizon, we cannot possibly see the deleting transaction */
 	else if (TransactionIdFollowsOrEquals(xmax, snapshot->xmax))
 		return true;
-	/* xmax is between [xmin, xmax), check known committed array */
-	else if (TransactionIdInArray(xmax, snapshot->xip, snapshot->xcnt))
+	/* xmax is between [xmin, xmax), check known committed set */
+	else if (SnapBuildXidCommitted(snapshot, xmax))
 		return false;
 	/* xmax is between [xmin, xmax), but known not to have committed yet */
 	else
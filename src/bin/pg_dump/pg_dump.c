@@ -14367,7 +14367,15 @@ dumpSequence(Archive *fout, TableInfo *tbinfo)
 	 * restored.
 	 */
 	if (amname != NULL && strcmp(amname, "local") != 0)
+	{
 		appendPQExpBuffer(query, "\n    USING %s", fmtId(amname));
+		if (nonemptyReloptions(tbinfo->reloptions))
+		{
+			appendPQExpBufferStr(query, " WITH (");
+			fmtReloptionsArray(fout, query, tbinfo->reloptions, "");
+			appendPQExpBufferChar(query, ')');
+		}
+	}
 
 	free(amname);
 
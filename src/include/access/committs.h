@@ -16,6 +16,7 @@
 
 
 extern PGDLLIMPORT bool	commit_ts_enabled;
+extern int	commit_ts_buffers;
 
 typedef uint32 CommitExtraData;
 
@@ -28,12 +29,16 @@ extern void TransactionIdGetCommitTsData(TransactionId xid, TimestampTz *ts,
 							 CommitExtraData *data);
 extern TransactionId GetLatestCommitTimestampData(TimestampTz *ts,
 							 CommitExtraData *extra);
+extern bool CommitTsGetXidRange(TimestampTz from, TimestampTz to,
+					TransactionId *first_xid, TransactionId *last_xid);
 
 extern Size CommitTsShmemBuffers(void);
+extern int	CommitTsNumLWLocks(void);
 extern Size CommitTsShmemSize(void);
 extern void CommitTsShmemInit(void);
 extern void BootStrapCommitTs(void);
 extern void StartupCommitTs(void);
+extern void StartupCommitTsIndex(void);
 extern void ShutdownCommitTs(void);
 extern void CheckPointCommitTs(void);
 extern void ExtendCommitTs(TransactionId newestXact);
@@ -46,9 +46,10 @@ typedef enum relopt_kind
 	RELOPT_KIND_SPGIST = (1 << 8),
 	RELOPT_KIND_VIEW = (1 << 9),
 	RELOPT_KIND_SEQUENCE = (1 << 10),
+	RELOPT_KIND_SHARED_SEQUENCE = (1 << 11),
 
 	/* if you add a new kind, make sure you update "last_default" too */
-	RELOPT_KIND_LAST_DEFAULT = RELOPT_KIND_SEQUENCE,
+	RELOPT_KIND_LAST_DEFAULT = RELOPT_KIND_SHARED_SEQUENCE,
 	/* some compilers treat enums as signed ints, so we can't use 1 << 31 */
 	RELOPT_KIND_MAX = (1 << 30)
 } relopt_kind;
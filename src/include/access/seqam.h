@@ -21,6 +21,7 @@
 #include "utils/relcache.h"
 #include "storage/buf.h"
 #include "storage/bufpage.h"
+#include "utils/timestamp.h"
 
 /*
  * We store a SeqTable item for every sequence we have touched in the current
@@ -44,18 +45,46 @@ typedef struct SeqTableData
 
 typedef SeqTableData *SeqTable;
 
+/* reloptions of sequences using the shared SeqAm */
+typedef struct SharedSeqOptions
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	int			block_size;		/* values reserved at once, or -1 */
+} SharedSeqOptions;
+
 extern char *default_seqam;
+extern int	max_shared_sequences;
+extern int	shared_sequence_block_size;
 
 Oid GetDefaultSeqAM(void);
 
 extern void sequence_alloc(Relation seqRelation, SeqTable seq_elem, Buffer buf, HeapTuple tup);
 extern void sequence_setval(Relation seqRelation, SeqTable seq_elem, Buffer buf, HeapTuple tup, int64 next, bool iscalled);
+extern bool sequence_nextval(Relation seqRelation, SeqTable seq_elem);
+extern void sequence_refill(Relation seqRelation, SeqTable seq_elem, Buffer buf, HeapTuple tup);
+extern bool sequence_has_refill(Relation seqRelation);
 
 
 extern void sequence_local_alloc(PG_FUNCTION_ARGS);
 extern void sequence_local_setval(PG_FUNCTION_ARGS);
 extern Datum sequence_local_options(PG_FUNCTION_ARGS);
 
+extern Datum sequence_shared_alloc(PG_FUNCTION_ARGS);
+extern Datum sequence_shared_setval(PG_FUNCTION_ARGS);
+extern Datum sequence_shared_nextval(PG_FUNCTION_ARGS);
+extern Datum sequence_shared_refill(PG_FUNCTION_ARGS);
+extern Datum sequence_shared_options(PG_FUNCTION_ARGS);
+extern void sequence_shared_invalidate(Relation seqrel);
+extern void sequence_shared_forget(Oid relid);
+extern Size SharedSeqShmemSize(void);
+extern void SharedSeqShmemInit(void);
+
+extern void sequence_low_watermark(Relation seqrel);
+extern void sequence_report_stall(Relation seqrel, TimestampTz start);
+extern Size SeqRefillShmemSize(void);
+extern void SeqRefillShmemInit(void);
+extern Datum pg_stat_get_sequence_refill(PG_FUNCTION_ARGS);
+
 extern Oid get_seqam_oid(const char *sequencename, bool missing_ok);
 
 extern void log_sequence_tuple(Relation seqrel, HeapTuple tup, Page page);
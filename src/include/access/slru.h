@@ -36,6 +36,12 @@
  */
 #define SLRU_PAGES_PER_SEGMENT	32
 
+/*
+ * Number of buffer slots in each bank of a banked SLRU, see
+ * SimpleLruInitBanked().
+ */
+#define SLRU_BANK_SIZE			16
+
 /*
  * Page status codes.  Note that these do not include the "dirty" bit.
  * page_dirty can be TRUE only in the VALID or WRITE_IN_PROGRESS states;
@@ -50,8 +56,27 @@ typedef enum
 	SLRU_PAGE_WRITE_IN_PROGRESS /* page is being written out */
 } SlruPageStatus;
 
+/*
+ * Activity counters of a bank, see pg_stat_slru.  Like the LRU counts, the
+ * hit counter is incremented while holding the bank lock in shared mode, so
+ * it might miss some increments.
+ */
+typedef struct SlruBankStats
+{
+	uint64		blks_zeroed;
+	uint64		blks_hit;
+	uint64		blks_read;
+	uint64		blks_written;
+} SlruBankStats;
+
 /*
  * Shared-memory state
+ *
+ * The buffer slots are divided into banks of consecutive slots, each
+ * protected by its own lock; a page can only be stored in the bank selected
+ * by its page number (see SlruBankOfPage()).  So operations on pages of
+ * different banks don't contend with each other.  Most SLRUs just consist of
+ * a single bank, whose lock is ControlLock.
  */
 typedef struct SlruSharedData
 {
@@ -60,6 +85,16 @@ typedef struct SlruSharedData
 	/* Number of buffers managed by this SLRU structure */
 	int			num_slots;
 
+	/* Number of banks, and number of buffers in each of them */
+	int			num_banks;
+	int			bank_size;
+
+	/* Per-bank locks; bank_locks[0] is ControlLock */
+	LWLock	  **bank_locks;
+
+	/* Per-bank activity counters */
+	SlruBankStats *bank_stats;
+
 	/*
 	 * Arrays holding info for each buffer slot.  Page number is undefined
 	 * when status is EMPTY, as is page_lru_count.
@@ -84,14 +119,14 @@ typedef struct SlruSharedData
 
 	/*----------
 	 * We mark a page "most recently used" by setting
-	 *		page_lru_count[slotno] = ++cur_lru_count;
-	 * The oldest page is therefore the one with the highest value of
-	 *		cur_lru_count - page_lru_count[slotno]
+	 *		page_lru_count[slotno] = ++cur_lru_count[bankno];
+	 * The oldest page of a bank is therefore the one with the highest value of
+	 *		cur_lru_count[bankno] - page_lru_count[slotno]
 	 * The counts will eventually wrap around, but this calculation still
 	 * works as long as no page's age exceeds INT_MAX counts.
 	 *----------
 	 */
-	int			cur_lru_count;
+	int		   *cur_lru_count;
 
 	/*
 	 * latest_page_number is the page number of the current end of the log;
@@ -99,6 +134,9 @@ typedef struct SlruSharedData
 	 * the latest page.
 	 */
 	int			latest_page_number;
+
+	/* name of the SLRU, for pg_stat_slru */
+	char		name[NAMEDATALEN];
 } SlruSharedData;
 
 typedef SlruSharedData *SlruShared;
@@ -133,10 +171,21 @@ typedef struct SlruCtlData
 
 typedef SlruCtlData *SlruCtl;
 
+/*
+ * Bank a page is stored in, and the lock protecting it.
+ */
+#define SlruBankOfPage(shared, pageno) \
+	((uint32) (pageno) % (uint32) (shared)->num_banks)
+#define SimpleLruGetBankLock(ctl, pageno) \
+	((ctl)->shared->bank_locks[SlruBankOfPage((ctl)->shared, pageno)])
+
 
 extern Size SimpleLruShmemSize(int nslots, int nlsns);
 extern void SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
 			  LWLock *ctllock, const char *subdir);
+extern int	SimpleLruNumBanks(int nslots);
+extern void SimpleLruInitBanked(SlruCtl ctl, const char *name, int nslots,
+					int nlsns, LWLock *ctllock, const char *subdir);
 extern int	SimpleLruZeroPage(SlruCtl ctl, int pageno);
 extern int SimpleLruReadPage(SlruCtl ctl, int pageno, bool write_ok,
 				  TransactionId xid);
@@ -146,6 +195,7 @@ extern void SimpleLruWritePage(SlruCtl ctl, int slotno);
 extern void SimpleLruFlush(SlruCtl ctl, bool checkpoint);
 extern void SimpleLruTruncate(SlruCtl ctl, int cutoffPage);
 extern bool SimpleLruDoesPhysicalPageExist(SlruCtl ctl, int pageno);
+extern SlruShared SimpleLruGetRegistered(int i);
 
 typedef bool (*SlruScanCallback) (SlruCtl ctl, char *filename, int segpage,
 											  void *data);
@@ -124,7 +124,7 @@ typedef struct VariableCacheData
 	Oid			oldestXidDB;	/* database with minimum datfrozenxid */
 
 	/*
-	 * These fields are protected by CommitTsControlLock
+	 * These fields are protected by CommitTsLock
 	 */
 	TransactionId oldestCommitTs;
 
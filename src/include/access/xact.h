@@ -57,7 +57,9 @@ typedef enum
 	SYNCHRONOUS_COMMIT_LOCAL_FLUSH,		/* wait for local flush only */
 	SYNCHRONOUS_COMMIT_REMOTE_WRITE,	/* wait for local flush and remote
 										 * write */
-	SYNCHRONOUS_COMMIT_REMOTE_FLUSH		/* wait for local and remote flush */
+	SYNCHRONOUS_COMMIT_REMOTE_FLUSH,	/* wait for local and remote flush */
+	SYNCHRONOUS_COMMIT_REMOTE_APPLY		/* wait for local flush and remote
+										 * apply */
 }	SyncCommitLevel;
 
 /* Define the default setting for synchronous_commit */
@@ -146,10 +148,15 @@ typedef struct xl_xact_commit
 	/* ARRAY OF SHARED INVALIDATION MESSAGES FOLLOWS */
 } xl_xact_commit;
 
+/*
+ * Replication origin of a commit, following the invalidation messages.  The
+ * origin's node id isn't repeated here, it's the record's xl_origin_id.  As
+ * the preceding arrays don't preserve alignment, it has to be copied out of
+ * the record before being accessed.
+ */
 typedef struct xl_xact_origin
 {
 	XLogRecPtr	origin_lsn;
-	RepNodeId	origin_node_id;
 	TimestampTz origin_timestamp;
 } xl_xact_origin;
 
@@ -55,7 +55,7 @@ typedef struct BkpBlock
 /*
  * Each page of XLOG file has a header like this:
  */
-#define XLOG_PAGE_MAGIC 0xD07E	/* can be used as WAL version indicator */
+#define XLOG_PAGE_MAGIC 0xD07F	/* can be used as WAL version indicator */
 
 typedef struct XLogPageHeaderData
 {
@@ -240,6 +240,10 @@ struct XLogRecord;
  * rmgr.c.
  *
  * RmgrTable[] is indexed by RmgrId values (see rmgrlist.h).
+ *
+ * rm_desc's rec points to the record's data, which always directly follows
+ * the record's XLogRecord header (see XLogRecGetData()), so the description
+ * can include fields of the header, too.
  */
 typedef struct RmgrData
 {
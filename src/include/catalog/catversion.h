@@ -53,6 +53,6 @@
  */
 
 /*							yyyymmddN */
-#define CATALOG_VERSION_NO	201409291
+#define CATALOG_VERSION_NO	202610178
 
 #endif
@@ -2681,7 +2681,7 @@ DATA(insert OID = 1936 (  pg_stat_get_backend_idset		PGNSP PGUID 12 1 100 0 0 f
 DESCR("statistics: currently active backend IDs");
 DATA(insert OID = 2022 (  pg_stat_get_activity			PGNSP PGUID 12 1 100 0 0 f f f f f t s 1 0 2249 "23" "{23,26,23,26,25,25,25,16,1184,1184,1184,1184,869,25,23,28,28}" "{i,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o}" "{pid,datid,pid,usesysid,application_name,state,query,waiting,xact_start,query_start,backend_start,state_change,client_addr,client_hostname,client_port,backend_xid,backend_xmin}" _null_ pg_stat_get_activity _null_ _null_ _null_ ));
 DESCR("statistics: information about currently active backends");
-DATA(insert OID = 3099 (  pg_stat_get_wal_senders	PGNSP PGUID 12 1 10 0 0 f f f f f t s 0 0 2249 "" "{23,25,3220,3220,3220,3220,23,25}" "{o,o,o,o,o,o,o,o}" "{pid,state,sent_location,write_location,flush_location,replay_location,sync_priority,sync_state}" _null_ pg_stat_get_wal_senders _null_ _null_ _null_ ));
+DATA(insert OID = 3099 (  pg_stat_get_wal_senders	PGNSP PGUID 12 1 10 0 0 f f f f f t s 0 0 2249 "" "{23,25,3220,3220,3220,3220,23,25,20,20,20,20,20,20,20,701,20,20,20,20,20}" "{o,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o}" "{pid,state,sent_location,write_location,flush_location,replay_location,sync_priority,sync_state,spill_txns,spill_count,spill_bytes,spill_disk_bytes,wal_reads,wal_read_bytes,wal_prefetches,wal_read_time,rel_cache_hits,rel_cache_misses,output_messages,output_bytes,output_flushes}" _null_ pg_stat_get_wal_senders _null_ _null_ _null_ ));
 DESCR("statistics: information about currently active replication");
 DATA(insert OID = 2026 (  pg_backend_pid				PGNSP PGUID 12 1 0 0 0 f f f f t f s 0 0 23 "" _null_ _null_ _null_ _null_ pg_backend_pid _null_ _null_ _null_ ));
 DESCR("statistics: current backend PID");
@@ -2751,6 +2751,10 @@ DATA(insert OID = 2845 (  pg_stat_get_db_blk_write_time PGNSP PGUID 12 1 0 0 0 f
 DESCR("statistics: block write time, in msec");
 DATA(insert OID = 3195 (  pg_stat_get_archiver		PGNSP PGUID 12 1 0 0 0 f f f f f f s 0 0 2249 "" "{20,25,1184,20,25,1184,1184}" "{o,o,o,o,o,o,o}" "{archived_count,last_archived_wal,last_archived_time,failed_count,last_failed_wal,last_failed_time,stats_reset}" _null_ pg_stat_get_archiver _null_ _null_ _null_ ));
 DESCR("statistics: information about WAL archiver");
+DATA(insert OID = 6030 (  pg_stat_get_sequence_refill	PGNSP PGUID 12 1 100 0 0 f f f f f t s 0 0 2249 "" "{26,20,20,20,701,1184}" "{o,o,o,o,o,o}" "{relid,refill_requests,refills,stalls,stall_time,last_refill}" _null_ pg_stat_get_sequence_refill _null_ _null_ _null_ ));
+DESCR("statistics: background refills of sequence ranges");
+DATA(insert OID = 3218 (  pg_stat_get_slru			PGNSP PGUID 12 1 10 0 0 f f f f f t s 0 0 2249 "" "{25,23,23,20,20,20,20}" "{o,o,o,o,o,o,o}" "{name,buffers,banks,blks_zeroed,blks_hit,blks_read,blks_written}" _null_ pg_stat_get_slru _null_ _null_ _null_ ));
+DESCR("statistics: information about SLRU caches");
 DATA(insert OID = 2769 ( pg_stat_get_bgwriter_timed_checkpoints PGNSP PGUID 12 1 0 0 0 f f f f t f s 0 0 20 "" _null_ _null_ _null_ _null_ pg_stat_get_bgwriter_timed_checkpoints _null_ _null_ _null_ ));
 DESCR("statistics: number of timed checkpoints started by the bgwriter");
 DATA(insert OID = 2770 ( pg_stat_get_bgwriter_requested_checkpoints PGNSP PGUID 12 1 0 0 0 f f f f t f s 0 0 20 "" _null_ _null_ _null_ _null_ pg_stat_get_bgwriter_requested_checkpoints _null_ _null_ _null_ ));
@@ -2990,6 +2994,9 @@ DESCR("get commit time and additional data from transaction commit timestamp rec
 DATA(insert OID = 3790 ( pg_get_latest_transaction_committime_data PGNSP PGUID 12 1 0 0 0 f f f f t f s 0 0 2249 "" "{28,1184,23}" "{o,o,o}" "{xid,committime,extradata}" _null_ pg_get_latest_transaction_committime_data _null_ _null_ _null_ ));
 DESCR("get transaction Id, commit timestamp and additional data of latest transaction commit");
 
+DATA(insert OID = 3255 ( pg_xid_range_for_committime PGNSP PGUID 12 1 0 0 0 f f f f t f v 2 0 2249 "1184 1184" "{1184,1184,28,28}" "{i,i,o,o}" "{from_time,to_time,first_xid,last_xid}" _null_ pg_xid_range_for_committime _null_ _null_ _null_ ));
+DESCR("get range of transaction Ids that may have committed between two timestamps");
+
 DATA(insert OID = 3537 (  pg_describe_object		PGNSP PGUID 12 1 0 0 0 f f f f t f s 3 0 25 "26 26 23" _null_ _null_ _null_ _null_ pg_describe_object _null_ _null_ _null_ ));
 DESCR("get identification of SQL object");
 
@@ -4995,18 +5002,32 @@ DATA(insert OID = 6023 (  sequence_local_setval	   PGNSP PGUID 12 1 0 0 0 f f f
 DESCR("Local SequenceAM setval");
 DATA(insert OID = 6024 (  sequence_local_options	   PGNSP PGUID 12 1 0 0 0 f f f f t f s 2 0 2281 "2281 16" _null_ _null_ _null_ _null_ sequence_local_options _null_ _null_ _null_ ));
 DESCR("Local SequenceAM options");
+DATA(insert OID = 6026 (  sequence_shared_alloc	   PGNSP PGUID 12 1 0 0 0 f f f f t f s 4 0 2281 "2281 2281 2281 2281" _null_ _null_ _null_ _null_ sequence_shared_alloc _null_ _null_ _null_ ));
+DESCR("Shared SequenceAM allocation");
+DATA(insert OID = 6027 (  sequence_shared_setval	   PGNSP PGUID 12 1 0 0 0 f f f f t f s 6 0 2281 "2281 2281 2281 2281 20 16" _null_ _null_ _null_ _null_ sequence_shared_setval _null_ _null_ _null_ ));
+DESCR("Shared SequenceAM setval");
+DATA(insert OID = 6028 (  sequence_shared_nextval	   PGNSP PGUID 12 1 0 0 0 f f f f t f s 2 0 16 "2281 2281" _null_ _null_ _null_ _null_ sequence_shared_nextval _null_ _null_ _null_ ));
+DESCR("Shared SequenceAM nextval");
+DATA(insert OID = 6029 (  sequence_shared_refill	   PGNSP PGUID 12 1 0 0 0 f f f f t f s 4 0 2281 "2281 2281 2281 2281" _null_ _null_ _null_ _null_ sequence_shared_refill _null_ _null_ _null_ ));
+DESCR("Shared SequenceAM background refill");
+DATA(insert OID = 6031 (  sequence_shared_options	   PGNSP PGUID 12 1 0 0 0 f f f f t f s 2 0 2281 "2281 16" _null_ _null_ _null_ _null_ sequence_shared_options _null_ _null_ _null_ ));
+DESCR("Shared SequenceAM options");
 
 DATA(insert OID = 6040 (  pg_xlog_wait_remote_apply PGNSP PGUID 12 1 0 0 0 f f f f f f v 2 0 2278 "3220 23" _null_ _null_ _null_ _null_ pg_xlog_wait_remote_apply _null_ _null_ _null_ ));
 DESCR("wait for an lsn to be applied by a remote node");
 DATA(insert OID = 6041 (  pg_xlog_wait_remote_receive PGNSP PGUID 12 1 0 0 0 f f f f f f v 2 0 2278 "3220 23" _null_ _null_ _null_ _null_ pg_xlog_wait_remote_receive _null_ _null_ _null_ ));
 DESCR("wait for an lsn to be received by a remote node");
+DATA(insert OID = 6042 (  pg_xlog_wait_remote_apply PGNSP PGUID 12 1 0 0 0 f f f f f f v 4 0 16 "3220 23 23 23" _null_ _null_ "{lsn,pid,timeout,quorum}" _null_ pg_xlog_wait_remote_apply_quorum _null_ _null_ _null_ ));
+DESCR("wait for an lsn to be applied by a quorum of remote nodes, with timeout");
+DATA(insert OID = 6043 (  pg_xlog_wait_remote_receive PGNSP PGUID 12 1 0 0 0 f f f f f f v 4 0 16 "3220 23 23 23" _null_ _null_ "{lsn,pid,timeout,quorum}" _null_ pg_xlog_wait_remote_receive_quorum _null_ _null_ _null_ ));
+DESCR("wait for an lsn to be received by a quorum of remote nodes, with timeout");
 
 /* event triggers */
 DATA(insert OID = 3566 (  pg_event_trigger_dropped_objects		PGNSP PGUID 12 10 100 0 0 f f f f t t s 0 0 2249 "" "{26,26,23,16,16,25,25,25,25,1009,1009}" "{o,o,o,o,o,o,o,o,o,o,o}" "{classid, objid, objsubid, original, normal, object_type, schema_name, object_name, object_identity, address_names, address_args}" _null_ pg_event_trigger_dropped_objects _null_ _null_ _null_ ));
 DESCR("list objects dropped by the current command");
-DATA(insert OID = 3564 (  pg_event_trigger_get_creation_commands PGNSP PGUID 12 10 100 0 0 f f f f t t s 0 0 2249 "" "{26,26,23,25,25,25,25,16,114}" "{o,o,o,o,o,o,o,o,o}" "{classid,objid,objsubid,command_tag,object_type,schema,identity,in_extension,command}" _null_ pg_event_trigger_get_creation_commands _null_ _null_ _null_ ));
+DATA(insert OID = 3564 (  pg_event_trigger_get_creation_commands PGNSP PGUID 12 10 100 0 0 f f f f t t s 0 0 2249 "" "{26,26,23,25,25,25,25,16,3802}" "{o,o,o,o,o,o,o,o,o}" "{classid,objid,objsubid,command_tag,object_type,schema,identity,in_extension,command}" _null_ pg_event_trigger_get_creation_commands _null_ _null_ _null_ ));
 DESCR("list JSON-formatted commands executed by the current command");
-DATA(insert OID = 3565 (  pg_event_trigger_expand_command PGNSP PGUID 12 10 0 0 0 f f f f t f s 1 0 25 "114" _null_ _null_ _null_ _null_ pg_event_trigger_expand_command _null_ _null_ _null_ ));
+DATA(insert OID = 3565 (  pg_event_trigger_expand_command PGNSP PGUID 12 10 0 0 0 f f f f t f s 1 0 25 "3802" _null_ _null_ _null_ _null_ pg_event_trigger_expand_command _null_ _null_ _null_ ));
 DESCR("format JSON command");
 
 /* generic transition functions for ordered-set aggregates */
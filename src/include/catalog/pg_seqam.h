@@ -36,6 +36,8 @@ CATALOG(pg_seqam,32)
 	NameData	seqamname;			/* access method name */
 	regproc		seqamalloc;			/* get next allocation of range of values function */
 	regproc		seqamsetval;		/* set value function */
+	regproc		seqamnextval;		/* return AM-cached values, or 0 */
+	regproc		seqamrefill;		/* refill the AM's cache in background, or 0 */
 	regproc		seqamoptions;		/* parse AM-specific parameters */
 } FormData_pg_seqam;
 
@@ -50,20 +52,25 @@ typedef FormData_pg_seqam *Form_pg_seqam;
  *		compiler constants for pg_seqam
  * ----------------
  */
-#define Natts_pg_seqam						4
+#define Natts_pg_seqam						6
 #define Anum_pg_seqam_amname				1
 #define Anum_pg_seqam_amalloc				2
 #define Anum_pg_seqam_amsetval				3
-#define Anum_pg_seqam_amoptions				4
+#define Anum_pg_seqam_amnextval				4
+#define Anum_pg_seqam_amrefill				5
+#define Anum_pg_seqam_amoptions				6
 
 /* ----------------
  *		initial contents of pg_seqam
  * ----------------
  */
 
-DATA(insert OID = 2 (  local		sequence_local_alloc sequence_local_setval sequence_local_options));
+DATA(insert OID = 2 (  local		sequence_local_alloc sequence_local_setval - - sequence_local_options));
 DESCR("local sequence access method");
 #define LOCAL_SEQAM_OID 2
+DATA(insert OID = 6025 (  shared	sequence_shared_alloc sequence_shared_setval sequence_shared_nextval sequence_shared_refill sequence_shared_options));
+DESCR("sequence access method caching ranges of values in shared memory");
+#define SHARED_SEQAM_OID 6025
 
 #define DEFAULT_SEQAM	""
 
@@ -0,0 +1,60 @@
+/*-------------------------------------------------------------------------
+ * decodegroup.h
+ *	   Sharing of logical decoding between walsenders.
+ *
+ * Copyright (c) 2012-2014, PostgreSQL Global Development Group
+ *
+ * src/include/replication/decodegroup.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef DECODEGROUP_H
+#define DECODEGROUP_H
+
+#include "replication/logical.h"
+#include "storage/shm_mq.h"
+
+/* GUCs */
+extern bool shared_logical_decoding;
+extern int	shared_logical_decoding_queue_size;
+
+/*
+ * Called by the leader of a group while it is waiting for space in a
+ * member's queue, so it can keep servicing its own client meanwhile.
+ */
+typedef void (*DecodingGroupWaitCB) (void);
+
+/* outcome of DecodingGroupTryJoin() */
+typedef enum DecodingGroupJoinResult
+{
+	DECODING_GROUP_DECODE,		/* keep decoding WAL ourselves */
+	DECODING_GROUP_PENDING,		/* join request outstanding, don't decode */
+	DECODING_GROUP_JOINED		/* changes are now received from a leader */
+} DecodingGroupJoinResult;
+
+/* shared memory */
+extern Size DecodingGroupShmemSize(void);
+extern void DecodingGroupShmemInit(void);
+
+/* setup and teardown */
+extern void DecodingGroupStartup(LogicalDecodingContext *ctx,
+					 List *output_plugin_options,
+					 LogicalOutputPluginWriterPrepareWrite prepare_write,
+					 LogicalOutputPluginWriterWrite do_write,
+					 DecodingGroupWaitCB wait_cb);
+extern void DecodingGroupRelease(void);
+
+/* leader side */
+extern void DecodingGroupLeaderAdvance(bool wakeup);
+extern void DecodingGroupSendData(LogicalDecodingContext *ctx);
+extern void DecodingGroupForwardXmin(XLogRecPtr current_lsn,
+						 TransactionId xmin);
+extern void DecodingGroupForwardRestart(XLogRecPtr current_lsn,
+							XLogRecPtr restart_lsn);
+
+/* member side */
+extern DecodingGroupJoinResult DecodingGroupTryJoin(bool caught_up);
+extern XLogRecPtr DecodingGroupLeaderPosition(void);
+extern shm_mq_result DecodingGroupReceive(Size *nbytes, void **data);
+
+#endif
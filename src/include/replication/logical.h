@@ -40,6 +40,13 @@ typedef struct LogicalDecodingContext
 	OutputPluginCallbacks callbacks;
 	OutputPluginOptions options;
 
+	/*
+	 * Does the output plugin support streaming of in-progress transactions?
+	 * Set if the plugin registers the stream callbacks; the plugin can reset
+	 * it in its startup callback, e.g. depending on an option.
+	 */
+	bool		streaming;
+
 	/*
 	 * User specified options
 	 */
@@ -73,6 +80,15 @@ typedef struct LogicalDecodingContext
 	bool		prepared_write;
 	XLogRecPtr	write_location;
 	TransactionId write_xid;
+
+	/*
+	 * Contexts of other slots that are fed from this context's reorder
+	 * buffer, see decodegroup.c. For such a member context, group_start_lsn
+	 * is the position up to which the member had already decoded WAL itself;
+	 * transactions ending before that are not passed to it again.
+	 */
+	List	   *group_members;
+	XLogRecPtr	group_start_lsn;
 } LogicalDecodingContext;
 
 extern void CheckLogicalDecodingRequirements(void);
@@ -93,6 +109,19 @@ extern void DecodingContextFindStartpoint(LogicalDecodingContext *ctx);
 extern bool DecodingContextReady(LogicalDecodingContext *ctx);
 extern void FreeDecodingContext(LogicalDecodingContext *ctx);
 
+extern LogicalDecodingContext *CreateDecodingGroupMemberContext(
+								 LogicalDecodingContext *leader,
+								 ReplicationSlot *slot,
+								 XLogRecPtr start_lsn,
+								 List *output_plugin_options,
+						  LogicalOutputPluginWriterPrepareWrite prepare_write,
+						  LogicalOutputPluginWriterWrite do_write);
+extern void FreeDecodingGroupMemberContext(LogicalDecodingContext *leader,
+							   LogicalDecodingContext *ctx);
+
+extern bool FilterByOrigin(LogicalDecodingContext *ctx, RepNodeId origin_id);
+extern bool FilterByRelation(LogicalDecodingContext *ctx, RelFileNode *rnode);
+
 extern void LogicalIncreaseXminForSlot(XLogRecPtr lsn, TransactionId xmin);
 extern void LogicalIncreaseRestartDecodingForSlot(XLogRecPtr current_lsn,
 									  XLogRecPtr restart_lsn);
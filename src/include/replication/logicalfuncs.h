@@ -11,6 +11,30 @@
 
 #include "replication/logical.h"
 
+#include "portability/instr_time.h"
+
+/* GUC */
+extern int	logical_decoding_readahead;
+
+/* callback used by LogicalReadAheadPage() to actually read WAL */
+typedef void (*LogicalReadAheadReadCB) (char *buf, TimeLineID tli,
+												XLogRecPtr startptr,
+												Size count);
+
+/* counters maintained by LogicalReadAheadPage() */
+typedef struct LogicalReadAheadStats
+{
+	int64		reads;			/* number of times WAL was read */
+	int64		read_bytes;		/* amount of WAL read */
+	int64		prefetches;		/* number of segments prefetched */
+	instr_time	read_time;		/* time spent reading, if track_io_timing */
+} LogicalReadAheadStats;
+
+extern void LogicalReadAheadPage(char *cur_page, XLogRecPtr targetPagePtr,
+					 Size count, XLogRecPtr flushptr, TimeLineID tli,
+					 LogicalReadAheadReadCB read_cb);
+extern void LogicalReadAheadGetStats(LogicalReadAheadStats *stats);
+
 extern int logical_read_local_xlog_page(XLogReaderState *state,
 							 XLogRecPtr targetPagePtr,
 							 int reqLen, XLogRecPtr targetRecPtr,
@@ -26,6 +26,7 @@ typedef enum OutputPluginOutputType
 typedef struct OutputPluginOptions
 {
 	OutputPluginOutputType output_type;
+	bool		skip_toast_reassembly;
 } OutputPluginOptions;
 
 /*
@@ -82,6 +83,79 @@ typedef void (*LogicalDecodeMessageCB) (
 											 bool transactional, Size sz,
 											 const char *message);
 
+/*
+ * Filter changes by origin. Called while decoding WAL, before the change is
+ * queued in the reorder buffer, so returning true for changes the plugin
+ * isn't interested in avoids the cost of copying and reassembling them.
+ *
+ * Return true to skip the change.
+ */
+typedef bool (*LogicalDecodeFilterByOriginCB) (struct LogicalDecodingContext *ctx,
+														   RepNodeId origin_id);
+
+/*
+ * Filter changes by relation, like LogicalDecodeFilterByOriginCB. As no
+ * catalog access is possible while WAL is being decoded, only the relation's
+ * relfilenode is available here. Note that the TOAST table of a relation has
+ * its own relfilenode; filtering it while keeping its main table breaks the
+ * reassembly of toasted values.
+ *
+ * Return true to skip the change.
+ */
+typedef bool (*LogicalDecodeFilterRelationCB) (struct LogicalDecodingContext *ctx,
+														   RelFileNode *rnode);
+
+/*
+ * Called when starting to stream a block of changes from an in-progress
+ * transaction. Large transactions may be streamed in several blocks, each
+ * of them enclosed by stream_start and stream_stop.
+ */
+typedef void (*LogicalDecodeStreamStartCB) (struct LogicalDecodingContext *ctx,
+														 ReorderBufferTXN *txn);
+
+/*
+ * Called when done streaming a block of changes from an in-progress
+ * transaction.
+ */
+typedef void (*LogicalDecodeStreamStopCB) (struct LogicalDecodingContext *ctx,
+														ReorderBufferTXN *txn);
+
+/*
+ * Called for every individual change streamed from an in-progress
+ * transaction. "txn" may be a subtransaction of the streamed transaction,
+ * in which case txn->toplevel_xid is set.
+ */
+typedef void (*LogicalDecodeStreamChangeCB) (struct LogicalDecodingContext *ctx,
+														 ReorderBufferTXN *txn,
+														 Relation relation,
+												ReorderBufferChange *change);
+
+/*
+ * Called for every transactional message streamed from an in-progress
+ * transaction.
+ */
+typedef void (*LogicalDecodeStreamMessageCB) (struct LogicalDecodingContext *ctx,
+														  ReorderBufferTXN *txn,
+														  XLogRecPtr message_lsn,
+														  bool transactional,
+														  Size sz,
+														  const char *message);
+
+/*
+ * Called to discard the changes streamed for an aborted (sub-)transaction.
+ */
+typedef void (*LogicalDecodeStreamAbortCB) (struct LogicalDecodingContext *ctx,
+														ReorderBufferTXN *txn,
+														XLogRecPtr abort_lsn);
+
+/*
+ * Called when a transaction whose changes have been streamed commits. All
+ * remaining changes have been sent in a final stream block before.
+ */
+typedef void (*LogicalDecodeStreamCommitCB) (struct LogicalDecodingContext *ctx,
+														 ReorderBufferTXN *txn,
+														 XLogRecPtr commit_lsn);
+
 /*
  * Output plugin callbacks
  */
@@ -93,6 +167,20 @@ typedef struct OutputPluginCallbacks
 	LogicalDecodeCommitCB commit_cb;
 	LogicalDecodeShutdownCB shutdown_cb;
 	LogicalDecodeMessageCB message_cb;
+	LogicalDecodeFilterByOriginCB filter_by_origin_cb;
+	LogicalDecodeFilterRelationCB filter_relation_cb;
+
+	/*
+	 * Streaming of in-progress transactions. Either all of the start, stop,
+	 * change, abort and commit callbacks have to be provided, or none of
+	 * them. stream_message_cb is optional, like message_cb.
+	 */
+	LogicalDecodeStreamStartCB stream_start_cb;
+	LogicalDecodeStreamStopCB stream_stop_cb;
+	LogicalDecodeStreamChangeCB stream_change_cb;
+	LogicalDecodeStreamMessageCB stream_message_cb;
+	LogicalDecodeStreamAbortCB stream_abort_cb;
+	LogicalDecodeStreamCommitCB stream_commit_cb;
 } OutputPluginCallbacks;
 
 /* Functions in replication/logical/logical.c */
@@ -20,16 +20,17 @@
 #include "utils/snapshot.h"
 #include "utils/timestamp.h"
 
+/* GUC variables */
+extern PGDLLIMPORT int logical_decoding_work_mem;
+extern PGDLLIMPORT bool logical_decoding_spill_compression;
+
 /* an individual tuple, stored in one chunk of memory */
 typedef struct ReorderBufferTupleBuf
 {
-	/* position in preallocated list */
-	slist_node	node;
-
 	/* tuple header, the interesting bit for users of logical decoding */
 	HeapTupleData tuple;
 
-	/* pre-allocated size of tuple buffer, different from tuple size */
+	/* allocated size of tuple buffer, may differ from tuple size */
 	Size	alloc_tuple_size;
 
 	/* actual tuple data follows */
@@ -93,6 +94,14 @@ typedef struct ReorderBufferChange
 			ReorderBufferTupleBuf *oldtuple;
 			/* valid for INSERT || UPDATE */
 			ReorderBufferTupleBuf *newtuple;
+
+			/*
+			 * Attribute numbers of the externally stored values in newtuple
+			 * that were changed but whose chunks weren't kept for
+			 * reassembly. Only set while the change is passed to the output
+			 * plugin.
+			 */
+			Bitmapset  *toast_skipped;
 		}			tp;
 
 		struct
@@ -126,8 +135,13 @@ typedef struct ReorderBufferChange
 	}			data;
 
 	/*
-	 * While in use this is how a change is linked into a transactions,
-	 * otherwise it's the preallocated list.
+	 * Transaction whose memory accounting this change is included in, NULL
+	 * if it isn't accounted for.
+	 */
+	struct ReorderBufferTXN *txn;
+
+	/*
+	 * While in use this is how a change is linked into a transactions.
 	 */
 	dlist_node	node;
 } ReorderBufferChange;
@@ -211,6 +225,12 @@ typedef struct ReorderBufferTXN
 	 */
 	uint64		nentries_mem;
 
+	/*
+	 * Size of the changes of this transaction kept in memory, in bytes.
+	 * Changes in subtransactions are *not* included but tracked separately.
+	 */
+	Size		size;
+
 	/*
 	 * Has this transaction been spilled to disk?  It's not always possible to
 	 * deduce that fact by comparing nentries with nentries_mem, because
@@ -220,6 +240,21 @@ typedef struct ReorderBufferTXN
 	 */
 	bool		serialized;
 
+	/*
+	 * Have changes of this transaction already been passed to the output
+	 * plugin using the stream callbacks, before its commit was seen?
+	 */
+	bool		streamed;
+
+	/*
+	 * Snapshot and CommandId the last stream block of a streamed toplevel
+	 * transaction ended with, so the next block can continue from there, and
+	 * the LSN of the last catalog snapshot that block switched to.
+	 */
+	Snapshot	snapshot_now;
+	CommandId	command_id;
+	XLogRecPtr	snapshot_lsn;
+
 	/*
 	 * List of ReorderBufferChange structs, including new Snapshots and new
 	 * CommandIds
@@ -260,10 +295,9 @@ typedef struct ReorderBufferTXN
 	SharedInvalidationMessage *invalidations;
 
 	/* ---
-	 * Position in one of three lists:
+	 * Position in one of two lists:
 	 * * list of subtransactions if we are *known* to be subxact
 	 * * list of toplevel xacts (can be an as-yet unknown subxact)
-	 * * list of preallocated ReorderBufferTXNs (if unused)
 	 * ---
 	 */
 	dlist_node	node;
@@ -299,6 +333,33 @@ typedef void (*ReorderBufferMessageCB) (
 												   bool transactional, Size sz,
 												   const char *message);
 
+/* stream start callback signature */
+typedef void (*ReorderBufferStreamStartCB) (
+												  ReorderBuffer *rb,
+												  ReorderBufferTXN *txn);
+
+/* stream stop callback signature */
+typedef void (*ReorderBufferStreamStopCB) (
+												 ReorderBuffer *rb,
+												 ReorderBufferTXN *txn);
+
+/* stream abort callback signature */
+typedef void (*ReorderBufferStreamAbortCB) (
+												  ReorderBuffer *rb,
+												  ReorderBufferTXN *txn,
+												  XLogRecPtr abort_lsn);
+
+/* stream commit callback signature */
+typedef void (*ReorderBufferStreamCommitCB) (
+												   ReorderBuffer *rb,
+												   ReorderBufferTXN *txn,
+												   XLogRecPtr commit_lsn);
+
+/* relation filter callback signature */
+typedef bool (*ReorderBufferFilterRelationCB) (
+												   ReorderBuffer *rb,
+												   RelFileNode *rnode);
+
 struct ReorderBuffer
 {
 	/*
@@ -321,6 +382,12 @@ struct ReorderBuffer
 	 */
 	dlist_head	txns_by_base_snapshot_lsn;
 
+	/*
+	 * Catalog snapshots built after catalog-modifying commits, ordered by
+	 * the LSN of those commits, see ReorderBufferAddCatalogSnapshot().
+	 */
+	dlist_head	catalog_snapshots;
+
 	/*
 	 * one-entry sized cache for by_txn. Very frequently the same txn gets
 	 * looked up over and over again.
@@ -336,6 +403,29 @@ struct ReorderBuffer
 	ReorderBufferCommitCB commit;
 	ReorderBufferMessageCB message;
 
+	/*
+	 * Callbacks to be called while streaming in-progress transactions.
+	 */
+	ReorderBufferStreamStartCB stream_start;
+	ReorderBufferStreamStopCB stream_stop;
+	ReorderBufferApplyChangeCB stream_change;
+	ReorderBufferMessageCB stream_message;
+	ReorderBufferStreamAbortCB stream_abort;
+	ReorderBufferStreamCommitCB stream_commit;
+
+	/*
+	 * Whether the output plugin wants TOASTed values to be reassembled, and
+	 * the callback telling whether it is interested in changes to a
+	 * relation. TOAST tables whose chunks aren't needed are remembered in
+	 * toast_filter, see ReorderBufferSetupToastFilter().
+	 * toast_chunks_dropped is set once any chunk may have been dropped while
+	 * decoding, and stays set even if the filter changes later on.
+	 */
+	bool		skip_toast_reassembly;
+	ReorderBufferFilterRelationCB filter_relation;
+	HTAB	   *toast_filter;
+	bool		toast_chunks_dropped;
+
 	/*
 	 * Pointer that will be passed untouched to the callbacks.
 	 */
@@ -347,32 +437,45 @@ struct ReorderBuffer
 	MemoryContext context;
 
 	/*
-	 * Data structure slab cache.
-	 *
-	 * We allocate/deallocate some structures very frequently, to avoid bigger
-	 * overhead we cache some unused ones here.
-	 *
-	 * The maximum number of cached entries is controlled by const variables
-	 * on top of reorderbuffer.c
+	 * Memory contexts for specific types objects
 	 */
-
-	/* cached ReorderBufferTXNs */
-	dlist_head	cached_transactions;
-	Size		nr_cached_transactions;
-
-	/* cached ReorderBufferChanges */
-	dlist_head	cached_changes;
-	Size		nr_cached_changes;
-
-	/* cached ReorderBufferTupleBufs */
-	slist_head	cached_tuplebufs;
-	Size		nr_cached_tuplebufs;
+	MemoryContext change_context;
+	MemoryContext txn_context;
+	MemoryContext tup_context;
 
 	XLogRecPtr	current_restart_decoding_lsn;
 
 	/* buffer for disk<->memory conversions */
 	char	   *outbuf;
 	Size		outbufsize;
+
+	/* block of serialized changes not yet written to disk */
+	char	   *spillbuf;
+	Size		spillbufsize;
+	Size		spillbuflen;
+
+	/* memory used by the changes of all transactions, in bytes */
+	Size		size;
+
+	/*
+	 * Statistics about transactions spilled to disk.
+	 *
+	 * A single transaction may be spilled repeatedly, which is why we keep
+	 * two different counters. For spilling, the transaction counter includes
+	 * both toplevel transactions and subtransactions.
+	 */
+	int64		spillTxns;		/* number of transactions spilled to disk */
+	int64		spillCount;		/* spill-to-disk invocation counter */
+	int64		spillBytes;		/* amount of data spilled to disk */
+	int64		spillDiskBytes; /* same, after compression */
+
+	/*
+	 * relfilenode => relation OID cache used while replaying changes, and
+	 * statistics about its use.
+	 */
+	HTAB	   *relfilenode_cache;
+	int64		relCacheHits;	/* relations found in the cache */
+	int64		relCacheMisses; /* relations looked up in the catalog */
 };
 
 
@@ -399,6 +502,7 @@ void		ReorderBufferForget(ReorderBuffer *, TransactionId, XLogRecPtr lsn);
 
 void		ReorderBufferSetBaseSnapshot(ReorderBuffer *, TransactionId, XLogRecPtr lsn, struct SnapshotData *snap);
 void		ReorderBufferAddSnapshot(ReorderBuffer *, TransactionId, XLogRecPtr lsn, struct SnapshotData *snap);
+void		ReorderBufferAddCatalogSnapshot(ReorderBuffer *, XLogRecPtr lsn, struct SnapshotData *snap);
 void ReorderBufferAddNewCommandId(ReorderBuffer *, TransactionId, XLogRecPtr lsn,
 							 CommandId cid);
 void ReorderBufferAddNewTupleCids(ReorderBuffer *, TransactionId, XLogRecPtr lsn,
@@ -416,6 +520,10 @@ TransactionId ReorderBufferGetOldestXmin(ReorderBuffer *rb);
 
 void		ReorderBufferSetRestartPoint(ReorderBuffer *, XLogRecPtr ptr);
 
+void ReorderBufferSetupToastFilter(ReorderBuffer *, bool skip_reassembly,
+							  ReorderBufferFilterRelationCB filter_relation);
+bool		ReorderBufferSkipToastChunk(ReorderBuffer *, RelFileNode *rnode);
+
 void		StartupReorderBuffer(void);
 
 #endif
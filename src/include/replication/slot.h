@@ -130,6 +130,20 @@ typedef struct ReplicationSlot
  */
 typedef struct ReplicationSlotCtlData
 {
+	/*
+	 * The oldest xmin, catalog xmin and restart LSN across all slots, as last
+	 * installed in the procarray and the xlog module, protected by mutex.
+	 * They let updates of a single slot skip recomputing them if they can't
+	 * change.  Recomputations are serialized by compute_lock; while one is
+	 * in progress, computing is > 0 and nobody may skip recomputing.
+	 */
+	slock_t		mutex;
+	LWLock	   *compute_lock;
+	int			computing;
+	TransactionId required_xmin;
+	TransactionId required_catalog_xmin;
+	XLogRecPtr	required_lsn;
+
 	ReplicationSlot replication_slots[1];
 } ReplicationSlotCtlData;
 
@@ -161,6 +175,10 @@ extern void ReplicationSlotMarkDirty(void);
 extern bool ReplicationSlotValidateName(const char *name, int elevel);
 extern void ReplicationSlotsComputeRequiredXmin(bool already_locked);
 extern void ReplicationSlotsComputeRequiredLSN(void);
+extern void ReplicationSlotsUpdateRequiredXmin(TransactionId old_xmin,
+								   TransactionId new_xmin, bool catalog);
+extern void ReplicationSlotsUpdateRequiredLSN(XLogRecPtr old_lsn,
+								  XLogRecPtr new_lsn);
 extern XLogRecPtr ReplicationSlotsComputeLogicalRestartLSN(void);
 extern bool ReplicationSlotsCountDBSlots(Oid dboid, int *nslots, int *nactive);
 
@@ -57,6 +57,12 @@ struct ReorderBuffer;
 struct xl_heap_new_cid;
 struct xl_running_xacts;
 
+/* GUCs */
+extern int	logical_decoding_serialize_interval;
+
+extern Size SnapBuildShmemSize(void);
+extern void SnapBuildShmemInit(void);
+
 extern void CheckPointSnapBuild(void);
 
 extern SnapBuild *AllocateSnapshotBuilder(struct ReorderBuffer *cache,
@@ -65,6 +71,7 @@ extern SnapBuild *AllocateSnapshotBuilder(struct ReorderBuffer *cache,
 extern void FreeSnapshotBuilder(SnapBuild *cache);
 
 extern void SnapBuildSnapDecRefcount(Snapshot snap);
+extern bool SnapBuildXidCommitted(Snapshot snap, TransactionId xid);
 
 extern const char *SnapBuildExportSnapshot(SnapBuild *snapstate);
 extern void SnapBuildClearExportedSnapshot(void);
@@ -23,17 +23,38 @@
 #define SYNC_REP_NO_WAIT		-1
 #define SYNC_REP_WAIT_WRITE		0
 #define SYNC_REP_WAIT_FLUSH		1
+#define SYNC_REP_WAIT_APPLY		2
 
-#define NUM_SYNC_REP_WAIT_MODE	2
+#define NUM_SYNC_REP_WAIT_MODE	3
 
 /* syncRepState */
 #define SYNC_REP_NOT_WAITING		0
 #define SYNC_REP_WAITING			1
 #define SYNC_REP_WAIT_COMPLETE		2
 
+/* SyncRepConfigData->syncrep_method */
+#define SYNC_REP_PRIORITY		0
+#define SYNC_REP_QUORUM			1
+
+/*
+ * Parsed synchronous_standby_names: how many standbys have to confirm a
+ * commit, how they are chosen, and the names of the candidates as
+ * consecutive null-terminated strings.
+ */
+typedef struct SyncRepConfigData
+{
+	int			config_size;	/* total size of this struct, in bytes */
+	int			num_sync;		/* number of standbys that have to confirm */
+	uint8		syncrep_method;	/* SYNC_REP_PRIORITY or SYNC_REP_QUORUM */
+	int			nmembers;		/* number of names in member_names */
+	char		member_names[1];	/* VARIABLE LENGTH ARRAY */
+} SyncRepConfigData;
+
 /* user-settable parameters for synchronous replication */
 extern char *SyncRepStandbyNames;
 
+extern SyncRepConfigData *SyncRepConfig;
+
 /* called by user backend */
 extern void SyncRepWaitForLSN(XLogRecPtr XactCommitLSN);
 
@@ -48,6 +69,7 @@ extern void SyncRepReleaseWaiters(void);
 extern void SyncRepUpdateSyncStandbysDefined(void);
 
 extern bool check_synchronous_standby_names(char **newval, void **extra, GucSource source);
+extern void assign_synchronous_standby_names(const char *newval, void *extra);
 extern void assign_synchronous_commit(int newval, void *extra);
 
 #endif   /* _SYNCREP_H */
@@ -14,6 +14,7 @@
 
 #include <signal.h>
 
+#include "access/xlogdefs.h"
 #include "fmgr.h"
 
 /* global state */
@@ -25,6 +26,8 @@ extern bool wake_wal_senders;
 /* user-settable parameters */
 extern int	max_wal_senders;
 extern int	wal_sender_timeout;
+extern int	wal_sender_flush_after;
+extern int	wal_sender_flush_delay;
 
 extern void InitWalSender(void);
 extern void exec_replication_command(const char *query_string);
@@ -33,6 +36,7 @@ extern void WalSndSignals(void);
 extern Size WalSndShmemSize(void);
 extern void WalSndShmemInit(void);
 extern void WalSndWakeup(void);
+extern void WalSndWakeupWaiters(XLogRecPtr flushed, int kinds);
 extern void WalSndInitStopping(void);
 extern void WalSndWaitStopping(void);
 extern void HandleWalSndInitStopping(void);
@@ -41,6 +45,13 @@ extern void WalSndRqstFileReload(void);
 extern Datum pg_stat_get_wal_senders(PG_FUNCTION_ARGS);
 extern Datum pg_xlog_wait_remote_apply(PG_FUNCTION_ARGS);
 extern Datum pg_xlog_wait_remote_receive(PG_FUNCTION_ARGS);
+extern Datum pg_xlog_wait_remote_apply_quorum(PG_FUNCTION_ARGS);
+extern Datum pg_xlog_wait_remote_receive_quorum(PG_FUNCTION_ARGS);
+
+/* kinds of walsenders to wake up in WalSndWakeupWaiters() */
+#define WALSND_WAKEUP_PHYSICAL		0x01
+#define WALSND_WAKEUP_LOGICAL		0x02
+#define WALSND_WAKEUP_ALL			(WALSND_WAKEUP_PHYSICAL | WALSND_WAKEUP_LOGICAL)
 
 /*
  * Remember that we want to wakeup walsenders later
@@ -52,16 +63,16 @@ extern Datum pg_xlog_wait_remote_receive(PG_FUNCTION_ARGS);
 	do { wake_wal_senders = true; } while (0)
 
 /*
- * wakeup walsenders if there is work to be done
+ * wakeup walsenders waiting for WAL up to flushed, if there is work to be done
  */
-#define WalSndWakeupProcessRequests()		\
+#define WalSndWakeupProcessRequests(flushed)	\
 	do										\
 	{										\
 		if (wake_wal_senders)				\
 		{									\
 			wake_wal_senders = false;		\
 			if (max_wal_senders > 0)		\
-				WalSndWakeup();				\
+				WalSndWakeupWaiters((flushed), WALSND_WAKEUP_ALL); \
 		}									\
 	} while (0)
 
@@ -28,6 +28,29 @@ typedef enum WalSndState
 	WALSNDSTATE_STOPPING
 } WalSndState;
 
+/*
+ * Walsenders waiting for WAL to be flushed are queued separately by the kind
+ * of replication they do, so e.g. the walreceiver only needs to wake up
+ * physical ones.
+ */
+typedef enum WalSndWaitQueueKind
+{
+	WALSND_QUEUE_PHYSICAL = 0,
+	WALSND_QUEUE_LOGICAL,
+	NUM_WALSND_WAIT_QUEUES
+} WalSndWaitQueueKind;
+
+/*
+ * Positions reported by standbys that backends can wait for, in
+ * pg_xlog_wait_remote_receive() and pg_xlog_wait_remote_apply().
+ */
+typedef enum WalSndRemoteWaitMode
+{
+	REMOTE_WAIT_RECEIVE = 0,
+	REMOTE_WAIT_APPLY,
+	NUM_REMOTE_WAIT_MODES
+} WalSndRemoteWaitMode;
+
 /*
  * Each walsender has a WalSnd struct in shared memory.
  */
@@ -48,6 +71,27 @@ typedef struct WalSnd
 	XLogRecPtr	flush;
 	XLogRecPtr	apply;
 
+	/* Statistics for transactions spilled to disk by logical decoding. */
+	int64		spillTxns;
+	int64		spillCount;
+	int64		spillBytes;
+	int64		spillDiskBytes;
+
+	/* Statistics for WAL read by logical decoding, see LogicalReadAheadPage */
+	int64		walReads;
+	int64		walReadBytes;
+	int64		walPrefetches;
+	double		walReadTime;	/* in msec */
+
+	/* Statistics for logical decoding's relfilenode cache */
+	int64		relCacheHits;
+	int64		relCacheMisses;
+
+	/* Statistics for data sent to the client, see WalSndFlush */
+	int64		outputMessages;
+	int64		outputBytes;
+	int64		outputFlushes;
+
 	/* Protects shared variables shown above. */
 	slock_t		mutex;
 
@@ -57,6 +101,13 @@ typedef struct WalSnd
 	 */
 	Latch		latch;
 
+	/*
+	 * Position in a wait queue, and the WAL location this walsender wants to
+	 * be woken up at.  Protected by the queue's mutex.
+	 */
+	SHM_QUEUE	waitLinks;
+	XLogRecPtr	waitLSN;
+
 	/*
 	 * The priority order of the standby managed by this WALSender, as listed
 	 * in synchronous_standby_names, or 0 if not-listed. Protected by
@@ -89,6 +140,20 @@ typedef struct
 	 */
 	bool		sync_standbys_defined;
 
+	/*
+	 * Queues of walsenders waiting for WAL to be flushed, ordered by the
+	 * location they wait for, each protected by its mutex.
+	 */
+	slock_t		waitQueueMutex[NUM_WALSND_WAIT_QUEUES];
+	SHM_QUEUE	waitQueue[NUM_WALSND_WAIT_QUEUES];
+
+	/*
+	 * Queues of backends waiting for standbys to receive or apply WAL,
+	 * ordered by the location they wait for and protected by remoteWaitMutex.
+	 */
+	slock_t		remoteWaitMutex;
+	SHM_QUEUE	remoteWaitQueue[NUM_REMOTE_WAIT_MODES];
+
 	WalSnd		walsnds[1];		/* VARIABLE LENGTH ARRAY */
 } WalSndCtlData;
 
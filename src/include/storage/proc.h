@@ -124,6 +124,14 @@ struct PGPROC
 	int			syncRepState;	/* wait state for sync rep */
 	SHM_QUEUE	syncRepLinks;	/* list link if process is in syncrep queue */
 
+	/*
+	 * Info to allow us to wait for remote nodes to receive or apply WAL, see
+	 * pg_xlog_wait_remote_apply().  Both are only used while holding
+	 * WalSndCtl->remoteWaitMutex.
+	 */
+	XLogRecPtr	remoteWaitLSN;	/* waiting for this LSN or higher */
+	SHM_QUEUE	remoteWaitLinks;	/* list link if waiting for remote nodes */
+
 	/*
 	 * All PROCLOCK objects for locks held or awaited by this backend are
 	 * linked into one of these lists, according to the partition number of
@@ -15,6 +15,7 @@
 #include "access/attnum.h"
 #include "nodes/nodes.h"
 #include "utils/aclchk.h"
+#include "utils/jsonb.h"
 
 
 /*
@@ -71,6 +72,6 @@ typedef struct StashedCommand
 	} d;
 } StashedCommand;
 
-extern char *deparse_utility_command(StashedCommand *cmd);
+extern Jsonb *deparse_utility_command(StashedCommand *cmd);
 
 #endif	/* DEPARSE_UTILITY_H */
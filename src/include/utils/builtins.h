@@ -1205,6 +1205,7 @@ extern Datum pg_get_transaction_committime(PG_FUNCTION_ARGS);
 extern Datum pg_get_transaction_extradata(PG_FUNCTION_ARGS);
 extern Datum pg_get_transaction_committime_data(PG_FUNCTION_ARGS);
 extern Datum pg_get_latest_transaction_committime_data(PG_FUNCTION_ARGS);
+extern Datum pg_xid_range_for_committime(PG_FUNCTION_ARGS);
 
 /* catalogs/dependency.c */
 extern Datum pg_describe_object(PG_FUNCTION_ARGS);
@@ -69,6 +69,8 @@ typedef struct RelationAmInfo
 	/* pg_seqam only */
 	FmgrInfo	seqamalloc;
 	FmgrInfo	seqamsetval;
+	FmgrInfo	seqamnextval;
+	FmgrInfo	seqamrefill;
 
 	/* Common */
 	FmgrInfo	amoptions;
@@ -0,0 +1,101 @@
+--
+-- Round-trip DDL commands through pg_event_trigger_get_creation_commands()
+-- and pg_event_trigger_expand_command(): capture the expanded commands, drop
+-- the objects, replay the commands, and check the catalogs look the same.
+--
+
+CREATE TABLE evttrig_deparse_commands (id serial, tag text, command text);
+
+CREATE FUNCTION evttrig_deparse_capture() RETURNS event_trigger
+LANGUAGE plpgsql AS $$
+BEGIN
+	INSERT INTO evttrig_deparse_commands (tag, command)
+		SELECT command_tag, pg_event_trigger_expand_command(command)
+		  FROM pg_event_trigger_get_creation_commands();
+END;
+$$;
+
+CREATE EVENT TRIGGER evttrig_deparse_capture ON ddl_command_end
+	WHEN TAG IN ('CREATE SCHEMA', 'CREATE TYPE', 'CREATE DOMAIN',
+		'CREATE TABLE')
+	EXECUTE PROCEDURE evttrig_deparse_capture();
+
+-- string arrays with quotes and backslashes are passed through jsonb
+CREATE SCHEMA evttrig_deparse;
+CREATE TYPE evttrig_deparse.mood AS ENUM
+	('happy', 'it''s ok', 'back\slash', 'say "hi"');
+CREATE DOMAIN evttrig_deparse.label AS text NOT NULL
+	CONSTRAINT label_check CHECK (VALUE <> 'don''t \ "quote"');
+CREATE TABLE evttrig_deparse.notes (
+	id integer NOT NULL,
+	mood evttrig_deparse.mood DEFAULT 'it''s ok',
+	tags text[] DEFAULT ARRAY['a''b', 'c\d', 'e"f'],
+	created timestamp(3) with time zone,
+	CONSTRAINT notes_tags_check CHECK (tags <> ARRAY['{}', '\'])
+);
+
+ALTER EVENT TRIGGER evttrig_deparse_capture DISABLE;
+
+SELECT tag FROM evttrig_deparse_commands ORDER BY id;
+
+CREATE FUNCTION evttrig_deparse_state(OUT object text, OUT definition text)
+RETURNS SETOF record
+LANGUAGE sql AS $$
+	SELECT format('enum label %s', e.enumsortorder), e.enumlabel::text
+	  FROM pg_enum e
+	 WHERE e.enumtypid = 'evttrig_deparse.mood'::regtype
+	UNION ALL
+	SELECT format('domain %s', t.oid::regtype),
+		   format('%s not null %s', format_type(t.typbasetype, t.typtypmod),
+				  t.typnotnull)
+	  FROM pg_type t JOIN pg_namespace n ON n.oid = t.typnamespace
+	 WHERE n.nspname = 'evttrig_deparse' AND t.typtype = 'd'
+	UNION ALL
+	SELECT format('column %s.%s', a.attrelid::regclass, a.attname),
+		   format('%s not null %s default %s collation %s',
+				  format_type(a.atttypid, a.atttypmod), a.attnotnull,
+				  pg_get_expr(d.adbin, d.adrelid), c.collname)
+	  FROM pg_attribute a
+	  LEFT JOIN pg_attrdef d ON d.adrelid = a.attrelid AND d.adnum = a.attnum
+	  LEFT JOIN pg_collation c ON c.oid = a.attcollation
+	 WHERE a.attrelid = 'evttrig_deparse.notes'::regclass
+	   AND a.attnum > 0 AND NOT a.attisdropped
+	UNION ALL
+	SELECT format('constraint %s', c.conname), pg_get_constraintdef(c.oid)
+	  FROM pg_constraint c JOIN pg_namespace n ON n.oid = c.connamespace
+	 WHERE n.nspname = 'evttrig_deparse'
+$$;
+
+CREATE TEMP TABLE evttrig_deparse_before AS
+	SELECT * FROM evttrig_deparse_state();
+SELECT count(*) FROM evttrig_deparse_before;
+
+-- drop everything, and recreate it from the expanded commands
+SET client_min_messages = warning;
+DROP SCHEMA evttrig_deparse CASCADE;
+RESET client_min_messages;
+
+DO $$
+DECLARE
+	cmd text;
+BEGIN
+	FOR cmd IN SELECT command FROM evttrig_deparse_commands ORDER BY id
+	LOOP
+		EXECUTE cmd;
+	END LOOP;
+END;
+$$;
+
+-- should both be empty
+SELECT * FROM evttrig_deparse_before
+EXCEPT SELECT * FROM evttrig_deparse_state();
+SELECT * FROM evttrig_deparse_state()
+EXCEPT SELECT * FROM evttrig_deparse_before;
+
+SET client_min_messages = warning;
+DROP SCHEMA evttrig_deparse CASCADE;
+RESET client_min_messages;
+DROP EVENT TRIGGER evttrig_deparse_capture;
+DROP FUNCTION evttrig_deparse_capture();
+DROP FUNCTION evttrig_deparse_state();
+DROP TABLE evttrig_deparse_commands;
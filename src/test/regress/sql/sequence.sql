@@ -199,3 +199,26 @@ SELECT * FROM information_schema.sequences WHERE sequence_name IN
 
 DROP USER seq_user;
 DROP SEQUENCE seq;
+
+-- Test the shared sequence access method
+CREATE SEQUENCE shared_seq INCREMENT 5 USING shared WITH (block_size = 10);
+SELECT reloptions FROM pg_class WHERE relname = 'shared_seq';
+SELECT nextval('shared_seq');
+SELECT nextval('shared_seq');
+-- the whole block is reserved on disk
+SELECT last_value, log_cnt, is_called FROM shared_seq;
+SELECT setval('shared_seq', 100);
+SELECT nextval('shared_seq');
+SELECT currval('shared_seq');
+-- switching access methods continues after the reserved block
+ALTER SEQUENCE shared_seq USING local;
+SELECT nextval('shared_seq');
+ALTER SEQUENCE shared_seq USING shared;
+SELECT nextval('shared_seq');
+-- values stay in order whether or not the next block was prefetched
+ALTER SEQUENCE shared_seq RESTART 1 INCREMENT 1 USING shared WITH (block_size = 4);
+SELECT nextval('shared_seq') FROM generate_series(1, 6);
+SELECT refill_requests FROM pg_stat_sequence_refill WHERE relname = 'shared_seq';
+-- the second block has the sequence's block_size, whoever reserved it
+SELECT last_value FROM shared_seq;
+DROP SEQUENCE shared_seq;